@@ -0,0 +1,159 @@
+/**
+ * Compile many source files at once, on a pool of threads that share one
+ * Compiler.
+ */
+
+#include "batch_compiler.hpp"
+
+#include <algorithm>   // std::max, std::min, std::sort
+#include <atomic>	   // std::atomic
+#include <chrono>	   // std::chrono
+#include <cstddef>	   // std::size_t
+#include <exception>   // std::exception
+#include <filesystem>  // std::filesystem
+#include <fstream>	   // std::ifstream
+#include <iostream>	   // std::endl
+#include <stdexcept>   // std::invalid_argument
+#include <string>	   // std::string, std::getline
+#include <thread>	   // std::thread
+#include <vector>	   // std::vector
+
+#include <TMCompiler/compiler/compiler.hpp>				// Compiler
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudgetExceeded, ParseStatistics
+#include <TMCompiler/utils/logger/logger.hpp>			// LOG
+
+// extension of the source files found in a directory
+const std::string source_extension{".cpp"};
+
+/**
+ * Compile one file, and catch what goes wrong.
+ * @param compiler: compiler of the batch
+ * @param file_name: file to compile
+ * @return whether it compiled, and the work it took
+ */
+auto compile_file(const Compiler& compiler, const std::string& file_name)
+	-> CompileResult {
+	CompileResult result{file_name, false, "", ParseStatistics{}, 0};
+	const std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	try {
+		compiler.compile(file_name, result.statistics);
+		result.success = true;
+	} catch(const ParseBudgetExceeded& e) {
+		result.error = e.what();
+		result.statistics = e.get_statistics();
+	} catch(const std::exception& e) {
+		result.error = e.what();
+	}
+
+	result.milliseconds = static_cast<std::size_t>(
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start)
+			.count());
+
+	return result;
+}
+
+/**
+ * Source files to compile at path: path itself if it is a file, or else every
+ * .cpp file under the directory path, in order of name, so that a batch
+ * reports its files in the same order from run to run.
+ *
+ * @param path: file or directory
+ * @return names of the source files
+ */
+auto find_source_files(const std::string& path) -> std::vector<std::string> {
+	if(!std::filesystem::is_directory(path)) {
+		return {path};
+	}
+
+	std::vector<std::string> file_names;
+	for(const std::filesystem::directory_entry& entry :
+		std::filesystem::recursive_directory_iterator(path)) {
+		if(entry.is_regular_file() &&
+		   entry.path().extension() == source_extension) {
+			file_names.push_back(entry.path().string());
+		}
+	}
+
+	std::sort(file_names.begin(), file_names.end());
+	return file_names;
+}
+
+/**
+ * File names listed in a file, one per line, for batches too large to pass
+ * on the command line.
+ *
+ * @param list_file_name: file of file names
+ * @return the file names, without empty lines
+ */
+auto read_file_list(const std::string& list_file_name)
+	-> std::vector<std::string> {
+	std::ifstream list_file{list_file_name};
+	if(!list_file.is_open()) {
+		LOG("ERROR") << "Unable to open file " << list_file_name << std::endl;
+		throw std::invalid_argument(std::string("Unable to open file ") +
+									list_file_name);
+	}
+
+	std::vector<std::string> file_names;
+	std::string line;
+	while(std::getline(list_file, line)) {
+		if(!line.empty()) {
+			file_names.push_back(line);
+		}
+	}
+
+	return file_names;
+}
+
+/**
+ * Compile files on a pool of threads that share compiler. Each thread takes
+ * the next file that no thread took yet, so a slow file does not hold up the
+ * files after it. A file that fails to compile is reported in its
+ * CompileResult, and does not stop the other files.
+ *
+ * @param compiler: compiler shared by all threads
+ * @param file_names: files to compile
+ * @param jobs: number of threads, or 0 for one per core
+ * @return outcome of each file, in the order of file_names
+ */
+auto compile_files(const Compiler& compiler,
+				   const std::vector<std::string>& file_names,
+				   std::size_t jobs) -> std::vector<CompileResult> {
+	if(jobs == 0) {
+		jobs = std::max(std::size_t{1},
+						static_cast<std::size_t>(
+							std::thread::hardware_concurrency()));
+	}
+	jobs = std::min(jobs, file_names.size());
+
+	LOG("INFO") << "Compiling " << file_names.size() << " files on " << jobs
+				<< " threads" << std::endl;
+
+	// each thread writes the results of its own files only
+	std::vector<CompileResult> results(file_names.size());
+	std::atomic<std::size_t> next_file{0};
+
+	const auto work = [&]() {
+		for(std::size_t i = next_file++; i < file_names.size();
+			i = next_file++) {
+			results[i] = compile_file(compiler, file_names[i]);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(std::size_t job = 1; job < jobs; ++job) {
+		workers.emplace_back(work);
+	}
+
+	// the calling thread is one of the jobs
+	work();
+
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+
+	return results;
+}
@@ -0,0 +1,56 @@
+/**
+ * Compile many source files at once, on a pool of threads that share one
+ * Compiler: the language specification and its grammar are read and built
+ * once, instead of once per file.
+ */
+
+#ifndef BATCH_COMPILER_HPP
+#define BATCH_COMPILER_HPP
+
+#include <cstddef>	// std::size_t
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/compiler.hpp>				// Compiler
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseStatistics
+
+// outcome of compiling one file of a batch
+struct CompileResult {
+	std::string file_name;
+	bool success;
+	// what went wrong, if not success
+	std::string error;
+	// work of parsing the file, as far as it got
+	ParseStatistics statistics;
+	// wall time of compiling the file
+	std::size_t milliseconds;
+};
+
+/**
+ * Source files to compile at path: path itself if it is a file, or else every
+ * .cpp file under the directory path, in order of name.
+ * @param path: file or directory
+ * @return names of the source files
+ */
+auto find_source_files(const std::string& path) -> std::vector<std::string>;
+
+/**
+ * File names listed in a file, one per line.
+ * @param list_file_name: file of file names
+ * @return the file names, without empty lines
+ */
+auto read_file_list(const std::string& list_file_name)
+	-> std::vector<std::string>;
+
+/**
+ * Compile files with compiler on jobs threads.
+ * @param compiler: compiler shared by all threads
+ * @param file_names: files to compile
+ * @param jobs: number of threads, or 0 for one per core
+ * @return outcome of each file, in the order of file_names
+ */
+auto compile_files(const Compiler& compiler,
+				   const std::vector<std::string>& file_names,
+				   std::size_t jobs) -> std::vector<CompileResult>;
+
+#endif
@@ -0,0 +1,466 @@
+/**
+ * Long-running compiler that takes requests on a local Unix socket, and the
+ * client side of its requests.
+ */
+
+#include "compile_server.hpp"
+
+#include <algorithm>   // std::max, std::min
+#include <array>	   // std::array
+#include <cerrno>	   // errno, ECONNABORTED, EINTR, EMFILE, ENFILE, ENOBUFS, ENOMEM
+#include <chrono>	   // std::chrono
+#include <cstddef>	   // std::size_t
+#include <cstdio>	   // std::remove
+#include <cstring>	   // std::strerror
+#include <exception>   // std::exception
+#include <filesystem>  // std::filesystem
+#include <iostream>	   // std::endl
+#include <memory>	   // std::make_shared, std::shared_ptr
+#include <mutex>	   // std::lock_guard, std::mutex, std::unique_lock
+#include <stdexcept>   // std::invalid_argument, std::runtime_error
+#include <string>	   // std::string, std::to_string
+#include <thread>	   // std::this_thread, std::thread
+#include <utility>	   // std::move
+#include <vector>	   // std::vector
+
+#include <sys/socket.h>	 // accept, bind, connect, listen, recv, send, setsockopt, shutdown, socket
+#include <sys/time.h>	 // timeval
+#include <sys/un.h>		 // sockaddr_un
+#include <unistd.h>		 // close
+
+#include <TMCompiler/compiler/compiler.hpp>				// Compiler
+#include <TMCompiler/compiler/models/embedded_specification.hpp>  // embedded_language_specification
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget
+#include <TMCompiler/utils/logger/logger.hpp>			// LOG
+
+// longest request line: a command and a file name
+constexpr std::size_t max_request_length = 4096;
+
+// seconds that a worker waits for the rest of a request, before it gives up
+// on a client that connected but sends nothing
+constexpr int request_timeout_seconds = 10;
+
+// connections that wait to be accepted
+constexpr int listen_backlog = 128;
+
+// milliseconds that serve() waits when accept runs out of descriptors or
+// memory, doubled while it goes on failing, so that it does not spin until the
+// connections being answered free some
+constexpr int min_accept_backoff_milliseconds = 10;
+constexpr int max_accept_backoff_milliseconds = 1000;
+
+// bytes read from a socket at a time
+constexpr std::size_t read_size = 256;
+
+const std::string compile_command{"compile "};
+const std::string stop_command{"stop"};
+
+/**
+ * Throw for a socket operation that failed, with the reason of errno.
+ * @param action: what failed
+ * @param socket_path: socket it failed on
+ * @param descriptor: socket to close first, or -1
+ */
+[[noreturn]] auto throw_socket_error(const std::string& action,
+									 const std::string& socket_path,
+									 const int descriptor) -> void {
+	const std::string reason = std::strerror(errno);
+	if(descriptor >= 0) {
+		close(descriptor);
+	}
+
+	LOG("ERROR") << "Unable to " << action << " " << socket_path << ": "
+				 << reason << std::endl;
+	throw std::runtime_error("Unable to " + action + " " + socket_path + ": " +
+							 reason);
+}
+
+/**
+ * @param socket_path: file of a Unix socket
+ * @return address of the socket
+ */
+auto make_address(const std::string& socket_path) -> sockaddr_un {
+	sockaddr_un address{};
+	if(socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::invalid_argument("Socket path " + socket_path +
+									" is too long");
+	}
+
+	address.sun_family = AF_UNIX;
+	socket_path.copy(static_cast<char*>(address.sun_path), socket_path.size());
+	return address;
+}
+
+/**
+ * Connect to a Unix socket.
+ * @param address: address of the socket
+ * @return descriptor of the connection, or -1 if nothing listens on it
+ */
+auto connect_to(const sockaddr_un& address) -> int {
+	const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(descriptor < 0) {
+		return -1;
+	}
+
+	if(connect(descriptor,
+			   reinterpret_cast<const sockaddr*>(&address),
+			   sizeof(address)) != 0) {
+		close(descriptor);
+		return -1;
+	}
+
+	return descriptor;
+}
+
+/**
+ * Read one line from a socket.
+ * @param descriptor: socket to read from
+ * @param line: set to the line without '\n', or to what was read until the
+ * other side closed the connection, the read timed out, or the line got
+ * longer than max_request_length
+ * @return true iff a '\n' ended a line of at most max_request_length bytes
+ */
+auto read_line(const int descriptor, std::string& line) -> bool {
+	line.clear();
+	std::array<char, read_size> buffer{};
+
+	while(line.find('\n') == std::string::npos &&
+		  line.size() <= max_request_length) {
+		const auto num_read = recv(descriptor, buffer.data(), buffer.size(), 0);
+		if(num_read <= 0) {
+			break;
+		}
+		line.append(buffer.data(), static_cast<std::size_t>(num_read));
+	}
+
+	const std::size_t end = line.find('\n');
+	line = line.substr(0, end);
+	return end != std::string::npos && end <= max_request_length;
+}
+
+/**
+ * Make reads from a connection give up after request_timeout_seconds, so that
+ * an idle client cannot hold a worker, or a stop request waiting on it.
+ * @param descriptor: accepted connection
+ */
+auto set_request_timeout(const int descriptor) -> void {
+	timeval timeout{};
+	timeout.tv_sec = request_timeout_seconds;
+	if(setsockopt(descriptor,
+				  SOL_SOCKET,
+				  SO_RCVTIMEO,
+				  &timeout,
+				  sizeof(timeout)) != 0) {
+		LOG("WARNING") << "Unable to time out requests: "
+					   << std::strerror(errno) << std::endl;
+	}
+}
+
+/**
+ * Write one line to a socket. If the other side closed the connection, the
+ * line is dropped.
+ * @param descriptor: socket to write to
+ * @param line: line without '\n'
+ */
+auto write_line(const int descriptor, const std::string& line) -> void {
+	const std::string text = line + "\n";
+
+	std::size_t sent = 0;
+	while(sent < text.size()) {
+		// MSG_NOSIGNAL: a closed connection is an error, not SIGPIPE
+		const auto num_sent = send(
+			descriptor, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+		if(num_sent <= 0) {
+			return;
+		}
+		sent += static_cast<std::size_t>(num_sent);
+	}
+}
+
+/**
+ * Constructor for CompileServer: build the compiler, and listen on the
+ * socket. Clients may connect as soon as it returns, and are served once
+ * serve() is called. A program whose parse goes over the parse budget is
+ * answered with an error.
+ *
+ * @param _spec_file_name: path of TOML file specifying the language, or empty
+ * for the specification that tmc was built with, which is never reloaded
+ * @param _socket_path: file of the Unix socket to listen on. A file left
+ * behind by a server that did not stop cleanly is replaced.
+ * @param _parse_budget: most work of the parse of each program, with 0 for no
+ * limit
+ */
+CompileServer::CompileServer(std::string _spec_file_name,
+							 std::string _socket_path,
+							 const ParseBudget& _parse_budget)
+	: spec_file_name(std::move(_spec_file_name)),
+	  socket_path(std::move(_socket_path)),
+	  parse_budget(_parse_budget),
+	  listen_descriptor(-1),
+	  compiler(make_compiler()),
+	  spec_write_time(spec_file_name.empty()
+						  ? std::filesystem::file_time_type{}
+						  : std::filesystem::last_write_time(spec_file_name)),
+	  stopping(false) {
+	const sockaddr_un address = make_address(socket_path);
+
+	const int other_server = connect_to(address);
+	if(other_server >= 0) {
+		close(other_server);
+		LOG("ERROR") << "A server already listens on " << socket_path
+					 << std::endl;
+		throw std::runtime_error("A server already listens on " +
+								 socket_path);
+	}
+	std::remove(socket_path.c_str());
+
+	listen_descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listen_descriptor < 0) {
+		throw_socket_error("create", socket_path, -1);
+	}
+
+	if(bind(listen_descriptor,
+			reinterpret_cast<const sockaddr*>(&address),
+			sizeof(address)) != 0 ||
+	   listen(listen_descriptor, listen_backlog) != 0) {
+		throw_socket_error("listen on", socket_path, listen_descriptor);
+	}
+
+	LOG("INFO") << "Listening on " << socket_path << std::endl;
+}
+
+/**
+ * Destructor for CompileServer: stop listening, and remove the socket file.
+ */
+CompileServer::~CompileServer() {
+	close(listen_descriptor);
+	std::remove(socket_path.c_str());
+}
+
+/**
+ * Accept and answer requests on jobs threads, until a stop request, or until
+ * the socket fails for a reason other than running out of descriptors or
+ * memory. The requests accepted before then are still answered.
+ *
+ * @param jobs: number of threads that answer requests, or 0 for one per core
+ */
+auto CompileServer::serve(std::size_t jobs) -> void {
+	if(jobs == 0) {
+		jobs = std::max(std::size_t{1},
+						static_cast<std::size_t>(
+							std::thread::hardware_concurrency()));
+	}
+
+	LOG("INFO") << "Serving " << socket_path << " on " << jobs << " threads"
+				<< std::endl;
+
+	std::vector<std::thread> workers;
+	for(std::size_t job = 0; job < jobs; ++job) {
+		workers.emplace_back([this]() { serve_connections(); });
+	}
+
+	int backoff_milliseconds = 0;
+	while(true) {
+		// a stop request shuts the socket down, which wakes up accept
+		const int connection = accept(listen_descriptor, nullptr, nullptr);
+		const int accept_error = errno;
+
+		{
+			const std::lock_guard<std::mutex> lock{connections_mutex};
+			if(stopping) {
+				if(connection >= 0) {
+					close(connection);
+				}
+				break;
+			}
+
+			if(connection >= 0) {
+				connections.push(connection);
+			}
+		}
+
+		if(connection >= 0) {
+			backoff_milliseconds = 0;
+			connections_changed.notify_one();
+			continue;
+		}
+
+		// a signal, or a client that gave up before it was accepted
+		if(accept_error == EINTR || accept_error == ECONNABORTED) {
+			continue;
+		}
+
+		if(accept_error != EMFILE && accept_error != ENFILE &&
+		   accept_error != ENOBUFS && accept_error != ENOMEM) {
+			LOG("ERROR") << "Unable to accept connections on " << socket_path
+						 << ": " << std::strerror(accept_error) << std::endl;
+			stop();
+			break;
+		}
+
+		// logged once for each run of failures, rather than on every retry
+		if(backoff_milliseconds == 0) {
+			LOG("WARNING") << "Unable to accept a connection: "
+						   << std::strerror(accept_error) << std::endl;
+		}
+		backoff_milliseconds =
+			std::min(max_accept_backoff_milliseconds,
+					 std::max(min_accept_backoff_milliseconds,
+							  2 * backoff_milliseconds));
+		std::this_thread::sleep_for(
+			std::chrono::milliseconds(backoff_milliseconds));
+	}
+
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+
+	LOG("INFO") << "Stopped serving " << socket_path << std::endl;
+}
+
+/**
+ * Build a compiler of the language specification file, or of the specification
+ * that tmc was built with, held to the parse budget of the server.
+ * @return the compiler, ready to be shared between threads
+ */
+auto CompileServer::make_compiler() const -> std::shared_ptr<const Compiler> {
+	const std::shared_ptr<Compiler> built =
+		spec_file_name.empty()
+			? std::make_shared<Compiler>(embedded_language_specification())
+			: std::make_shared<Compiler>(spec_file_name);
+	built->set_parse_budget(parse_budget);
+	return built;
+}
+
+/**
+ * Compiler of the language specification as it is now: built again if the
+ * specification file changed since it was last built. If it fails to build,
+ * the request that needed it fails, and the next request tries again.
+ *
+ * @return compiler, which stays valid while a request uses it, even if the
+ * specification changes meanwhile
+ */
+auto CompileServer::current_compiler() -> std::shared_ptr<const Compiler> {
+	const std::lock_guard<std::mutex> lock{compiler_mutex};
+	if(spec_file_name.empty()) {
+		return compiler;
+	}
+
+	const std::filesystem::file_time_type write_time =
+		std::filesystem::last_write_time(spec_file_name);
+	if(write_time != spec_write_time) {
+		LOG("INFO") << "Reloading " << spec_file_name << std::endl;
+		compiler = make_compiler();
+		spec_write_time = write_time;
+	}
+
+	return compiler;
+}
+
+/**
+ * Answer the connections that serve() accepted, one at a time, until the
+ * server stops and no connection is left.
+ */
+auto CompileServer::serve_connections() -> void {
+	while(true) {
+		int connection = -1;
+		{
+			std::unique_lock<std::mutex> lock{connections_mutex};
+			connections_changed.wait(lock, [this]() {
+				return stopping || !connections.empty();
+			});
+
+			if(connections.empty()) {
+				return;
+			}
+
+			connection = connections.front();
+			connections.pop();
+		}
+
+		set_request_timeout(connection);
+
+		std::string request;
+		if(read_line(connection, request)) {
+			write_line(connection, answer(request));
+		} else {
+			write_line(connection,
+					   "error Expected a request line of at most " +
+						   std::to_string(max_request_length) +
+						   " bytes within " +
+						   std::to_string(request_timeout_seconds) +
+						   " seconds");
+		}
+		close(connection);
+	}
+}
+
+/**
+ * Carry out one request.
+ * @param request: request line
+ * @return answer line: "ok", with the wall time of a compile request, or
+ * "error" and what went wrong
+ */
+auto CompileServer::answer(const std::string& request) -> std::string {
+	if(request == stop_command) {
+		stop();
+		return "ok";
+	}
+
+	if(request.rfind(compile_command, 0) != 0) {
+		return "error Unknown request: " + request;
+	}
+
+	const std::string file_name = request.substr(compile_command.size());
+	const std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	try {
+		current_compiler()->compile(file_name);
+	} catch(const std::exception& e) {
+		return std::string("error ") + e.what();
+	}
+
+	const auto milliseconds =
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start)
+			.count();
+	return "ok " + std::to_string(milliseconds) + " ms";
+}
+
+/**
+ * Stop accepting connections: serve() returns once the connections accepted
+ * so far are answered.
+ */
+auto CompileServer::stop() -> void {
+	{
+		const std::lock_guard<std::mutex> lock{connections_mutex};
+		stopping = true;
+	}
+
+	shutdown(listen_descriptor, SHUT_RDWR);
+	connections_changed.notify_all();
+}
+
+/**
+ * Send one request to a CompileServer, and wait for its answer. File names in
+ * requests are read by the server, so they should be absolute.
+ *
+ * @param socket_path: socket the server listens on
+ * @param request: request line, without '\n'
+ * @return answer line of the server, without '\n'
+ */
+auto send_compile_request(const std::string& socket_path,
+						  const std::string& request) -> std::string {
+	const int descriptor = connect_to(make_address(socket_path));
+	if(descriptor < 0) {
+		throw_socket_error("connect to", socket_path, -1);
+	}
+
+	write_line(descriptor, request);
+	std::string answer;
+	(void)read_line(descriptor, answer);
+	close(descriptor);
+
+	return answer;
+}
@@ -0,0 +1,88 @@
+/**
+ * Long-running compiler that takes requests on a local Unix socket, so that
+ * the language specification is read and its grammar built once, instead of
+ * once per invocation of tmc. See CompileServer.
+ */
+
+#ifndef COMPILE_SERVER_HPP
+#define COMPILE_SERVER_HPP
+
+#include <condition_variable>  // std::condition_variable
+#include <cstddef>			   // std::size_t
+#include <filesystem>		   // std::filesystem
+#include <memory>			   // std::shared_ptr
+#include <mutex>			   // std::mutex
+#include <queue>			   // std::queue
+#include <string>			   // std::string
+
+#include <TMCompiler/compiler/compiler.hpp>				// Compiler
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget
+
+/**
+ * Serves requests of one line each on a Unix socket, and answers each with one
+ * line:
+ *
+ * compile /path/to/program.cpp   ->  ok 12 ms  |  error <message>
+ * stop                           ->  ok
+ *
+ * The Compiler is kept between requests, and built again only once the
+ * language specification file changes. With no file, the specification that
+ * tmc was built with is served. Requests are served by a pool of
+ * threads that share the Compiler. A budget limits the parse of each program,
+ * so that one pathological program cannot hold up a thread indefinitely. A
+ * request longer than 4096 bytes, or not sent within 10 seconds, is answered
+ * with an error.
+ *
+ * CompileServer server{"TMCompiler/config/language.toml", "/tmp/tmc.sock"};
+ * server.serve(4);	 // until a stop request
+ *
+ * and from another process:
+ *
+ * send_compile_request("/tmp/tmc.sock", "compile /home/me/program.cpp");
+ */
+class CompileServer {
+public:
+	CompileServer(std::string _spec_file_name,
+				  std::string _socket_path,
+				  const ParseBudget& _parse_budget = ParseBudget{});
+	CompileServer(const CompileServer&) = delete;
+	auto operator=(const CompileServer&) -> CompileServer& = delete;
+	~CompileServer();
+	auto serve(std::size_t jobs) -> void;
+
+private:
+	std::string spec_file_name;
+	std::string socket_path;
+	// budget of the parse of each program
+	ParseBudget parse_budget;
+	int listen_descriptor;
+
+	// held while the compiler is read or built again
+	std::mutex compiler_mutex;
+	std::shared_ptr<const Compiler> compiler;
+	// last change of the specification that compiler was built from
+	std::filesystem::file_time_type spec_write_time;
+
+	// connections accepted, and not yet taken by a thread of the pool
+	std::mutex connections_mutex;
+	std::condition_variable connections_changed;
+	std::queue<int> connections;
+	bool stopping;
+
+	[[nodiscard]] auto make_compiler() const -> std::shared_ptr<const Compiler>;
+	auto current_compiler() -> std::shared_ptr<const Compiler>;
+	auto serve_connections() -> void;
+	auto answer(const std::string& request) -> std::string;
+	auto stop() -> void;
+};
+
+/**
+ * Send one request to a CompileServer, and wait for its answer.
+ * @param socket_path: socket the server listens on
+ * @param request: request line, without '\n'
+ * @return answer line of the server, without '\n'
+ */
+auto send_compile_request(const std::string& socket_path,
+						  const std::string& request) -> std::string;
+
+#endif
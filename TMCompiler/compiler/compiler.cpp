@@ -8,36 +8,83 @@
 
 #include "compiler.hpp"
 
+#include <cstddef>	  // std::ptrdiff_t, std::size_t
 #include <fstream>	  // std::ifstream
 #include <iostream>	  // std::endl
+#include <memory>	  // std::make_shared
 #include <set>		  // std::set
-#include <stdexcept>  // std::invalid_argument
-#include <string>	  // std::string, std::getline
+#include <stdexcept>  // std::invalid_argument, std::logic_error
+#include <string>	  // std::string, std::getline, std::to_string
+#include <utility>	  // std::move
 #include <vector>	  // std::vector
 
 #include <TMCompiler/compiler/lexer/lexer.hpp>					  // Lexer
 #include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
 #include <TMCompiler/compiler/models/rule.hpp>					  // Rule
-#include <TMCompiler/compiler/models/token.hpp>					  // Token
-#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
-#include <TMCompiler/utils/logger/logger.hpp>			 // LOG
+#include <TMCompiler/compiler/models/specification_cache.hpp>  // read_language_specification_cached
+#include <TMCompiler/compiler/models/token.hpp>				 // Token
+#include <TMCompiler/compiler/parser/bitset_recognizer.hpp>	 // BitsetRecognizer
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // EarleyRecognizer, SubParse
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseStatistics
+#include <TMCompiler/utils/logger/logger.hpp>			// LOG
+#include <TMCompiler/utils/tracer/tracer.hpp>			// TraceSpan
+
+// symbols of a function definition, which is a header followed by a body in
+// braces
+const std::string function_header{"function-header"};
+const std::string function_body{"compound-statement"};
+const std::string open_brace{"{"};
+const std::string close_brace{"}"};
 
 /**
  * Constructor for Compiler class.
  *
  * Initializes the LanguageSpecification struct containing
- * token regexes and BNF grammar, the data to parse source code.
+ * token regexes and BNF grammar, the data to parse source code. It is read
+ * from the binary cache next to the TOML file while the TOML file is
+ * unchanged.
  *
- * Then it marks certain symbols in the syntactical BNF as terminal: some
- * non-terminals actually appear in the lexical BNF instead, like "identifier"
- * and "constants".
+ * Then it builds the syntactical grammar once, for every program compiled
+ * after: it marks certain symbols in the syntactical BNF as terminal, since
+ * some non-terminals actually appear in the lexical BNF instead, like
+ * "identifier" and "constants".
  *
  * @param language_spec_file_name: path of TOML file specifying
  * programming language syntax
  */
-Compiler::Compiler(const std::string& language_spec_file_name) {
-	spec = LanguageSpecification::read_language_specification_toml(
-		language_spec_file_name);
+Compiler::Compiler(const std::string& language_spec_file_name)
+	: spec(read_language_specification_cached(language_spec_file_name)),
+	  grammar(std::make_shared<const Grammar>(make_grammar())) {
+}
+
+/**
+ * Constructor for Compiler class, of a language specification that is read
+ * already: the grammar is built as by the constructor above.
+ *
+ * @param _spec: language specification, like the one that was generated from
+ * the TOML file at build time
+ */
+Compiler::Compiler(LanguageSpecification _spec)
+	: spec(std::move(_spec)),
+	  grammar(std::make_shared<const Grammar>(make_grammar())) {
+}
+
+/**
+ * Limit the work of parsing each program: the recognizer that the lexer feeds
+ * tokens to stops as soon as its Earley state sets go over budget, and the
+ * parse tree search after it goes on counting from there.
+ *
+ * Not thread-safe: call it before the Compiler is shared between threads.
+ * The grammar is copied once with the budget, so that a LazyParse made before
+ * keeps parsing its bodies with the grammar it parsed the headers with.
+ *
+ * @param budget: most work of one parse, with 0 for no limit
+ */
+auto Compiler::set_parse_budget(const ParseBudget& budget) -> void {
+	const std::shared_ptr<Grammar> budgeted =
+		std::make_shared<Grammar>(*grammar);
+	budgeted->set_parse_budget(budget);
+	grammar = budgeted;
 }
 
 /**
@@ -47,8 +94,297 @@ Compiler::Compiler(const std::string& language_spec_file_name) {
  * @param file_name: name of file containing source code to be compiled
  */
 auto Compiler::compile(const std::string& file_name) const -> void {
+	ParseStatistics statistics;
+	compile(file_name, statistics);
+}
+
+/**
+ * Wrapper program that reads in source code from file_name and compiles the
+ * text, and reports the work of parsing it.
+ *
+ * @param file_name: name of file containing source code to be compiled
+ * @param statistics: set to the work of parsing the source code
+ */
+auto Compiler::compile(const std::string& file_name,
+					   ParseStatistics& statistics) const -> void {
+	const TraceSpan span{"compile", file_name};
 	LOG("INFO") << "Compiling " << file_name << std::endl;
 
+	const std::string program_text = read_program(file_name);
+
+	// TODO(bwang1008): should compile_text be responsible for writing out to
+	// files?
+	compile_text(program_text, statistics);
+
+	LOG("INFO") << "Compilation finished!" << std::endl;
+}
+
+/**
+ * Program that parses source code string and generates equivalent program
+ * in a different backend architecture.
+ *
+ * @param program_text: source code to be be compiled, with '\n' between lines
+ */
+auto Compiler::compile_text(const std::string& program_text) const -> void {
+	ParseStatistics statistics;
+	compile_text(program_text, statistics);
+}
+
+/**
+ * Program that parses source code string and generates equivalent program
+ * in a different backend architecture, and reports the work of parsing it.
+ *
+ * @param program_text: source code to be be compiled, with '\n' between lines
+ * @param statistics: set to the work of parsing the source code
+ */
+auto Compiler::compile_text(const std::string& program_text,
+							ParseStatistics& statistics) const -> void {
+	// 1. Front-end: tokenization and parsing of program_text
+	std::vector<SubParse> parse_tree =
+		generate_parse_tree(program_text, statistics);
+
+	// 2. Middle-end: type-checking, identifiers are declared, functions that
+	// are called exist, main exists, no double declaration
+	{
+		const TraceSpan span{"semantic analysis"};
+		LOG("INFO") << "Performing standard checks" << std::endl;
+		// TODO(bwang1008): implement middle-end
+		//
+		// (semantic analysis)
+		// make sure identifiers are declared
+		// type checking
+		// no "break;" on its own line outside of loop
+	}
+
+	// 3. Back-end: convert parse_tree into architecture-specific representation
+	// / code-generation
+	{
+		const TraceSpan span{"backend"};
+		LOG("INFO") << "Pass to backend "
+					<< "Multitape Turing Machine" << std::endl;
+		// TODO(bwang1008):  implement back-ends, each phase in a TraceSpan of
+		// its own
+	}
+}
+
+/**
+ * Check the syntax of the source code in file_name, without building a parse
+ * tree.
+ *
+ * @param file_name: name of file containing source code to be checked
+ * @return whether the syntax is valid, and where the first error is
+ */
+auto Compiler::check(const std::string& file_name) const -> SyntaxCheck {
+	LOG("INFO") << "Checking syntax of " << file_name << std::endl;
+	return check_text(read_program(file_name));
+}
+
+/**
+ * Check the syntax of source code by recognizing its tokens as the lexer finds
+ * them. Neither the tokens nor the Earley state sets that later tokens cannot
+ * need are kept, so memory does not grow with the length of the program. A
+ * small grammar is recognized by BitsetRecognizer, and any other one by
+ * EarleyRecognizer.
+ *
+ * @param program_text: source code to be checked, with '\n' between lines
+ * @return whether the syntax is valid, and where the first error is
+ */
+auto Compiler::check_text(const std::string& program_text) const
+	-> SyntaxCheck {
+	const TraceSpan span{"check syntax"};
+
+	// feeds the tokens of program_text to either recognizer until the first
+	// syntax error
+	const auto check_tokens = [&](auto& recognizer) {
+		Lexer lexer{spec.token_regexes};
+		lexer.set_text(program_text);
+
+		// position of the last token, where a program that ends too early
+		// has its error
+		std::size_t end_line = 0;
+		std::size_t end_column = 0;
+
+		while(lexer.has_next_token()) {
+			const Token token = lexer.get_next_token();
+
+			if(spec.token_regexes_ignore.find(token.type) !=
+			   spec.token_regexes_ignore.end()) {
+				continue;
+			}
+
+			if(!recognizer.push(token)) {
+				LOG("INFO") << "Syntax error at line "
+							<< 1 + token.program_line_number << ", col "
+							<< token.start_position_of_token_in_program_line
+							<< ": unexpected token " << token.value
+							<< std::endl;
+				return SyntaxCheck{
+					false,
+					1 + token.program_line_number,
+					token.start_position_of_token_in_program_line,
+					token.value};
+			}
+
+			end_line = token.program_line_number;
+			end_column = token.start_position_of_token_in_program_line;
+		}
+
+		if(!recognizer.is_accepted()) {
+			LOG("INFO") << "Syntax error at line " << 1 + end_line
+						<< ", col " << end_column
+						<< ": unexpected end of program" << std::endl;
+			return SyntaxCheck{false, 1 + end_line, end_column, ""};
+		}
+
+		return SyntaxCheck{true, 1 + end_line, end_column, ""};
+	};
+
+	// the bit-parallel recognizer is faster, but only fits small grammars
+	if(grammar->fits_bitset_recognizer()) {
+		BitsetRecognizer recognizer = grammar->make_bitset_recognizer();
+		return check_tokens(recognizer);
+	}
+
+	EarleyRecognizer recognizer = grammar->make_recognizer();
+	recognizer.keep_needed_sets_only();
+	return check_tokens(recognizer);
+}
+
+/**
+ * Parse the function headers of the source code in file_name, and find the
+ * function bodies without parsing them.
+ *
+ * @param file_name: name of file containing source code to be parsed
+ * @return tokens of the program, the parse tree of each function header, and
+ * where each function body is
+ */
+auto Compiler::parse_headers(const std::string& file_name) const
+	-> LazyParse {
+	LOG("INFO") << "Parsing function headers of " << file_name << std::endl;
+	return parse_headers_text(read_program(file_name));
+}
+
+/**
+ * Parse the function headers of source code, and find the function bodies
+ * without parsing them: a header runs up to the first {, and its body up to
+ * the } that matches it. Only the headers go through the parser, so passes
+ * that need no more than the signatures of the functions, like building a
+ * call graph, cost about as much as lexing. A body is parsed once it is
+ * needed, by parse_body.
+ *
+ * A syntax error in a body is not found until the body is parsed.
+ *
+ * @param program_text: source code to be parsed, with '\n' between lines
+ * @return tokens of the program, the parse tree of each function header, and
+ * where each function body is
+ */
+auto Compiler::parse_headers_text(const std::string& program_text) const
+	-> LazyParse {
+	const TraceSpan span{"parse function headers"};
+	LazyParse program{grammar, lex(program_text), {}};
+	const std::vector<Token>& tokens = program.tokens;
+
+	// a program needs at least one function, and each function a body
+	const auto unexpected_end = [&tokens]() {
+		const std::size_t line =
+			tokens.empty() ? 0 : tokens.back().program_line_number;
+		const std::size_t column =
+			tokens.empty()
+				? 0
+				: tokens.back().start_position_of_token_in_program_line;
+		LOG("ERROR") << "Syntax error at line " << 1 + line << ", col "
+					 << column << ": unexpected end of program" << std::endl;
+		throw std::logic_error("Syntax error at line " +
+							   std::to_string(1 + line) + ", col " +
+							   std::to_string(column) +
+							   ": unexpected end of program");
+	};
+
+	if(tokens.empty()) {
+		unexpected_end();
+	}
+
+	LOG("INFO") << "Parsing function headers, skipping their bodies"
+				<< std::endl;
+
+	std::size_t header_start = 0;
+	while(header_start < tokens.size()) {
+		std::size_t body_start = header_start;
+		while(body_start < tokens.size() &&
+			  tokens[body_start].value != open_brace) {
+			++body_start;
+		}
+
+		// the body ends once each brace in it is closed
+		std::size_t depth = 0;
+		std::size_t body_end = body_start;
+		while(body_end < tokens.size()) {
+			const std::string& value = tokens[body_end].value;
+			++body_end;
+
+			if(value == open_brace) {
+				++depth;
+			} else if(value == close_brace && --depth == 0) {
+				break;
+			}
+		}
+
+		if(body_start == tokens.size() || depth != 0) {
+			unexpected_end();
+		}
+
+		const std::vector<Token> header_tokens(
+			tokens.begin() + static_cast<std::ptrdiff_t>(header_start),
+			tokens.begin() + static_cast<std::ptrdiff_t>(body_start));
+		program.functions.push_back(
+			LazyFunction{program.grammar->parse(header_tokens, function_header),
+						 header_start,
+						 body_start,
+						 body_end});
+
+		header_start = body_end;
+	}
+
+	return program;
+}
+
+/**
+ * Parse the body of a function found by parse_headers_text, by the rules of a
+ * body alone.
+ *
+ * @param program: result of parse_headers_text
+ * @param function: index of the function in program.functions
+ * @return parse tree of the body, over the body's tokens alone: add
+ * program.functions[function].body_start to a position in it to get the
+ * position in the program
+ */
+auto Compiler::parse_body(const LazyParse& program, const std::size_t function)
+	-> std::vector<SubParse> {
+	if(function >= program.functions.size()) {
+		throw std::invalid_argument("No function " + std::to_string(function) +
+									" in a program of " +
+									std::to_string(program.functions.size()) +
+									" functions");
+	}
+
+	const TraceSpan span{"parse function body"};
+	const LazyFunction& lazy_function = program.functions[function];
+	const std::vector<Token> body_tokens(
+		program.tokens.begin() +
+			static_cast<std::ptrdiff_t>(lazy_function.body_start),
+		program.tokens.begin() +
+			static_cast<std::ptrdiff_t>(lazy_function.body_end));
+
+	return program.grammar->parse(body_tokens, function_body);
+}
+
+/**
+ * Read in the source code of a file.
+ *
+ * @param file_name: name of file containing source code
+ * @return lines of the file, each followed by '\n'
+ */
+auto Compiler::read_program(const std::string& file_name) -> std::string {
 	std::ifstream program_file{file_name};
 	if(!program_file.is_open()) {
 		LOG("ERROR") << "Unable to open file " << file_name << std::endl;
@@ -65,60 +401,114 @@ auto Compiler::compile(const std::string& file_name) const -> void {
 
 	program_file.close();
 
-	// TODO(bwang1008): should compile_text be responsible for writing out to
-	// files?
-	compile_text(program_text);
+	return program_text;
+}
 
-	LOG("INFO") << "Compilation finished!" << std::endl;
+/**
+ * Build the syntactical grammar of the language specification, with
+ * ambiguities resolved and unit rules skipped.
+ *
+ * @return grammar that parses tokens of the lexer
+ */
+auto Compiler::make_grammar() const -> Grammar {
+	const TraceSpan span{"prepare grammar"};
+	LOG("INFO") << "Generating grammar" << std::endl;
+
+	// symbols like <identifier> are parsed by the lexer, so the syntactical
+	// grammar treats them as terminal
+	std::set<std::string> token_names;
+	for(const auto& token_regex : spec.token_regexes) {
+		token_names.insert(token_regex.first);
+	}
+
+	Grammar syntax_grammar{spec.syntax_rules, spec.syntax_main, token_names};
+
+	// ambiguities like the dangling else are resolved while recognizing, by
+	// the precedence and restrictions of the language specification
+	syntax_grammar.disambiguate(spec.syntax_disambiguation);
+
+	// skip unit rules like <expression> ::= <assignment-expression>, which
+	// make up most of the parse tree of an expression
+	syntax_grammar.collapse_unit_chains();
+
+	return syntax_grammar;
 }
 
 /**
- * Program that parses source code string and generates equivalent program
- * in a different backend architecture.
+ * Split source code into tokens, and drop the ones that the parser ignores,
+ * like whitespace and comments.
  *
- * @param program_text: source code to be be compiled, with '\n' between lines
+ * @param program_text: source code, with '\n' between lines
+ * @return tokens of program_text that are parsed
  */
-auto Compiler::compile_text(const std::string& program_text) const -> void {
-	// 1. Front-end: tokenization and parsing of program_text
-	std::vector<SubParse> parse_tree = generate_parse_tree(program_text);
+auto Compiler::lex(const std::string& program_text) const
+	-> std::vector<Token> {
+	const TraceSpan span{"lex"};
+	Lexer lexer{spec.token_regexes};
+	lexer.set_text(program_text);
 
-	// 2. Middle-end: type-checking, identifiers are declared, functions that
-	// are called exist, main exists, no double declaration
-	LOG("INFO") << "Performing standard checks" << std::endl;
-	// TODO(bwang1008): implement middle-end
-	//
-	// (semantic analysis)
-	// make sure identifiers are declared
-	// type checking
-	// no "break;" on its own line outside of loop
+	std::vector<Token> tokens;
+	while(lexer.has_next_token()) {
+		const Token token = lexer.get_next_token();
 
-	// 3. Back-end: convert parse_tree into architecture-specific representation
-	// / code-generation
-	LOG("INFO") << "Pass to backend "
-				<< "Multitape Turing Machine" << std::endl;
-	// TODO(bwang1008):  implement back-ends
+		if(spec.token_regexes_ignore.find(token.type) ==
+		   spec.token_regexes_ignore.end()) {
+			tokens.push_back(token);
+		}
+	}
+
+	return tokens;
 }
 
 /**
  * Frontend of compiler: turns source code text into a parse tree, described
- * by the syntactical grammar.
+ * by the syntactical grammar. The parse tree leaves out unit rules: see
+ * Grammar::expand_unit_chains to put them back.
  *
  * @param program_text: source code to be processed, with '\n' between newlines
+ * @param statistics: set to the work of recognizing and parsing the tokens
  */
-auto Compiler::generate_parse_tree(const std::string& program_text) const
+auto Compiler::generate_parse_tree(const std::string& program_text,
+								   ParseStatistics& statistics) const
 	-> std::vector<SubParse> {
-	LOG("INFO") << "Tokenizing input" << std::endl;
+	// tokens are fed to the recognizer as soon as the lexer finds them, so a
+	// syntax error is reported without tokenizing the rest of the program
+	LOG("INFO") << "Tokenizing input and recognizing tokens" << std::endl;
 
 	Lexer lexer{spec.token_regexes};
 	lexer.set_text(program_text);
+	EarleyRecognizer recognizer = grammar->make_recognizer();
 	std::vector<Token> words;
 
-	while(lexer.has_next_token()) {
-		const Token token = lexer.get_next_token();
+	{
+		// lexing and recognizing take turns on this thread, so they share a
+		// span. The lexer takes most of the time of the two, so a thread of
+		// its own would save at most the time of the recognizer, and a batch
+		// compile already keeps every core busy with whole programs.
+		const TraceSpan span{"lex and recognize"};
+		while(lexer.has_next_token()) {
+			const Token token = lexer.get_next_token();
+
+			if(spec.token_regexes_ignore.find(token.type) !=
+			   spec.token_regexes_ignore.end()) {
+				continue;
+			}
 
-		if(spec.token_regexes_ignore.find(token.type) ==
-		   spec.token_regexes_ignore.end()) {
 			words.push_back(token);
+
+			if(!recognizer.push(token)) {
+				LOG("ERROR") << "Syntax error at line "
+							 << 1 + token.program_line_number << ", col "
+							 << token.start_position_of_token_in_program_line
+							 << ": unexpected token " << token.value
+							 << std::endl;
+				throw std::logic_error(
+					"Syntax error at line " +
+					std::to_string(1 + token.program_line_number) + ", col " +
+					std::to_string(
+						token.start_position_of_token_in_program_line) +
+					": unexpected token " + token.value);
+			}
 		}
 	}
 
@@ -129,25 +519,10 @@ auto Compiler::generate_parse_tree(const std::string& program_text) const
 					 << std::endl;
 	}
 
-	LOG("INFO") << "Generating grammar" << std::endl;
-	Grammar grammar{spec.syntax_rules, spec.syntax_main};
-
-	// modify rules for special tokens
-	// for instance, <identifier> becomes terminal
-	// instead of non-terminal
-	//
-	// TODO(bwang): make this automatic, by comparing leaves in syntax with
-	// lexical
-	const std::set<std::string> special_tokens{"keyword",
-											   "identifier",
-											   "integer-constant",
-											   "boolean-constant",
-											   "punctuator"};
-	grammar.mark_special_symbols_as_terminal(special_tokens);
-
 	// obtain parse tree of source program from tokens
 	LOG("INFO") << "Parsing tokens into parse tree" << std::endl;
-	std::vector<SubParse> parse_tree_syntactical = grammar.parse(words);
+	std::vector<SubParse> parse_tree_syntactical =
+		grammar->parse(recognizer, words, statistics);
 
 	return parse_tree_syntactical;
 }
@@ -9,18 +9,58 @@
 #ifndef COMPILER_HPP
 #define COMPILER_HPP
 
-#include <string>  // std::string
-#include <vector>  // std::vector
+#include <cstddef>	// std::size_t
+#include <memory>	// std::shared_ptr
+#include <string>	// std::string
+#include <vector>	// std::vector
 
 #include <TMCompiler/compiler/models/grammar.hpp>				  // Grammar
 #include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
 #include <TMCompiler/compiler/models/token.hpp>					  // Token
 #include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseStatistics
 
+// outcome of checking the syntax of a program without compiling it
+struct SyntaxCheck {
+	bool valid;
+	// position of the first token that no rule can continue with, as in the
+	// error of compile_text, or of the last token if the program ended too
+	// early
+	std::size_t line;
+	std::size_t column;
+	// value of that token, or empty if the program ended too early
+	std::string unexpected;
+};
+
+// function definition of a LazyParse, whose body is parsed on demand
+struct LazyFunction {
+	// parse tree of the function header, over the header's tokens alone
+	std::vector<SubParse> header;
+	// the header is tokens [header_start, body_start) of the program, and the
+	// body, from its { to its }, tokens [body_start, body_end)
+	std::size_t header_start;
+	std::size_t body_start;
+	std::size_t body_end;
+};
+
+// program whose function headers are parsed, but whose function bodies are
+// only found by matching their braces: see Compiler::parse_headers_text
+struct LazyParse {
+	// grammar that parsed the headers, kept to parse the bodies. It is the
+	// grammar of the Compiler, not a copy of it
+	std::shared_ptr<const Grammar> grammar;
+	std::vector<Token> tokens;
+	std::vector<LazyFunction> functions;
+};
+
+// A Compiler does not change once constructed and given its parse budget: its
+// const methods may be called from many threads at once, which share its
+// language specification and grammar. See compile_files.
 class Compiler {
 public:
 	/**
-	 * Constructor for Compiler class.
+	 * Constructor for Compiler class: reads the language specification, and
+	 * prepares its grammar for every program compiled after.
 	 *
 	 * @param language_spec_file_name: path of TOML file specifying
 	 * token regexes and BNF grammar.
@@ -28,6 +68,23 @@ public:
 	 */
 	explicit Compiler(const std::string& language_spec_file_name);
 
+	/**
+	 * Constructor for Compiler class, of a language specification that is
+	 * read already, like embedded_language_specification().
+	 *
+	 * @param _spec: language specification
+	 */
+	explicit Compiler(LanguageSpecification _spec);
+
+	/**
+	 * Limit the work of parsing each program, so that a program that makes
+	 * the parser blow up fails with ParseBudgetExceeded. Call it before the
+	 * Compiler is shared between threads.
+	 *
+	 * @param budget: most work of one parse, with 0 for no limit
+	 */
+	auto set_parse_budget(const ParseBudget& budget) -> void;
+
 	/**
 	 * Wrapper program that reads in source code from file_name and compiles the
 	 * text.
@@ -36,6 +93,15 @@ public:
 	 */
 	auto compile(const std::string& file_name) const -> void;
 
+	/**
+	 * See the overload above, with the work of parsing the source code.
+	 *
+	 * @param file_name: name of file containing source code to be compiled
+	 * @param statistics: set to the work of parsing the source code
+	 */
+	auto compile(const std::string& file_name,
+				 ParseStatistics& statistics) const -> void;
+
 	/**
 	 * Program that parses source code string and generates equivalent program
 	 * in a different backend architecture.
@@ -45,19 +111,94 @@ public:
 	 */
 	auto compile_text(const std::string& program_text) const -> void;
 
+	/**
+	 * See the overload above, with the work of parsing the source code.
+	 *
+	 * @param program_text: source code to be be compiled, with '\n' between
+	 * lines
+	 * @param statistics: set to the work of parsing the source code
+	 */
+	auto compile_text(const std::string& program_text,
+					  ParseStatistics& statistics) const -> void;
+
+	/**
+	 * Check the syntax of the source code in file_name, without building a
+	 * parse tree.
+	 *
+	 * @param file_name: name of file containing source code to be checked
+	 * @return whether the syntax is valid, and where the first error is
+	 */
+	[[nodiscard]] auto check(const std::string& file_name) const
+		-> SyntaxCheck;
+
+	/**
+	 * Check the syntax of source code, without building a parse tree.
+	 *
+	 * @param program_text: source code to be checked, with '\n' between lines
+	 * @return whether the syntax is valid, and where the first error is
+	 */
+	[[nodiscard]] auto check_text(const std::string& program_text) const
+		-> SyntaxCheck;
+
+	/**
+	 * Parse the function headers of the source code in file_name, and find
+	 * the function bodies without parsing them.
+	 *
+	 * @param file_name: name of file containing source code to be parsed
+	 * @return tokens of the program, the parse tree of each function header,
+	 * and where each function body is
+	 */
+	[[nodiscard]] auto parse_headers(const std::string& file_name) const
+		-> LazyParse;
+
+	/**
+	 * Parse the function headers of source code, and find the function bodies
+	 * without parsing them.
+	 *
+	 * @param program_text: source code to be parsed, with '\n' between lines
+	 * @return tokens of the program, the parse tree of each function header,
+	 * and where each function body is
+	 */
+	[[nodiscard]] auto parse_headers_text(const std::string& program_text) const
+		-> LazyParse;
+
+	/**
+	 * Parse the body of a function found by parse_headers_text.
+	 *
+	 * @param program: result of parse_headers_text
+	 * @param function: index of the function in program.functions
+	 * @return parse tree of the body, over the body's tokens alone
+	 */
+	[[nodiscard]] static auto parse_body(const LazyParse& program,
+										 std::size_t function)
+		-> std::vector<SubParse>;
+
 private:
 	// specification of syntax of programming language: contains list of regexes
 	// for how to parse tokens / words from letters as well as the grammar for
 	// how to parse tokens into programming-language constructs
 	LanguageSpecification spec;
 
+	// syntactical grammar of spec, disambiguated and with unit rules skipped,
+	// built once and shared by every program compiled, and by every LazyParse
+	std::shared_ptr<const Grammar> grammar;
+
+	// read the lines of a source file, each followed by '\n'
+	[[nodiscard]] static auto read_program(const std::string& file_name)
+		-> std::string;
+	// syntactical grammar of the language specification, ready to recognize
+	[[nodiscard]] auto make_grammar() const -> Grammar;
+	// split source code into tokens, without the ones the parser ignores
+	[[nodiscard]] auto lex(const std::string& program_text) const
+		-> std::vector<Token>;
 	// convert lexical parse tree into list of tokens
 	[[nodiscard]] auto tokenize(const std::vector<SubParse>& parse_tree,
 								const std::string& program_text) const
 		-> std::vector<Token>;
 	// frontend of compiler: turn source code text into a parse tree
-	[[nodiscard]] auto generate_parse_tree(
-		const std::string& program_text) const -> std::vector<SubParse>;
+	[[nodiscard]] auto generate_parse_tree(const std::string& program_text,
+										   ParseStatistics& statistics) const
+		-> std::vector<SubParse>;
 };
 
 #endif
@@ -0,0 +1,75 @@
+#include "concrete_syntax_tree.hpp"
+
+#include <cstddef>	  // std::size_t
+#include <cstdint>	  // std::uint32_t
+#include <stdexcept>  // std::out_of_range
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+/**
+ * Constructor for ConcreteSyntaxTree: convert parse tree from
+ * build_earley_parse_tree into preorder.
+ *
+ * In parse_tree, every SubParse comes after its parent, and the children of
+ * a SubParse are next to each other, from left to right. That lets all three
+ * passes below be linear.
+ *
+ * @param parse_tree: list of SubParse, each with a range of tokens its rule
+ * covers, and an index of its parent SubParse
+ */
+ConcreteSyntaxTree::ConcreteSyntaxTree(const std::vector<SubParse>& parse_tree)
+	: rules(parse_tree.size()),
+	  token_begins(parse_tree.size()),
+	  token_ends(parse_tree.size()),
+	  parents(parse_tree.size()),
+	  subtree_ends(parse_tree.size()) {
+	const std::size_t num_nodes = parse_tree.size();
+	if(num_nodes >= static_cast<std::size_t>(no_node)) {
+		throw std::out_of_range("Parse tree too large for ConcreteSyntaxTree");
+	}
+
+	// 1. number of nodes in the subtree of each SubParse: children come after
+	// their parents, so accumulate from the back
+	std::vector<std::uint32_t> subtree_sizes(num_nodes, 1);
+	for(std::size_t i = num_nodes; i > 1; --i) {
+		subtree_sizes[parse_tree[i - 1].parent] += subtree_sizes[i - 1];
+	}
+
+	// 2. preorder position of each SubParse: the first child of a node comes
+	// right after it, and each next child after the subtree of the previous
+	std::vector<std::uint32_t> positions(num_nodes, 0);
+	std::vector<std::uint32_t> next_child_positions(num_nodes, 1);
+	for(std::size_t i = 1; i < num_nodes; ++i) {
+		const std::size_t parent = parse_tree[i].parent;
+		positions[i] = positions[parent] + next_child_positions[parent];
+		next_child_positions[parent] += subtree_sizes[i];
+	}
+
+	// 3. store each SubParse at its preorder position
+	for(std::size_t i = 0; i < num_nodes; ++i) {
+		const SubParse& sub_parse = parse_tree[i];
+		const std::uint32_t position = positions[i];
+
+		rules[position] = static_cast<std::uint32_t>(sub_parse.rule);
+		token_begins[position] = static_cast<std::uint32_t>(sub_parse.start);
+		token_ends[position] = static_cast<std::uint32_t>(sub_parse.end);
+		parents[position] =
+			(i == 0) ? no_node : positions[parse_tree[i].parent];
+		subtree_ends[position] = position + subtree_sizes[i];
+	}
+}
+
+/**
+ * @return number of children of node
+ */
+[[gnu::pure]] auto ConcreteSyntaxTree::num_children(
+	const std::uint32_t node) const -> std::uint32_t {
+	std::uint32_t count = 0;
+	for(std::uint32_t child = 1 + node; child < subtree_ends[node];
+		child = subtree_ends[child]) {
+		++count;
+	}
+
+	return count;
+}
@@ -0,0 +1,117 @@
+/**
+ * Compact concrete syntax tree, built from the parse tree of
+ * build_earley_parse_tree.
+ *
+ * Nodes are stored in preorder, in parallel arrays of 32-bit integers. The
+ * subtree of node i is the range [i, subtree_end(i)) of nodes, so its first
+ * child (if any) is i + 1, and the sibling after child c is subtree_end(c).
+ * Walking the whole tree is a linear scan over the arrays, and iterating over
+ * the children of a node allocates nothing:
+ *
+ * ConcreteSyntaxTree tree{grammar.parse(tokens)};
+ * for(const std::uint32_t child : tree.children(tree.root())) {
+ *		std::uint32_t rule = tree.rule(child);
+ * }
+ */
+
+#ifndef CONCRETE_SYNTAX_TREE_HPP
+#define CONCRETE_SYNTAX_TREE_HPP
+
+#include <cstdint>	// std::uint32_t
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+class ConcreteSyntaxTree {
+public:
+	// parent of the root
+	static constexpr std::uint32_t no_node = UINT32_MAX;
+
+	// iterates over the children of one node, from left to right
+	class ChildIterator {
+	public:
+		ChildIterator(const ConcreteSyntaxTree& _tree, std::uint32_t _node)
+			: tree(&_tree), node(_node) {
+		}
+		auto operator*() const -> std::uint32_t {
+			return node;
+		}
+		auto operator++() -> ChildIterator& {
+			node = tree->subtree_ends[node];
+			return *this;
+		}
+		auto operator!=(const ChildIterator& other) const -> bool {
+			return node != other.node;
+		}
+
+	private:
+		const ConcreteSyntaxTree* tree;
+		std::uint32_t node;
+	};
+
+	struct ChildRange {
+		ChildIterator first;
+		ChildIterator last;
+
+		[[nodiscard]] auto begin() const -> ChildIterator {
+			return first;
+		}
+		[[nodiscard]] auto end() const -> ChildIterator {
+			return last;
+		}
+	};
+
+	explicit ConcreteSyntaxTree(const std::vector<SubParse>& parse_tree);
+
+	// number of nodes in the tree
+	[[nodiscard]] auto size() const -> std::uint32_t {
+		return static_cast<std::uint32_t>(rules.size());
+	}
+	// node of the top-level rule
+	[[nodiscard]] static auto root() -> std::uint32_t {
+		return 0;
+	}
+	// index of the rule of node in list of rules in Grammar
+	[[nodiscard]] auto rule(const std::uint32_t node) const -> std::uint32_t {
+		return rules[node];
+	}
+	// node covers tokens in range [token_begin(node), token_end(node))
+	[[nodiscard]] auto token_begin(const std::uint32_t node) const
+		-> std::uint32_t {
+		return token_begins[node];
+	}
+	[[nodiscard]] auto token_end(const std::uint32_t node) const
+		-> std::uint32_t {
+		return token_ends[node];
+	}
+	// parent of node, or no_node for the root
+	[[nodiscard]] auto parent(const std::uint32_t node) const
+		-> std::uint32_t {
+		return parents[node];
+	}
+	// one past the last node in the subtree of node
+	[[nodiscard]] auto subtree_end(const std::uint32_t node) const
+		-> std::uint32_t {
+		return subtree_ends[node];
+	}
+	// children of node, from left to right
+	[[nodiscard]] auto children(const std::uint32_t node) const
+		-> ChildRange {
+		return ChildRange{ChildIterator{*this, 1 + node},
+						  ChildIterator{*this, subtree_ends[node]}};
+	}
+	[[nodiscard]] auto num_children(std::uint32_t node) const
+		-> std::uint32_t;
+
+private:
+	// index of rule in list of rules in Grammar
+	std::vector<std::uint32_t> rules;
+	// node covers tokens in range [token_begins[i], token_ends[i])
+	std::vector<std::uint32_t> token_begins;
+	std::vector<std::uint32_t> token_ends;
+	std::vector<std::uint32_t> parents;
+	// one past the last node of the subtree of each node
+	std::vector<std::uint32_t> subtree_ends;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "disambiguation.hpp"
+
+#include <cstddef>	  // std::size_t
+#include <map>		  // std::map
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument
+#include <string>	  // std::string
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // rule_to_string, Disambiguation
+
+/**
+ * Find a declared rule among the grammar rules.
+ * @param rules: grammar rules
+ * @param declared: rule from a declaration
+ * @return index of the rule with the same production and replacement
+ */
+auto find_declared_rule(const std::vector<Rule>& rules, const Rule& declared)
+	-> std::size_t {
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		const Rule& rule = rules[i];
+		if(rule.production.value != declared.production.value ||
+		   rule.replacement.size() != declared.replacement.size()) {
+			continue;
+		}
+
+		// symbols are compared by name only: the grammar may have marked
+		// some of them as terminal since the declaration was read
+		bool same = true;
+		for(std::size_t k = 0; k < rule.replacement.size(); ++k) {
+			same = same &&
+				   rule.replacement[k].value == declared.replacement[k].value;
+		}
+
+		if(same) {
+			return i;
+		}
+	}
+
+	throw std::invalid_argument("Cannot disambiguate " +
+								rule_to_string(declared) +
+								": it is not a rule of the grammar");
+}
+
+/**
+ * Turn precedence and follow restriction declarations into the filters the
+ * Earley parser applies while it recognizes.
+ *
+ * An operand of an operator rule is a symbol at either end of its replacement
+ * that is the rule's own non-terminal, like both <expression> of
+ * <expression> ::= <expression> + <expression>. The SubParse for an operand
+ * may not use a rule of a looser precedence level. It may not use a rule of
+ * the same level either, unless the operand is on the side of the level's
+ * associativity: the left operand for "left", the right operand for "right".
+ * Rules without a precedence level, like parenthesized expressions, are
+ * always allowed.
+ *
+ * A follow restriction keeps a finished rule from being completed when the
+ * next token is one of the restricted tokens.
+ *
+ * @param rules: grammar rules that the declarations refer to
+ * @param declarations: precedence levels and follow restrictions
+ * @return filters on indices of rules
+ */
+auto make_disambiguation(const std::vector<Rule>& rules,
+						 const DisambiguationRules& declarations)
+	-> Disambiguation {
+	Disambiguation disambiguation;
+
+	// level and associativity of each rule with a precedence level
+	std::map<std::size_t, std::size_t> levels;
+	std::map<std::size_t, std::string> associativities;
+	for(std::size_t level = 0; level < declarations.precedence.size();
+		++level) {
+		const PrecedenceLevel& precedence_level =
+			declarations.precedence[level];
+		const std::string& associativity = precedence_level.associativity;
+		if(associativity != "left" && associativity != "right" &&
+		   associativity != "none") {
+			throw std::invalid_argument("Unknown associativity \"" +
+										associativity +
+										"\": expected left, right or none");
+		}
+
+		for(const Rule& rule : precedence_level.rules) {
+			const std::size_t index = find_declared_rule(rules, rule);
+			levels[index] = level;
+			associativities[index] = associativity;
+		}
+	}
+
+	if(!levels.empty()) {
+		disambiguation.rejected_children.resize(rules.size());
+	}
+
+	for(const auto& parent : levels) {
+		const Rule& parent_rule = rules[parent.first];
+		const std::vector<GrammarSymbol>& replacement = parent_rule.replacement;
+		disambiguation.rejected_children[parent.first].resize(
+			replacement.size());
+
+		for(const std::size_t position : {std::size_t{0},
+										  replacement.size() - 1}) {
+			const bool operand =
+				replacement.size() > 1 && !replacement[position].terminal &&
+				replacement[position].value == parent_rule.production.value;
+			if(!operand) {
+				continue;
+			}
+
+			const std::string allowed_associativity =
+				position == 0 ? "left" : "right";
+			for(const auto& child : levels) {
+				if(child.second < parent.second ||
+				   (child.second == parent.second &&
+					associativities[parent.first] != allowed_associativity)) {
+					disambiguation.rejected_children[parent.first][position]
+						.insert(child.first);
+				}
+			}
+		}
+	}
+
+	if(!declarations.restrictions.empty()) {
+		disambiguation.follow_restrictions.resize(rules.size());
+	}
+
+	for(const FollowRestriction& restriction : declarations.restrictions) {
+		const std::size_t index = find_declared_rule(rules, restriction.rule);
+		disambiguation.follow_restrictions[index].insert(
+			restriction.tokens.begin(), restriction.tokens.end());
+	}
+
+	return disambiguation;
+}
+
+/**
+ * @param declarations: precedence levels and follow restrictions
+ * @return non-terminals that have a rule in a declaration
+ */
+auto disambiguated_productions(const DisambiguationRules& declarations)
+	-> std::set<std::string> {
+	std::set<std::string> productions;
+	for(const PrecedenceLevel& level : declarations.precedence) {
+		for(const Rule& rule : level.rules) {
+			productions.insert(rule.production.value);
+		}
+	}
+
+	for(const FollowRestriction& restriction : declarations.restrictions) {
+		productions.insert(restriction.rule.production.value);
+	}
+
+	return productions;
+}
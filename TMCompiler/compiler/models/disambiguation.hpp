@@ -0,0 +1,52 @@
+#ifndef DISAMBIGUATION_HPP
+#define DISAMBIGUATION_HPP
+
+#include <set>	   // std::set
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // Disambiguation
+
+// operator rules that bind equally tightly, like <expression> + <expression>
+// and <expression> - <expression>
+struct PrecedenceLevel {
+	std::string associativity;	// "left", "right" or "none"
+	std::vector<Rule> rules;
+};
+
+// a rule that may not be followed by some tokens, like an if-statement
+// without else, that may not be followed by else
+struct FollowRestriction {
+	Rule rule;
+	std::set<std::string> tokens;  // token types or values
+};
+
+// declarations in [[syntax.precedence]] and [[syntax.restrictions]] of a
+// language specification, that choose between the parses of an ambiguous
+// grammar
+struct DisambiguationRules {
+	// from the loosest binding level to the tightest
+	std::vector<PrecedenceLevel> precedence;
+	std::vector<FollowRestriction> restrictions;
+};
+
+/**
+ * Turn precedence and follow restriction declarations into the filters the
+ * Earley parser applies while it recognizes.
+ * @param rules: grammar rules that the declarations refer to
+ * @param declarations: precedence levels and follow restrictions
+ * @return filters on indices of rules
+ */
+auto make_disambiguation(const std::vector<Rule>& rules,
+						 const DisambiguationRules& declarations)
+	-> Disambiguation;
+
+/**
+ * @param declarations: precedence levels and follow restrictions
+ * @return non-terminals that have a rule in a declaration
+ */
+auto disambiguated_productions(const DisambiguationRules& declarations)
+	-> std::set<std::string>;
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Build the language specification from the tables that
+ * generate_language_tables made of the TOML file at build time.
+ */
+
+#include "embedded_specification.hpp"
+
+#include <cstddef>	// std::ptrdiff_t, std::size_t
+#include <regex>	// std::regex
+#include <set>		// std::set
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // FollowRestriction, PrecedenceLevel
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/language_tables.hpp>  // language_grammar, language_token_names, ...
+#include <TMCompiler/compiler/models/rule.hpp>	// Rule
+#include <TMCompiler/compiler/models/static_grammar.hpp>  // static_first_sets, static_set_empty, static_undefined_symbol, to_rules
+#include <TMCompiler/utils/tracer/tracer.hpp>  // TraceSpan
+
+// mistakes in the language specification fail the build, instead of the
+// first compile
+static_assert(static_undefined_symbol(language_grammar) ==
+				  language_grammar.symbols.values.size(),
+			  "A non-terminal in language.toml has no rules, and is not the "
+			  "name of a token");
+static_assert(!static_set_empty(
+				  static_first_sets(language_grammar)[language_grammar.main]),
+			  "The main symbol of language.toml derives no token");
+
+/**
+ * Build the language specification of the generated tables. Only the regexes
+ * of the tokens are compiled at run time, since a std::regex cannot be
+ * constexpr.
+ *
+ * @return the language specification of the TOML file, as it was when the
+ * program was built
+ */
+auto embedded_language_specification() -> LanguageSpecification {
+	const TraceSpan span{"load specification",
+						 std::string{language_spec_file_name}};
+	LanguageSpecification spec;
+	spec.title = language_title;
+	spec.description = language_description;
+	spec.version = language_version;
+	spec.spec_file_name = language_spec_file_name;
+
+	for(std::size_t i = 0; i < language_token_names.size(); ++i) {
+		const std::string name{language_token_names[i]};
+		const std::string pattern{language_token_patterns[i]};
+		spec.token_regexes.emplace_back(name, std::regex(pattern));
+		spec.token_patterns.push_back(pattern);
+		if(language_token_ignored[i]) {
+			spec.token_regexes_ignore.insert(name);
+		}
+	}
+
+	spec.syntax_main = language_grammar.symbols.values[language_grammar.main];
+	spec.syntax_rules =
+		to_rules(language_grammar.symbols, language_grammar.rules);
+
+	const std::vector<Rule> precedence_rules =
+		to_rules(language_grammar.symbols, language_precedence_rules);
+	for(std::size_t level = 0;
+		level < language_precedence_associativity.size();
+		++level) {
+		spec.syntax_disambiguation.precedence.push_back(PrecedenceLevel{
+			std::string{language_precedence_associativity[level]},
+			std::vector<Rule>(
+				precedence_rules.begin() +
+					static_cast<std::ptrdiff_t>(
+						language_precedence_offsets[level]),
+				precedence_rules.begin() +
+					static_cast<std::ptrdiff_t>(
+						language_precedence_offsets[level + 1]))});
+	}
+
+	const std::vector<Rule> restriction_rules =
+		to_rules(language_grammar.symbols, language_restriction_rules);
+	for(std::size_t i = 0; i < restriction_rules.size(); ++i) {
+		std::set<std::string> tokens;
+		for(std::size_t j = language_restriction_token_offsets[i];
+			j < language_restriction_token_offsets[i + 1];
+			++j) {
+			tokens.insert(std::string{language_restriction_tokens[j]});
+		}
+
+		spec.syntax_disambiguation.restrictions.push_back(
+			FollowRestriction{restriction_rules[i], tokens});
+	}
+
+	return spec;
+}
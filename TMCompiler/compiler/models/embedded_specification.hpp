@@ -0,0 +1,19 @@
+/**
+ * Language specification of TMCompiler/config/language.toml, compiled into
+ * the program: generate_language_tables turns the TOML file into constexpr
+ * tables at build time, in language_tables.hpp, and tmc builds its Compiler
+ * from them instead of reading the TOML file when it starts.
+ */
+
+#ifndef EMBEDDED_SPECIFICATION_HPP
+#define EMBEDDED_SPECIFICATION_HPP
+
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+
+/**
+ * @return the language specification of the TOML file, as it was when the
+ * program was built
+ */
+auto embedded_language_specification() -> LanguageSpecification;
+
+#endif
@@ -1,31 +1,530 @@
 #include "grammar.hpp"
 
-#include <set>		// std::set
-#include <string>	// std::string
-#include <utility>	// std::move
-#include <vector>	// std::vector
+#include <cstddef>	  // std::ptrdiff_t, std::size_t
+#include <iostream>	  // std::endl
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument, std::logic_error
+#include <string>	  // std::string
+#include <utility>	  // std::move
+#include <vector>	  // std::vector
 
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // disambiguated_productions, make_disambiguation, DisambiguationRules
+#include <TMCompiler/compiler/models/grammar_analysis.hpp>	// analyze_grammar, mark_lexical_symbols_as_terminal, GrammarAnalysis
+#include <TMCompiler/compiler/models/grammar_normalization.hpp>	 // hide_helper_rules, normalize_rules, NormalizedRules
+#include <TMCompiler/compiler/models/grammar_repetition.hpp>  // expand_repetitions, flatten_repetitions, nest_repetitions, RepetitionRules
 #include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
-#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
-#include <TMCompiler/compiler/models/token.hpp>			  // Token
-#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // build_earley_items, build_earley_parse_tree, EarleyItem, SubParse
+#include <TMCompiler/compiler/models/parse_profile.hpp>	 // rank_rules, ParseProfile
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/models/token.hpp>			 // Token
+#include <TMCompiler/compiler/parser/bitset_recognizer.hpp>	 // fits_bitset_recognizer, make_bitset_grammar, BitsetRecognizer
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // collapse_unit_chains, expand_unit_chains, find_unit_chains, build_earley_parse_tree, flip_finished_items, is_accepted, no_embedded_parser, rebuild_earley_items, rebuild_earley_parse_tree, reparse_earley_items, rule_to_string, walk_earley_parse_tree, Disambiguation, EarleyItem, EarleyRecognizer, EmbeddedParser, FlippedEarleyItem, IncrementalParseState, ParseEvents, RuleVisibility, SubParse, UnitChains
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseMeter, ParseStatistics
+#include <TMCompiler/compiler/parser/precedence_parser.hpp>	 // find_precedence_region, PrecedenceParser
+#include <TMCompiler/compiler/parser/spilled_earley_sets.hpp>  // SpilledEarleySets
+#include <TMCompiler/utils/logger/logger.hpp>				   // LOG
+#include <TMCompiler/utils/tracer/tracer.hpp>				   // TraceSpan
 
 Grammar::Grammar(std::vector<Rule> _rules, std::string _default_start)
 	: rules(std::move(_rules)), default_start(std::move(_default_start)) {
+	RepetitionRules expanded = expand_repetitions(rules);
+	rules = std::move(expanded.rules);
+	repetitions = std::move(expanded.helpers);
+	analysis = analyze_grammar(rules, default_start);
 }
 
+Grammar::Grammar(std::vector<Rule> _rules,
+				 std::string _default_start,
+				 const std::set<std::string>& lexical_symbols)
+	: rules(std::move(_rules)), default_start(std::move(_default_start)) {
+	RepetitionRules expanded = expand_repetitions(rules);
+	rules = std::move(expanded.rules);
+	repetitions = std::move(expanded.helpers);
+
+	for(const std::string& symbol_name :
+		mark_lexical_symbols_as_terminal(rules, lexical_symbols)) {
+		LOG("DEBUG") << "Treating <" << symbol_name << "> as a token"
+					 << std::endl;
+	}
+
+	remove_unused_rules();
+}
+
+/**
+ * Remove rules that can never be part of a parse of default_start: rules of
+ * unreachable non-terminals, rules that use a non-terminal that derives no
+ * string of terminals, and repeated rules. Such rules only slow down the
+ * Earley parser, and usually come from a typo in the language specification,
+ * so each one is logged.
+ */
+auto Grammar::remove_unused_rules() -> void {
+	const TraceSpan span{"remove unused rules"};
+	analysis = analyze_grammar(rules, default_start);
+
+	if(analysis.productive.find(default_start) == analysis.productive.end()) {
+		throw std::invalid_argument("Start symbol <" + default_start +
+									"> does not derive any string of tokens");
+	}
+
+	std::vector<bool> unused(rules.size(), false);
+	for(const std::size_t i : analysis.nonproductive_rules) {
+		LOG("WARNING") << "Removing rule that can never finish: "
+					   << rule_to_string(rules[i]) << std::endl;
+		unused[i] = true;
+	}
+	for(const std::size_t i : analysis.unreachable_rules) {
+		LOG("WARNING") << "Removing rule unreachable from <" << default_start
+					   << ">: " << rule_to_string(rules[i]) << std::endl;
+		unused[i] = true;
+	}
+	for(const std::size_t i : analysis.duplicate_rules) {
+		LOG("WARNING") << "Removing duplicate rule: "
+					   << rule_to_string(rules[i]) << std::endl;
+		unused[i] = true;
+	}
+
+	std::vector<Rule> used_rules;
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		if(!unused[i]) {
+			used_rules.push_back(rules[i]);
+		}
+	}
+
+	if(used_rules.size() != rules.size()) {
+		rules = used_rules;
+		analysis = analyze_grammar(rules, default_start);
+	}
+}
+
+/**
+ * Parse input tokens into a parse tree.
+ *
+ * If a precedence parser is embedded, the Earley parser hands each expression
+ * over to it. The precedence parser only finds the longest parse of an
+ * expression, so an input that needs another one is parsed again by the
+ * Earley parser alone.
+ *
+ * Throws ParseBudgetExceeded if the parse goes over the budget of
+ * set_parse_budget.
+ *
+ * @param input_tokens: words of the program
+ * @return parse tree of input_tokens
+ */
 auto Grammar::parse(const std::vector<Token>& input_tokens) const
 	-> std::vector<SubParse> {
-	const std::vector<std::vector<EarleyItem> > earley_sets =
-		build_earley_items(rules, input_tokens, default_start);
-	return build_earley_parse_tree(
-		earley_sets, rules, input_tokens, default_start);
+	ParseStatistics statistics;
+	return parse(input_tokens, statistics);
+}
+
+/**
+ * Parse input tokens into a parse tree, and report the work it took: see the
+ * overload above.
+ *
+ * @param input_tokens: words of the program
+ * @param statistics: set to the work of the parse, from building the Earley
+ * state sets, including a parse without the precedence parser, to the parse
+ * tree search
+ * @return parse tree of input_tokens
+ */
+auto Grammar::parse(const std::vector<Token>& input_tokens,
+					ParseStatistics& statistics) const
+	-> std::vector<SubParse> {
+	return parse(input_tokens, default_start, statistics);
+}
+
+/**
+ * Parse input tokens into a parse tree of start_symbol instead of the start
+ * symbol of the grammar, like the body of a single function: see the overload
+ * above.
+ *
+ * @param input_tokens: words of a part of the program
+ * @param start_symbol: non-terminal that input_tokens are parsed as
+ * @return parse tree of input_tokens, whose top rule has start_symbol as its
+ * production
+ */
+auto Grammar::parse(const std::vector<Token>& input_tokens,
+					const std::string& start_symbol) const
+	-> std::vector<SubParse> {
+	ParseStatistics statistics;
+	return parse(input_tokens, start_symbol, statistics);
+}
+
+/**
+ * Parse input tokens into a parse tree of start_symbol, and report the work
+ * it took: see the overloads above.
+ *
+ * @param input_tokens: words of a part of the program
+ * @param start_symbol: non-terminal that input_tokens are parsed as
+ * @param statistics: set to the work of the parse
+ * @return parse tree of input_tokens, whose top rule has start_symbol as its
+ * production
+ */
+auto Grammar::parse(const std::vector<Token>& input_tokens,
+					const std::string& start_symbol,
+					ParseStatistics& statistics) const
+	-> std::vector<SubParse> {
+	if(analysis.productive.find(start_symbol) == analysis.productive.end()) {
+		LOG("ERROR") << "Cannot parse from <" << start_symbol
+					 << ">: it does not derive any string of tokens"
+					 << std::endl;
+		throw std::invalid_argument("Cannot parse from <" + start_symbol +
+									">: it does not derive any string of "
+									"tokens");
+	}
+
+	ParseMeter meter{parse_budget};
+
+	if(uses_precedence_parser()) {
+		PrecedenceParser precedence_parser{
+			precedence_region, rules, unit_chains, input_tokens};
+		const EmbeddedParser embedded_parser{
+			precedence_region.embedded,
+			[&precedence_parser](const std::string& symbol_name,
+								 const std::size_t start) {
+				return precedence_parser.parse(symbol_name, start);
+			}};
+
+		std::vector<std::vector<EarleyItem> > earley_sets;
+		{
+			const TraceSpan span{"recognize"};
+			rebuild_earley_items(earley_sets,
+								 rules,
+								 unit_chains,
+								 disambiguation,
+								 input_tokens,
+								 start_symbol,
+								 0,
+								 embedded_parser,
+								 &meter);
+		}
+		if(is_accepted(earley_sets, rules, unit_chains, start_symbol)) {
+			const TraceSpan span{"build parse tree"};
+			meter.start_search();
+			const std::vector<SubParse> tree =
+				build_earley_parse_tree(earley_sets,
+										rules,
+										input_tokens,
+										start_symbol,
+										unit_chains,
+										disambiguation,
+										parser_rule_ranks(),
+										&meter);
+			statistics = meter.get_statistics();
+			return to_visible_tree(tree);
+		}
+
+		LOG("INFO") << "Parsing again without the precedence parser"
+					<< std::endl;
+	}
+
+	std::vector<std::vector<EarleyItem> > earley_sets;
+	{
+		const TraceSpan span{"recognize"};
+		rebuild_earley_items(earley_sets,
+							 parser_rules(),
+							 parser_unit_chains(),
+							 parser_disambiguation(),
+							 input_tokens,
+							 start_symbol,
+							 0,
+							 no_embedded_parser,
+							 &meter);
+	}
+
+	const TraceSpan span{"build parse tree"};
+	meter.start_search();
+	const std::vector<SubParse> tree =
+		build_earley_parse_tree(earley_sets,
+								parser_rules(),
+								input_tokens,
+								start_symbol,
+								parser_unit_chains(),
+								parser_disambiguation(),
+								parser_rule_ranks(),
+								&meter);
+	statistics = meter.get_statistics();
+	return to_visible_tree(tree);
+}
+
+/**
+ * Parse input tokens without building the parse tree: the tree is derived
+ * depth-first and reported to events in document order, with the same rules
+ * and SubParses that parse(input_tokens) returns. Of the tree, only the path
+ * from the root to the current SubParse is kept in memory, but the finished
+ * items of the Earley state sets of the whole input are kept too, so memory
+ * still grows with the input.
+ *
+ * @param input_tokens: words of the program
+ * @param events: callbacks for entering and leaving each SubParse, and for
+ * each token
+ */
+auto Grammar::walk_parse_tree(const std::vector<Token>& input_tokens,
+							  const ParseEvents& events) const -> void {
+	ParseMeter meter{parse_budget};
+
+	// the Earley state sets are only needed until their finished items are
+	// flipped
+	std::vector<std::vector<FlippedEarleyItem> > flipped_earley_sets;
+	{
+		const TraceSpan span{"recognize"};
+		std::vector<std::vector<EarleyItem> > earley_sets;
+		rebuild_earley_items(earley_sets,
+							 parser_rules(),
+							 parser_unit_chains(),
+							 parser_disambiguation(),
+							 input_tokens,
+							 default_start,
+							 0,
+							 no_embedded_parser,
+							 &meter);
+		flipped_earley_sets = flip_finished_items(
+			earley_sets, parser_rules(), parser_rule_ranks());
+	}
+
+	const TraceSpan span{"walk parse tree"};
+	walk_earley_parse_tree(flipped_earley_sets,
+						   parser_rules(),
+						   parser_unit_chains(),
+						   parser_disambiguation(),
+						   input_tokens,
+						   default_start,
+						   rule_visibility(),
+						   events,
+						   &meter);
+}
+
+/**
+ * Create an Earley recognizer for this grammar, to be fed tokens one at a time.
+ * The recognizer refers to the rules of this Grammar, so it must not outlive
+ * it. It is held to the budget of set_parse_budget while it recognizes, and
+ * parse(recognizer, input_tokens) goes on counting from its work.
+ */
+auto Grammar::make_recognizer() const -> EarleyRecognizer {
+	return EarleyRecognizer{parser_rules(),
+							default_start,
+							parser_unit_chains(),
+							parser_disambiguation(),
+							parse_budget};
+}
+
+/**
+ * @return true iff make_bitset_recognizer() can recognize this grammar
+ */
+[[gnu::pure]] auto Grammar::fits_bitset_recognizer() const -> bool {
+	return ::fits_bitset_recognizer(parser_rules());
+}
+
+/**
+ * Create a bit-parallel recognizer for this grammar, which only tells if the
+ * input is valid, and is faster than make_recognizer() for small grammars.
+ * Throws std::invalid_argument unless fits_bitset_recognizer(). The
+ * recognizer has its own tables, so it may outlive this Grammar. It is held
+ * to the budget of set_parse_budget.
+ */
+auto Grammar::make_bitset_recognizer() const -> BitsetRecognizer {
+	return BitsetRecognizer{make_bitset_grammar(parser_rules(),
+												parser_unit_chains(),
+												parser_disambiguation(),
+												default_start),
+							parse_budget};
+}
+
+/**
+ * Build the parse tree of tokens that were already pushed through a
+ * recognizer from make_recognizer().
+ *
+ * @param recognizer: recognizer that has been fed all of input_tokens
+ * @param input_tokens: words of the program, in the order they were pushed
+ * @return parse tree of input_tokens
+ */
+auto Grammar::parse(const EarleyRecognizer& recognizer,
+					const std::vector<Token>& input_tokens) const
+	-> std::vector<SubParse> {
+	ParseStatistics statistics;
+	return parse(recognizer, input_tokens, statistics);
+}
+
+/**
+ * Build the parse tree of tokens that were already pushed through a
+ * recognizer, and report the work it took: see the overload above.
+ *
+ * @param recognizer: recognizer that has been fed all of input_tokens
+ * @param input_tokens: words of the program, in the order they were pushed
+ * @param statistics: set to the work of the recognizer and of the parse tree
+ * search
+ * @return parse tree of input_tokens
+ */
+auto Grammar::parse(const EarleyRecognizer& recognizer,
+					const std::vector<Token>& input_tokens,
+					ParseStatistics& statistics) const
+	-> std::vector<SubParse> {
+	const TraceSpan span{"build parse tree"};
+	ParseMeter meter{parse_budget, recognizer.get_statistics()};
+	meter.start_search();
+	const std::vector<SubParse> tree =
+		build_earley_parse_tree(recognizer.get_earley_sets(),
+								parser_rules(),
+								input_tokens,
+								default_start,
+								parser_unit_chains(),
+								parser_disambiguation(),
+								parser_rule_ranks(),
+								&meter);
+	statistics = meter.get_statistics();
+	return to_visible_tree(tree);
+}
+
+/**
+ * Parse input tokens with most of their Earley items out of memory, for a long
+ * input like a program generated by a tool. The recognizer only keeps the
+ * state sets that later tokens can still need, and writes the finished items
+ * of each state set to spill_file_name as it goes; the parse tree is then
+ * searched in that file, mapped back into memory. The parse tree is the same
+ * as parse(input_tokens) without an embedded precedence parser.
+ *
+ * Only the finished items are spilled. The tokens, an offset per token, the
+ * pages of the file that the search touches and the parse tree stay in memory,
+ * so memory still grows with the length of the input, by less than
+ * parse(input_tokens) needs.
+ *
+ * Throws ParseBudgetExceeded if the parse goes over the budget of
+ * set_parse_budget, and std::logic_error if input_tokens do not parse.
+ *
+ * @param input_tokens: words of the program
+ * @param spill_file_name: file to keep the finished items in. It is
+ * overwritten, and removed once the parse tree is built.
+ * @return parse tree of input_tokens
+ */
+auto Grammar::parse_spilling_finished_items(
+	const std::vector<Token>& input_tokens,
+	const std::string& spill_file_name) const -> std::vector<SubParse> {
+	SpilledEarleySets spilled{spill_file_name, parser_rules()};
+
+	EarleyRecognizer recognizer = make_recognizer();
+	{
+		const TraceSpan span{"recognize"};
+		recognizer.keep_needed_sets_only();
+		recognizer.spill_finished_items(spilled);
+		for(const Token& token : input_tokens) {
+			if(!recognizer.push(token)) {
+				break;
+			}
+		}
+
+		if(!recognizer.is_accepted()) {
+			LOG("ERROR") << "No successful parse of tokens" << std::endl;
+			throw std::logic_error("No successful parse of tokens");
+		}
+
+		spilled.finish(recognizer.get_earley_sets().back(),
+					   parser_rule_ranks());
+	}
+
+	const TraceSpan span{"build parse tree"};
+	ParseMeter meter{parse_budget, recognizer.get_statistics()};
+	meter.start_search();
+	const std::vector<SubParse> tree =
+		build_earley_parse_tree(spilled,
+								parser_rules(),
+								parser_unit_chains(),
+								parser_disambiguation(),
+								input_tokens,
+								default_start,
+								meter);
+	return to_visible_tree(tree);
+}
+
+/**
+ * Parse input tokens, reusing the work of the previous parse stored in state.
+ *
+ * Only the tokens from the first token that differs from the previous input
+ * onwards are parsed again: Earley state sets before it are kept, and parts
+ * of the previous parse tree that end before it are copied over. Parsing an
+ * input that was edited near its end is then much cheaper than a full parse.
+ *
+ * @param input_tokens: words of the (edited) program
+ * @param state: Earley state sets, tokens and parse tree of the previous
+ * parse, or an empty state for the first parse. Updated to describe
+ * input_tokens, or emptied if input_tokens fail to parse. The parse tree in
+ * state uses the rules the parser uses, which differ from get_rules() if the
+ * rules are normalized. Its statistics are set to the work of this parse.
+ * @return parse tree of input_tokens, same as parse(input_tokens)
+ */
+auto Grammar::reparse(const std::vector<Token>& input_tokens,
+					  IncrementalParseState& state) const
+	-> std::vector<SubParse> {
+	// number of leading tokens that did not change since the previous parse
+	std::size_t first_changed_token = 0;
+	while(first_changed_token < input_tokens.size() &&
+		  first_changed_token < state.tokens.size() &&
+		  input_tokens[first_changed_token].type ==
+			  state.tokens[first_changed_token].type &&
+		  input_tokens[first_changed_token].value ==
+			  state.tokens[first_changed_token].value) {
+		++first_changed_token;
+	}
+
+	if(!state.tree.empty() && first_changed_token == input_tokens.size() &&
+	   first_changed_token == state.tokens.size()) {
+		state.statistics = ParseStatistics{};
+		return to_visible_tree(state.tree);
+	}
+
+	ParseMeter meter{parse_budget};
+
+	// the Earley state sets are rebuilt in place, so once they describe
+	// input_tokens, the tokens and tree of state no longer match them. If the
+	// parse fails, state is reset, and the next reparse starts over.
+	try {
+		{
+			const TraceSpan span{"recognize"};
+			reparse_earley_items(state,
+								 parser_rules(),
+								 parser_unit_chains(),
+								 parser_disambiguation(),
+								 input_tokens,
+								 default_start,
+								 first_changed_token,
+								 parser_rule_ranks(),
+								 &meter);
+		}
+
+		const TraceSpan span{"build parse tree"};
+		meter.start_search();
+		rebuild_earley_parse_tree(state,
+								  parser_rules(),
+								  parser_unit_chains(),
+								  parser_disambiguation(),
+								  input_tokens,
+								  default_start,
+								  first_changed_token,
+								  &meter);
+	} catch(...) {
+		state = IncrementalParseState{};
+		throw;
+	}
+
+	// only the tokens from the first changed one on are copied
+	const auto kept_tokens = static_cast<std::ptrdiff_t>(first_changed_token);
+	state.tokens.erase(state.tokens.begin() + kept_tokens, state.tokens.end());
+	state.tokens.insert(state.tokens.end(),
+						input_tokens.begin() + kept_tokens,
+						input_tokens.end());
+	state.statistics = meter.get_statistics();
+
+	return to_visible_tree(state.tree);
 }
 
 auto Grammar::get_rules() const -> std::vector<Rule> {
 	return rules;
 }
 
+/**
+ * @return reachability, nullability, FIRST and FOLLOW sets of the rules
+ */
+[[gnu::const]] auto Grammar::get_analysis() const -> const GrammarAnalysis& {
+	return analysis;
+}
+
 /**
  * Mark some special rule symbols from default non-terminal to terminal.
  *
@@ -40,15 +539,305 @@ auto Grammar::get_rules() const -> std::vector<Rule> {
  */
 auto Grammar::mark_special_symbols_as_terminal(
 	const std::set<std::string>& special_tokens) -> void {
-	for(Rule& rule : rules) {
-		if(special_tokens.find(rule.production.value) != special_tokens.end()) {
-			rule.production.terminal = true;
+	for(std::vector<Rule>* rule_list : {&rules, &normalized.rules}) {
+		for(Rule& rule : *rule_list) {
+			if(special_tokens.find(rule.production.value) !=
+			   special_tokens.end()) {
+				rule.production.terminal = true;
+			}
+
+			for(GrammarSymbol& symbol : rule.replacement) {
+				if(special_tokens.find(symbol.value) != special_tokens.end()) {
+					symbol.terminal = true;
+				}
+			}
 		}
+	}
+
+	analysis = analyze_grammar(rules, default_start);
+	if(!unit_chains.skipped.empty()) {
+		collapse_unit_chains();
+	}
+	if(!precedence_root.empty()) {
+		embed_precedence_parser(precedence_root);
+	}
+}
+
+/**
+ * Let the parser skip unit rules, like
+ * <expression> ::= <assignment-expression>, whose replacement is a single
+ * non-terminal. A rule that expects <expression> then directly matches a rule
+ * of <assignment-expression>, or of any non-terminal further down the chain.
+ *
+ * Parsing creates fewer Earley items, and parse trees leave out the SubParses
+ * of unit rules. The rules keep their indices, and expand_unit_chains puts
+ * the left-out SubParses back.
+ */
+auto Grammar::collapse_unit_chains() -> void {
+	const TraceSpan span{"collapse unit chains"};
+	unit_chains = find_unit_chains(rules, repetitions);
+	if(!normalized.rules.empty()) {
+		normalized_unit_chains =
+			find_unit_chains(normalized.rules, repetitions);
+	}
+}
+
+/**
+ * Let the parser use left-factored and binarized rules: alternatives of a
+ * non-terminal that start with the same symbols share a rule for them, like
+ * the two forms of <selection-statement> that start with
+ * "if" "(" <expression> ")" <statement>, and rules longer than
+ * max_rule_length are split up. Both add helper non-terminals, which parse
+ * trees leave out: a parse tree still refers to get_rules(), and has the same
+ * shape as without normalized rules.
+ *
+ * @param max_rule_length: longest rule to keep, at least 2
+ */
+auto Grammar::normalize_rules(const std::size_t _max_rule_length) -> void {
+	max_rule_length = _max_rule_length;
+	normalized =
+		::normalize_rules(rules,
+						  max_rule_length,
+						  disambiguated_productions(disambiguation_rules));
+	if(!unit_chains.skipped.empty()) {
+		normalized_unit_chains =
+			find_unit_chains(normalized.rules, repetitions);
+	}
+	normalized_disambiguation =
+		make_disambiguation(normalized.rules, disambiguation_rules);
+}
+
+/**
+ * Choose between the parses of an ambiguous grammar while parsing: an operand
+ * of an operator rule may not be a looser operator, or an operator of the
+ * same level on the wrong side for its associativity, and a rule with a
+ * follow restriction is not finished right before a restricted token. The
+ * parser never builds the rejected parses, rather than building every parse
+ * and choosing one afterwards.
+ *
+ * @param declarations: precedence levels and follow restrictions on rules of
+ * this grammar
+ */
+auto Grammar::disambiguate(const DisambiguationRules& declarations) -> void {
+	const TraceSpan span{"disambiguate grammar"};
+	disambiguation_rules = declarations;
+	disambiguation = make_disambiguation(rules, disambiguation_rules);
+	if(!normalized.rules.empty()) {
+		normalize_rules(max_rule_length);
+	}
+}
+
+/**
+ * Let parse(input_tokens) parse a symbol like <expression>, and everything it
+ * derives, by precedence climbing instead of by the Earley parser: each
+ * operator of an expression is then matched once, instead of being predicted
+ * at every level of precedence. The parse trees are the same, except that an
+ * ambiguous expression gets the parse of its longest operand first.
+ *
+ * Statements and everything else around the expressions are still parsed by
+ * the Earley parser. The precedence parser is not used with normalized rules,
+ * or if rules of the region have precedence or follow restrictions, and it is
+ * only used by parse(input_tokens).
+ *
+ * This is opt-in, and Compiler does not call it: Compiler recognizes each
+ * token as soon as the lexer finds it, while the precedence parser needs the
+ * tokens after the start of an expression to parse it. So the Earley items it
+ * saves are only saved by callers of parse(input_tokens) that embed it.
+ *
+ * @param symbol_name: non-terminal at the top of the expressions
+ */
+auto Grammar::embed_precedence_parser(const std::string& symbol_name) -> void {
+	precedence_region = find_precedence_region(rules, symbol_name);
+	precedence_root = symbol_name;
+}
+
+/**
+ * Let parse tree searches try the rules that a profile saw most often first.
+ * Every parse function of this Grammar builds the same parse trees as
+ * without the profile, as long as the grammar is unambiguous, but backtracks
+ * less on inputs like the profiled ones.
+ *
+ * @param profile: uses of rules in the parse trees of a corpus, from
+ * add_to_profile
+ */
+auto Grammar::use_parse_profile(const ParseProfile& profile) -> void {
+	parse_profile = profile;
+}
 
-		for(GrammarSymbol& symbol : rule.replacement) {
-			if(special_tokens.find(symbol.value) != special_tokens.end()) {
-				symbol.terminal = true;
+/**
+ * Limit the work of each parse of this Grammar, so that an input that makes
+ * the Earley state sets or the parse tree search blow up fails fast with
+ * ParseBudgetExceeded, instead of taking unbounded time and memory.
+ * Recognizers made after this call are held to the budget too.
+ *
+ * @param budget: most work of one parse, with 0 for no limit
+ */
+auto Grammar::set_parse_budget(const ParseBudget& budget) -> void {
+	parse_budget = budget;
+}
+
+/**
+ * @return rank of each rule of parser_rules() in parse_profile, or empty
+ * without a profile
+ */
+auto Grammar::parser_rule_ranks() const -> std::vector<std::size_t> {
+	if(parse_profile.rule_uses.empty()) {
+		return {};
+	}
+
+	return rank_rules(parse_profile, parser_rules());
+}
+
+/**
+ * @return true iff parse(input_tokens) hands the region of precedence_root
+ * over to the precedence parser
+ */
+[[gnu::pure]] auto Grammar::uses_precedence_parser() const -> bool {
+	if(precedence_root.empty() || !normalized.rules.empty()) {
+		return false;
+	}
+
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		if(!precedence_region.embedded[i]) {
+			continue;
+		}
+
+		if(i < disambiguation.follow_restrictions.size() &&
+		   !disambiguation.follow_restrictions[i].empty()) {
+			return false;
+		}
+
+		if(i < disambiguation.rejected_children.size()) {
+			for(const std::set<std::size_t>& rejected :
+				disambiguation.rejected_children[i]) {
+				if(!rejected.empty()) {
+					return false;
+				}
 			}
 		}
 	}
+
+	return true;
+}
+
+/**
+ * @return rules that the Earley parser uses: normalized rules if there are
+ * any
+ */
+[[gnu::pure]] auto Grammar::parser_rules() const -> const std::vector<Rule>& {
+	return normalized.rules.empty() ? rules : normalized.rules;
+}
+
+/**
+ * @return unit rules of parser_rules() that the Earley parser skips
+ */
+[[gnu::pure]] auto Grammar::parser_unit_chains() const -> const UnitChains& {
+	return normalized.rules.empty() ? unit_chains : normalized_unit_chains;
+}
+
+/**
+ * @return precedence and follow restrictions on rules of parser_rules()
+ */
+[[gnu::pure]] auto Grammar::parser_disambiguation() const
+	-> const Disambiguation& {
+	return normalized.rules.empty() ? disambiguation
+									: normalized_disambiguation;
+}
+
+/**
+ * Turn a parse tree of parser_rules() into a parse tree of get_rules(), with
+ * the same unit rules left out as if parsed without normalized rules, and
+ * each list as a single SubParse.
+ * @param tree: parse tree from the Earley parser
+ * @return parse tree for users of Grammar
+ */
+auto Grammar::to_visible_tree(const std::vector<SubParse>& tree) const
+	-> std::vector<SubParse> {
+	if(normalized.rules.empty()) {
+		return flatten_repetitions(tree, rules, repetitions);
+	}
+
+	std::vector<SubParse> visible_tree =
+		hide_helper_rules(::expand_unit_chains(tree,
+											   normalized.rules,
+											   normalized_unit_chains,
+											   default_start),
+						  normalized);
+
+	if(!unit_chains.skipped.empty()) {
+		visible_tree = ::collapse_unit_chains(visible_tree, unit_chains);
+	}
+
+	return flatten_repetitions(visible_tree, rules, repetitions);
+}
+
+/**
+ * How the rules of parser_rules() show up in a walk of the parse tree: helper
+ * rules of normalized rules and of lists, and unit rules if unit chains are
+ * collapsed, are left out, and normalized rules are reported as the rules
+ * they come from.
+ * @return the same view of the parse as to_visible_tree
+ */
+auto Grammar::rule_visibility() const -> RuleVisibility {
+	const auto is_repetition = [this](const std::size_t rule) {
+		return repetitions.find(rules[rule].production.value) !=
+			   repetitions.end();
+	};
+
+	RuleVisibility visibility;
+	if(normalized.rules.empty()) {
+		visibility.spliced = unit_chains.skipped;
+		if(!repetitions.empty()) {
+			visibility.spliced.resize(rules.size(), false);
+			for(std::size_t i = 0; i < rules.size(); ++i) {
+				visibility.spliced[i] =
+					visibility.spliced[i] || is_repetition(i);
+			}
+		}
+		return visibility;
+	}
+
+	for(std::size_t i = 0; i < normalized.rules.size(); ++i) {
+		const std::size_t original = normalized.original_rules[i];
+		const bool helper =
+			normalized.helpers.find(normalized.rules[i].production.value) !=
+			normalized.helpers.end();
+
+		visibility.reported_rules.push_back(
+			original == NormalizedRules::no_rule
+				? RuleVisibility::same_as_last_child
+				: original);
+		visibility.spliced.push_back(
+			helper || (original != NormalizedRules::no_rule &&
+					   ((original < unit_chains.skipped.size() &&
+						 unit_chains.skipped[original]) ||
+						is_repetition(original))));
+	}
+
+	return visibility;
+}
+
+/**
+ * Recover the full parse tree from a parse tree of a Grammar with collapsed
+ * unit chains.
+ *
+ * @param tree: parse tree from parse or reparse
+ * @return same parse tree, with a SubParse for every unit rule that was
+ * skipped. If unit chains are not collapsed, this is tree itself.
+ */
+auto Grammar::expand_unit_chains(const std::vector<SubParse>& tree) const
+	-> std::vector<SubParse> {
+	if(unit_chains.skipped.empty()) {
+		return tree;
+	}
+
+	// unit rules are put back between a SubParse and the children of its
+	// rule's symbols, so lists are nested again while they are put back
+	return flatten_repetitions(
+		::expand_unit_chains(nest_repetitions(tree, rules, repetitions),
+							 rules,
+							 unit_chains,
+							 default_start),
+		rules,
+		repetitions);
 }
@@ -1,34 +1,133 @@
 #ifndef GRAMMAR_HPP
 #define GRAMMAR_HPP
 
-#include <set>	   // std::set
-#include <string>  // std::string
-#include <vector>  // std::vector
+#include <cstddef>	// std::size_t
+#include <set>		// std::set
+#include <string>	// std::string
+#include <vector>	// std::vector
 
-#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
-#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
-#include <TMCompiler/compiler/models/token.hpp>			  // Token
-#include <TMCompiler/compiler/parser/earley_parser.hpp>	  // SubParse
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // DisambiguationRules
+#include <TMCompiler/compiler/models/grammar_analysis.hpp>	// GrammarAnalysis
+#include <TMCompiler/compiler/models/grammar_normalization.hpp>	 // NormalizedRules
+#include <TMCompiler/compiler/models/grammar_repetition.hpp>  // RepetitionRules
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>	  // GrammarSymbol
+#include <TMCompiler/compiler/models/parse_profile.hpp>		  // ParseProfile
+#include <TMCompiler/compiler/models/rule.hpp>				  // Rule
+#include <TMCompiler/compiler/models/token.hpp>				  // Token
+#include <TMCompiler/compiler/parser/bitset_recognizer.hpp>	 // BitsetRecognizer
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // Disambiguation, EarleyRecognizer, IncrementalParseState, ParseEvents, RuleVisibility, SubParse, UnitChains
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseStatistics
+#include <TMCompiler/compiler/parser/precedence_parser.hpp>	 // PrecedenceRegion
 
 class Grammar {
 public:
 	/**
-	 * Constructor for Grammar class.
+	 * Constructor for Grammar class. Symbols with an EBNF operator, like
+	 * <statement>*, are rewritten into plain rules: see RepetitionRules.
 	 *
 	 * @param rules: list of rules: non-terminal symbols to productions
 	 * @param default_start: non-terminal symbol name that every compilation
 	 * matches
 	 */
 	Grammar(std::vector<Rule> _rules, std::string _default_start);
+
+	/**
+	 * Constructor for Grammar class, that also cleans up the rules: symbols
+	 * like <identifier> that have no rules but are names of tokens become
+	 * terminal, and rules that no parse can use are removed.
+	 *
+	 * @param rules: list of rules: non-terminal symbols to productions
+	 * @param default_start: non-terminal symbol name that every compilation
+	 * matches
+	 * @param lexical_symbols: names of tokens produced by the lexer
+	 */
+	Grammar(std::vector<Rule> _rules,
+			std::string _default_start,
+			const std::set<std::string>& lexical_symbols);
 	[[nodiscard]] auto parse(const std::vector<Token>& input_tokens) const
 		-> std::vector<SubParse>;
+	[[nodiscard]] auto parse(const std::vector<Token>& input_tokens,
+							 ParseStatistics& statistics) const
+		-> std::vector<SubParse>;
+	[[nodiscard]] auto parse(const std::vector<Token>& input_tokens,
+							 const std::string& start_symbol) const
+		-> std::vector<SubParse>;
+	[[nodiscard]] auto parse(const std::vector<Token>& input_tokens,
+							 const std::string& start_symbol,
+							 ParseStatistics& statistics) const
+		-> std::vector<SubParse>;
+	auto walk_parse_tree(const std::vector<Token>& input_tokens,
+						 const ParseEvents& events) const -> void;
+	[[nodiscard]] auto make_recognizer() const -> EarleyRecognizer;
+	[[nodiscard]] auto fits_bitset_recognizer() const -> bool;
+	[[nodiscard]] auto make_bitset_recognizer() const -> BitsetRecognizer;
+	[[nodiscard]] auto parse(const EarleyRecognizer& recognizer,
+							 const std::vector<Token>& input_tokens) const
+		-> std::vector<SubParse>;
+	[[nodiscard]] auto parse(const EarleyRecognizer& recognizer,
+							 const std::vector<Token>& input_tokens,
+							 ParseStatistics& statistics) const
+		-> std::vector<SubParse>;
+	[[nodiscard]] auto parse_spilling_finished_items(
+		const std::vector<Token>& input_tokens,
+		const std::string& spill_file_name) const -> std::vector<SubParse>;
+	[[nodiscard]] auto reparse(const std::vector<Token>& input_tokens,
+							   IncrementalParseState& state) const
+		-> std::vector<SubParse>;
 	[[nodiscard]] auto get_rules() const -> std::vector<Rule>;
+	[[nodiscard]] auto get_analysis() const -> const GrammarAnalysis&;
 	auto mark_special_symbols_as_terminal(
 		const std::set<std::string>& special_tokens) -> void;
+	auto collapse_unit_chains() -> void;
+	auto normalize_rules(std::size_t max_rule_length) -> void;
+	auto disambiguate(const DisambiguationRules& declarations) -> void;
+	auto embed_precedence_parser(const std::string& symbol_name) -> void;
+	auto use_parse_profile(const ParseProfile& profile) -> void;
+	auto set_parse_budget(const ParseBudget& budget) -> void;
+	[[nodiscard]] auto expand_unit_chains(const std::vector<SubParse>& tree) const
+		-> std::vector<SubParse>;
 
 private:
 	std::vector<Rule> rules;
 	std::string default_start;
+
+	// helper non-terminals of lists like <statement>+, left out of parse trees
+	std::set<std::string> repetitions;
+	GrammarAnalysis analysis;
+	UnitChains unit_chains;
+
+	// rules the Earley parser uses instead of rules, if normalized
+	NormalizedRules normalized;
+	UnitChains normalized_unit_chains;
+	std::size_t max_rule_length = 0;
+
+	// precedence and follow restrictions, applied to rules and to normalized
+	// rules
+	DisambiguationRules disambiguation_rules;
+	Disambiguation disambiguation;
+	Disambiguation normalized_disambiguation;
+
+	// non-terminals that parse(input_tokens) parses by precedence climbing,
+	// reachable from precedence_root
+	std::string precedence_root;
+	PrecedenceRegion precedence_region;
+
+	// uses of rules in the parse trees of a corpus, which order the children
+	// that the parse tree search tries
+	ParseProfile parse_profile;
+
+	// most work of one parse
+	ParseBudget parse_budget;
+
+	auto remove_unused_rules() -> void;
+	[[nodiscard]] auto parser_rules() const -> const std::vector<Rule>&;
+	[[nodiscard]] auto parser_unit_chains() const -> const UnitChains&;
+	[[nodiscard]] auto parser_disambiguation() const -> const Disambiguation&;
+	[[nodiscard]] auto uses_precedence_parser() const -> bool;
+	[[nodiscard]] auto parser_rule_ranks() const -> std::vector<std::size_t>;
+	[[nodiscard]] auto rule_visibility() const -> RuleVisibility;
+	[[nodiscard]] auto to_visible_tree(const std::vector<SubParse>& tree) const
+		-> std::vector<SubParse>;
 };
 
 #endif
@@ -0,0 +1,325 @@
+#include "grammar_analysis.hpp"
+
+#include <cstddef>	// std::ptrdiff_t, std::size_t
+#include <set>		// std::set
+#include <string>	// std::string
+#include <utility>	// std::pair
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+
+// cannot be the value of a symbol read from the language specification,
+// because those are written between quotes or angle brackets
+const std::string GrammarAnalysis::end_of_input{};
+
+/**
+ * Replace non-terminals that have no rules of their own, but are names of
+ * tokens, by terminals. For instance, rules like <a> ::= <identifier> "c" mark
+ * <identifier> as non-terminal, but it is actually parsed by the lexer, in the
+ * first round of parsing, so the Earley parser should match it against the
+ * type of a token.
+ *
+ * @param rules: grammar rules to modify
+ * @param lexical_symbols: names of tokens of the lexical grammar
+ * @return names of the symbols that became terminal
+ */
+auto mark_lexical_symbols_as_terminal(
+	std::vector<Rule>& rules, const std::set<std::string>& lexical_symbols)
+	-> std::set<std::string> {
+	std::set<std::string> defined;
+	for(const Rule& rule : rules) {
+		defined.insert(rule.production.value);
+	}
+
+	std::set<std::string> marked;
+	for(Rule& rule : rules) {
+		for(GrammarSymbol& symbol : rule.replacement) {
+			if(!symbol.terminal &&
+			   defined.find(symbol.value) == defined.end() &&
+			   lexical_symbols.find(symbol.value) != lexical_symbols.end()) {
+				symbol.terminal = true;
+				marked.insert(symbol.value);
+			}
+		}
+	}
+
+	return marked;
+}
+
+/**
+ * Find the non-terminals that derive the empty string.
+ */
+auto find_nullable(const std::vector<Rule>& rules) -> std::set<std::string> {
+	std::set<std::string> nullable;
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(const Rule& rule : rules) {
+			if(nullable.find(rule.production.value) != nullable.end()) {
+				continue;
+			}
+
+			bool all_nullable = true;
+			for(const GrammarSymbol& symbol : rule.replacement) {
+				if(symbol.terminal ||
+				   nullable.find(symbol.value) == nullable.end()) {
+					all_nullable = false;
+					break;
+				}
+			}
+
+			if(all_nullable) {
+				nullable.insert(rule.production.value);
+				changed = true;
+			}
+		}
+	}
+
+	return nullable;
+}
+
+/**
+ * Find the non-terminals that derive at least one string of terminals.
+ */
+auto find_productive(const std::vector<Rule>& rules) -> std::set<std::string> {
+	std::set<std::string> productive;
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(const Rule& rule : rules) {
+			if(productive.find(rule.production.value) != productive.end()) {
+				continue;
+			}
+
+			bool all_productive = true;
+			for(const GrammarSymbol& symbol : rule.replacement) {
+				if(!symbol.terminal &&
+				   productive.find(symbol.value) == productive.end()) {
+					all_productive = false;
+					break;
+				}
+			}
+
+			if(all_productive) {
+				productive.insert(rule.production.value);
+				changed = true;
+			}
+		}
+	}
+
+	return productive;
+}
+
+/**
+ * Find the non-terminals reachable from the start symbol, through rules that
+ * can finish.
+ */
+auto find_reachable(const std::vector<Rule>& rules,
+					const std::string& default_start,
+					const std::set<std::string>& productive)
+	-> std::set<std::string> {
+	std::set<std::string> reachable{default_start};
+	std::vector<std::string> frontier{default_start};
+	while(!frontier.empty()) {
+		const std::string symbol_name = frontier.back();
+		frontier.pop_back();
+
+		for(const Rule& rule : rules) {
+			if(rule.production.value != symbol_name) {
+				continue;
+			}
+
+			bool finishes = true;
+			for(const GrammarSymbol& symbol : rule.replacement) {
+				if(!symbol.terminal &&
+				   productive.find(symbol.value) == productive.end()) {
+					finishes = false;
+					break;
+				}
+			}
+
+			if(!finishes) {
+				continue;
+			}
+
+			for(const GrammarSymbol& symbol : rule.replacement) {
+				if(!symbol.terminal &&
+				   reachable.insert(symbol.value).second) {
+					frontier.push_back(symbol.value);
+				}
+			}
+		}
+	}
+
+	return reachable;
+}
+
+/**
+ * @return true iff every symbol of the sequence derives the empty string
+ */
+[[gnu::pure]] auto is_nullable_sequence(
+	const GrammarAnalysis& analysis, const std::vector<GrammarSymbol>& symbols)
+	-> bool {
+	for(const GrammarSymbol& symbol : symbols) {
+		if(symbol.terminal ||
+		   analysis.nullable.find(symbol.value) == analysis.nullable.end()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @return terminals that can begin a string derived from the sequence
+ */
+auto first_of_sequence(const GrammarAnalysis& analysis,
+					   const std::vector<GrammarSymbol>& symbols)
+	-> std::set<std::string> {
+	std::set<std::string> result;
+	for(const GrammarSymbol& symbol : symbols) {
+		if(symbol.terminal) {
+			result.insert(symbol.value);
+			break;
+		}
+
+		const auto it = analysis.first.find(symbol.value);
+		if(it != analysis.first.end()) {
+			result.insert(it->second.begin(), it->second.end());
+		}
+
+		if(analysis.nullable.find(symbol.value) == analysis.nullable.end()) {
+			break;
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Analyze a grammar: see GrammarAnalysis.
+ *
+ * Rules are reported as unreachable or nonproductive when no parse from the
+ * start symbol can use them, and as duplicate when an earlier rule has the
+ * same production and replacement. FIRST and FOLLOW sets are computed from
+ * the other rules, so that removing the reported rules does not change them.
+ *
+ * @param rules: grammar rules
+ * @param default_start: non-terminal symbol name that every parse matches
+ * @return results of the analysis
+ */
+auto analyze_grammar(const std::vector<Rule>& rules,
+					 const std::string& default_start) -> GrammarAnalysis {
+	GrammarAnalysis analysis;
+
+	for(const Rule& rule : rules) {
+		analysis.nonterminals.insert(rule.production.value);
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(symbol.terminal) {
+				analysis.terminals.insert(symbol.value);
+			}
+		}
+	}
+
+	analysis.productive = find_productive(rules);
+	analysis.reachable =
+		find_reachable(rules, default_start, analysis.productive);
+
+	// classify rules that no parse can use, and rules seen before
+	std::set<std::pair<std::string, std::vector<std::pair<std::string, bool> > > >
+		seen_rules;
+	std::vector<Rule> live_rules;
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		const Rule& rule = rules[i];
+
+		bool finishes = true;
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(!symbol.terminal && analysis.productive.find(symbol.value) ==
+									   analysis.productive.end()) {
+				finishes = false;
+				break;
+			}
+		}
+
+		std::vector<std::pair<std::string, bool> > replacement;
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			replacement.emplace_back(symbol.value, symbol.terminal);
+		}
+
+		if(!finishes) {
+			analysis.nonproductive_rules.push_back(i);
+		} else if(analysis.reachable.find(rule.production.value) ==
+				  analysis.reachable.end()) {
+			analysis.unreachable_rules.push_back(i);
+		} else if(!seen_rules.emplace(rule.production.value, replacement)
+					   .second) {
+			analysis.duplicate_rules.push_back(i);
+		} else {
+			live_rules.push_back(rule);
+		}
+	}
+
+	analysis.nullable = find_nullable(live_rules);
+
+	for(const std::string& nonterminal : analysis.nonterminals) {
+		analysis.first[nonterminal];
+		analysis.follow[nonterminal];
+	}
+
+	// FIRST: grow until no set changes
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(const Rule& rule : live_rules) {
+			const std::set<std::string> first =
+				first_of_sequence(analysis, rule.replacement);
+			std::set<std::string>& production_first =
+				analysis.first[rule.production.value];
+			for(const std::string& terminal : first) {
+				if(production_first.insert(terminal).second) {
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// FOLLOW: for every A ::= ... B rest, FOLLOW(B) contains FIRST(rest), and
+	// FOLLOW(A) if rest is nullable
+	analysis.follow[default_start].insert(GrammarAnalysis::end_of_input);
+	changed = true;
+	while(changed) {
+		changed = false;
+		for(const Rule& rule : live_rules) {
+			for(std::size_t i = 0; i < rule.replacement.size(); ++i) {
+				const GrammarSymbol& symbol = rule.replacement[i];
+				if(symbol.terminal) {
+					continue;
+				}
+
+				const std::vector<GrammarSymbol> rest(
+					rule.replacement.begin() +
+						static_cast<std::ptrdiff_t>(i + 1),
+					rule.replacement.end());
+
+				std::set<std::string> follow = first_of_sequence(analysis, rest);
+				if(is_nullable_sequence(analysis, rest)) {
+					const std::set<std::string>& production_follow =
+						analysis.follow[rule.production.value];
+					follow.insert(production_follow.begin(),
+								  production_follow.end());
+				}
+
+				std::set<std::string>& symbol_follow =
+					analysis.follow[symbol.value];
+				for(const std::string& terminal : follow) {
+					if(symbol_follow.insert(terminal).second) {
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	return analysis;
+}
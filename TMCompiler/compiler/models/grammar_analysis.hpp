@@ -0,0 +1,88 @@
+#ifndef GRAMMAR_ANALYSIS_HPP
+#define GRAMMAR_ANALYSIS_HPP
+
+#include <cstddef>	// std::size_t
+#include <map>		// std::map
+#include <set>		// std::set
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+
+/**
+ * Facts about a context-free grammar that do not depend on the input: which
+ * non-terminals are reachable from the start symbol, which derive a string of
+ * terminals, which derive the empty string, and their FIRST and FOLLOW sets.
+ */
+struct GrammarAnalysis {
+	// stands for the end of the input in FOLLOW sets
+	static const std::string end_of_input;
+
+	// non-terminal symbols that have at least one rule
+	std::set<std::string> nonterminals;
+
+	// values of terminal symbols in rules
+	std::set<std::string> terminals;
+
+	// non-terminals reachable from the start symbol
+	std::set<std::string> reachable;
+
+	// non-terminals that derive at least one string of terminals
+	std::set<std::string> productive;
+
+	// non-terminals that derive the empty string
+	std::set<std::string> nullable;
+
+	// terminals that can begin a string derived from each non-terminal
+	std::map<std::string, std::set<std::string> > first;
+
+	// terminals that can follow each non-terminal, including end_of_input
+	std::map<std::string, std::set<std::string> > follow;
+
+	// indices of rules whose production is unreachable from the start symbol
+	std::vector<std::size_t> unreachable_rules;
+
+	// indices of rules that can never finish, because a symbol in them
+	// derives no string of terminals
+	std::vector<std::size_t> nonproductive_rules;
+
+	// indices of rules that are the same as an earlier rule
+	std::vector<std::size_t> duplicate_rules;
+};
+
+/**
+ * Replace non-terminals that have no rules of their own, but are names of
+ * tokens, by terminals: for instance <identifier> is parsed by the lexer and
+ * not by the syntactical grammar.
+ * @param rules: grammar rules to modify
+ * @param lexical_symbols: names of tokens of the lexical grammar
+ * @return names of the symbols that became terminal
+ */
+auto mark_lexical_symbols_as_terminal(
+	std::vector<Rule>& rules, const std::set<std::string>& lexical_symbols)
+	-> std::set<std::string>;
+
+/**
+ * Analyze a grammar: see GrammarAnalysis.
+ * @param rules: grammar rules
+ * @param default_start: non-terminal symbol name that every parse matches
+ * @return results of the analysis
+ */
+auto analyze_grammar(const std::vector<Rule>& rules,
+					 const std::string& default_start) -> GrammarAnalysis;
+
+/**
+ * @return true iff every symbol of the sequence derives the empty string
+ */
+auto is_nullable_sequence(const GrammarAnalysis& analysis,
+						  const std::vector<GrammarSymbol>& symbols) -> bool;
+
+/**
+ * @return terminals that can begin a string derived from the sequence
+ */
+auto first_of_sequence(const GrammarAnalysis& analysis,
+					   const std::vector<GrammarSymbol>& symbols)
+	-> std::set<std::string>;
+
+#endif
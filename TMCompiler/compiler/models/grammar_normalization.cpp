@@ -0,0 +1,377 @@
+#include "grammar_normalization.hpp"
+
+#include <algorithm>  // std::max, std::min
+#include <cstddef>	  // std::ptrdiff_t, std::size_t
+#include <set>		  // std::set
+#include <string>	  // std::string, std::to_string
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	  // SubParse
+
+// a replacement of a non-terminal, and the original rule it finishes
+struct Alternative {
+	std::vector<GrammarSymbol> replacement;
+	std::size_t original;
+};
+
+[[gnu::pure]] auto same_symbol(const GrammarSymbol& symbol1,
+							   const GrammarSymbol& symbol2) -> bool {
+	return symbol1.value == symbol2.value &&
+		   symbol1.terminal == symbol2.terminal;
+}
+
+/**
+ * Create a name for a helper non-terminal that no other symbol has, like
+ * "selection-statement~1".
+ * @param production: non-terminal the helper is made for
+ * @param taken: names already in use; the new name is added
+ * @return new non-terminal
+ */
+auto make_helper(const std::string& production, std::set<std::string>& taken)
+	-> GrammarSymbol {
+	for(std::size_t k = 1;; ++k) {
+		const std::string name = production + "~" + std::to_string(k);
+		if(taken.insert(name).second) {
+			return GrammarSymbol{name, false};
+		}
+	}
+}
+
+/**
+ * Add a rule, split into rules of at most max_rule_length symbols: the first
+ * symbols are kept, and a helper non-terminal derives the rest.
+ * @param normalized: rules to add to
+ * @param taken: names of non-terminals in use
+ * @param production: left-hand side of the rule
+ * @param replacement: right-hand side of the rule
+ * @param original: index of the original rule that this rule finishes, or
+ * NormalizedRules::no_rule
+ * @param max_rule_length: longest replacement to keep, at least 2
+ */
+auto add_binarized_rule(NormalizedRules& normalized,
+						std::set<std::string>& taken,
+						GrammarSymbol production,
+						std::vector<GrammarSymbol> replacement,
+						const std::size_t original,
+						const std::size_t max_rule_length) -> void {
+	while(replacement.size() > max_rule_length) {
+		const GrammarSymbol helper = make_helper(production.value, taken);
+		normalized.helpers.insert(helper.value);
+
+		std::vector<GrammarSymbol> head(
+			replacement.begin(),
+			replacement.begin() +
+				static_cast<std::ptrdiff_t>(max_rule_length - 1));
+		head.push_back(helper);
+		normalized.rules.push_back(Rule{production, head});
+		normalized.original_rules.push_back(NormalizedRules::no_rule);
+
+		production = helper;
+		replacement.erase(replacement.begin(),
+						  replacement.begin() +
+							  static_cast<std::ptrdiff_t>(max_rule_length - 1));
+	}
+
+	normalized.rules.push_back(Rule{production, replacement});
+	normalized.original_rules.push_back(original);
+}
+
+/**
+ * Add the alternatives of a non-terminal, with common prefixes factored out:
+ * alternatives A ::= x y z and A ::= x y w become A ::= x y H, H ::= z and
+ * H ::= w, for a new helper non-terminal H. A prefix is only factored out if
+ * every alternative keeps at least one symbol after it, so that no helper
+ * derives the empty string.
+ * @param normalized: rules to add to
+ * @param taken: names of non-terminals in use
+ * @param production: left-hand side of the alternatives
+ * @param alternatives: right-hand sides, in order
+ * @param max_rule_length: longest replacement to keep
+ */
+auto add_left_factored_rules(NormalizedRules& normalized,
+							 std::set<std::string>& taken,
+							 const GrammarSymbol& production,
+							 const std::vector<Alternative>& alternatives,
+							 const std::size_t max_rule_length) -> void {
+	std::vector<bool> added(alternatives.size(), false);
+
+	for(std::size_t i = 0; i < alternatives.size(); ++i) {
+		if(added[i]) {
+			continue;
+		}
+
+		// alternatives with the same first symbol, in order
+		std::vector<Alternative> group{alternatives[i]};
+		added[i] = true;
+		for(std::size_t j = 1 + i;
+			j < alternatives.size() && !alternatives[i].replacement.empty();
+			++j) {
+			if(!added[j] && !alternatives[j].replacement.empty() &&
+			   same_symbol(alternatives[i].replacement[0],
+						   alternatives[j].replacement[0])) {
+				group.push_back(alternatives[j]);
+				added[j] = true;
+			}
+		}
+
+		if(group.size() == 1) {
+			add_binarized_rule(normalized,
+							   taken,
+							   production,
+							   group[0].replacement,
+							   group[0].original,
+							   max_rule_length);
+			continue;
+		}
+
+		std::size_t shortest = group[0].replacement.size();
+		for(const Alternative& alternative : group) {
+			shortest = std::min(shortest, alternative.replacement.size());
+		}
+
+		std::size_t prefix_length = 0;
+		while(prefix_length + 1 < shortest) {
+			bool all_same = true;
+			for(const Alternative& alternative : group) {
+				if(!same_symbol(alternative.replacement[prefix_length],
+								group[0].replacement[prefix_length])) {
+					all_same = false;
+					break;
+				}
+			}
+
+			if(!all_same) {
+				break;
+			}
+
+			++prefix_length;
+		}
+
+		// some alternative is just the common first symbol: keep it as it is,
+		// and factor the others
+		if(prefix_length == 0) {
+			std::vector<Alternative> longer;
+			for(const Alternative& alternative : group) {
+				if(alternative.replacement.size() == 1) {
+					add_binarized_rule(normalized,
+									   taken,
+									   production,
+									   alternative.replacement,
+									   alternative.original,
+									   max_rule_length);
+				} else {
+					longer.push_back(alternative);
+				}
+			}
+
+			add_left_factored_rules(
+				normalized, taken, production, longer, max_rule_length);
+			continue;
+		}
+
+		const GrammarSymbol helper = make_helper(production.value, taken);
+		normalized.helpers.insert(helper.value);
+
+		std::vector<GrammarSymbol> prefix(
+			group[0].replacement.begin(),
+			group[0].replacement.begin() +
+				static_cast<std::ptrdiff_t>(prefix_length));
+		prefix.push_back(helper);
+		add_binarized_rule(normalized,
+						   taken,
+						   production,
+						   prefix,
+						   NormalizedRules::no_rule,
+						   max_rule_length);
+
+		std::vector<Alternative> suffixes;
+		for(const Alternative& alternative : group) {
+			suffixes.push_back(Alternative{
+				std::vector<GrammarSymbol>(
+					alternative.replacement.begin() +
+						static_cast<std::ptrdiff_t>(prefix_length),
+					alternative.replacement.end()),
+				alternative.original});
+		}
+
+		add_left_factored_rules(
+			normalized, taken, helper, suffixes, max_rule_length);
+	}
+}
+
+/**
+ * Left-factor and binarize grammar rules.
+ *
+ * The Earley parser keeps an item for every rule whose prefix matches the
+ * input so far, so alternatives that share a prefix are tracked once per
+ * alternative. After left-factoring, the shared prefix is a single rule.
+ * Rules longer than max_rule_length are split into a chain of shorter rules.
+ *
+ * The rules of kept_productions are copied as they are. Precedence and follow
+ * restrictions refer to whole rules, so the rules they name must stay whole.
+ *
+ * @param rules: grammar rules to normalize
+ * @param max_rule_length: longest replacement to keep, at least 2
+ * @param kept_productions: non-terminals whose rules are not normalized
+ * @return normalized rules, which derive the same strings as rules
+ */
+auto normalize_rules(const std::vector<Rule>& rules,
+					 const std::size_t max_rule_length,
+					 const std::set<std::string>& kept_productions)
+	-> NormalizedRules {
+	NormalizedRules normalized;
+
+	// non-terminals in order of their first rule, and all symbol names
+	std::vector<std::string> productions;
+	std::set<std::string> taken;
+	for(const Rule& rule : rules) {
+		bool first_rule = true;
+		for(const std::string& production : productions) {
+			first_rule = first_rule && production != rule.production.value;
+		}
+		if(first_rule) {
+			productions.push_back(rule.production.value);
+		}
+
+		taken.insert(rule.production.value);
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			taken.insert(symbol.value);
+		}
+	}
+
+	for(const std::string& production : productions) {
+		const bool kept =
+			kept_productions.find(production) != kept_productions.end();
+		std::vector<Alternative> alternatives;
+		for(std::size_t i = 0; i < rules.size(); ++i) {
+			if(rules[i].production.value != production) {
+				continue;
+			}
+
+			if(kept) {
+				normalized.rules.push_back(rules[i]);
+				normalized.original_rules.push_back(i);
+			} else {
+				alternatives.push_back(Alternative{rules[i].replacement, i});
+			}
+		}
+
+		if(kept) {
+			continue;
+		}
+
+		add_left_factored_rules(normalized,
+								taken,
+								GrammarSymbol{production, false},
+								alternatives,
+								std::max<std::size_t>(2, max_rule_length));
+	}
+
+	return normalized;
+}
+
+/**
+ * Collect the children of a SubParse that are not helpers: children that are
+ * helpers are replaced by their own children.
+ * @param tree: parse tree that uses the normalized rules
+ * @param normalized: rules the parse tree uses
+ * @param children_begin: where the children of each SubParse begin
+ * @param children_end: where the children of each SubParse end
+ * @param location: SubParse whose children to collect
+ * @param visible_children: the children are appended here, in order
+ */
+auto collect_visible_children(const std::vector<SubParse>& tree,
+							  const NormalizedRules& normalized,
+							  const std::vector<std::size_t>& children_begin,
+							  const std::vector<std::size_t>& children_end,
+							  const std::size_t location,
+							  std::vector<std::size_t>& visible_children)
+	-> void {
+	for(std::size_t child = children_begin[location];
+		child < children_end[location];
+		++child) {
+		const std::string& production =
+			normalized.rules[tree[child].rule].production.value;
+		if(normalized.helpers.find(production) != normalized.helpers.end()) {
+			collect_visible_children(tree,
+									 normalized,
+									 children_begin,
+									 children_end,
+									 child,
+									 visible_children);
+		} else {
+			visible_children.push_back(child);
+		}
+	}
+}
+
+/**
+ * Turn a parse tree of normalized rules into a parse tree of the original
+ * rules.
+ *
+ * A SubParse of an original non-terminal uses a rule that may end in a
+ * helper, whose SubParse may again end in a helper: the last rule in that
+ * chain tells which original rule applies. The SubParses of the helpers are
+ * left out, and their children become children of the original SubParse.
+ *
+ * @param tree: parse tree that uses the normalized rules, without skipped
+ * unit rules
+ * @param normalized: rules the parse tree uses
+ * @return the same parse, with indices of the original rules
+ */
+auto hide_helper_rules(const std::vector<SubParse>& tree,
+					   const NormalizedRules& normalized)
+	-> std::vector<SubParse> {
+	if(tree.empty()) {
+		return tree;
+	}
+
+	std::vector<std::size_t> children_begin(tree.size(), 0);
+	std::vector<std::size_t> children_end(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		const std::size_t parent = tree[i].parent;
+		if(children_begin[parent] == children_end[parent]) {
+			children_begin[parent] = i;
+		}
+		children_end[parent] = 1 + i;
+	}
+
+	// the original rule of a SubParse: the helper of a rule that does not
+	// finish an original rule is its last symbol, so its last child
+	const auto original_rule = [&](std::size_t location) {
+		while(normalized.original_rules[tree[location].rule] ==
+			  NormalizedRules::no_rule) {
+			location = children_end[location] - 1;
+		}
+
+		return normalized.original_rules[tree[location].rule];
+	};
+
+	std::vector<SubParse> visible_tree{
+		SubParse{original_rule(0), tree[0].start, tree[0].end, 0}};
+
+	// for each SubParse of visible_tree, the same SubParse in tree
+	std::vector<std::size_t> locations{0};
+
+	for(std::size_t location = 0; location < visible_tree.size(); ++location) {
+		std::vector<std::size_t> visible_children;
+		collect_visible_children(tree,
+								 normalized,
+								 children_begin,
+								 children_end,
+								 locations[location],
+								 visible_children);
+
+		for(const std::size_t child : visible_children) {
+			visible_tree.push_back(SubParse{original_rule(child),
+											tree[child].start,
+											tree[child].end,
+											location});
+			locations.push_back(child);
+		}
+	}
+
+	return visible_tree;
+}
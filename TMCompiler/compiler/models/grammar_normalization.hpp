@@ -0,0 +1,56 @@
+#ifndef GRAMMAR_NORMALIZATION_HPP
+#define GRAMMAR_NORMALIZATION_HPP
+
+#include <cstddef>	// std::size_t
+#include <set>		// std::set
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+/**
+ * Rules of a grammar rewritten for the Earley parser: alternatives with a
+ * common prefix share one rule for it, and long rules are split into rules of
+ * at most two symbols. Both introduce helper non-terminals, which a parse tree
+ * of the original rules does not have.
+ */
+struct NormalizedRules {
+	// marks a rule that does not finish an original rule
+	static constexpr std::size_t no_rule = static_cast<std::size_t>(-1);
+
+	std::vector<Rule> rules;
+
+	// for each rule, the index of the original rule that it finishes, or
+	// no_rule if it ends in a helper non-terminal
+	std::vector<std::size_t> original_rules;
+
+	// names of helper non-terminals
+	std::set<std::string> helpers;
+};
+
+/**
+ * Left-factor and binarize grammar rules: see NormalizedRules.
+ * @param rules: grammar rules to normalize
+ * @param max_rule_length: longest replacement to keep, at least 2
+ * @param kept_productions: non-terminals whose rules are not normalized
+ * @return normalized rules, which derive the same strings as rules
+ */
+auto normalize_rules(const std::vector<Rule>& rules,
+					 std::size_t max_rule_length,
+					 const std::set<std::string>& kept_productions = {})
+	-> NormalizedRules;
+
+/**
+ * Turn a parse tree of normalized rules into a parse tree of the original
+ * rules: SubParses of helper non-terminals are replaced by their children.
+ * @param tree: parse tree that uses the normalized rules, without skipped
+ * unit rules
+ * @param normalized: rules the parse tree uses
+ * @return the same parse, with indices of the original rules
+ */
+auto hide_helper_rules(const std::vector<SubParse>& tree,
+					   const NormalizedRules& normalized)
+	-> std::vector<SubParse>;
+
+#endif
@@ -0,0 +1,287 @@
+#include "grammar_repetition.hpp"
+
+#include <cstddef>	  // std::size_t
+#include <map>		  // std::map
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument
+#include <string>	  // std::string
+#include <utility>	  // std::pair
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // rule_to_string, SubParse
+
+/**
+ * Rewrite the EBNF operators of grammar rules.
+ *
+ * A list written as a recursive rule, like
+ * <statements> ::= <statement> | <statement> <statements>, nests a SubParse
+ * for every element, so a parse tree is as deep as the list is long. With
+ * <statements> ::= <statement>+, the list is one SubParse with a child per
+ * statement. The helper rules are left-recursive, which the Earley parser
+ * recognizes with a constant number of items per element.
+ *
+ * Each alternative may have at most one <x>* or <x>+, so that the children
+ * of a list can be told apart from the other children by counting them.
+ *
+ * @param rules: grammar rules, whose symbols may have an EBNF operator
+ * @return rules without EBNF operators, which derive the same strings
+ */
+auto expand_repetitions(const std::vector<Rule>& rules) -> RepetitionRules {
+	RepetitionRules expanded;
+
+	std::set<std::string> productions;
+	for(const Rule& rule : rules) {
+		productions.insert(rule.production.value);
+	}
+
+	// repeated non-terminals, in order of first use
+	std::vector<GrammarSymbol> repeated;
+
+	for(const Rule& rule : rules) {
+		std::vector<std::vector<GrammarSymbol> > alternatives{{}};
+		std::size_t lists = 0;
+
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			GrammarSymbol kept{symbol.value, symbol.terminal};
+			if(symbol.repetition == '+' || symbol.repetition == '*') {
+				++lists;
+				kept.value = symbol.value + "+";
+				if(productions.find(kept.value) != productions.end()) {
+					throw std::invalid_argument(
+						"Cannot repeat <" + symbol.value + ">: <" +
+						kept.value + "> is already a non-terminal");
+				}
+
+				if(expanded.helpers.insert(kept.value).second) {
+					repeated.push_back(GrammarSymbol{symbol.value, false});
+				}
+			}
+
+			// alternatives without the symbol come first
+			const bool optional =
+				symbol.repetition == '?' || symbol.repetition == '*';
+			std::vector<std::vector<GrammarSymbol> > longer_alternatives;
+			if(optional) {
+				longer_alternatives = alternatives;
+			}
+			for(std::vector<GrammarSymbol> alternative : alternatives) {
+				alternative.push_back(kept);
+				longer_alternatives.push_back(alternative);
+			}
+			alternatives = longer_alternatives;
+		}
+
+		if(lists > 1) {
+			throw std::invalid_argument(
+				"Rule " + rule_to_string(rule) +
+				" has more than one symbol with * or +");
+		}
+
+		for(const std::vector<GrammarSymbol>& alternative : alternatives) {
+			expanded.rules.push_back(Rule{rule.production, alternative});
+		}
+	}
+
+	for(const GrammarSymbol& symbol : repeated) {
+		const GrammarSymbol helper{symbol.value + "+", false};
+		expanded.rules.push_back(Rule{helper, {symbol}});
+		expanded.rules.push_back(Rule{helper, {helper, symbol}});
+	}
+
+	return expanded;
+}
+
+/**
+ * Leave out the SubParses of helpers from a parse tree: their children become
+ * children of the SubParse above them. A list of n elements has n - 1 nested
+ * SubParses of helpers, which are spliced with a stack instead of recursion.
+ *
+ * @param tree: parse tree that uses the rules of RepetitionRules
+ * @param rules: rules the parse tree uses
+ * @param helpers: names of helper non-terminals
+ * @return the same parse, with each list as a single SubParse
+ */
+auto flatten_repetitions(const std::vector<SubParse>& tree,
+						 const std::vector<Rule>& rules,
+						 const std::set<std::string>& helpers)
+	-> std::vector<SubParse> {
+	if(tree.empty() || helpers.empty()) {
+		return tree;
+	}
+
+	std::vector<std::size_t> children_begin(tree.size(), 0);
+	std::vector<std::size_t> children_end(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		const std::size_t parent = tree[i].parent;
+		if(children_begin[parent] == children_end[parent]) {
+			children_begin[parent] = i;
+		}
+		children_end[parent] = 1 + i;
+	}
+
+	const auto is_helper = [&](const std::size_t location) {
+		return helpers.find(rules[tree[location].rule].production.value) !=
+			   helpers.end();
+	};
+
+	std::vector<SubParse> flattened{
+		SubParse{tree[0].rule, tree[0].start, tree[0].end, 0}};
+
+	// for each SubParse of flattened, the same SubParse in tree
+	std::vector<std::size_t> locations{0};
+
+	for(std::size_t location = 0; location < flattened.size(); ++location) {
+		// children still to visit, the next one on top
+		std::vector<std::size_t> pending;
+		for(std::size_t child = children_end[locations[location]];
+			child > children_begin[locations[location]];
+			--child) {
+			pending.push_back(child - 1);
+		}
+
+		while(!pending.empty()) {
+			const std::size_t child = pending.back();
+			pending.pop_back();
+
+			if(is_helper(child)) {
+				for(std::size_t grandchild = children_end[child];
+					grandchild > children_begin[child];
+					--grandchild) {
+					pending.push_back(grandchild - 1);
+				}
+				continue;
+			}
+
+			flattened.push_back(SubParse{tree[child].rule,
+										 tree[child].start,
+										 tree[child].end,
+										 location});
+			locations.push_back(child);
+		}
+	}
+
+	return flattened;
+}
+
+/**
+ * Put the SubParses of helpers back into a parse tree from
+ * flatten_repetitions.
+ *
+ * A SubParse has a child per non-terminal of its rule, except that the
+ * helper of a list, if any, stands for as many children as the list has
+ * elements: the children that are left over. The elements are nested again
+ * as x+ ::= x+ <x> down to x+ ::= <x>.
+ *
+ * @param tree: parse tree with each list as a single SubParse
+ * @param rules: rules the parse tree uses
+ * @param helpers: names of helper non-terminals
+ * @return the same parse, with a SubParse for every rule applied
+ */
+auto nest_repetitions(const std::vector<SubParse>& tree,
+					  const std::vector<Rule>& rules,
+					  const std::set<std::string>& helpers)
+	-> std::vector<SubParse> {
+	if(tree.empty() || helpers.empty()) {
+		return tree;
+	}
+
+	std::vector<std::size_t> children_begin(tree.size(), 0);
+	std::vector<std::size_t> children_end(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		const std::size_t parent = tree[i].parent;
+		if(children_begin[parent] == children_end[parent]) {
+			children_begin[parent] = i;
+		}
+		children_end[parent] = 1 + i;
+	}
+
+	// rules x+ ::= <x> and x+ ::= x+ <x> of each helper
+	std::map<std::string, std::pair<std::size_t, std::size_t> > helper_rules;
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		const std::string& production = rules[i].production.value;
+		if(helpers.find(production) != helpers.end()) {
+			std::pair<std::size_t, std::size_t>& found =
+				helper_rules[production];
+			(rules[i].replacement.size() == 1 ? found.first : found.second) =
+				i;
+		}
+	}
+
+	// each SubParse of the nested tree is either the SubParse at location of
+	// tree, or a helper for the elements [location, end) of a list, which are
+	// SubParses of tree next to each other
+	struct Origin {
+		std::size_t location;
+		const std::string* helper;
+		std::size_t end;
+	};
+
+	std::vector<SubParse> nested{
+		SubParse{tree[0].rule, tree[0].start, tree[0].end, 0}};
+	std::vector<Origin> origins{Origin{0, nullptr, 0}};
+
+	const auto add = [&](const Origin origin, const std::size_t parent) {
+		if(origin.helper == nullptr) {
+			nested.push_back(SubParse{tree[origin.location].rule,
+									  tree[origin.location].start,
+									  tree[origin.location].end,
+									  parent});
+		} else {
+			const std::pair<std::size_t, std::size_t>& helper_rule =
+				helper_rules[*origin.helper];
+			nested.push_back(SubParse{origin.end - origin.location == 1
+										  ? helper_rule.first
+										  : helper_rule.second,
+									  tree[origin.location].start,
+									  tree[origin.end - 1].end,
+									  parent});
+		}
+		origins.push_back(origin);
+	};
+
+	for(std::size_t location = 0; location < nested.size(); ++location) {
+		const Origin origin = origins[location];
+
+		if(origin.helper != nullptr) {
+			// x+ ::= x+ <x>: all elements but the last, then the last one
+			if(origin.end - origin.location > 1) {
+				add(Origin{origin.location, origin.helper, origin.end - 1},
+					location);
+			}
+			add(Origin{origin.end - 1, nullptr, 0}, location);
+			continue;
+		}
+
+		const std::size_t begin = children_begin[origin.location];
+		const std::size_t end = children_end[origin.location];
+		const Rule& rule = rules[tree[origin.location].rule];
+
+		std::size_t nonterminals = 0;
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			nonterminals += symbol.terminal ? 0 : 1;
+		}
+
+		std::size_t child = begin;
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(symbol.terminal || child == end) {
+				continue;
+			}
+
+			const auto helper = helpers.find(symbol.value);
+			if(helper == helpers.end()) {
+				add(Origin{child, nullptr, 0}, location);
+				++child;
+				continue;
+			}
+
+			// the list takes the children that are left over
+			const std::size_t elements = end - begin + 1 - nonterminals;
+			add(Origin{child, &*helper, child + elements}, location);
+			child += elements;
+		}
+	}
+
+	return nested;
+}
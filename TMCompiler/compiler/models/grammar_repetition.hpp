@@ -0,0 +1,58 @@
+#ifndef GRAMMAR_REPETITION_HPP
+#define GRAMMAR_REPETITION_HPP
+
+#include <set>	   // std::set
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+/**
+ * Rules of a grammar with EBNF operators rewritten into plain rules:
+ * <x>? becomes an alternative without and one with <x>, and <x>+ becomes the
+ * helper non-terminal "x+" with the left-recursive rules x+ ::= <x> and
+ * x+ ::= x+ <x>; <x>* is either left out or <x>+. Parse trees leave out the
+ * SubParses of helpers, so a list is one SubParse with a child per element.
+ */
+struct RepetitionRules {
+	std::vector<Rule> rules;
+
+	// names of helper non-terminals
+	std::set<std::string> helpers;
+};
+
+/**
+ * Rewrite the EBNF operators of grammar rules: see RepetitionRules.
+ * @param rules: grammar rules, whose symbols may have an EBNF operator
+ * @return rules without EBNF operators, which derive the same strings
+ */
+auto expand_repetitions(const std::vector<Rule>& rules) -> RepetitionRules;
+
+/**
+ * Leave out the SubParses of helpers from a parse tree: their children become
+ * children of the SubParse above them.
+ * @param tree: parse tree that uses the rules of RepetitionRules
+ * @param rules: rules the parse tree uses
+ * @param helpers: names of helper non-terminals
+ * @return the same parse, with each list as a single SubParse
+ */
+auto flatten_repetitions(const std::vector<SubParse>& tree,
+						 const std::vector<Rule>& rules,
+						 const std::set<std::string>& helpers)
+	-> std::vector<SubParse>;
+
+/**
+ * Put the SubParses of helpers back into a parse tree from
+ * flatten_repetitions.
+ * @param tree: parse tree with each list as a single SubParse
+ * @param rules: rules the parse tree uses
+ * @param helpers: names of helper non-terminals
+ * @return the same parse, with a SubParse for every rule applied
+ */
+auto nest_repetitions(const std::vector<SubParse>& tree,
+					  const std::vector<Rule>& rules,
+					  const std::set<std::string>& helpers)
+	-> std::vector<SubParse>;
+
+#endif
@@ -7,6 +7,11 @@
 struct GrammarSymbol {
 	std::string value;
 	bool terminal{false};
+
+	// EBNF operator of a non-terminal, like <abc>*: '*' for zero or more,
+	// '+' for one or more, '?' for zero or one, or '\0' for exactly one.
+	// Grammar rewrites symbols with an operator into plain rules
+	char repetition{'\0'};
 };
 
 #endif
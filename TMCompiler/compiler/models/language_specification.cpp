@@ -27,14 +27,17 @@
 
 #include "language_specification.hpp"
 
+#include <cstddef>		  // std::size_t
 #include <optional>		  // std::optional
 #include <regex>		  // std::regex
+#include <set>			  // std::set
 #include <stdexcept>	  // std::logic_error
 #include <string>		  // std::string
 #include <unordered_set>  // std::unordered_set
 #include <utility>		  // std::pair
 #include <vector>		  // std::vector
 
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // DisambiguationRules, FollowRestriction, PrecedenceLevel
 #include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
 #include <TMCompiler/compiler/models/rule.hpp>			  // Rule
 
@@ -83,23 +86,23 @@ auto _read_top_level_string(const toml::table& language_spec_table,
  * ------------
  *  should return (
  *		vector[
- *			("whitespace", regex("\s+")),
- *			("integer-constant", regex("\d+")),
+ *			("whitespace", "\s+"),
+ *			("integer-constant", "\d+"),
  *		],
  *		unordered_set(["whitespace"]),
  *  )
  *
  * @param syntax_rules Array that is [[token.regexes]] in TOML format.
  *        Ex: language_spec_table["token"]["regexes"].as_array()
- * @return std::pair<std::vector<std::pair<std::string, std::regex>>,
+ * @return std::pair<std::vector<std::pair<std::string, std::string>>,
  *					 std::unordered_set<std::string>>
  *		   : First element returned is all (name, production) pairs; the second
  * element is a set of all names that have "ignore = true" grammar Rules
  */
 auto _read_token_regexes(const toml::array* token_regexes)
-	-> std::pair<std::vector<std::pair<std::string, std::regex>>,
+	-> std::pair<std::vector<std::pair<std::string, std::string>>,
 				 std::unordered_set<std::string>> {
-	std::vector<std::pair<std::string, std::regex>> name_and_regexes;
+	std::vector<std::pair<std::string, std::string>> name_and_patterns;
 	std::unordered_set<std::string> ignore_set;
 
 	for(const toml::v3::node& token_regex_node : *token_regexes) {
@@ -131,20 +134,23 @@ auto _read_token_regexes(const toml::array* token_regexes)
 		const bool is_ignore =
 			(is_ignore_opt.has_value() && is_ignore_opt.value());
 
-		name_and_regexes.emplace_back(name.value(),
-									  std::regex(regex_pattern.value()));
+		name_and_patterns.emplace_back(name.value(), regex_pattern.value());
 
 		if(is_ignore) {
 			ignore_set.insert(name.value());
 		}
 	}
 
-	return {name_and_regexes, ignore_set};
+	return {name_and_patterns, ignore_set};
 }
 
 /**
  * @brief Read in array of arrays of key "production" under [syntax.rules]
  *
+ * Nonterminal symbols may carry an EBNF operator: "<statement>*" for zero or
+ * more statements, "<statement>+" for one or more, and "<statement>?" for an
+ * optional one. Grammar rewrites them into plain rules.
+ *
  * @param production Array under each "production" key in [[syntax.rules]]
  *        header, such as {production = [["<type>", "<identifier>"]]}
  * @return std::vector<std::vector<GrammarSymbol>> Convert 2D array to 2D vector
@@ -169,7 +175,20 @@ auto _read_syntax_rule_production(const toml::array* production)
 					"Symbol in production cannot be parsed as a string");
 			}
 
-			const std::string& symbol_string = symbol_string_opt.value();
+			std::string symbol_string = symbol_string_opt.value();
+
+			// a nonterminal symbol may end in an EBNF operator, like
+			// "<statement>*": zero or more, "+": one or more, "?": optional.
+			// Terminal symbols are taken as they are, so "+" stays a token.
+			char repetition = '\0';
+			const std::size_t size = symbol_string.size();
+			if(size > 3 && symbol_string[0] == '<' &&
+			   symbol_string[size - 2] == '>' &&
+			   std::string{"*+?"}.find(symbol_string[size - 1]) !=
+				   std::string::npos) {
+				repetition = symbol_string[size - 1];
+				symbol_string.pop_back();
+			}
 
 			// nonterminal symbols look like "<type>". That is, surrounded by
 			// angle brackets. If so, remove surrounding angle brackets.
@@ -180,7 +199,8 @@ auto _read_syntax_rule_production(const toml::array* production)
 			if(non_terminal) {
 				rhs_vec.push_back(GrammarSymbol{
 					symbol_string.substr(1, symbol_string.size() - 2),
-					!non_terminal});
+					!non_terminal,
+					repetition});
 			} else {
 				rhs_vec.push_back(GrammarSymbol{symbol_string, !non_terminal});
 			}
@@ -248,6 +268,131 @@ auto _read_syntax_rules(const toml::array* syntax_rules) -> std::vector<Rule> {
 	return parsed_syntax_rules;
 }
 
+/**
+ * @brief Read in the name and rules of a [[syntax.precedence]] or
+ * [[syntax.restrictions]] table
+ *
+ * @param table one table of the array
+ * @param header name of the array, for error messages
+ * @return std::vector<Rule> rules of the table's "production"
+ */
+auto _read_syntax_declared_rules(const toml::table* table,
+								 const std::string& header)
+	-> std::vector<Rule> {
+	const std::optional<std::string> name =
+		(*table)["name"].value<std::string>();
+	const toml::array* production_node = (*table)["production"].as_array();
+	if(!name.has_value() || production_node == nullptr) {
+		throw std::logic_error("'name' or 'production' attribute in [[" +
+							   header + "]] either missing or not parsable");
+	}
+
+	std::vector<Rule> declared_rules;
+	for(const std::vector<GrammarSymbol>& production :
+		_read_syntax_rule_production(production_node)) {
+		declared_rules.push_back(
+			Rule{GrammarSymbol{name.value(), false}, production});
+	}
+
+	return declared_rules;
+}
+
+/**
+ * @brief Read in optional [[syntax.precedence]] list from TOML file
+ *
+ * Each table is one precedence level, from the loosest to the tightest:
+ * ------------
+ *  [[syntax.precedence]]
+ *  name = "expression"
+ *  associativity = "left"
+ *  production = [
+ *     ["<expression>", "+", "<expression>"],
+ *     ["<expression>", "-", "<expression>"],
+ *  ]
+ * ------------
+ *
+ * @param syntax_precedence Array that is [[syntax.precedence]] in TOML format,
+ *        or nullptr if there is none
+ * @return std::vector<PrecedenceLevel> levels in the order of the file
+ */
+auto _read_syntax_precedence(const toml::array* syntax_precedence)
+	-> std::vector<PrecedenceLevel> {
+	std::vector<PrecedenceLevel> levels;
+	if(syntax_precedence == nullptr) {
+		return levels;
+	}
+
+	for(const toml::v3::node& level_node : *syntax_precedence) {
+		const toml::table* level_table = level_node.as_table();
+		const std::optional<std::string> associativity =
+			(*level_table)["associativity"].value<std::string>();
+		if(!associativity.has_value()) {
+			throw std::logic_error(
+				"'associativity' attribute in [[syntax.precedence]] either "
+				"missing or not parsable as string");
+		}
+
+		levels.push_back(PrecedenceLevel{
+			associativity.value(),
+			_read_syntax_declared_rules(level_table, "syntax.precedence")});
+	}
+
+	return levels;
+}
+
+/**
+ * @brief Read in optional [[syntax.restrictions]] list from TOML file
+ *
+ * Each table names rules that may not be followed by some tokens:
+ * ------------
+ *  [[syntax.restrictions]]
+ *  name = "selection-statement"
+ *  production = [["if", "(", "<expression>", ")", "<statement>"]]
+ *  not-followed-by = ["else"]
+ * ------------
+ *
+ * @param syntax_restrictions Array that is [[syntax.restrictions]] in TOML
+ *        format, or nullptr if there is none
+ * @return std::vector<FollowRestriction> one restriction per rule
+ */
+auto _read_syntax_restrictions(const toml::array* syntax_restrictions)
+	-> std::vector<FollowRestriction> {
+	std::vector<FollowRestriction> restrictions;
+	if(syntax_restrictions == nullptr) {
+		return restrictions;
+	}
+
+	for(const toml::v3::node& restriction_node : *syntax_restrictions) {
+		const toml::table* restriction_table = restriction_node.as_table();
+		const toml::array* tokens_node =
+			(*restriction_table)["not-followed-by"].as_array();
+		if(tokens_node == nullptr) {
+			throw std::logic_error(
+				"'not-followed-by' attribute in [[syntax.restrictions]] "
+				"either missing or not an array");
+		}
+
+		std::set<std::string> tokens;
+		for(const toml::v3::node& token_node : *tokens_node) {
+			const std::optional<std::string> token =
+				token_node.value<std::string>();
+			if(!token.has_value()) {
+				throw std::logic_error(
+					"Token in 'not-followed-by' cannot be parsed as a string");
+			}
+
+			tokens.insert(token.value());
+		}
+
+		for(const Rule& rule : _read_syntax_declared_rules(
+				restriction_table, "syntax.restrictions")) {
+			restrictions.push_back(FollowRestriction{rule, tokens});
+		}
+	}
+
+	return restrictions;
+}
+
 /**
  * @brief Read in "main" value under [syntax] header from TOML file
  *
@@ -288,16 +433,22 @@ auto LanguageSpecification::read_language_specification_toml(
 	const std::string parsed_version =
 		_read_top_level_string(language_spec_table, "version");
 
-	const std::pair<std::vector<std::pair<std::string, std::regex>>,
+	const std::pair<std::vector<std::pair<std::string, std::string>>,
 					std::unordered_set<std::string>>
-		name_regex_and_ignore_set = _read_token_regexes(
+		name_pattern_and_ignore_set = _read_token_regexes(
 			language_spec_table["token"]["regexes"].as_array());
 
-	const std::vector<std::pair<std::string, std::regex>> parsed_token_regexes =
-		name_regex_and_ignore_set.first;
+	std::vector<std::pair<std::string, std::regex>> parsed_token_regexes;
+	std::vector<std::string> parsed_token_patterns;
+	for(const std::pair<std::string, std::string>& name_and_pattern :
+		name_pattern_and_ignore_set.first) {
+		parsed_token_regexes.emplace_back(name_and_pattern.first,
+										  std::regex(name_and_pattern.second));
+		parsed_token_patterns.push_back(name_and_pattern.second);
+	}
 
 	const std::unordered_set<std::string> parsed_token_regexes_ignore =
-		name_regex_and_ignore_set.second;
+		name_pattern_and_ignore_set.second;
 
 	const std::vector<Rule> parsed_syntax_rules =
 		_read_syntax_rules(language_spec_table["syntax"]["rules"].as_array());
@@ -305,14 +456,23 @@ auto LanguageSpecification::read_language_specification_toml(
 	const std::string parsed_syntax_main =
 		_read_syntax_main(language_spec_table["syntax"].as_table());
 
+	const DisambiguationRules parsed_syntax_disambiguation{
+		_read_syntax_precedence(
+			language_spec_table["syntax"]["precedence"].as_array()),
+		_read_syntax_restrictions(
+			language_spec_table["syntax"]["restrictions"].as_array()),
+	};
+
 	return LanguageSpecification{
 		parsed_title,
 		parsed_description,
 		parsed_version,
 		parsed_token_regexes,
+		parsed_token_patterns,
 		parsed_token_regexes_ignore,
 		parsed_syntax_main,
 		parsed_syntax_rules,
+		parsed_syntax_disambiguation,
 		language_specification_toml,
 	};
 }
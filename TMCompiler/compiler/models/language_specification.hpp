@@ -7,7 +7,8 @@
 #include <utility>		  // std::pair
 #include <vector>		  // std::vector
 
-#include <TMCompiler/compiler/models/rule.hpp>	// Rule
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // DisambiguationRules
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
 
 struct LanguageSpecification {
 	std::string title;
@@ -19,6 +20,11 @@ struct LanguageSpecification {
 	// ex: [("whitespace", "\s+"), ("integer-constant", "\d+"), ...]
 	std::vector<std::pair<std::string, std::regex> > token_regexes;
 
+	// regex pattern of each of token_regexes, in the same order, since a
+	// std::regex does not keep its pattern
+	// ex: ["\s+", "\d+", ...]
+	std::vector<std::string> token_patterns;
+
 	// name of tokens that should be ignored when parsing tokens into the
 	// grammar found in TOML file under [[token.regexes.ignore]]
 	std::unordered_set<std::string> token_regexes_ignore;
@@ -29,6 +35,10 @@ struct LanguageSpecification {
 	// list of rules in [[syntax.rules]]
 	std::vector<Rule> syntax_rules;
 
+	// operator precedence in [[syntax.precedence]], from the loosest level to
+	// the tightest, and [[syntax.restrictions]] on tokens after a rule
+	DisambiguationRules syntax_disambiguation;
+
 	// METADATA
 
 	// name of TOML file information is parsed from
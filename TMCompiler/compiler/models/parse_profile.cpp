@@ -0,0 +1,102 @@
+#include "parse_profile.hpp"
+
+#include <algorithm>  // std::max
+#include <cstddef>	  // std::size_t
+#include <fstream>	  // std::ifstream, std::ofstream
+#include <stdexcept>  // std::invalid_argument
+#include <string>	  // std::string, std::getline, std::stoul, std::to_string
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // rule_to_string, SubParse
+
+/**
+ * Count the rules of a parse tree into a profile.
+ * @param profile: profile to add to
+ * @param rules: rules the parse tree refers to, like Grammar::get_rules()
+ * @param tree: parse tree of a program
+ */
+auto add_to_profile(ParseProfile& profile,
+					const std::vector<Rule>& rules,
+					const std::vector<SubParse>& tree) -> void {
+	for(const SubParse& sub_parse : tree) {
+		++profile.rule_uses[rule_to_string(rules[sub_parse.rule])];
+	}
+}
+
+/**
+ * Rank rules by how often a profile saw them. The ranks only order the
+ * children that the parse tree search tries at one token, so only the number
+ * of uses matters: rules with the same number keep the order of the Earley
+ * sets.
+ * @param profile: uses of rules in a corpus
+ * @param rules: rules to rank
+ * @return for each rule, its rank: the most used rules have rank 0
+ */
+auto rank_rules(const ParseProfile& profile, const std::vector<Rule>& rules)
+	-> std::vector<std::size_t> {
+	std::vector<std::size_t> uses(rules.size(), 0);
+	std::size_t most_uses = 0;
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		const auto found = profile.rule_uses.find(rule_to_string(rules[i]));
+		if(found != profile.rule_uses.end()) {
+			uses[i] = found->second;
+			most_uses = std::max(most_uses, uses[i]);
+		}
+	}
+
+	std::vector<std::size_t> ranks(rules.size(), 0);
+	for(std::size_t i = 0; i < rules.size(); ++i) {
+		ranks[i] = most_uses - uses[i];
+	}
+
+	return ranks;
+}
+
+/**
+ * Save a profile to a file: each line holds the number of uses of a rule, a
+ * space, and the rule, like "12 Rule[statement -> expression ;]".
+ * @param profile: profile to save
+ * @param file_name: path of the file to write
+ */
+auto write_parse_profile(const ParseProfile& profile,
+						 const std::string& file_name) -> void {
+	std::ofstream profile_file{file_name};
+	if(!profile_file.is_open()) {
+		throw std::invalid_argument("Unable to write file " + file_name);
+	}
+
+	for(const auto& rule_uses : profile.rule_uses) {
+		profile_file << rule_uses.second << " " << rule_uses.first << "\n";
+	}
+}
+
+/**
+ * Load a profile saved by write_parse_profile.
+ * @param file_name: path of the file to read
+ * @return the saved profile
+ */
+auto read_parse_profile(const std::string& file_name) -> ParseProfile {
+	std::ifstream profile_file{file_name};
+	if(!profile_file.is_open()) {
+		throw std::invalid_argument("Unable to open file " + file_name);
+	}
+
+	ParseProfile profile;
+	std::string line;
+	for(std::size_t line_number = 1; std::getline(profile_file, line);
+		++line_number) {
+		const std::size_t space = line.find(' ');
+		if(space == 0 || space == std::string::npos ||
+		   line.find_first_not_of("0123456789") != space) {
+			throw std::invalid_argument("Line " + std::to_string(line_number) +
+										" of " + file_name +
+										" is not \"<uses> <rule>\"");
+		}
+
+		profile.rule_uses[line.substr(1 + space)] +=
+			std::stoul(line.substr(0, space));
+	}
+
+	return profile;
+}
@@ -0,0 +1,55 @@
+#ifndef PARSE_PROFILE_HPP
+#define PARSE_PROFILE_HPP
+
+#include <cstddef>	// std::size_t
+#include <map>		// std::map
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+// how often each rule shows up in the parse trees of a corpus of programs,
+// so that later parses try the common alternatives first. Rules are keyed by
+// rule_to_string, so a profile still applies after rules are added or
+// reordered.
+struct ParseProfile {
+	std::map<std::string, std::size_t> rule_uses;
+};
+
+/**
+ * Count the rules of a parse tree into a profile.
+ * @param profile: profile to add to
+ * @param rules: rules the parse tree refers to, like Grammar::get_rules()
+ * @param tree: parse tree of a program
+ */
+auto add_to_profile(ParseProfile& profile,
+					const std::vector<Rule>& rules,
+					const std::vector<SubParse>& tree) -> void;
+
+/**
+ * Rank rules by how often a profile saw them: see flip_finished_items.
+ * @param profile: uses of rules in a corpus
+ * @param rules: rules to rank
+ * @return for each rule, its rank: the most used rules have rank 0, and
+ * rules with the same number of uses have the same rank
+ */
+auto rank_rules(const ParseProfile& profile, const std::vector<Rule>& rules)
+	-> std::vector<std::size_t>;
+
+/**
+ * Save a profile to a file, one rule per line after its number of uses.
+ * @param profile: profile to save
+ * @param file_name: path of the file to write
+ */
+auto write_parse_profile(const ParseProfile& profile,
+						 const std::string& file_name) -> void;
+
+/**
+ * Load a profile saved by write_parse_profile.
+ * @param file_name: path of the file to read
+ * @return the saved profile
+ */
+auto read_parse_profile(const std::string& file_name) -> ParseProfile;
+
+#endif
@@ -0,0 +1,578 @@
+/**
+ * Write a LanguageSpecification to a binary cache file, and map it back into
+ * memory.
+ *
+ * The file is a header followed by 32-bit words. The words start with a table
+ * of every string of the specification, each stored once; the rest refer to
+ * strings by their index in the table:
+ *
+ * strings:       count, then per string: length, and its bytes padded to words
+ * metadata:      title, description, version, syntax main
+ * token regexes: count, then per regex: name, pattern, 1 if ignored else 0
+ * rules:         count, then per rule: symbol, length, symbols
+ * precedence:    count, then per level: associativity, count, rules
+ * restrictions:  count, then per restriction: rule, count, tokens
+ *
+ * where a symbol is two words: its value, and 1 if terminal plus its
+ * repetition operator shifted by 8 bits. The words are in the byte order of
+ * the machine that wrote them, since a cache is only read where it is written.
+ */
+
+#include "specification_cache.hpp"
+
+#include <array>		  // std::array
+#include <cerrno>		  // errno, EINTR
+#include <cstddef>		  // std::size_t
+#include <cstdint>		  // std::uint32_t, std::uint64_t
+#include <cstdio>		  // std::remove, std::rename
+#include <cstring>		  // std::memcpy, std::strerror
+#include <exception>	  // std::exception
+#include <fstream>		  // std::ifstream
+#include <ios>			  // std::ios
+#include <iostream>		  // std::endl
+#include <iterator>		  // std::istreambuf_iterator
+#include <limits>		  // std::numeric_limits
+#include <optional>		  // std::optional, std::nullopt
+#include <regex>		  // std::regex
+#include <stdexcept>	  // std::invalid_argument, std::runtime_error
+#include <string>		  // std::string, std::to_string
+#include <unordered_map>  // std::unordered_map
+#include <vector>		  // std::vector
+
+#include <fcntl.h>	   // open, O_RDONLY
+#include <stdlib.h>	   // mkstemp
+#include <sys/mman.h>  // mmap, munmap, MAP_FAILED, MAP_PRIVATE, PROT_READ
+#include <sys/stat.h>  // fchmod, fstat, struct stat, S_IRGRP, S_IROTH, S_IRUSR, S_IWUSR
+#include <unistd.h>	   // close, write
+
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // DisambiguationRules, FollowRestriction, PrecedenceLevel
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/rule.hpp>					  // Rule
+#include <TMCompiler/utils/logger/logger.hpp>					  // LOG
+#include <TMCompiler/utils/tracer/tracer.hpp>					  // TraceSpan
+
+// first bytes of a cache file
+constexpr std::array<char, 8> cache_magic{
+	{'T', 'M', 'C', 'S', 'P', 'E', 'C', '\0'}};
+
+// changed whenever the layout of the words, or what the TOML reader makes of
+// a specification, changes, so that older cache files are read again
+constexpr std::uint32_t cache_format_version = 1;
+
+// appended to the name of a TOML file for its cache
+const std::string cache_extension{".cache"};
+
+// FNV-1a parameters for 64-bit hashes
+constexpr std::uint64_t fnv_offset_basis = 14695981039346656037ULL;
+constexpr std::uint64_t fnv_prime = 1099511628211ULL;
+
+// bit of the second word of a symbol that marks it terminal, and where its
+// repetition operator starts
+constexpr std::uint32_t terminal_flag = 1;
+constexpr std::uint32_t repetition_shift = 8;
+
+struct SpecificationCacheHeader {
+	std::array<char, 8> magic;
+	std::uint32_t format_version;
+	// number of words after the header
+	std::uint32_t num_words;
+	// hash of the TOML file the words were written from
+	std::uint64_t text_hash;
+};
+
+// words of a cache file as they are written, and the strings they refer to
+class SpecificationCacheWriter {
+public:
+	auto add(std::size_t value) -> void;
+	auto add(const std::string& text) -> void;
+	auto add(const GrammarSymbol& symbol) -> void;
+	auto add(const Rule& rule) -> void;
+	[[nodiscard]] auto words() const -> std::vector<std::uint32_t>;
+
+private:
+	std::vector<std::uint32_t> body;
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, std::uint32_t> string_indices;
+};
+
+// words of a mapped cache file as they are read back. A read past the end
+// reads zeros, and marks the reader invalid
+class SpecificationCacheReader {
+public:
+	SpecificationCacheReader(const std::uint32_t* _words, std::size_t _size);
+	[[nodiscard]] auto valid() const -> bool;
+	auto read_number() -> std::size_t;
+	auto read_string() -> std::string;
+	auto read_symbol() -> GrammarSymbol;
+	auto read_rule() -> Rule;
+
+private:
+	const std::uint32_t* words;
+	std::size_t size;
+	std::size_t position;
+	bool is_valid;
+	std::vector<std::string> strings;
+};
+
+/**
+ * Narrow a count or index to one word of a cache file.
+ * @param value: count or index
+ * @return value, as stored in the file
+ */
+auto to_cache_word(const std::size_t value) -> std::uint32_t {
+	if(value > std::numeric_limits<std::uint32_t>::max()) {
+		throw std::invalid_argument("Value " + std::to_string(value) +
+									" is too large for a language "
+									"specification cache");
+	}
+
+	return static_cast<std::uint32_t>(value);
+}
+
+/**
+ * Append a count or index.
+ * @param value: count or index
+ */
+auto SpecificationCacheWriter::add(const std::size_t value) -> void {
+	body.push_back(to_cache_word(value));
+}
+
+/**
+ * Append a string, as its index in the string table.
+ * @param text: string, added to the table if it is not in it yet
+ */
+auto SpecificationCacheWriter::add(const std::string& text) -> void {
+	const auto found = string_indices.find(text);
+	if(found != string_indices.end()) {
+		body.push_back(found->second);
+		return;
+	}
+
+	const std::uint32_t index = to_cache_word(strings.size());
+	strings.push_back(text);
+	string_indices.emplace(text, index);
+	body.push_back(index);
+}
+
+/**
+ * Append a symbol: its value, and its flags.
+ * @param symbol: grammar symbol
+ */
+auto SpecificationCacheWriter::add(const GrammarSymbol& symbol) -> void {
+	add(symbol.value);
+
+	const auto repetition = static_cast<std::uint32_t>(
+		static_cast<unsigned char>(symbol.repetition));
+	body.push_back((symbol.terminal ? terminal_flag : 0) |
+				   (repetition << repetition_shift));
+}
+
+/**
+ * Append a rule: its production, and the symbols of its replacement.
+ * @param rule: grammar rule
+ */
+auto SpecificationCacheWriter::add(const Rule& rule) -> void {
+	add(rule.production);
+	add(rule.replacement.size());
+	for(const GrammarSymbol& symbol : rule.replacement) {
+		add(symbol);
+	}
+}
+
+/**
+ * @return the words of the file: the string table, then the words appended
+ */
+auto SpecificationCacheWriter::words() const -> std::vector<std::uint32_t> {
+	std::vector<std::uint32_t> all_words{to_cache_word(strings.size())};
+	for(const std::string& text : strings) {
+		all_words.push_back(to_cache_word(text.size()));
+
+		const std::size_t first = all_words.size();
+		all_words.resize(first + (text.size() + sizeof(std::uint32_t) - 1) /
+									 sizeof(std::uint32_t));
+		std::memcpy(all_words.data() + first, text.data(), text.size());
+	}
+
+	all_words.insert(all_words.end(), body.begin(), body.end());
+	return all_words;
+}
+
+/**
+ * Constructor for SpecificationCacheReader: read the string table.
+ * @param _words: words after the header of a cache file
+ * @param _size: number of words
+ */
+SpecificationCacheReader::SpecificationCacheReader(
+	const std::uint32_t* const _words,
+	const std::size_t _size)
+	: words(_words), size(_size), position(0), is_valid(true) {
+	const std::size_t num_strings = read_number();
+	for(std::size_t i = 0; i < num_strings && is_valid; ++i) {
+		const std::size_t length = read_number();
+		const std::size_t num_string_words =
+			(length + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t);
+		if(num_string_words > size - position) {
+			is_valid = false;
+			break;
+		}
+
+		strings.emplace_back(reinterpret_cast<const char*>(words + position),
+							 length);
+		position += num_string_words;
+	}
+}
+
+/**
+ * @return false iff a read went past the end of the words, or referred to a
+ * string that is not in the table
+ */
+[[gnu::pure]] auto SpecificationCacheReader::valid() const -> bool {
+	return is_valid;
+}
+
+/**
+ * @return next word
+ */
+auto SpecificationCacheReader::read_number() -> std::size_t {
+	if(position >= size) {
+		is_valid = false;
+		return 0;
+	}
+
+	return words[position++];
+}
+
+/**
+ * @return string that the next word is the index of
+ */
+auto SpecificationCacheReader::read_string() -> std::string {
+	const std::size_t index = read_number();
+	if(index >= strings.size()) {
+		is_valid = false;
+		return "";
+	}
+
+	return strings[index];
+}
+
+/**
+ * @return symbol of the next two words
+ */
+auto SpecificationCacheReader::read_symbol() -> GrammarSymbol {
+	const std::string value = read_string();
+	const std::size_t flags = read_number();
+
+	return GrammarSymbol{value,
+						 (flags & terminal_flag) != 0,
+						 static_cast<char>(flags >> repetition_shift)};
+}
+
+/**
+ * @return rule of the next words
+ */
+auto SpecificationCacheReader::read_rule() -> Rule {
+	Rule rule{read_symbol(), {}};
+
+	const std::size_t length = read_number();
+	for(std::size_t i = 0; i < length && is_valid; ++i) {
+		rule.replacement.push_back(read_symbol());
+	}
+
+	return rule;
+}
+
+/**
+ * Read the specification from the words of a cache file.
+ * @param reader: words after the header
+ * @return the specification, or nothing if the words are damaged
+ */
+auto read_specification_words(SpecificationCacheReader& reader)
+	-> std::optional<LanguageSpecification> {
+	LanguageSpecification spec;
+	spec.title = reader.read_string();
+	spec.description = reader.read_string();
+	spec.version = reader.read_string();
+	spec.syntax_main = reader.read_string();
+
+	const std::size_t num_regexes = reader.read_number();
+	for(std::size_t i = 0; i < num_regexes && reader.valid(); ++i) {
+		const std::string name = reader.read_string();
+		const std::string pattern = reader.read_string();
+		if(reader.read_number() != 0) {
+			spec.token_regexes_ignore.insert(name);
+		}
+
+		spec.token_regexes.emplace_back(name, std::regex(pattern));
+		spec.token_patterns.push_back(pattern);
+	}
+
+	const std::size_t num_rules = reader.read_number();
+	for(std::size_t i = 0; i < num_rules && reader.valid(); ++i) {
+		spec.syntax_rules.push_back(reader.read_rule());
+	}
+
+	const std::size_t num_levels = reader.read_number();
+	for(std::size_t i = 0; i < num_levels && reader.valid(); ++i) {
+		PrecedenceLevel level{reader.read_string(), {}};
+		const std::size_t num_level_rules = reader.read_number();
+		for(std::size_t j = 0; j < num_level_rules && reader.valid(); ++j) {
+			level.rules.push_back(reader.read_rule());
+		}
+
+		spec.syntax_disambiguation.precedence.push_back(level);
+	}
+
+	const std::size_t num_restrictions = reader.read_number();
+	for(std::size_t i = 0; i < num_restrictions && reader.valid(); ++i) {
+		FollowRestriction restriction{reader.read_rule(), {}};
+		const std::size_t num_tokens = reader.read_number();
+		for(std::size_t j = 0; j < num_tokens && reader.valid(); ++j) {
+			restriction.tokens.insert(reader.read_string());
+		}
+
+		spec.syntax_disambiguation.restrictions.push_back(restriction);
+	}
+
+	if(!reader.valid()) {
+		return std::nullopt;
+	}
+
+	return spec;
+}
+
+/**
+ * Hash of the contents of a specification file, with 64-bit FNV-1a: a
+ * change of the file almost surely changes its hash.
+ *
+ * @param text: contents of a language specification file
+ * @return hash of text, that a cache of the specification is keyed by
+ */
+[[gnu::pure]] auto hash_specification_text(const std::string& text)
+	-> std::uint64_t {
+	std::uint64_t hash = fnv_offset_basis;
+	for(const char c : text) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= fnv_prime;
+	}
+
+	return hash;
+}
+
+/**
+ * Write all of size bytes to a file, in as many writes as it takes.
+ * @param file_descriptor: file to write to
+ * @param bytes: start of the bytes
+ * @param size: number of bytes
+ * @return true iff every byte was written
+ */
+auto write_cache_bytes(const int file_descriptor,
+					   const char* bytes,
+					   std::size_t size) -> bool {
+	while(size > 0) {
+		const auto num_written = write(file_descriptor, bytes, size);
+		if(num_written < 0 && errno == EINTR) {
+			continue;
+		}
+		if(num_written <= 0) {
+			return false;
+		}
+		bytes += num_written;
+		size -= static_cast<std::size_t>(num_written);
+	}
+
+	return true;
+}
+
+/**
+ * Write spec to a cache file. The file is written under a name of its own in
+ * the same directory first and then renamed, so that a process reading the
+ * cache meanwhile sees either the old file or the new one whole, and
+ * processes that write the cache at the same time do not write into each
+ * other's file.
+ *
+ * @param spec: language specification
+ * @param text_hash: hash of the TOML file spec was read from
+ * @param cache_file_name: file to write
+ */
+auto write_specification_cache(const LanguageSpecification& spec,
+							   const std::uint64_t text_hash,
+							   const std::string& cache_file_name) -> void {
+	SpecificationCacheWriter writer;
+	writer.add(spec.title);
+	writer.add(spec.description);
+	writer.add(spec.version);
+	writer.add(spec.syntax_main);
+
+	writer.add(spec.token_patterns.size());
+	for(std::size_t i = 0; i < spec.token_patterns.size(); ++i) {
+		const std::string& name = spec.token_regexes[i].first;
+		writer.add(name);
+		writer.add(spec.token_patterns[i]);
+		writer.add(std::size_t{spec.token_regexes_ignore.count(name)});
+	}
+
+	writer.add(spec.syntax_rules.size());
+	for(const Rule& rule : spec.syntax_rules) {
+		writer.add(rule);
+	}
+
+	writer.add(spec.syntax_disambiguation.precedence.size());
+	for(const PrecedenceLevel& level : spec.syntax_disambiguation.precedence) {
+		writer.add(level.associativity);
+		writer.add(level.rules.size());
+		for(const Rule& rule : level.rules) {
+			writer.add(rule);
+		}
+	}
+
+	writer.add(spec.syntax_disambiguation.restrictions.size());
+	for(const FollowRestriction& restriction :
+		spec.syntax_disambiguation.restrictions) {
+		writer.add(restriction.rule);
+		writer.add(restriction.tokens.size());
+		for(const std::string& token : restriction.tokens) {
+			writer.add(token);
+		}
+	}
+
+	const std::vector<std::uint32_t> words = writer.words();
+	const SpecificationCacheHeader header{cache_magic,
+										  cache_format_version,
+										  to_cache_word(words.size()),
+										  text_hash};
+
+	// mkstemp replaces the X's with a name that no other file has
+	std::string written_file_name = cache_file_name + ".XXXXXX";
+	const int file_descriptor = mkstemp(written_file_name.data());
+	if(file_descriptor < 0) {
+		throw std::runtime_error("Unable to write file " + cache_file_name +
+								 ": " + std::strerror(errno));
+	}
+
+	// readable by others, like the TOML file next to it
+	const bool written =
+		fchmod(file_descriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0 &&
+		write_cache_bytes(file_descriptor,
+						  reinterpret_cast<const char*>(&header),
+						  sizeof(header)) &&
+		write_cache_bytes(file_descriptor,
+						  reinterpret_cast<const char*>(words.data()),
+						  words.size() * sizeof(std::uint32_t));
+	const int write_error = errno;
+	const bool closed = close(file_descriptor) == 0;
+
+	if(!written || !closed ||
+	   std::rename(written_file_name.c_str(), cache_file_name.c_str()) != 0) {
+		const std::string reason =
+			std::strerror(!written ? write_error : errno);
+		std::remove(written_file_name.c_str());
+		throw std::runtime_error("Unable to write file " + cache_file_name +
+								 ": " + reason);
+	}
+}
+
+/**
+ * Read a language specification from a cache file, mapped into memory. The
+ * regexes of the tokens are built again from their patterns, since a
+ * std::regex cannot be stored.
+ *
+ * @param cache_file_name: file written by write_specification_cache
+ * @param text_hash: hash of the TOML file as it is now
+ * @return the specification, or nothing if the file is missing, damaged, or
+ * written for other TOML contents
+ */
+auto read_specification_cache(const std::string& cache_file_name,
+							  const std::uint64_t text_hash)
+	-> std::optional<LanguageSpecification> {
+	const int file_descriptor = open(cache_file_name.c_str(), O_RDONLY);
+	if(file_descriptor < 0) {
+		return std::nullopt;
+	}
+
+	struct stat file_status {};
+	if(fstat(file_descriptor, &file_status) != 0 ||
+	   static_cast<std::size_t>(file_status.st_size) <
+		   sizeof(SpecificationCacheHeader)) {
+		close(file_descriptor);
+		return std::nullopt;
+	}
+
+	const auto mapped_bytes = static_cast<std::size_t>(file_status.st_size);
+	void* const memory = mmap(
+		nullptr, mapped_bytes, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	// the mapping stays after the file is closed
+	close(file_descriptor);
+	if(memory == MAP_FAILED) {
+		return std::nullopt;
+	}
+
+	SpecificationCacheHeader header{};
+	std::memcpy(&header, memory, sizeof(header));
+
+	const std::size_t num_words =
+		(mapped_bytes - sizeof(header)) / sizeof(std::uint32_t);
+	std::optional<LanguageSpecification> spec;
+	if(header.magic == cache_magic &&
+	   header.format_version == cache_format_version &&
+	   header.num_words == num_words && header.text_hash == text_hash) {
+		SpecificationCacheReader reader{
+			reinterpret_cast<const std::uint32_t*>(
+				static_cast<const char*>(memory) + sizeof(header)),
+			num_words};
+		spec = read_specification_words(reader);
+	}
+
+	munmap(memory, mapped_bytes);
+	return spec;
+}
+
+/**
+ * Read a language specification from the cache next to its TOML file, named
+ * like the TOML file with ".cache" appended. If the cache is missing, or was
+ * written for other contents of the TOML file, the TOML file is read instead,
+ * and the cache written for the next time. A cache that cannot be written,
+ * like next to a read-only TOML file, only costs the next run the same time.
+ *
+ * @param language_specification_toml: TOML file path of the specification
+ * @return the specification
+ */
+auto read_language_specification_cached(
+	const std::string& language_specification_toml) -> LanguageSpecification {
+	const TraceSpan span{"load specification", language_specification_toml};
+	std::ifstream toml_file{language_specification_toml, std::ios::binary};
+	if(!toml_file.is_open()) {
+		// reports that the file is missing
+		return LanguageSpecification::read_language_specification_toml(
+			language_specification_toml);
+	}
+
+	const std::string text{std::istreambuf_iterator<char>(toml_file),
+						   std::istreambuf_iterator<char>()};
+	const std::uint64_t text_hash = hash_specification_text(text);
+	const std::string cache_file_name =
+		language_specification_toml + cache_extension;
+
+	std::optional<LanguageSpecification> cached =
+		read_specification_cache(cache_file_name, text_hash);
+	if(cached.has_value()) {
+		LOG("INFO") << "Read language specification from " << cache_file_name
+					<< std::endl;
+		cached->spec_file_name = language_specification_toml;
+		return cached.value();
+	}
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			language_specification_toml);
+
+	try {
+		write_specification_cache(spec, text_hash, cache_file_name);
+		LOG("INFO") << "Wrote language specification cache " << cache_file_name
+					<< std::endl;
+	} catch(const std::exception& e) {
+		LOG("WARNING") << e.what() << std::endl;
+	}
+
+	return spec;
+}
@@ -0,0 +1,52 @@
+/**
+ * Binary copy of a LanguageSpecification, kept next to its TOML file, so that
+ * later runs map it into memory instead of parsing the TOML file again. See
+ * read_language_specification_cached.
+ */
+
+#ifndef SPECIFICATION_CACHE_HPP
+#define SPECIFICATION_CACHE_HPP
+
+#include <cstdint>	 // std::uint64_t
+#include <optional>	 // std::optional
+#include <string>	 // std::string
+
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+
+/**
+ * @param text: contents of a language specification file
+ * @return hash of text, that a cache of the specification is keyed by
+ */
+auto hash_specification_text(const std::string& text) -> std::uint64_t;
+
+/**
+ * Write spec to a cache file.
+ * @param spec: language specification
+ * @param text_hash: hash of the TOML file spec was read from
+ * @param cache_file_name: file to write
+ */
+auto write_specification_cache(const LanguageSpecification& spec,
+							   std::uint64_t text_hash,
+							   const std::string& cache_file_name) -> void;
+
+/**
+ * Read a language specification from a cache file.
+ * @param cache_file_name: file written by write_specification_cache
+ * @param text_hash: hash of the TOML file as it is now
+ * @return the specification, or nothing if the file is missing, damaged, or
+ * written for other TOML contents
+ */
+auto read_specification_cache(const std::string& cache_file_name,
+							  std::uint64_t text_hash)
+	-> std::optional<LanguageSpecification>;
+
+/**
+ * Read a language specification from the cache next to its TOML file, or
+ * from the TOML file if the cache is out of date, and write the cache then.
+ * @param language_specification_toml: TOML file path of the specification
+ * @return the specification
+ */
+auto read_language_specification_cached(
+	const std::string& language_specification_toml) -> LanguageSpecification;
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * Grammar of a language specification as constexpr arrays, generated from
+ * the TOML file at build time by generate_language_tables, and analyses of
+ * it that run at compile time: see embedded_specification.hpp.
+ */
+
+#ifndef STATIC_GRAMMAR_HPP
+#define STATIC_GRAMMAR_HPP
+
+#include <array>		// std::array
+#include <cstddef>		// std::size_t
+#include <cstdint>		// std::uint64_t
+#include <string_view>	// std::string_view
+#include <vector>		// std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+
+// every symbol of a StaticGrammar, by index
+template <std::size_t NumSymbols>
+struct StaticSymbols {
+	std::array<std::string_view, NumSymbols> values;
+	// as written in the specification, like "+" and not <expression>
+	std::array<bool, NumSymbols> terminal;
+	// non-terminals without rules that are names of tokens, like
+	// <identifier>, which the lexer parses
+	std::array<bool, NumSymbols> lexical;
+};
+
+// rules over the symbols of a StaticGrammar. The replacement of rule i is
+// replacement_symbols[replacement_offsets[i]] up to
+// replacement_symbols[replacement_offsets[i + 1]]
+template <std::size_t NumRules, std::size_t NumReplacementSymbols>
+struct StaticRules {
+	std::array<std::size_t, NumRules> productions;
+	std::array<std::size_t, NumRules + 1> replacement_offsets;
+	std::array<std::size_t, NumReplacementSymbols> replacement_symbols;
+	// EBNF operator of each symbol of replacement_symbols, or '\0'
+	std::array<char, NumReplacementSymbols> repetitions;
+};
+
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+struct StaticGrammar {
+	StaticSymbols<NumSymbols> symbols;
+	// [syntax.main]
+	std::size_t main;
+	StaticRules<NumRules, NumReplacementSymbols> rules;
+	// the rules of symbol s are symbol_rules[symbol_rule_offsets[s]] up to
+	// symbol_rules[symbol_rule_offsets[s + 1]]
+	std::array<std::size_t, NumSymbols + 1> symbol_rule_offsets;
+	std::array<std::size_t, NumRules> symbol_rules;
+};
+
+// set of symbols of a StaticGrammar, one bit per symbol
+template <std::size_t NumSymbols>
+struct StaticSymbolSet {
+	std::array<std::uint64_t, (NumSymbols + 63) / 64> words;
+};
+
+/**
+ * @param set: set of symbols
+ * @param symbol: index of a symbol
+ * @return true iff symbol is in set
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_set_contains(const StaticSymbolSet<NumSymbols>& set,
+								   std::size_t symbol) -> bool;
+
+/**
+ * @param set: set of symbols
+ * @return true iff set has no symbol
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_set_empty(const StaticSymbolSet<NumSymbols>& set)
+	-> bool;
+
+/**
+ * @param grammar: generated grammar
+ * @param value: value of the symbol, without angle brackets
+ * @param terminal: whether the symbol is terminal, as written
+ * @return index of the symbol, or the number of symbols if there is none
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_symbol_index(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar,
+	std::string_view value,
+	bool terminal) -> std::size_t;
+
+/**
+ * @param grammar: generated grammar
+ * @return index of the first non-terminal that has no rules and is not the
+ * name of a token, or the number of symbols if there is none
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_undefined_symbol(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::size_t;
+
+/**
+ * @param grammar: generated grammar
+ * @return for each symbol, whether it derives the empty string
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_nullable(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::array<bool, NumSymbols>;
+
+/**
+ * @param grammar: generated grammar
+ * @return for each symbol, the terminals and tokens that can begin a string
+ * derived from it
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_first_sets(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::array<StaticSymbolSet<NumSymbols>, NumSymbols>;
+
+/**
+ * @param symbols: symbols of a generated grammar
+ * @param rules: rules over symbols
+ * @return the rules, as read from a language specification
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+auto to_rules(const StaticSymbols<NumSymbols>& symbols,
+			  const StaticRules<NumRules, NumReplacementSymbols>& rules)
+	-> std::vector<Rule>;
+
+// implementation of template functions
+#include "static_grammar.tpp"
+
+#endif
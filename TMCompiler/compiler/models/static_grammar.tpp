@@ -0,0 +1,246 @@
+/**
+ * @return true iff the symbol is parsed as a token: terminal as written, or a
+ * non-terminal that names a token
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_is_token(const StaticSymbols<NumSymbols>& symbols,
+							   const std::size_t symbol) -> bool {
+	return symbols.terminal[symbol] || symbols.lexical[symbol];
+}
+
+/**
+ * @return true iff the symbol at index replacement_symbol of a replacement
+ * derives the empty string: its EBNF operator allows none of it, or its
+ * symbol is nullable
+ */
+template <std::size_t NumRules, std::size_t NumReplacementSymbols>
+constexpr auto static_is_nullable_use(
+	const StaticRules<NumRules, NumReplacementSymbols>& rules,
+	const std::size_t replacement_symbol,
+	const bool symbol_nullable) -> bool {
+	const char repetition = rules.repetitions[replacement_symbol];
+	return repetition == '*' || repetition == '?' || symbol_nullable;
+}
+
+/**
+ * @param set: set of symbols
+ * @param symbol: index of a symbol
+ * @return true iff symbol is in set
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_set_contains(const StaticSymbolSet<NumSymbols>& set,
+								   const std::size_t symbol) -> bool {
+	return ((set.words[symbol / 64] >> (symbol % 64)) & 1U) != 0;
+}
+
+/**
+ * @param set: set of symbols
+ * @return true iff set has no symbol
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_set_empty(const StaticSymbolSet<NumSymbols>& set)
+	-> bool {
+	for(const std::uint64_t word : set.words) {
+		if(word != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Add the symbols of other to set.
+ * @return true iff set changed
+ */
+template <std::size_t NumSymbols>
+constexpr auto static_set_merge(StaticSymbolSet<NumSymbols>& set,
+								const StaticSymbolSet<NumSymbols>& other)
+	-> bool {
+	bool changed = false;
+	for(std::size_t i = 0; i < set.words.size(); ++i) {
+		const std::uint64_t merged = set.words[i] | other.words[i];
+		changed = changed || merged != set.words[i];
+		set.words[i] = merged;
+	}
+
+	return changed;
+}
+
+/**
+ * Find a symbol by its value. Called in a constant expression, the lookup
+ * costs nothing at run time.
+ *
+ * @param grammar: generated grammar
+ * @param value: value of the symbol, without angle brackets
+ * @param terminal: whether the symbol is terminal, as written
+ * @return index of the symbol, or the number of symbols if there is none
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_symbol_index(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar,
+	const std::string_view value,
+	const bool terminal) -> std::size_t {
+	for(std::size_t symbol = 0; symbol < NumSymbols; ++symbol) {
+		if(grammar.symbols.values[symbol] == value &&
+		   grammar.symbols.terminal[symbol] == terminal) {
+			return symbol;
+		}
+	}
+
+	return NumSymbols;
+}
+
+/**
+ * A non-terminal that has no rules, and is not parsed by the lexer either,
+ * can never be parsed: usually a typo in the language specification.
+ *
+ * @param grammar: generated grammar
+ * @return index of the first non-terminal that has no rules and is not the
+ * name of a token, or the number of symbols if there is none
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_undefined_symbol(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::size_t {
+	for(std::size_t symbol = 0; symbol < NumSymbols; ++symbol) {
+		if(!static_is_token(grammar.symbols, symbol) &&
+		   grammar.symbol_rule_offsets[symbol] ==
+			   grammar.symbol_rule_offsets[symbol + 1]) {
+			return symbol;
+		}
+	}
+
+	return NumSymbols;
+}
+
+/**
+ * Find the symbols that derive the empty string, like find_nullable does at
+ * run time: repeat over the rules until no rule adds a symbol.
+ *
+ * @param grammar: generated grammar
+ * @return for each symbol, whether it derives the empty string
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_nullable(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::array<bool, NumSymbols> {
+	std::array<bool, NumSymbols> nullable{};
+
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(std::size_t rule = 0; rule < NumRules; ++rule) {
+			const std::size_t production = grammar.rules.productions[rule];
+			if(nullable[production]) {
+				continue;
+			}
+
+			bool all_nullable = true;
+			for(std::size_t i = grammar.rules.replacement_offsets[rule];
+				i < grammar.rules.replacement_offsets[rule + 1];
+				++i) {
+				const std::size_t symbol = grammar.rules.replacement_symbols[i];
+				all_nullable =
+					all_nullable &&
+					static_is_nullable_use(grammar.rules, i, nullable[symbol]);
+			}
+
+			if(all_nullable) {
+				nullable[production] = true;
+				changed = true;
+			}
+		}
+	}
+
+	return nullable;
+}
+
+/**
+ * Find the FIRST set of each symbol: a token is its own FIRST set, and a
+ * non-terminal takes the FIRST sets of the symbols that can begin its rules,
+ * until no set changes.
+ *
+ * @param grammar: generated grammar
+ * @return for each symbol, the terminals and tokens that can begin a string
+ * derived from it
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+constexpr auto static_first_sets(
+	const StaticGrammar<NumSymbols, NumRules, NumReplacementSymbols>& grammar)
+	-> std::array<StaticSymbolSet<NumSymbols>, NumSymbols> {
+	const std::array<bool, NumSymbols> nullable = static_nullable(grammar);
+
+	std::array<StaticSymbolSet<NumSymbols>, NumSymbols> first{};
+	for(std::size_t symbol = 0; symbol < NumSymbols; ++symbol) {
+		if(static_is_token(grammar.symbols, symbol)) {
+			first[symbol].words[symbol / 64] |= std::uint64_t{1}
+											 << (symbol % 64);
+		}
+	}
+
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(std::size_t rule = 0; rule < NumRules; ++rule) {
+			const std::size_t production = grammar.rules.productions[rule];
+			for(std::size_t i = grammar.rules.replacement_offsets[rule];
+				i < grammar.rules.replacement_offsets[rule + 1];
+				++i) {
+				const std::size_t symbol = grammar.rules.replacement_symbols[i];
+				if(static_set_merge(first[production], first[symbol])) {
+					changed = true;
+				}
+
+				if(!static_is_nullable_use(grammar.rules, i, nullable[symbol])) {
+					break;
+				}
+			}
+		}
+	}
+
+	return first;
+}
+
+/**
+ * Turn generated rules back into the rules of a language specification.
+ * @param symbols: symbols of a generated grammar
+ * @param rules: rules over symbols
+ * @return the rules, as read from a language specification
+ */
+template <std::size_t NumSymbols,
+		  std::size_t NumRules,
+		  std::size_t NumReplacementSymbols>
+auto to_rules(const StaticSymbols<NumSymbols>& symbols,
+			  const StaticRules<NumRules, NumReplacementSymbols>& rules)
+	-> std::vector<Rule> {
+	std::vector<Rule> converted;
+	for(std::size_t rule = 0; rule < NumRules; ++rule) {
+		const std::size_t production = rules.productions[rule];
+		Rule converted_rule{
+			GrammarSymbol{std::string{symbols.values[production]}, false},
+			{}};
+
+		for(std::size_t i = rules.replacement_offsets[rule];
+			i < rules.replacement_offsets[rule + 1];
+			++i) {
+			const std::size_t symbol = rules.replacement_symbols[i];
+			converted_rule.replacement.push_back(
+				GrammarSymbol{std::string{symbols.values[symbol]},
+							  symbols.terminal[symbol],
+							  rules.repetitions[i]});
+		}
+
+		converted.push_back(converted_rule);
+	}
+
+	return converted;
+}
@@ -0,0 +1,574 @@
+/**
+ * Earley recognition over sets of dotted rules stored as bits. See
+ * https://loup-vaillant.fr/tutorials/earley-parsing/recogniser for the item
+ * list version that this follows step for step.
+ */
+#include "bitset_recognizer.hpp"
+
+#include <algorithm>  // std::fill, std::lower_bound, std::max
+#include <cstddef>	  // std::size_t
+#include <cstdint>	  // std::uint64_t
+#include <map>		  // std::map
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument
+#include <string>	  // std::string
+#include <utility>	  // std::make_pair, std::move
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+#include <TMCompiler/compiler/models/token.hpp>			  // Token
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // Disambiguation, UnitChains
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseMeter
+
+// fewest new state sets between two clears of BitsetRecognizer
+constexpr std::size_t min_bitset_sets_between_clears = 64;
+
+/**
+ * Set a bit in a set of dotted rules.
+ * @param bits: the first word of the set
+ * @param bit: dotted rule to add
+ */
+auto set_dotted_bit(std::uint64_t* const bits, const std::size_t bit) -> void {
+	bits[bit / 64] |= std::uint64_t{1} << (bit % 64);
+}
+
+/**
+ * Add the dotted rules of one set to another.
+ * @param target: the first word of the set to add to
+ * @param source: the first word of the set to add
+ * @param words: number of words in a set
+ * @return true iff target gained a dotted rule
+ */
+auto or_dotted(std::uint64_t* const target,
+			   const std::uint64_t* const source,
+			   const std::size_t words) -> bool {
+	std::uint64_t gained = 0;
+	for(std::size_t w = 0; w < words; ++w) {
+		gained |= source[w] & ~target[w];
+		target[w] |= source[w];
+	}
+	return gained != 0;
+}
+
+/**
+ * Move the dot of the dotted rules in source & mask one symbol forward.
+ * @param target: the first word of the set of moved dotted rules
+ * @param source: the first word of a set of dotted rules
+ * @param mask: the first word of the dotted rules that may move
+ * @param words: number of words in a set
+ * @return true iff any dotted rule moved
+ */
+auto advance_dotted(std::uint64_t* const target,
+					const std::uint64_t* const source,
+					const std::uint64_t* const mask,
+					const std::size_t words) -> bool {
+	std::uint64_t carry = 0;
+	std::uint64_t any = 0;
+	for(std::size_t w = 0; w < words; ++w) {
+		const std::uint64_t moving = source[w] & mask[w];
+		target[w] = (moving << 1) | carry;
+		carry = moving >> 63;
+		any |= moving;
+	}
+	return any != 0;
+}
+
+/**
+ * Call visit with each dotted rule in a set, in increasing order.
+ * @param bits: the first word of the set
+ * @param words: number of words in a set
+ */
+template <typename Visit>
+auto for_each_dotted(const std::uint64_t* const bits,
+					 const std::size_t words,
+					 Visit visit) -> void {
+	for(std::size_t w = 0; w < words; ++w) {
+		for(std::uint64_t word = bits[w]; word != 0; word &= word - 1) {
+			visit(64 * w +
+				  static_cast<std::size_t>(__builtin_ctzll(word)));
+		}
+	}
+}
+
+/**
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @return true iff BitsetRecognizer can recognize the grammar: it is small,
+ * and no rule is empty. The recognizer completes each finished rule in the
+ * state set after its last token, which an empty rule does not have.
+ */
+[[gnu::pure]] auto fits_bitset_recognizer(
+	const std::vector<Rule>& grammar_rules) -> bool {
+	std::size_t dotted_rules = 0;
+	for(const Rule& rule : grammar_rules) {
+		if(rule.replacement.empty()) {
+			return false;
+		}
+		dotted_rules += 1 + rule.replacement.size();
+	}
+
+	return dotted_rules <= max_bitset_dotted_rules;
+}
+
+/**
+ * Compute the tables of a grammar for BitsetRecognizer. They mirror the steps
+ * of the Earley parser: a rule is predicted for a non-terminal, or for a
+ * non-terminal that derives it through skipped unit rules, and a finished
+ * rule completes the dotted rules that expect its production or an ancestor
+ * of it, unless disambiguation rejects it there.
+ *
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip: see find_unit_chains
+ * @param disambiguation: parses to rule out
+ * @param default_start: the top symbol of the parse
+ * @return tables of the grammar
+ */
+auto make_bitset_grammar(const std::vector<Rule>& grammar_rules,
+						 const UnitChains& unit_chains,
+						 const Disambiguation& disambiguation,
+						 const std::string& default_start) -> BitsetGrammar {
+	if(!fits_bitset_recognizer(grammar_rules)) {
+		throw std::invalid_argument(
+			"Grammar is too large or has an empty rule for BitsetRecognizer");
+	}
+
+	BitsetGrammar grammar;
+
+	std::vector<std::size_t> offsets;
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		offsets.push_back(grammar.dotted_rules.size());
+		grammar.dotted_rules.resize(
+			grammar.dotted_rules.size() + 1 +
+				grammar_rules[i].replacement.size(),
+			i);
+	}
+
+	const std::size_t words = (grammar.dotted_rules.size() + 63) / 64;
+	grammar.words = words;
+	const std::vector<std::uint64_t> empty(words, 0);
+
+	const auto related = [](const std::map<std::string, std::set<std::string> >&
+								related_symbols,
+							const std::string& symbol_name)
+		-> const std::set<std::string>& {
+		static const std::set<std::string> unrelated;
+		const auto found = related_symbols.find(symbol_name);
+		return found == related_symbols.end() ? unrelated : found->second;
+	};
+
+	const auto is_skipped = [&unit_chains](const std::size_t rule) {
+		return rule < unit_chains.skipped.size() && unit_chains.skipped[rule];
+	};
+
+	// rules predicted for each non-terminal, first directly, then through the
+	// first symbols of the predicted rules until nothing changes
+	std::map<std::string, std::vector<std::uint64_t> > predicted;
+	const auto direct_predictions = [&](const std::string& symbol_name) {
+		std::vector<std::uint64_t> bits = empty;
+		const std::set<std::string>& descendants =
+			related(unit_chains.descendants, symbol_name);
+		for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+			const std::string& value = grammar_rules[i].production.value;
+			if(!is_skipped(i) &&
+			   (value == symbol_name ||
+				descendants.find(value) != descendants.end())) {
+				set_dotted_bit(bits.data(), offsets[i]);
+			}
+		}
+		return bits;
+	};
+
+	predicted[default_start] = direct_predictions(default_start);
+	for(const Rule& rule : grammar_rules) {
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(!symbol.terminal &&
+			   predicted.find(symbol.value) == predicted.end()) {
+				predicted[symbol.value] = direct_predictions(symbol.value);
+			}
+		}
+	}
+
+	for(bool changed = true; changed;) {
+		changed = false;
+		for(auto& symbol_predictions : predicted) {
+			std::vector<std::uint64_t>& bits = symbol_predictions.second;
+			for_each_dotted(bits.data(), words, [&](const std::size_t bit) {
+				const GrammarSymbol& first =
+					grammar_rules[grammar.dotted_rules[bit]].replacement[0];
+				if(!first.terminal) {
+					changed = or_dotted(bits.data(),
+										predicted[first.value].data(),
+										words) ||
+							  changed;
+				}
+			});
+		}
+	}
+
+	grammar.finished = empty;
+	grammar.predicting = empty;
+	grammar.predictions.resize(grammar.dotted_rules.size() * words, 0);
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		const std::vector<GrammarSymbol>& replacement =
+			grammar_rules[i].replacement;
+		set_dotted_bit(grammar.finished.data(),
+					   offsets[i] + replacement.size());
+
+		for(std::size_t k = 0; k < replacement.size(); ++k) {
+			const std::size_t bit = offsets[i] + k;
+			if(replacement[k].terminal) {
+				std::vector<std::uint64_t>& scan =
+					grammar.scans
+						.insert(std::make_pair(replacement[k].value, empty))
+						.first->second;
+				set_dotted_bit(scan.data(), bit);
+				continue;
+			}
+
+			set_dotted_bit(grammar.predicting.data(), bit);
+			or_dotted(&grammar.predictions[bit * words],
+					  predicted[replacement[k].value].data(),
+					  words);
+		}
+	}
+
+	grammar.completions.resize(grammar_rules.size() * words, 0);
+	for(std::size_t r = 0; r < grammar_rules.size(); ++r) {
+		const GrammarSymbol& production = grammar_rules[r].production;
+		const std::set<std::string>& ancestors =
+			related(unit_chains.ancestors, production.value);
+
+		for(std::size_t p = 0; p < grammar_rules.size(); ++p) {
+			const std::vector<GrammarSymbol>& replacement =
+				grammar_rules[p].replacement;
+			for(std::size_t k = 0; k < replacement.size(); ++k) {
+				const GrammarSymbol& expected = replacement[k];
+				const bool rejected =
+					p < disambiguation.rejected_children.size() &&
+					k < disambiguation.rejected_children[p].size() &&
+					disambiguation.rejected_children[p][k].find(r) !=
+						disambiguation.rejected_children[p][k].end();
+				if(expected.terminal == production.terminal &&
+				   (expected.value == production.value ||
+					ancestors.find(expected.value) != ancestors.end()) &&
+				   !rejected) {
+					set_dotted_bit(&grammar.completions[r * words],
+								   offsets[p] + k);
+				}
+			}
+		}
+	}
+
+	for(std::size_t r = 0; r < disambiguation.follow_restrictions.size();
+		++r) {
+		for(const std::string& restricted :
+			disambiguation.follow_restrictions[r]) {
+			std::vector<std::uint64_t>& bits =
+				grammar.restrictions
+					.insert(std::make_pair(restricted, empty))
+					.first->second;
+			set_dotted_bit(bits.data(),
+						   offsets[r] + grammar_rules[r].replacement.size());
+		}
+	}
+
+	grammar.start = predicted[default_start];
+
+	grammar.accepted = empty;
+	const std::set<std::string>& descendants =
+		related(unit_chains.descendants, default_start);
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		const std::string& value = grammar_rules[i].production.value;
+		if(value == default_start ||
+		   descendants.find(value) != descendants.end()) {
+			set_dotted_bit(grammar.accepted.data(),
+						   offsets[i] + grammar_rules[i].replacement.size());
+		}
+	}
+
+	return grammar;
+}
+
+/**
+ * Count the items of a state set: one for each dotted rule of each start.
+ * @param dotted: dotted rules of a state set
+ * @return number of bits set
+ */
+[[gnu::pure]] auto count_dotted_rules(const std::vector<std::uint64_t>& dotted)
+	-> std::size_t {
+	std::size_t count = 0;
+	for(std::uint64_t word : dotted) {
+		for(; word != 0; word &= word - 1) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Constructor for BitsetRecognizer: create the first state set, with the
+ * rules predicted for the top symbol, so the recognizer is ready for the
+ * first token.
+ *
+ * A budget limits its work like the one of EarleyRecognizer. An item is a
+ * dotted rule of a start of a state set, as in EarleyRecognizer.
+ *
+ * @param _grammar: tables of the grammar, from make_bitset_grammar
+ * @param budget: limits of the recognizer, or none. Its wall time counts from
+ * the construction of the recognizer.
+ */
+BitsetRecognizer::BitsetRecognizer(BitsetGrammar _grammar,
+								   const ParseBudget& budget)
+	: grammar(std::move(_grammar)),
+	  earley_sets(1),
+	  checked_sets(0),
+	  meter(budget) {
+	earley_sets[0].starts.push_back(0);
+	earley_sets[0].dotted = grammar.start;
+	open_set = earley_sets[0];
+	meter.count_earley_set(count_dotted_rules(earley_sets[0].dotted));
+}
+
+/**
+ * Feed the next input token: scan it from the last state set, and close the
+ * new state set. As in EarleyRecognizer::push, the last state set is closed
+ * again if it completed a rule that may not be followed by token.
+ *
+ * Throws ParseBudgetExceeded if the recognizer goes over its budget.
+ *
+ * @param token: next word of the program
+ * @return false iff the input is no longer parsable, starting from this token
+ */
+auto BitsetRecognizer::push(const Token& token) -> bool {
+	const std::size_t words = grammar.words;
+
+	// finished dotted rules that may not be followed by token
+	std::vector<std::uint64_t> restricted(words, 0);
+	bool any_restricted = false;
+	for(const std::string& key : {token.type, token.value}) {
+		const auto found = grammar.restrictions.find(key);
+		if(found != grammar.restrictions.end()) {
+			or_dotted(restricted.data(), found->second.data(), words);
+			any_restricted = true;
+		}
+	}
+
+	if(any_restricted) {
+		const BitsetEarleySet& last = earley_sets.back();
+		std::uint64_t completed_restricted = 0;
+		for(std::size_t w = 0; w < last.dotted.size(); ++w) {
+			completed_restricted |= last.dotted[w] & restricted[w % words];
+		}
+
+		if(completed_restricted != 0) {
+			earley_sets.back() = open_set;
+			close_last_set(&restricted);
+		}
+	}
+
+	// dotted rules whose next symbol matches token
+	std::vector<std::uint64_t> scanned(words, 0);
+	for(const std::string& key : {token.type, token.value}) {
+		const auto found = grammar.scans.find(key);
+		if(found != grammar.scans.end()) {
+			or_dotted(scanned.data(), found->second.data(), words);
+		}
+	}
+
+	BitsetEarleySet next_set;
+	std::vector<std::uint64_t> moved(words, 0);
+	const BitsetEarleySet& last = earley_sets.back();
+	for(std::size_t s = 0; s < last.starts.size(); ++s) {
+		if(advance_dotted(moved.data(),
+						  &last.dotted[s * words],
+						  scanned.data(),
+						  words)) {
+			next_set.starts.push_back(last.starts[s]);
+			next_set.dotted.insert(
+				next_set.dotted.end(), moved.begin(), moved.end());
+		}
+	}
+
+	if(!grammar.restrictions.empty()) {
+		open_set = next_set;
+	}
+	earley_sets.push_back(std::move(next_set));
+	close_last_set(nullptr);
+	meter.count_earley_set(count_dotted_rules(earley_sets.back().dotted));
+
+	// clearing takes time in the number of kept sets, so it waits for at
+	// least as many new sets
+	if(earley_sets.size() >=
+	   checked_sets +
+		   std::max(kept_sets.size(), min_bitset_sets_between_clears)) {
+		clear_unneeded_sets();
+	}
+
+	return !earley_sets.back().starts.empty();
+}
+
+/**
+ * @return true iff the tokens pushed so far are a complete parse of the top
+ * symbol
+ */
+[[gnu::pure]] auto BitsetRecognizer::is_accepted() const -> bool {
+	const BitsetEarleySet& last = earley_sets.back();
+	if(last.starts.empty() || last.starts[0] != 0) {
+		return false;
+	}
+
+	std::uint64_t accepted = 0;
+	for(std::size_t w = 0; w < grammar.words; ++w) {
+		accepted |= last.dotted[w] & grammar.accepted[w];
+	}
+	return accepted != 0;
+}
+
+/**
+ * @return number of tokens pushed so far
+ */
+[[gnu::pure]] auto BitsetRecognizer::num_tokens() const -> std::size_t {
+	return earley_sets.size() - 1;
+}
+
+/**
+ * Close the last state set: complete its finished rules, then predict the
+ * non-terminals after its dots.
+ *
+ * Completing the finished rules that start at s adds items that start at s
+ * or before, so the starts are completed from the last one backwards, each
+ * until it finishes no new rules. Without empty rules, predicted rules are
+ * not finished, so they complete nothing in this state set.
+ *
+ * @param restricted: finished dotted rules that are not completed, because
+ * the next token may not follow them, or nullptr at the end of the input
+ */
+auto BitsetRecognizer::close_last_set(
+	const std::vector<std::uint64_t>* const restricted) -> void {
+	const std::size_t words = grammar.words;
+	const std::size_t i = earley_sets.size() - 1;
+	BitsetEarleySet& current = earley_sets[i];
+
+	// finds the dotted rules of a start in current, adding it if needed
+	const auto dotted_of = [&](const std::size_t start) -> std::uint64_t* {
+		const auto found = std::lower_bound(
+			current.starts.begin(), current.starts.end(), start);
+		const std::size_t s =
+			static_cast<std::size_t>(found - current.starts.begin());
+		if(found == current.starts.end() || *found != start) {
+			current.starts.insert(found, start);
+			current.dotted.insert(
+				current.dotted.begin() + static_cast<std::ptrdiff_t>(s * words),
+				words,
+				0);
+		}
+		return &current.dotted[s * words];
+	};
+
+	std::vector<std::uint64_t> completed(words, 0);
+	std::vector<std::uint64_t> pending(words, 0);
+	std::vector<std::uint64_t> expected(words, 0);
+	std::vector<std::uint64_t> moved(words, 0);
+
+	for(std::size_t bound = i; !current.starts.empty();) {
+		const auto below = std::lower_bound(
+			current.starts.begin(), current.starts.end(), bound);
+		if(below == current.starts.begin()) {
+			break;
+		}
+		const std::size_t start = *(below - 1);
+		bound = start;
+
+		std::fill(completed.begin(), completed.end(), 0);
+		while(true) {
+			const std::uint64_t* const dotted = dotted_of(start);
+			std::uint64_t any = 0;
+			for(std::size_t w = 0; w < words; ++w) {
+				pending[w] = dotted[w] & grammar.finished[w] & ~completed[w];
+				completed[w] |= pending[w];
+				if(restricted != nullptr) {
+					pending[w] &= ~(*restricted)[w];
+				}
+				any |= pending[w];
+			}
+			if(any == 0) {
+				break;
+			}
+
+			// the dotted rules that the pending finished rules complete
+			std::fill(expected.begin(), expected.end(), 0);
+			for_each_dotted(pending.data(), words, [&](const std::size_t bit) {
+				or_dotted(expected.data(),
+						  &grammar.completions[grammar.dotted_rules[bit] *
+											   words],
+						  words);
+			});
+
+			const BitsetEarleySet& origin = earley_sets[start];
+			for(std::size_t s = 0; s < origin.starts.size(); ++s) {
+				if(advance_dotted(moved.data(),
+								  &origin.dotted[s * words],
+								  expected.data(),
+								  words)) {
+					or_dotted(dotted_of(origin.starts[s]), moved.data(), words);
+				}
+			}
+		}
+	}
+
+	// rules predicted by any dotted rule of the state set
+	std::vector<std::uint64_t> predicted(words, 0);
+	std::fill(expected.begin(), expected.end(), 0);
+	for(std::size_t s = 0; s < current.starts.size(); ++s) {
+		for(std::size_t w = 0; w < words; ++w) {
+			expected[w] |=
+				current.dotted[s * words + w] & grammar.predicting[w];
+		}
+	}
+	for_each_dotted(expected.data(), words, [&](const std::size_t bit) {
+		or_dotted(
+			predicted.data(), &grammar.predictions[bit * words], words);
+	});
+
+	std::uint64_t any = 0;
+	for(const std::uint64_t word : predicted) {
+		any |= word;
+	}
+	if(any != 0) {
+		or_dotted(dotted_of(i), predicted.data(), words);
+	}
+}
+
+/**
+ * Clear the state sets that no later token can need. As with
+ * EarleyRecognizer::keep_needed_sets_only, the last state set is needed, and
+ * so is every state set where an item of a needed state set starts.
+ */
+auto BitsetRecognizer::clear_unneeded_sets() -> void {
+	const std::size_t last = earley_sets.size() - 1;
+
+	std::set<std::size_t> needed{last};
+	for(auto it = needed.end(); it != needed.begin();) {
+		--it;
+		needed.insert(earley_sets[*it].starts.begin(),
+					  earley_sets[*it].starts.end());
+	}
+
+	std::vector<std::size_t> candidates = kept_sets;
+	for(std::size_t j = checked_sets; j < last; ++j) {
+		candidates.push_back(j);
+	}
+
+	kept_sets.clear();
+	for(const std::size_t j : candidates) {
+		if(needed.find(j) != needed.end()) {
+			kept_sets.push_back(j);
+		} else {
+			std::vector<std::size_t>().swap(earley_sets[j].starts);
+			std::vector<std::uint64_t>().swap(earley_sets[j].dotted);
+		}
+	}
+
+	checked_sets = last;
+}
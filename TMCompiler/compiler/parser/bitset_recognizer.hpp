@@ -0,0 +1,133 @@
+/**
+ * Bit-parallel Earley recognizer for small grammars, which only tells if the
+ * input is valid: see BitsetRecognizer.
+ */
+#ifndef BITSET_RECOGNIZER_HPP
+#define BITSET_RECOGNIZER_HPP
+
+#include <cstddef>	// std::size_t
+#include <cstdint>	// std::uint64_t
+#include <map>		// std::map
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/models/token.hpp>			 // Token
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // Disambiguation, UnitChains
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseMeter
+
+/**
+ * Tables of a grammar for BitsetRecognizer. A dotted rule, which is a rule
+ * with a position in its replacement, is one bit: rule r with its dot before
+ * the k-th symbol is bit offsets[r] + k. Moving the dot of a set of dotted
+ * rules one symbol forward shifts the set by one bit.
+ *
+ * A set of dotted rules takes words 64-bit words; the tables below that hold
+ * several sets store them one after the other.
+ */
+struct BitsetGrammar {
+	// number of 64-bit words in a set of dotted rules
+	std::size_t words;
+
+	// rule of each dotted rule
+	std::vector<std::size_t> dotted_rules;
+
+	// dotted rules with the dot at the end
+	std::vector<std::uint64_t> finished;
+
+	// dotted rules with a non-terminal after the dot
+	std::vector<std::uint64_t> predicting;
+
+	// for each dotted rule: the rules, with the dot at the start, that the
+	// non-terminal after its dot predicts, directly or through the rules it
+	// predicts
+	std::vector<std::uint64_t> predictions;
+
+	// for each rule: the dotted rules whose next symbol a SubParse of the rule
+	// can be
+	std::vector<std::uint64_t> completions;
+
+	// for each terminal: the dotted rules whose next symbol it is
+	std::map<std::string, std::vector<std::uint64_t> > scans;
+
+	// for each token type or value: the finished dotted rules that may not be
+	// followed by it
+	std::map<std::string, std::vector<std::uint64_t> > restrictions;
+
+	// rules predicted for the top symbol, with the dot at the start
+	std::vector<std::uint64_t> start;
+
+	// finished dotted rules that are a parse of the top symbol
+	std::vector<std::uint64_t> accepted;
+};
+
+// most dotted rules of a grammar for BitsetRecognizer: past that, the tables
+// and sets of dotted rules are mostly empty words
+constexpr std::size_t max_bitset_dotted_rules = 1024;
+
+/**
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @return true iff BitsetRecognizer can recognize the grammar: it is small,
+ * and no rule is empty
+ */
+auto fits_bitset_recognizer(const std::vector<Rule>& grammar_rules) -> bool;
+
+/**
+ * Compute the tables of a grammar for BitsetRecognizer. Throws
+ * std::invalid_argument if the grammar does not fit: see
+ * fits_bitset_recognizer.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip: see find_unit_chains
+ * @param disambiguation: parses to rule out
+ * @param default_start: the top symbol of the parse
+ * @return tables of the grammar
+ */
+auto make_bitset_grammar(const std::vector<Rule>& grammar_rules,
+						 const UnitChains& unit_chains,
+						 const Disambiguation& disambiguation,
+						 const std::string& default_start) -> BitsetGrammar;
+
+/**
+ * Earley recognizer that stores each state set as a set of dotted rules for
+ * each start of its items, instead of a list of items. Scanning a token,
+ * completing a finished rule and predicting are each a few AND / OR / shift
+ * operations over whole words of dotted rules, in loops that the compiler
+ * vectorizes.
+ *
+ * It recognizes the same inputs as EarleyRecognizer, but builds no parse
+ * tree: state sets that no later token can need are cleared as it goes.
+ */
+class BitsetRecognizer {
+public:
+	explicit BitsetRecognizer(BitsetGrammar _grammar,
+							  const ParseBudget& budget = ParseBudget{});
+	auto push(const Token& token) -> bool;
+	[[nodiscard]] auto is_accepted() const -> bool;
+	[[nodiscard]] auto num_tokens() const -> std::size_t;
+
+private:
+	// a state set: the starts of its items in increasing order, and for each
+	// start, the dotted rules of its items
+	struct BitsetEarleySet {
+		std::vector<std::size_t> starts;
+		std::vector<std::uint64_t> dotted;
+	};
+
+	BitsetGrammar grammar;
+	std::vector<BitsetEarleySet> earley_sets;
+	// the last state set before it was closed, if a rule has a follow
+	// restriction
+	BitsetEarleySet open_set;
+	// state sets before checked_sets that were needed when last checked
+	std::vector<std::size_t> kept_sets;
+	// number of state sets that were checked for being needed
+	std::size_t checked_sets;
+	// counts the items of the state sets, and stops the recognizer once it
+	// goes over its budget
+	ParseMeter meter;
+
+	auto close_last_set(const std::vector<std::uint64_t>* restricted) -> void;
+	auto clear_unneeded_sets() -> void;
+};
+
+#endif
@@ -4,8 +4,12 @@
  */
 #include "earley_parser.hpp"
 
+#include <algorithm>  // std::max, std::min, std::remove_if, std::sort, std::stable_sort, std::unique
 #include <cstddef>	// std::size_t
+#include <deque>	// std::deque
 #include <iostream>
+#include <map>	// std::map
+#include <set>	// std::set
 #include <sstream>
 #include <stdexcept>  // std::invalid_argument, std::logic_error
 #include <string>
@@ -14,7 +18,22 @@
 
 #include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
 #include <TMCompiler/compiler/models/token.hpp>			  // Token
-#include <TMCompiler/utils/logger/logger.hpp>			  // Logger
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseMeter
+#include <TMCompiler/compiler/parser/spilled_earley_sets.hpp>  // SpilledEarleySets
+#include <TMCompiler/utils/logger/logger.hpp>				   // Logger
+
+// skips no rules: for parsing with every rule of the grammar
+const UnitChains no_unit_chains{};
+
+// rules out no parses: for parsing an unambiguous grammar
+const Disambiguation no_disambiguation{};
+
+// embeds no other parser: the Earley parser predicts every rule
+const EmbeddedParser no_embedded_parser{};
+
+// fewest new state sets between two clears of EarleyRecognizer, which is
+// never worth it for a handful of tokens
+constexpr std::size_t min_sets_between_clears = 64;
 
 auto rule_to_string(const Rule& rule) -> std::string {
 	std::stringstream ss;
@@ -76,22 +95,109 @@ auto item_to_string(const FlippedEarleyItem item) -> std::string {
 	return predicted.value == actual.value;
 }
 
+/**
+ * Look up the non-terminals related to a non-terminal through skipped unit
+ * rules.
+ * @param related: descendants or ancestors of UnitChains
+ * @param symbol_name: non-terminal to look up
+ * @return the related non-terminals, not including symbol_name
+ */
+[[gnu::pure]] auto find_related_by_unit_chains(
+	const std::map<std::string, std::set<std::string> >& related,
+	const std::string& symbol_name) -> const std::set<std::string>& {
+	static const std::set<std::string> unrelated;
+
+	const auto found = related.find(symbol_name);
+	return found == related.end() ? unrelated : found->second;
+}
+
+/**
+ * Check if a non-terminal derives another one through skipped unit rules.
+ * @param unit_chains: unit rules skipped by the parser
+ * @param ancestor: non-terminal that a rule expects
+ * @param descendant: production of a rule that might stand in for ancestor
+ * @return true iff ancestor is descendant, or derives it by unit rules
+ */
+[[gnu::pure]] auto derives_by_unit_chain(const UnitChains& unit_chains,
+										 const std::string& ancestor,
+										 const std::string& descendant)
+	-> bool {
+	if(ancestor == descendant) {
+		return true;
+	}
+
+	const std::set<std::string>& descendants =
+		find_related_by_unit_chains(unit_chains.descendants, ancestor);
+	return descendants.find(descendant) != descendants.end();
+}
+
+/**
+ * @return true iff the parser never predicts the rule, because it is part of
+ * a unit chain
+ */
+[[gnu::pure]] auto is_skipped(const UnitChains& unit_chains,
+							  const std::size_t rule_index) -> bool {
+	return rule_index < unit_chains.skipped.size() &&
+		   unit_chains.skipped[rule_index];
+}
+
+/**
+ * @return true iff a SubParse of child_rule may not be the child for the
+ * position-th symbol of parent_rule
+ */
+[[gnu::pure]] auto is_rejected_child(const Disambiguation& disambiguation,
+									 const std::size_t parent_rule,
+									 const std::size_t position,
+									 const std::size_t child_rule) -> bool {
+	if(parent_rule >= disambiguation.rejected_children.size()) {
+		return false;
+	}
+
+	const std::vector<std::set<std::size_t> >& positions =
+		disambiguation.rejected_children[parent_rule];
+	return position < positions.size() &&
+		   positions[position].find(child_rule) != positions[position].end();
+}
+
+/**
+ * @param disambiguation: parses to rule out
+ * @param rule_index: rule of a finished item
+ * @param next_token: token right after the finished item, or nullptr at the
+ * end of the input
+ * @return true iff a SubParse of the rule may not be followed by next_token
+ */
+[[gnu::pure]] auto is_restricted(const Disambiguation& disambiguation,
+								 const std::size_t rule_index,
+								 const Token* const next_token) -> bool {
+	if(next_token == nullptr ||
+	   rule_index >= disambiguation.follow_restrictions.size()) {
+		return false;
+	}
+
+	const std::set<std::string>& restricted =
+		disambiguation.follow_restrictions[rule_index];
+	return restricted.find(next_token->type) != restricted.end() ||
+		   restricted.find(next_token->value) != restricted.end();
+}
+
 /**
  * Add an element to a set, maintaining the property that an element
  * appears at most once.
  * @param earley_set: list of elements
  * @param item: element to add to the list
+ * @return false iff the item was already in the set
  */
 auto add_earley_item_to_set(std::vector<EarleyItem>& earley_set,
-							const EarleyItem item) -> void {
+							const EarleyItem item) -> bool {
 	// if duplicate found in set, do nothing
 	for(const EarleyItem element : earley_set) {
 		if(equals(element, item)) {
-			return;
+			return false;
 		}
 	}
 
 	earley_set.push_back(item);
+	return true;
 }
 
 /**
@@ -101,35 +207,53 @@ auto add_earley_item_to_set(std::vector<EarleyItem>& earley_set,
  * @param current_earley_set_index: index of token we are currently parsing
  * @param grammar_rules: global set of grammar rules that is being used
  * to parse the input
+ * @param unit_chains: unit rules skipped by the parser
+ * @param disambiguation: parses to rule out
  * @param item: Earley item that is finished. Use to find prev rule
+ * @param meter: counts the items that are moved forward
  */
 auto complete(std::vector<std::vector<EarleyItem> >& earley_sets,
 			  const std::size_t current_earley_set_index,
 			  const std::vector<Rule>& grammar_rules,
-			  const EarleyItem item) -> void {
-	const Rule finished_rule = grammar_rules[item.rule];
-	const GrammarSymbol finished_production = finished_rule.production;
+			  const UnitChains& unit_chains,
+			  const Disambiguation& disambiguation,
+			  const EarleyItem item,
+			  ParseMeter& meter) -> void {
+	const GrammarSymbol& finished_production =
+		grammar_rules[item.rule].production;
+
+	// non-terminals that derive finished_production through skipped unit
+	// rules: rules expecting them move forward a step as well
+	const std::set<std::string>& ancestors = find_related_by_unit_chains(
+		unit_chains.ancestors, finished_production.value);
 
 	// find who generated this finished_rule. That previous rule has made a step
-	// forward
-	const std::vector<EarleyItem> prev_earley_set = earley_sets[item.start];
+	// forward. An empty rule starts in the current set, which grows below:
+	// only the items that were there before are candidates, and they are read
+	// by index since adding an item may move the set.
+	const std::size_t candidates = earley_sets[item.start].size();
+
+	for(std::size_t k = 0; k < candidates; ++k) {
+		const EarleyItem candidate = earley_sets[item.start][k];
 
-	for(const EarleyItem candidate : prev_earley_set) {
 		// find rules that have <finished> production next to their dot
-		const Rule candidate_rule = grammar_rules[candidate.rule];
+		const Rule& candidate_rule = grammar_rules[candidate.rule];
 
 		if(candidate.next == candidate_rule.replacement.size()) {
 			continue;
 		}
 
-		const GrammarSymbol actual = candidate_rule.replacement[candidate.next];
+		const GrammarSymbol& actual = candidate_rule.replacement[candidate.next];
 
-		if(actual.value == finished_production.value &&
-		   actual.terminal == finished_production.terminal) {
+		if(actual.terminal == finished_production.terminal &&
+		   (actual.value == finished_production.value ||
+			ancestors.find(actual.value) != ancestors.end()) &&
+		   !is_rejected_child(
+			   disambiguation, candidate.rule, candidate.next, item.rule)) {
 			const EarleyItem next_item{
 				candidate.rule, candidate.start, 1 + candidate.next};
-			add_earley_item_to_set(earley_sets[current_earley_set_index],
-								   next_item);
+			meter.count_completion(add_earley_item_to_set(
+				earley_sets[current_earley_set_index], next_item));
 		}
 	}
 }
@@ -142,17 +266,19 @@ auto complete(std::vector<std::vector<EarleyItem> >& earley_sets,
  * @param item: Earley item whose next symbol in rule is a terminal symbol
  * @param predicted: next symbol in rule
  * @param actual: input token to match with predicted symbol
+ * @param meter: counts the item if it moves forward
  */
 auto scan(std::vector<std::vector<EarleyItem> >& earley_sets,
 		  const std::size_t current_earley_set_index,
 		  const EarleyItem item,
 		  const GrammarSymbol& predicted,
-		  const Token& actual) -> void {
+		  const Token& actual,
+		  ParseMeter& meter) -> void {
 	if(matches(predicted, actual) &&
 	   1 + current_earley_set_index < earley_sets.size()) {
 		const EarleyItem next_item{item.rule, item.start, 1 + item.next};
-		add_earley_item_to_set(earley_sets[1 + current_earley_set_index],
-							   next_item);
+		meter.count_scan(add_earley_item_to_set(
+			earley_sets[1 + current_earley_set_index], next_item));
 	}
 }
 
@@ -164,30 +290,300 @@ auto scan(std::vector<std::vector<EarleyItem> >& earley_sets,
  * @param earley_sets: global EarleyItems at each iteration / input token
  * @param current_earley_set_index: index of token we are currently parsing
  * @param grammar_rules: global set of grammar rules that is being used
- * @param production: the current rule's next symbol (non-terminal).
+ * @param unit_chains: unit rules skipped by the parser. Instead of predicting
+ * a unit rule, the rules of the non-terminals it derives are predicted.
+ * @param embedded_parser: parser for rules that are not predicted. The items
+ * it finds are added to the state sets they belong in.
+ * @param production: name of the current rule's next symbol (non-terminal).
  * We want to "recurse" down the current rule, to see if the input here
  * matches this production rule
+ * @param meter: counts the items that are predicted
  */
 auto predict(std::vector<std::vector<EarleyItem> >& earley_sets,
 			 const std::size_t current_earley_set_index,
 			 const std::vector<Rule>& grammar_rules,
-			 const GrammarSymbol& production) -> void {
+			 const UnitChains& unit_chains,
+			 const EmbeddedParser& embedded_parser,
+			 const std::string& production,
+			 ParseMeter& meter) -> void {
+	const std::set<std::string>& descendants =
+		find_related_by_unit_chains(unit_chains.descendants, production);
+
 	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
-		if(grammar_rules[i].production.value == production.value) {
+		const std::string& value = grammar_rules[i].production.value;
+		if(!is_skipped(unit_chains, i) &&
+		   (i >= embedded_parser.embedded.size() ||
+			!embedded_parser.embedded[i]) &&
+		   (value == production ||
+			descendants.find(value) != descendants.end())) {
 			const EarleyItem item{i, current_earley_set_index, 0};
-			add_earley_item_to_set(earley_sets[current_earley_set_index], item);
+			meter.count_prediction(add_earley_item_to_set(
+				earley_sets[current_earley_set_index], item));
+		}
+	}
+
+	if(embedded_parser.parse) {
+		for(const std::pair<std::size_t, EarleyItem>& found :
+			embedded_parser.parse(production, current_earley_set_index)) {
+			meter.count_prediction(
+				add_earley_item_to_set(earley_sets[found.first], found.second));
+		}
+	}
+}
+
+/**
+ * Close one Earley state set: complete finished rules and predict
+ * non-terminals, until no more items can be added. Items appended to the
+ * current set while processing are processed as well. Items whose next symbol
+ * is a terminal wait for the next token: see scan_earley_set.
+ * @param earley_sets: global EarleyItems at each iteration / input token
+ * @param current_earley_set_index: index of the state set to close
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser
+ * @param disambiguation: parses to rule out
+ * @param embedded_parser: parser for rules that are not predicted
+ * @param next_token: token at index current_earley_set_index, or nullptr at
+ * the end of the input. A finished rule that may not be followed by it is not
+ * completed.
+ * @param meter: counts the items that are added
+ */
+auto close_earley_set(std::vector<std::vector<EarleyItem> >& earley_sets,
+					  const std::size_t current_earley_set_index,
+					  const std::vector<Rule>& grammar_rules,
+					  const UnitChains& unit_chains,
+					  const Disambiguation& disambiguation,
+					  const EmbeddedParser& embedded_parser,
+					  const Token* const next_token,
+					  ParseMeter& meter) -> void {
+	const std::size_t i = current_earley_set_index;
+
+	for(std::size_t j = 0; j < earley_sets[i].size(); ++j) {
+		const EarleyItem item = earley_sets[i][j];
+		const Rule& rule = grammar_rules[item.rule];
+
+		// if Rule ends in dot, COMPLETE
+		if(item.next == rule.replacement.size()) {
+			if(!is_restricted(disambiguation, item.rule, next_token)) {
+				complete(earley_sets,
+						 i,
+						 grammar_rules,
+						 unit_chains,
+						 disambiguation,
+						 item,
+						 meter);
+			}
+			continue;
+		}
+
+		// if next token after dot is non-terminal, PREDICT
+		const GrammarSymbol& next_symbol = rule.replacement[item.next];
+		if(!next_symbol.terminal) {
+			predict(earley_sets,
+					i,
+					grammar_rules,
+					unit_chains,
+					embedded_parser,
+					next_symbol.value,
+					meter);
 		}
 	}
 }
 
+/**
+ * Scan an input token: every item of a closed Earley state set whose next
+ * symbol is a terminal matching the token moves on to the next state set.
+ * @param earley_sets: global EarleyItems at each iteration / input token
+ * @param current_earley_set_index: index of the state set before the token
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param token: input token at index current_earley_set_index
+ * @param meter: counts the items that move on
+ */
+auto scan_earley_set(std::vector<std::vector<EarleyItem> >& earley_sets,
+					 const std::size_t current_earley_set_index,
+					 const std::vector<Rule>& grammar_rules,
+					 const Token& token,
+					 ParseMeter& meter) -> void {
+	const std::size_t i = current_earley_set_index;
+
+	for(const EarleyItem item : earley_sets[i]) {
+		const Rule& rule = grammar_rules[item.rule];
+
+		if(item.next < rule.replacement.size() &&
+		   rule.replacement[item.next].terminal) {
+			scan(earley_sets,
+				 i,
+				 item,
+				 rule.replacement[item.next],
+				 token,
+				 meter);
+		}
+	}
+}
+
+/**
+ * Create the first Earley state set: predict every rule of the top symbol.
+ * @param earley_sets: global EarleyItems, with at least one (empty) state set
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser
+ * @param disambiguation: parses to rule out
+ * @param embedded_parser: parser for rules that are not predicted
+ * @param default_start: the top symbol of the parse
+ * @param next_token: first token, or nullptr if the input is empty
+ * @param meter: counts the items that are added
+ */
+auto initialize_earley_sets(std::vector<std::vector<EarleyItem> >& earley_sets,
+							const std::vector<Rule>& grammar_rules,
+							const UnitChains& unit_chains,
+							const Disambiguation& disambiguation,
+							const EmbeddedParser& embedded_parser,
+							const std::string& default_start,
+							const Token* const next_token,
+							ParseMeter& meter) -> void {
+	predict(earley_sets,
+			0,
+			grammar_rules,
+			unit_chains,
+			embedded_parser,
+			default_start,
+			meter);
+
+	close_earley_set(earley_sets,
+					 0,
+					 grammar_rules,
+					 unit_chains,
+					 disambiguation,
+					 embedded_parser,
+					 next_token,
+					 meter);
+}
+
+/**
+ * Count the Earley state sets of a previous input that remain valid for a new
+ * input: see rebuild_earley_items.
+ * @param earley_sets: Earley state sets of the previous input, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param inputs: the "words" of the new input
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in inputs
+ * @return number of leading state sets to keep
+ */
+[[gnu::pure]] auto count_kept_earley_sets(
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const Disambiguation& disambiguation,
+	const std::vector<Token>& inputs,
+	const std::size_t first_changed_token) -> std::size_t {
+	if(earley_sets.empty()) {
+		return 0;
+	}
+
+	const std::size_t kept_sets =
+		std::min({first_changed_token, earley_sets.size() - 1, inputs.size()});
+	return disambiguation.follow_restrictions.empty() ? 1 + kept_sets
+													  : kept_sets;
+}
+
+/**
+ * Bring Earley state sets of a previous input up to date with a new input.
+ *
+ * State set i only depends on the tokens before token i, so if the first
+ * first_changed_token tokens of the previous and the new input are equal, the
+ * state sets 0 through first_changed_token are still valid. Those are kept,
+ * and only the following state sets are rebuilt. With follow restrictions,
+ * state set i also depends on token i, so one state set less is kept.
+ *
+ * @param earley_sets: Earley state sets of the previous input, or empty to
+ * build from scratch. Updated to be the state sets of inputs.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param inputs: the "words" of the program / input
+ * @param default_start: the top symbol of the parse
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in inputs
+ * @param embedded_parser: parser for rules that are not predicted, or none.
+ * Only used to build from scratch: the items it adds ahead of the current
+ * state set are not kept apart from the others.
+ * @param meter: counts each state set that is built, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto rebuild_earley_items(std::vector<std::vector<EarleyItem> >& earley_sets,
+						  const std::vector<Rule>& grammar_rules,
+						  const UnitChains& unit_chains,
+						  const Disambiguation& disambiguation,
+						  const std::vector<Token>& inputs,
+						  const std::string& default_start,
+						  const std::size_t first_changed_token,
+						  const EmbeddedParser& embedded_parser,
+						  ParseMeter* const meter) -> void {
+	LOG("INFO") << "Building Earley sets" << std::endl;
+
+	ParseMeter unlimited{ParseBudget{}};
+	ParseMeter& counted = meter != nullptr ? *meter : unlimited;
+
+	std::size_t kept_sets = count_kept_earley_sets(
+		earley_sets, disambiguation, inputs, first_changed_token);
+
+	// state sets after the kept ones are cleared instead of destroyed, so that
+	// they are rebuilt in the memory they already have
+	for(std::size_t i = kept_sets; i < earley_sets.size(); ++i) {
+		earley_sets[i].clear();
+	}
+	earley_sets.resize(1 + inputs.size());
+
+	// token right after state set i
+	const auto next_token = [&inputs](const std::size_t i) -> const Token* {
+		return i < inputs.size() ? &inputs[i] : nullptr;
+	};
+
+	// initialize first state
+	if(kept_sets == 0) {
+		initialize_earley_sets(earley_sets,
+							   grammar_rules,
+							   unit_chains,
+							   disambiguation,
+							   embedded_parser,
+							   default_start,
+							   next_token(0),
+							   counted);
+		counted.count_earley_set(earley_sets.front().size());
+		kept_sets = 1;
+	}
+
+	// create the remaining state sets, while traversing the input: scan each
+	// token from the state set before it, then close the new state set
+	for(std::size_t i = kept_sets - 1; i < inputs.size(); ++i) {
+		scan_earley_set(earley_sets, i, grammar_rules, inputs[i], counted);
+		close_earley_set(earley_sets,
+						 1 + i,
+						 grammar_rules,
+						 unit_chains,
+						 disambiguation,
+						 embedded_parser,
+						 next_token(1 + i),
+						 counted);
+		counted.count_earley_set(earley_sets[1 + i].size());
+	}
+
+	LOG("INFO") << "Finish building earley_sets" << std::endl;
+}
+
 /**
  * Build up the entire Earley state sets from a given input and set of
  * grammar rules. From it, backtrack from the end to find the parse of
  * the entire input program.
+ *
+ * Unit rules in unit_chains are skipped, and the parses in disambiguation
+ * ruled out. With an embedded parser, the parses of some rules are found by
+ * the other parser instead of predicted: the state sets hold the finished
+ * items that it finds, and none of the partial items of the rules it parses.
+ *
  * @param grammar_rules: list of production symbols to replacement rules
  * @param inputs: the "words" of the program / input
  * @param default_start: the top symbol of the parse; which production
  * rule in grammar_rules should start parsing the input
+ * @param unit_chains: unit rules to skip, or none: see find_unit_chains
+ * @param disambiguation: parses to rule out, or none
+ * @param embedded_parser: parser for rules that are not predicted, or none
  * @return list of Earley state sets, of size inputs.size() + 1.
  * state_set[i] refers to the valid possible parses, before reading
  * token[i]. The last state set that has a finished rule and starts from
@@ -195,119 +591,539 @@ auto predict(std::vector<std::vector<EarleyItem> >& earley_sets,
  */
 auto build_earley_items(const std::vector<Rule>& grammar_rules,
 						const std::vector<Token>& inputs,
-						const std::string& default_start)
+						const std::string& default_start,
+						const UnitChains& unit_chains,
+						const Disambiguation& disambiguation,
+						const EmbeddedParser& embedded_parser)
 	-> std::vector<std::vector<EarleyItem> > {
-	std::vector<std::vector<EarleyItem> > earley_sets(1 + inputs.size());
+	std::vector<std::vector<EarleyItem> > earley_sets;
+	rebuild_earley_items(earley_sets,
+						 grammar_rules,
+						 unit_chains,
+						 disambiguation,
+						 inputs,
+						 default_start,
+						 0,
+						 embedded_parser);
 
-	LOG("INFO") << "Building Earley sets" << std::endl;
+	return earley_sets;
+}
 
-	// initialize first state
-	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
-		if(grammar_rules[i].production.value == default_start) {
-			const EarleyItem item{i, 0, 0};
-			add_earley_item_to_set(earley_sets[0], item);
+/**
+ * Check whether Earley state sets hold a parse of the whole input.
+ * @param earley_sets: Earley state sets generated by build_earley_items
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules the parser skipped, or empty
+ * @param default_start: the top symbol of the parse
+ * @return true iff the last state set has a finished item of default_start
+ * that starts at the first token
+ */
+[[gnu::pure]] auto is_accepted(
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const UnitChains& unit_chains,
+	const std::string& default_start) -> bool {
+	for(const EarleyItem item : earley_sets.back()) {
+		const Rule& rule = grammar_rules[item.rule];
+		if(item.start == 0 && item.next == rule.replacement.size() &&
+		   derives_by_unit_chain(
+			   unit_chains, default_start, rule.production.value)) {
+			return true;
 		}
 	}
 
-	// create the remaining state sets, while traversing the input
+	return false;
+}
 
-	// for each earley_set, starting from 0 and working up, parse all
-	// earley_items
-	for(std::size_t i = 0; i < earley_sets.size(); ++i) {
-		for(std::size_t j = 0; j < earley_sets[i].size(); ++j) {
-			const EarleyItem item = earley_sets[i][j];
-			const Rule rule = grammar_rules[item.rule];
+/**
+ * Constructor for EarleyRecognizer: create the first Earley state set, so the
+ * recognizer is ready for the first token.
+ *
+ * With a budget, a push throws ParseBudgetExceeded once the state sets built
+ * so far go over it, so an input that makes the state sets blow up fails
+ * before the rest of it is recognized.
+ *
+ * @param _grammar_rules: list of production symbols to replacement rules.
+ * Must outlive the recognizer.
+ * @param _default_start: the top symbol of the parse
+ * @param _unit_chains: unit rules to skip, or none: see find_unit_chains.
+ * Must outlive the recognizer.
+ * @param _disambiguation: parses to rule out, or none. Must outlive the
+ * recognizer.
+ * @param budget: limits of the recognizer, or none. Its wall time counts from
+ * the construction of the recognizer.
+ */
+EarleyRecognizer::EarleyRecognizer(const std::vector<Rule>& _grammar_rules,
+								   std::string _default_start,
+								   const UnitChains& _unit_chains,
+								   const Disambiguation& _disambiguation,
+								   const ParseBudget& budget)
+	: grammar_rules(_grammar_rules),
+	  unit_chains(_unit_chains),
+	  disambiguation(_disambiguation),
+	  default_start(std::move(_default_start)),
+	  earley_sets(1),
+	  open_items(0),
+	  needed_sets_only(false),
+	  checked_sets(0),
+	  meter(budget),
+	  spilled_sets(nullptr) {
+	initialize_earley_sets(earley_sets,
+						   grammar_rules,
+						   unit_chains,
+						   disambiguation,
+						   no_embedded_parser,
+						   default_start,
+						   nullptr,
+						   meter);
+	meter.count_earley_set(earley_sets.front().size());
+}
 
-			// if Rule ends in dot, COMPLETE
-			if(item.next == rule.replacement.size()) {
-				complete(earley_sets, i, grammar_rules, item);
-				continue;
-			}
+/**
+ * Feed the next input token: scan it from the last Earley state set, and close
+ * the new state set.
+ *
+ * If the new state set is empty, no rule can continue with this token, so the
+ * input has a syntax error at this token regardless of the tokens after it.
+ *
+ * The last state set is closed as if the input ended there. If it completed a
+ * rule that may not be followed by token, it is closed again without it.
+ *
+ * Throws ParseBudgetExceeded if the recognizer goes over its budget.
+ *
+ * @param token: next word of the program
+ * @return false iff the input is no longer parsable, starting from this token
+ */
+auto EarleyRecognizer::push(const Token& token) -> bool {
+	const std::size_t i = earley_sets.size() - 1;
 
-			const GrammarSymbol next_symbol = rule.replacement[item.next];
-			if(next_symbol.terminal) {
-				// if next token after dot is terminal, SCAN
-				if(i < inputs.size()) {
-					scan(earley_sets, i, item, next_symbol, inputs[i]);
-				}
-			} else {
-				// if next token after dot is non-terminal, PREDICT
-				predict(earley_sets, i, grammar_rules, next_symbol);
-			}
+	bool restricted = false;
+	if(!disambiguation.follow_restrictions.empty()) {
+		for(const EarleyItem item : earley_sets[i]) {
+			restricted =
+				restricted ||
+				(item.next == grammar_rules[item.rule].replacement.size() &&
+				 is_restricted(disambiguation, item.rule, &token));
 		}
 	}
 
-	LOG("INFO") << "Finish building earley_sets" << std::endl;
+	if(restricted) {
+		earley_sets[i].resize(open_items);
+		if(i == 0) {
+			initialize_earley_sets(earley_sets,
+								   grammar_rules,
+								   unit_chains,
+								   disambiguation,
+								   no_embedded_parser,
+								   default_start,
+								   &token,
+								   meter);
+		} else {
+			close_earley_set(earley_sets,
+							 i,
+							 grammar_rules,
+							 unit_chains,
+							 disambiguation,
+							 no_embedded_parser,
+							 &token,
+							 meter);
+		}
+	}
+
+	if(spare_sets.empty()) {
+		earley_sets.emplace_back();
+	} else {
+		earley_sets.push_back(std::move(spare_sets.back()));
+		spare_sets.pop_back();
+	}
+
+	scan_earley_set(earley_sets, i, grammar_rules, token, meter);
+	open_items = earley_sets.back().size();
+	close_earley_set(earley_sets,
+					 1 + i,
+					 grammar_rules,
+					 unit_chains,
+					 disambiguation,
+					 no_embedded_parser,
+					 nullptr,
+					 meter);
+	meter.count_earley_set(earley_sets.back().size());
+
+	// the previous state set is final once a token follows it, and is
+	// written before it may be cleared
+	if(spilled_sets != nullptr) {
+		spilled_sets->add_earley_set(earley_sets[i]);
+	}
+
+	// clearing takes time in the number of kept sets, so it waits for at
+	// least as many new sets
+	if(needed_sets_only &&
+	   earley_sets.size() >=
+		   checked_sets + std::max(kept_sets.size(), min_sets_between_clears)) {
+		clear_unneeded_sets();
+	}
 
+	return !earley_sets.back().empty();
+}
+
+/**
+ * @return true iff the tokens pushed so far are a complete parse of the top
+ * symbol
+ */
+[[gnu::pure]] auto EarleyRecognizer::is_accepted() const -> bool {
+	return ::is_accepted(
+		earley_sets, grammar_rules, unit_chains, default_start);
+}
+
+/**
+ * @return number of tokens pushed so far
+ */
+[[gnu::pure]] auto EarleyRecognizer::num_tokens() const -> std::size_t {
+	return earley_sets.size() - 1;
+}
+
+/**
+ * @return Earley state sets of the tokens pushed so far, one more than the
+ * number of tokens. After keep_needed_sets_only(), some of them may be
+ * cleared, and no parse tree can be built from them.
+ */
+[[gnu::const]] auto EarleyRecognizer::get_earley_sets() const
+	-> const std::vector<std::vector<EarleyItem> >& {
 	return earley_sets;
 }
 
 /**
- * Filter out partial parses from Earley State set
- * @param earley_sets: Earley state sets to filter on
+ * @return work of the recognizer so far, from its construction: the time
+ * includes whatever happened between pushes, like finding the next token
+ */
+auto EarleyRecognizer::get_statistics() const -> ParseStatistics {
+	return meter.get_statistics();
+}
+
+/**
+ * Forget the tokens pushed so far, so the recognizer is ready for the first
+ * token of another input, and its budget and statistics start over. The state
+ * sets are emptied but keep their memory, so pushing the tokens of an input
+ * no larger than earlier ones does not allocate. keep_needed_sets_only() still
+ * holds, while spill_finished_items() has to be called again.
+ */
+auto EarleyRecognizer::restart() -> void {
+	while(earley_sets.size() > 1) {
+		earley_sets.back().clear();
+		spare_sets.push_back(std::move(earley_sets.back()));
+		earley_sets.pop_back();
+	}
+
+	earley_sets.front().clear();
+	open_items = 0;
+	kept_sets.clear();
+	checked_sets = 0;
+	meter.restart();
+	spilled_sets = nullptr;
+
+	initialize_earley_sets(earley_sets,
+						   grammar_rules,
+						   unit_chains,
+						   disambiguation,
+						   no_embedded_parser,
+						   default_start,
+						   nullptr,
+						   meter);
+	meter.count_earley_set(earley_sets.front().size());
+}
+
+/**
+ * From now on, clear the Earley state sets that no later token can need, for
+ * checking the syntax of long inputs without building a parse tree.
+ *
+ * A state set is only read when completing an item that starts there, so
+ * the last state set is needed, and so is every state set where an item of a
+ * needed state set starts. Whether the input is accepted only depends on the
+ * last state set.
+ */
+auto EarleyRecognizer::keep_needed_sets_only() -> void {
+	needed_sets_only = true;
+}
+
+/**
+ * From now on, write the finished items of each state set to spilled once the
+ * next token is pushed, for building the parse tree of a long input without
+ * keeping its state sets in memory: see
+ * Grammar::parse_spilling_finished_items. Together with keep_needed_sets_only,
+ * the state sets in memory grow with the nesting of the input instead of its
+ * length. The last state set is final once the input
+ * ends, and is left to SpilledEarleySets::finish.
+ *
+ * Must be called before the first token is pushed.
+ *
+ * @param spilled: where the finished items are written. Must outlive the
+ * recognizer, or be finished before it is destroyed
+ */
+auto EarleyRecognizer::spill_finished_items(SpilledEarleySets& spilled)
+	-> void {
+	if(num_tokens() > 0) {
+		throw std::logic_error(
+			"Finished items are spilled from the first token on");
+	}
+
+	spilled_sets = &spilled;
+}
+
+/**
+ * Clear the state sets that are not needed: see keep_needed_sets_only.
+ */
+auto EarleyRecognizer::clear_unneeded_sets() -> void {
+	const std::size_t last = earley_sets.size() - 1;
+
+	// items start at or before their own state set, so the needed state sets
+	// are found from the last one backwards
+	std::set<std::size_t> needed{last};
+	for(auto it = needed.end(); it != needed.begin();) {
+		--it;
+		for(const EarleyItem item : earley_sets[*it]) {
+			needed.insert(item.start);
+		}
+	}
+
+	std::vector<std::size_t> candidates = kept_sets;
+	for(std::size_t j = checked_sets; j < last; ++j) {
+		candidates.push_back(j);
+	}
+
+	kept_sets.clear();
+	for(const std::size_t j : candidates) {
+		if(needed.find(j) != needed.end()) {
+			kept_sets.push_back(j);
+		} else {
+			std::vector<EarleyItem>().swap(earley_sets[j]);
+		}
+	}
+
+	checked_sets = last;
+}
+
+/**
+ * Flip the finished items of the Earley state sets from first_set onwards,
+ * and add them after the items that start at the same token: see
+ * flip_finished_items. The items of each token that got new ones are sorted
+ * by rank again.
+ * @param flipped_earley_sets: finished items by start of the state sets
+ * before first_set
+ * @param earley_sets: Earley state sets to swap start and end positions
  * @param grammar_rules: global set of grammar rules
- * @return Earley state sets without partial parses
+ * @param first_set: first state set whose finished items are added
+ * @param rule_ranks: rank of each rule, lowest first, or empty to keep the
+ * order of the Earley sets
  */
-auto filter_out_partial_parses(
+auto add_flipped_items(
+	std::vector<std::vector<FlippedEarleyItem> >& flipped_earley_sets,
 	const std::vector<std::vector<EarleyItem> >& earley_sets,
-	const std::vector<Rule>& grammar_rules)
-	-> std::vector<std::vector<EarleyItem> > {
-	std::vector<std::vector<EarleyItem> > filtered(earley_sets.size());
+	const std::vector<Rule>& grammar_rules,
+	const std::size_t first_set,
+	const std::vector<std::size_t>& rule_ranks) -> void {
+	flipped_earley_sets.resize(earley_sets.size());
 
-	for(std::size_t i = 0; i < earley_sets.size(); ++i) {
+	// tokens that new items start at
+	std::vector<std::size_t> starts;
+	for(std::size_t i = first_set; i < earley_sets.size(); ++i) {
 		for(const EarleyItem item : earley_sets[i]) {
-			const Rule rule = grammar_rules[item.rule];
-			if(rule.replacement.size() == item.next) {
-				filtered[i].push_back(item);
+			// partial parses are never part of the parse tree
+			if(grammar_rules[item.rule].replacement.size() == item.next) {
+				flipped_earley_sets[item.start].push_back(
+					FlippedEarleyItem{item.rule, i, item.next});
+				starts.push_back(item.start);
 			}
 		}
 	}
 
-	return filtered;
+	if(rule_ranks.empty()) {
+		return;
+	}
+
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+	for(const std::size_t start : starts) {
+		std::vector<FlippedEarleyItem>& items = flipped_earley_sets[start];
+		std::stable_sort(
+			items.begin(),
+			items.end(),
+			[&rule_ranks](const FlippedEarleyItem a, const FlippedEarleyItem b) {
+				return rule_ranks[a.rule] < rule_ranks[b.rule];
+			});
+	}
 }
 
 /**
- * Change the meaning of Earley state sets: instead of storing the end position
- * explicitly, store the start position explicitly. This allows parsing from
- * the beginning of input, instead from the end.
- * @param earley_sets: Earley state sets to swap start and end positions
- * @return same Earley sets, just stored in a different way
+ * Take the finished items of the Earley state sets from first_set onwards out
+ * of the finished items by start, so that those state sets can be rebuilt.
+ * @param flipped_earley_sets: finished items by start of earley_sets
+ * @param earley_sets: Earley state sets that flipped_earley_sets were flipped
+ * from
+ * @param grammar_rules: global set of grammar rules
+ * @param first_set: first state set whose finished items are taken out
  */
-auto flip_earley_sets(const std::vector<std::vector<EarleyItem> >& earley_sets)
-	-> std::vector<std::vector<FlippedEarleyItem> > {
-	std::vector<std::vector<FlippedEarleyItem> > swapped(earley_sets.size());
-	for(std::size_t i = 0; i < earley_sets.size(); ++i) {
-		for(EarleyItem item : earley_sets[i]) {
-			const FlippedEarleyItem same_item{item.rule, i, item.next};
-			swapped[item.start].push_back(same_item);
+auto remove_flipped_items(
+	std::vector<std::vector<FlippedEarleyItem> >& flipped_earley_sets,
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const std::size_t first_set) -> void {
+	if(first_set == 0) {
+		flipped_earley_sets.clear();
+		return;
+	}
+
+	// items that start at or after first_set also end there, so only the
+	// tokens before it keep any
+	std::vector<std::size_t> starts;
+	for(std::size_t i = first_set; i < earley_sets.size(); ++i) {
+		for(const EarleyItem item : earley_sets[i]) {
+			if(grammar_rules[item.rule].replacement.size() == item.next &&
+			   item.start < first_set) {
+				starts.push_back(item.start);
+			}
 		}
 	}
 
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+	for(const std::size_t start : starts) {
+		std::vector<FlippedEarleyItem>& items = flipped_earley_sets[start];
+		items.erase(std::remove_if(items.begin(),
+								   items.end(),
+								   [first_set](const FlippedEarleyItem item) {
+									   return item.end >= first_set;
+								   }),
+					items.end());
+	}
+
+	flipped_earley_sets.resize(
+		std::min(flipped_earley_sets.size(), first_set));
+}
+
+/**
+ * Keep the finished items of Earley state sets, and change their meaning:
+ * instead of storing the end position explicitly, store the start position
+ * explicitly. This allows parsing from the beginning of input, instead from
+ * the end.
+ *
+ * With rule_ranks, the items that start at each token are sorted by the rank
+ * of their rule. The parse tree search tries
+ * children in this order, so ranking the rules that parses use most often
+ * first makes it backtrack less. Items of rules with the same rank keep their
+ * order.
+ *
+ * With an unambiguous grammar the parse tree is the same in any order. With an
+ * ambiguous one, the order chooses which parse is found.
+ *
+ * @param earley_sets: Earley state sets to swap start and end positions
+ * @param grammar_rules: global set of grammar rules
+ * @param rule_ranks: rank of each rule, lowest first, or empty to keep the
+ * order of the Earley sets
+ * @return finished items of the same Earley sets, stored in a different way
+ */
+auto flip_finished_items(
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const std::vector<std::size_t>& rule_ranks)
+	-> std::vector<std::vector<FlippedEarleyItem> > {
+	std::vector<std::vector<FlippedEarleyItem> > swapped;
+	add_flipped_items(swapped, earley_sets, grammar_rules, 0, rule_ranks);
 	return swapped;
 }
 
+/**
+ * Bring the Earley state sets of state up to date with a new input, and with
+ * them the finished items by start. Finished items of the kept state sets are
+ * kept where they are: the ones of the state sets that are rebuilt are taken
+ * out before, and the ones of the new state sets added after. If rule_ranks
+ * changed since the previous input, all finished items are flipped again.
+ *
+ * @param state: Earley state sets and finished items of the previous input,
+ * or an empty state. Updated to describe inputs.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param inputs: the "words" of the program / input
+ * @param default_start: the top symbol of the parse
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in inputs
+ * @param rule_ranks: rank of each rule, lowest first, or empty to keep the
+ * order of the Earley sets
+ * @param meter: counts each state set that is built, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto reparse_earley_items(IncrementalParseState& state,
+						  const std::vector<Rule>& grammar_rules,
+						  const UnitChains& unit_chains,
+						  const Disambiguation& disambiguation,
+						  const std::vector<Token>& inputs,
+						  const std::string& default_start,
+						  const std::size_t first_changed_token,
+						  const std::vector<std::size_t>& rule_ranks,
+						  ParseMeter* const meter) -> void {
+	const bool same_order =
+		state.rule_ranks == rule_ranks &&
+		state.flipped_earley_sets.size() == state.earley_sets.size();
+
+	// state sets whose finished items stay where they are
+	const std::size_t kept_sets =
+		same_order ? count_kept_earley_sets(state.earley_sets,
+											disambiguation,
+											inputs,
+											first_changed_token)
+				   : 0;
+
+	remove_flipped_items(state.flipped_earley_sets,
+						 state.earley_sets,
+						 grammar_rules,
+						 kept_sets);
+
+	rebuild_earley_items(state.earley_sets,
+						 grammar_rules,
+						 unit_chains,
+						 disambiguation,
+						 inputs,
+						 default_start,
+						 first_changed_token,
+						 no_embedded_parser,
+						 meter);
+
+	add_flipped_items(state.flipped_earley_sets,
+					  state.earley_sets,
+					  grammar_rules,
+					  kept_sets,
+					  rule_ranks);
+	state.rule_ranks = rule_ranks;
+}
+
 /**
  * Once the Earley state sets have been created, find the item that corresponds
  * to the highest-level rule that applies to the input tokens
- * @param earley_sets: created Earley state sets
+ * @param earley_sets: finished items by start, from flip_finished_items or
+ * SpilledEarleySets
  * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser
  * @param default_start: first production rule that applies to input
  * @return FlippedEarleyItem that corresponds to highest-level rule
  */
-auto find_top_item(
-	const std::vector<std::vector<FlippedEarleyItem> >& earley_sets,
-	const std::vector<Rule>& grammar_rules,
-	const std::string& default_start) -> FlippedEarleyItem {
-	if(earley_sets.empty()) {
+template <typename FlippedEarleySets>
+auto find_top_item(const FlippedEarleySets& earley_sets,
+				   const std::vector<Rule>& grammar_rules,
+				   const UnitChains& unit_chains,
+				   const std::string& default_start) -> FlippedEarleyItem {
+	if(earley_sets.size() == 0) {
 		throw std::invalid_argument(
 			"There is no parse if the Earley state sets are empty");
 	}
 
-	for(const FlippedEarleyItem item : earley_sets.front()) {
-		const Rule rule = grammar_rules[item.rule];
+	const auto& first_items = earley_sets[0];
+	for(std::size_t i = 0; i < first_items.size(); ++i) {
+		const FlippedEarleyItem item = first_items[i];
+		const Rule& rule = grammar_rules[item.rule];
 		// earley_sets.size() is 1 more than number of tokens
 		if(item.end + 1 == earley_sets.size() &&
-		   rule.production.value == default_start) {
+		   derives_by_unit_chain(
+			   unit_chains, default_start, rule.production.value)) {
 			return item;
 		}
 	}
@@ -317,137 +1133,183 @@ auto find_top_item(
 }
 
 /**
- * Given a current EarleyItem, recursively find its next child.
+ * Given a current EarleyItem, find its children: one sub-rule for every
+ * non-terminal of its rule, that together with its terminals cover the tokens
+ * of the item.
  *
- * "Next" refers to the sub-rule of the parent at its dot. For instance, if
- * parent_item refers to the rule "Salad -> Vegetables + Dressing", then one
- * iteration of this function before recursing might try adding the sub-rule
- * "Vegetables -> Cabbage". In the recursive call, if "Cabbage" doesn't match
- * with the input tokens, then the parent call rejects this sub-rule and tries
- * another one, like "Vegetables -> Lettuce". Once the recursive calls finish
- * successfully, path gets populated with [("Vegetables -> Lettuce", 3),
- * ("Dressing -> Ranch", 8)], where the number refers to which token position
- * marks the start of that rule.
+ * The search goes through the parent's rule from left to right. For instance,
+ * if parent_item refers to the rule "Salad -> Vegetables + Dressing", then it
+ * might first try the sub-rule "Vegetables -> Cabbage". If "Cabbage" is not
+ * followed by a "+" in the input tokens, the search backtracks, rejects this
+ * sub-rule and tries another one, like "Vegetables -> Lettuce". Once the
+ * search reaches the end of the rule at the end of parent_item, path gets
+ * populated with [("Vegetables -> Lettuce", 3), ("Dressing -> Ranch", 8)],
+ * where the number refers to which token position marks the start of that
+ * rule.
  *
- * @param earley_sets: created Earley state sets
+ * Each symbol of the rule gets a step on an explicit stack instead of a
+ * recursive call, so backtracking does not use the call stack.
+ *
+ * @param earley_sets: finished items by start, from flip_finished_items or
+ * SpilledEarleySets
  * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser
+ * @param disambiguation: parses the parser ruled out
  * @param input_tokens: list of tokens / words from the input being parsed
  * @param parent_item: the rule which we want to find its sub-rules
- * @param parent_rule_dot: in the RHS of the parent_item rule, which child
- *		are we looking at now
- * @param token_location: index of input_tokens. Everything before has been
- *		parsed already.
- * @param path: current list of sub-rules of parent_item. When the recursive
- *		call finishes, this path will be populated
+ * @param token_location: index of input_tokens where parent_item starts
+ * @param path: current list of sub-rules of parent_item. When the search
+ *		finishes, this path will be populated
+ * @param meter: counts each child that is tried
  * @return true iff there is a path from curr_node to its last child
  */
-auto dfs(const std::vector<std::vector<FlippedEarleyItem> >& earley_sets,
+template <typename FlippedEarleySets>
+auto dfs(const FlippedEarleySets& earley_sets,
 		 const std::vector<Rule>& grammar_rules,
+		 const UnitChains& unit_chains,
+		 const Disambiguation& disambiguation,
 		 const std::vector<Token>& input_tokens,
 		 const FlippedEarleyItem& parent_item,
-		 const std::size_t parent_rule_dot,
 		 const std::size_t token_location,
-		 std::vector<std::pair<FlippedEarleyItem, std::size_t> >& path)
-	-> bool {
-	const Rule parent_rule = grammar_rules[parent_item.rule];
-
-	// LOG("DEBUG") << "Call DFS(parent_rule=" << rule_to_string(parent_rule)
-	// << ", parent_rule_dot=" << parent_rule_dot
-	// << ", token_location=" << token_location
-	// << ", path history size=" << path.size() << ")" << std::endl;
-
-	// finished if dot at right-most of parent_rule,
-	// and last child ends at parent_rule's end
-	if(parent_rule_dot == parent_rule.replacement.size()) {
-		return token_location == parent_item.end;
-	}
-
-	// for instance, get "Vegetable" from "Salad -> Vegetable + Dressing"
-	const GrammarSymbol next_rule_symbol =
-		parent_rule.replacement[parent_rule_dot];
-
-	// if next part of rule is a terminal, check if it matches the token
-	if(next_rule_symbol.terminal) {
-		// if no more tokens, bad parse
-		if(token_location >= input_tokens.size()) {
-			return false;
-		}
-
-		const bool match_result =
-			matches(next_rule_symbol, input_tokens[token_location]);
-
-		if(!match_result) {
-			return false;
-		}
-
-		// terminal symbol matches token, so continue recursing down rule
-		return dfs(earley_sets,
-				   grammar_rules,
-				   input_tokens,
-				   parent_item,
-				   1 + parent_rule_dot,
-				   1 + token_location,
-				   path);
-	}
-
-	// next part of rule is non-terminal:
-	// check all possible children where the rule's dot is located
-	// Ex: if next_symbol_rule is "Vegetable", find all rules starting with it,
-	// like "Vegetable -> Cabbage" and "Vegetable -> Lettuce". Try adding each
-	// to path and recurse to see if it offers a valid parse.
-
-	for(const FlippedEarleyItem possible_child : earley_sets[token_location]) {
-		const Rule possible_child_rule = grammar_rules[possible_child.rule];
-
-		if(possible_child_rule.production.value == next_rule_symbol.value &&
-		   possible_child_rule.production.terminal ==
-			   next_rule_symbol.terminal) {
-			path.emplace_back(possible_child, token_location);
-
-			const bool child_ret = dfs(earley_sets,
-									   grammar_rules,
-									   input_tokens,
-									   parent_item,
-									   1 + parent_rule_dot,
-									   possible_child.end,
-									   path);
-
-			if(child_ret) {
+		 std::vector<std::pair<FlippedEarleyItem, std::size_t> >& path,
+		 ParseMeter& meter) -> bool {
+	const Rule& parent_rule = grammar_rules[parent_item.rule];
+
+	// one step per symbol of parent_rule before the dot: where the symbol
+	// starts, and which candidate in earley_sets to try next for it
+	struct Step {
+		std::size_t token_location;
+		std::size_t candidate;
+	};
+
+	std::vector<Step> steps{Step{token_location, 0}};
+
+	while(!steps.empty()) {
+		// dot of parent_rule: the symbol that the top step matches
+		const std::size_t dot = steps.size() - 1;
+		Step& step = steps.back();
+
+		// finished if dot at right-most of parent_rule,
+		// and last child ends at parent_rule's end
+		if(dot == parent_rule.replacement.size()) {
+			if(step.token_location == parent_item.end) {
 				return true;
 			}
+		} else {
+			// for instance, get "Vegetable" from "Salad -> Vegetable + Dressing"
+			const GrammarSymbol& next_rule_symbol = parent_rule.replacement[dot];
+
+			// the last symbol must end where parent_item ends
+			const bool last_symbol = 1 + dot == parent_rule.replacement.size();
+
+			if(next_rule_symbol.terminal) {
+				// a terminal symbol has a single candidate: the next token
+				if(step.candidate == 0 &&
+				   step.token_location < input_tokens.size() &&
+				   matches(next_rule_symbol, input_tokens[step.token_location])) {
+					step.candidate = 1;
+					steps.push_back(Step{1 + step.token_location, 0});
+					continue;
+				}
+			} else {
+				// next part of rule is non-terminal: try the possible children
+				// where the rule's dot is located, one at a time. Ex: if
+				// next_symbol_rule is "Vegetable", try rules starting with it,
+				// like "Vegetable -> Cabbage" and "Vegetable -> Lettuce".
+
+				// children may also be rules of non-terminals that
+				// next_rule_symbol derives through skipped unit rules
+				const std::set<std::string>& descendants =
+					find_related_by_unit_chains(unit_chains.descendants,
+												next_rule_symbol.value);
+
+				const auto& possible_children = earley_sets[step.token_location];
+
+				// a child from a previous try is no longer on the path
+				if(step.candidate > 0) {
+					path.pop_back();
+					meter.count_backtrack();
+				}
 
-			path.pop_back();
+				while(step.candidate < possible_children.size()) {
+					const FlippedEarleyItem possible_child =
+						possible_children[step.candidate];
+					++step.candidate;
+					meter.count_search_step();
+
+					if(possible_child.end > parent_item.end ||
+					   (last_symbol && possible_child.end != parent_item.end) ||
+					   is_rejected_child(disambiguation,
+										 parent_item.rule,
+										 dot,
+										 possible_child.rule) ||
+					   is_restricted(disambiguation,
+									 possible_child.rule,
+									 possible_child.end < input_tokens.size()
+										 ? &input_tokens[possible_child.end]
+										 : nullptr)) {
+						continue;
+					}
+
+					const GrammarSymbol& production =
+						grammar_rules[possible_child.rule].production;
+					if(production.terminal == next_rule_symbol.terminal &&
+					   (production.value == next_rule_symbol.value ||
+						descendants.find(production.value) !=
+							descendants.end())) {
+						// add to path and see if it offers a valid parse
+						path.emplace_back(possible_child, step.token_location);
+						steps.push_back(Step{possible_child.end, 0});
+						break;
+					}
+				}
+
+				if(dot + 1 < steps.size()) {
+					continue;
+				}
+			}
 		}
+
+		// none of the parses from this step work: go back to the previous one
+		steps.pop_back();
 	}
 
-	// none of the parses here work
 	return false;
 }
 
 /**
  * Wrapper function for dfs.
- * @param earley_sets: created Earley state sets
+ * @param earley_sets: finished items by start, from flip_finished_items or
+ * SpilledEarleySets
  * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser
+ * @param disambiguation: parses the parser ruled out
  * @param input_tokens: list of tokens / words from the input being parsed
  * @param item: FlippedEarleyItem to find its path from start to finish, as dot
  *		advances from beginning of rule to end of rule
+ * @param meter: counts each child that is tried
  * @return list of item's path / children
  */
-auto find_rule_steps(
-	const std::vector<std::vector<FlippedEarleyItem> >& earley_sets,
-	const std::vector<Rule>& grammar_rules,
-	const std::vector<Token>& input_tokens,
-	FlippedEarleyItem item,
-	std::size_t item_start)
+template <typename FlippedEarleySets>
+auto find_rule_steps(const FlippedEarleySets& earley_sets,
+					 const std::vector<Rule>& grammar_rules,
+					 const UnitChains& unit_chains,
+					 const Disambiguation& disambiguation,
+					 const std::vector<Token>& input_tokens,
+					 FlippedEarleyItem item,
+					 std::size_t item_start,
+					 ParseMeter& meter)
 	-> std::vector<std::pair<FlippedEarleyItem, std::size_t> > {
 	std::vector<std::pair<FlippedEarleyItem, std::size_t> > children_path;
 	const bool search_result = dfs(earley_sets,
 								   grammar_rules,
+								   unit_chains,
+								   disambiguation,
 								   input_tokens,
 								   item,
-								   0,
 								   item_start,
-								   children_path);
+								   children_path,
+								   meter);
 
 	if(!search_result) {
 		LOG("CRITICAL") << "No partial parses for rule" << std::endl;
@@ -458,90 +1320,769 @@ auto find_rule_steps(
 }
 
 /**
- * Build the parse tree given the Earley state sets.
- * @param earley_sets: created Earley state sets
+ * Search the parse tree in the finished items of Earley state sets, copying
+ * the children of SubParses that are the same in the previous parse tree of
+ * state: see rebuild_earley_parse_tree.
+ * @param flipped_earley_sets: finished items by start, from
+ *		flip_finished_items or SpilledEarleySets
  * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser, or empty
+ * @param disambiguation: parses the parser ruled out, or empty
  * @param input_tokens: list of tokens / words from the input being parsed
- * @param default_start: the top symbol of the parse; which production
- *		rule in grammar_rules should start parsing the input
+ * @param default_start: the top symbol of the parse
+ * @param meter: counts each child that the search tries
+ * @param state: previous parse tree, where the children of each of its
+ *		SubParses begin, and its SubParses by start, or nullptr. Its
+ *		children_begin is replaced by the one of the new parse tree.
+ * @param first_changed_token: number of leading tokens that are the same in
+ *		the previous input and in input_tokens
  * @return list of SubParse, each with a range of tokens its rule covers, and
  *		an index of its parent SubParse
  */
-auto build_earley_parse_tree(
-	const std::vector<std::vector<EarleyItem> >& earley_sets,
-	const std::vector<Rule>& grammar_rules,
-	const std::vector<Token>& input_tokens,
-	const std::string& default_start) -> std::vector<SubParse> {
-	LOG("INFO") << "Constructing Parse Tree" << std::endl;
-
-	/*
-	LOG("DEBUG") << "Rules: " << std::endl;
-	std::size_t rule_index = 0;
-	for(Rule r : grammar_rules) {
-		LOG("DEBUG") << "Rule " << rule_index << " :" << std::endl;
+template <typename FlippedEarleySets>
+auto search_parse_tree(const FlippedEarleySets& flipped_earley_sets,
+					   const std::vector<Rule>& grammar_rules,
+					   const UnitChains& unit_chains,
+					   const Disambiguation& disambiguation,
+					   const std::vector<Token>& input_tokens,
+					   const std::string& default_start,
+					   ParseMeter& meter,
+					   IncrementalParseState* const state = nullptr,
+					   const std::size_t first_changed_token = 0)
+	-> std::vector<SubParse> {
+	// marks a SubParse that has no counterpart in the previous tree
+	const std::size_t no_previous = state != nullptr ? state->tree.size() : 0;
+
+	// children of a SubParse that ends here or earlier are the same as before
+	const std::size_t unchanged_end =
+		disambiguation.follow_restrictions.empty() || first_changed_token == 0
+			? first_changed_token
+			: first_changed_token - 1;
+
+	// the SubParse of the previous tree with the same rule and range, if it
+	// ends before the first changed token. Only the SubParses that start at
+	// the same token are looked at.
+	const auto find_previous = [state, no_previous, unchanged_end](
+								   const SubParse sub_parse) -> std::size_t {
+		if(state == nullptr || sub_parse.end > unchanged_end ||
+		   1 + sub_parse.start >= state->subtrees_begin.size()) {
+			return no_previous;
+		}
 
-		std::cout << r.production.value << " -> ";
-		for(GrammarSymbol s : r.replacement) {
-			std::cout << s.value << " ";
+		for(std::size_t i = state->subtrees_begin[sub_parse.start];
+			i < state->subtrees_begin[1 + sub_parse.start];
+			++i) {
+			const SubParse previous = state->tree[state->subtrees[i]];
+			if(previous.rule == sub_parse.rule &&
+			   previous.end == sub_parse.end) {
+				return state->subtrees[i];
+			}
 		}
-		std::cout << std::endl;
 
-		rule_index += 1;
-	}
-
-	LOG("DEBUG") << "Tokens = " << std::endl;
-	std::size_t token_index = 0;
-	for(Token t : input_tokens) {
-		LOG("DEBUG") << "\t" << "Token " << token_index << "(" << t.type << ", "
-	<< t.value << ")" << std::endl;
-		++token_index;
-	}
-	*/
+		return no_previous;
+	};
 
 	std::vector<SubParse> tree;
 
-	const std::vector<std::vector<EarleyItem> > filtered =
-		filter_out_partial_parses(earley_sets, grammar_rules);
-	const std::vector<std::vector<FlippedEarleyItem> > flipped_earley_sets =
-		flip_earley_sets(filtered);
+	// children of a SubParse are next to each other in the tree: for each
+	// SubParse in tree, where its children begin
+	std::vector<std::size_t> children_begin;
 
-	/*
-	LOG("DEBUG") << "flipped_earley_sets = " << std::endl;
-	for(std::size_t i = 0; i < flipped_earley_sets.size(); ++i) {
-		LOG("DEBUG") << "starts with " << i << std::endl;
-		for(FlippedEarleyItem item : flipped_earley_sets[i]) {
-			LOG("DEBUG") << item_to_string(item) << std::endl;
-		}
-	}
-	*/
+	// for each SubParse in tree, the same SubParse in the previous tree
+	std::vector<std::size_t> previous_locations;
 
 	// add top-level parse to tree
 	const FlippedEarleyItem top =
-		find_top_item(flipped_earley_sets, grammar_rules, default_start);
+		find_top_item(
+			flipped_earley_sets, grammar_rules, unit_chains, default_start);
 
 	// the top-level parse covers tokens in range [0, top.end). No parent.
 	tree.push_back(SubParse{top.rule, 0, top.end, 0});
+	previous_locations.push_back(no_previous);
 
 	// for each rule in tree, add its subrules into tree, to be processed later
 	for(std::size_t location = 0; location < tree.size(); ++location) {
 		const SubParse current_sub_parse = tree[location];
+		children_begin.push_back(tree.size());
+
+		std::size_t previous_location = previous_locations[location];
+		if(previous_location == no_previous) {
+			previous_location = find_previous(current_sub_parse);
+		}
+
+		// same sub-tree in previous parse: copy its children
+		if(previous_location != no_previous) {
+			for(std::size_t i = state->children_begin[previous_location];
+				i < state->children_begin[1 + previous_location];
+				++i) {
+				const SubParse child = state->tree[i];
+				tree.push_back(
+					SubParse{child.rule, child.start, child.end, location});
+				previous_locations.push_back(i);
+			}
+
+			continue;
+		}
+
 		const FlippedEarleyItem item = {
 			current_sub_parse.rule, current_sub_parse.end, 0};
 
 		const std::vector<std::pair<FlippedEarleyItem, std::size_t> > children =
 			find_rule_steps(flipped_earley_sets,
 							grammar_rules,
+							unit_chains,
+							disambiguation,
 							input_tokens,
 							item,
-							tree[location].start);
+							tree[location].start,
+							meter);
 
-		for(const std::pair<FlippedEarleyItem, std::size_t> child : children) {
+		for(const std::pair<FlippedEarleyItem, std::size_t>& child : children) {
 			tree.push_back(SubParse{
 				child.first.rule, child.second, child.first.end, location});
+			previous_locations.push_back(no_previous);
 		}
 	}
+	children_begin.push_back(tree.size());
+
+	if(state != nullptr) {
+		state->children_begin.swap(children_begin);
+	}
 
 	LOG("INFO") << "Generated Parse Tree" << std::endl;
 
 	return tree;
 }
+
+/**
+ * Build the parse tree given the Earley state sets.
+ *
+ * If the Earley state sets were built skipping unit rules, the parse tree
+ * skips the same unit rules: a SubParse may be the child of a parent whose
+ * rule expects a non-terminal that derives the SubParse's production through
+ * unit rules. See expand_unit_chains.
+ *
+ * @param earley_sets: created Earley state sets
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param input_tokens: list of tokens / words from the input being parsed
+ * @param default_start: the top symbol of the parse; which production
+ *		rule in grammar_rules should start parsing the input
+ * @param unit_chains: unit rules skipped by the parser, or none
+ * @param disambiguation: parses the parser ruled out, or none
+ * @param rule_ranks: for each rule, the order in which its SubParses are
+ *		tried as children, lowest first: see flip_finished_items. Or empty
+ * @param meter: counts each child that the search tries, and throws
+ *		ParseBudgetExceeded once they go over its budget, or nullptr for no
+ *		limit
+ * @return list of SubParse, each with a range of tokens its rule covers, and
+ *		an index of its parent SubParse
+ */
+auto build_earley_parse_tree(
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const std::vector<Token>& input_tokens,
+	const std::string& default_start,
+	const UnitChains& unit_chains,
+	const Disambiguation& disambiguation,
+	const std::vector<std::size_t>& rule_ranks,
+	ParseMeter* const meter) -> std::vector<SubParse> {
+	LOG("INFO") << "Constructing Parse Tree" << std::endl;
+
+	ParseMeter unlimited{ParseBudget{}};
+
+	const std::vector<std::vector<FlippedEarleyItem> > flipped_earley_sets =
+		flip_finished_items(earley_sets, grammar_rules, rule_ranks);
+
+	return search_parse_tree(flipped_earley_sets,
+							 grammar_rules,
+							 unit_chains,
+							 disambiguation,
+							 input_tokens,
+							 default_start,
+							 meter != nullptr ? *meter : unlimited);
+}
+
+/**
+ * Build the parse tree given the finished items of Earley state sets that were
+ * spilled to disk. The items are read through the page cache, so only the
+ * pages of the items that the search tries take up memory.
+ * @param spilled_sets: finished items of the Earley state sets, finished
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser, or empty
+ * @param disambiguation: parses the parser ruled out, or empty
+ * @param input_tokens: list of tokens / words from the input being parsed
+ * @param default_start: the top symbol of the parse
+ * @param meter: counts each child that the search tries, and throws
+ *		ParseBudgetExceeded once they go over its budget
+ * @return list of SubParse, each with a range of tokens its rule covers, and
+ *		an index of its parent SubParse
+ */
+auto build_earley_parse_tree(const SpilledEarleySets& spilled_sets,
+							 const std::vector<Rule>& grammar_rules,
+							 const UnitChains& unit_chains,
+							 const Disambiguation& disambiguation,
+							 const std::vector<Token>& input_tokens,
+							 const std::string& default_start,
+							 ParseMeter& meter) -> std::vector<SubParse> {
+	LOG("INFO") << "Constructing Parse Tree from " << spilled_sets.num_items()
+				<< " spilled items" << std::endl;
+
+	return search_parse_tree(spilled_sets,
+							 grammar_rules,
+							 unit_chains,
+							 disambiguation,
+							 input_tokens,
+							 default_start,
+							 meter);
+}
+
+/**
+ * Index the SubParses of the parse tree in state by the token they start at:
+ * see IncrementalParseState.
+ * @param state: holds the parse tree to index
+ * @param num_tokens: number of tokens the parse tree covers
+ */
+auto index_subtrees_by_start(IncrementalParseState& state,
+							 const std::size_t num_tokens) -> void {
+	// count the SubParses that start before each token, then place each
+	// SubParse after the ones that start before it
+	std::vector<std::size_t>& begin = state.subtrees_begin;
+	begin.assign(2 + num_tokens, 0);
+	for(const SubParse sub_parse : state.tree) {
+		++begin[1 + sub_parse.start];
+	}
+	for(std::size_t i = 1; i < begin.size(); ++i) {
+		begin[i] += begin[i - 1];
+	}
+
+	std::vector<std::size_t> next(begin.begin(), begin.end() - 1);
+	state.subtrees.resize(state.tree.size());
+	for(std::size_t i = 0; i < state.tree.size(); ++i) {
+		state.subtrees[next[state.tree[i].start]++] = i;
+	}
+}
+
+/**
+ * Build the parse tree given the finished items of Earley state sets, reusing
+ * sub-trees of the parse tree of a previous input.
+ *
+ * The children of a SubParse only depend on the Earley state sets and tokens
+ * up to the end of the SubParse, and with follow restrictions also on the
+ * token right after it. So if a SubParse ends before the first changed token,
+ * and the previous parse tree has a SubParse with the same rule and range, its
+ * children are copied over instead of searched for.
+ *
+ * The previous SubParse is found among the ones that start at the same token,
+ * through the index that the previous call left in state. The new tree lists
+ * SubParses breadth-first like any other, so a change near the end of the
+ * input moves every SubParse after it in the list: the index is built again,
+ * in one pass over the new tree.
+ *
+ * @param state: finished items of input_tokens from reparse_earley_items, and
+ *		the parse tree of the previous input, or no tree. Its tree is replaced
+ *		by the one of input_tokens.
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules skipped by the parser, or empty
+ * @param disambiguation: parses the parser ruled out, or empty
+ * @param input_tokens: list of tokens / words from the input being parsed
+ * @param default_start: the top symbol of the parse; which production
+ *		rule in grammar_rules should start parsing the input
+ * @param first_changed_token: number of leading tokens that are the same in
+ *		the previous input and in input_tokens
+ * @param meter: counts each child that the search tries, and throws
+ *		ParseBudgetExceeded once they go over its budget, or nullptr for no
+ *		limit
+ */
+auto rebuild_earley_parse_tree(IncrementalParseState& state,
+							   const std::vector<Rule>& grammar_rules,
+							   const UnitChains& unit_chains,
+							   const Disambiguation& disambiguation,
+							   const std::vector<Token>& input_tokens,
+							   const std::string& default_start,
+							   const std::size_t first_changed_token,
+							   ParseMeter* const meter) -> void {
+	LOG("INFO") << "Constructing Parse Tree" << std::endl;
+
+	ParseMeter unlimited{ParseBudget{}};
+
+	std::vector<SubParse> tree =
+		search_parse_tree(state.flipped_earley_sets,
+						  grammar_rules,
+						  unit_chains,
+						  disambiguation,
+						  input_tokens,
+						  default_start,
+						  meter != nullptr ? *meter : unlimited,
+						  &state,
+						  first_changed_token);
+	state.tree.swap(tree);
+
+	index_subtrees_by_start(state, input_tokens.size());
+}
+
+/**
+ * Derive the parse tree depth-first and report it as events, without storing
+ * it.
+ *
+ * Each SubParse from the root down to the current one is a frame on a stack,
+ * with its children and how far the walk got through its rule. A SubParse of
+ * a skipped unit rule is a rule of the chain above an item of the Earley
+ * sets: its only child is the next rule of the chain, or the item itself at
+ * the end of the chain. A SubParse of a spliced rule gets no events, so its
+ * children show up as children of its parent.
+ *
+ * @param flipped_earley_sets: finished items from flip_finished_items
+ * @param grammar_rules: global set of grammar rules that is being used
+ * @param unit_chains: unit rules the parser skipped, or empty
+ * @param disambiguation: parses the parser ruled out, or empty
+ * @param input_tokens: list of tokens / words from the input being parsed
+ * @param default_start: the top symbol of the parse
+ * @param visibility: rules to report instead of grammar_rules, or empty
+ * @param events: callbacks for each SubParse and token, in document order
+ * @param meter: counts each child that the search tries, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto walk_earley_parse_tree(
+	const std::vector<std::vector<FlippedEarleyItem> >& flipped_earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const UnitChains& unit_chains,
+	const Disambiguation& disambiguation,
+	const std::vector<Token>& input_tokens,
+	const std::string& default_start,
+	const RuleVisibility& visibility,
+	const ParseEvents& events,
+	ParseMeter* const meter) -> void {
+	LOG("INFO") << "Walking Parse Tree" << std::endl;
+
+	ParseMeter unlimited{ParseBudget{}};
+	ParseMeter& counted = meter != nullptr ? *meter : unlimited;
+
+	using Children = std::vector<std::pair<FlippedEarleyItem, std::size_t> >;
+
+	// chain of skipped rules from expected down to the production of rule
+	const std::vector<std::size_t> no_chain;
+	const auto chain_to = [&](const std::string& expected,
+							  const std::size_t rule)
+		-> const std::vector<std::size_t>& {
+		const std::string& production = grammar_rules[rule].production.value;
+		if(expected == production) {
+			return no_chain;
+		}
+
+		const auto found =
+			unit_chains.chains.find(std::make_pair(expected, production));
+		if(found == unit_chains.chains.end()) {
+			throw std::invalid_argument("No chain of unit rules from <" +
+										expected + "> to <" + production +
+										">");
+		}
+
+		return found->second;
+	};
+
+	// a SubParse: the item of the Earley sets it comes from, and which rule of
+	// the chain above the item it is
+	struct Node {
+		FlippedEarleyItem item;
+		std::size_t start;
+		const std::vector<std::size_t>* chain;
+		std::size_t next;
+	};
+
+	const auto rule_of = [](const Node& node) {
+		return node.next < node.chain->size() ? (*node.chain)[node.next]
+											  : node.item.rule;
+	};
+
+	// children of the item, for a node at the end of its chain
+	const auto find_children = [&](const Node& node) {
+		if(node.next < node.chain->size()) {
+			return Children{};
+		}
+
+		return find_rule_steps(flipped_earley_sets,
+							   grammar_rules,
+							   unit_chains,
+							   disambiguation,
+							   input_tokens,
+							   node.item,
+							   node.start,
+							   counted);
+	};
+
+	// node of the child-th non-terminal symbol of the rule of node
+	const auto child_of = [&](const Node& node,
+							  const Children& children,
+							  const std::size_t child,
+							  const GrammarSymbol& symbol) {
+		if(node.next < node.chain->size()) {
+			return Node{node.item, node.start, node.chain, 1 + node.next};
+		}
+
+		const FlippedEarleyItem item = children[child].first;
+		return Node{
+			item, children[child].second, &chain_to(symbol.value, item.rule), 0};
+	};
+
+	// rule to report for a node, looking down its last children if needed.
+	// below[i] holds the children of the node i + 1 levels down the last-child
+	// chain: the ones found already are used, and the ones it finds are added,
+	// so that the last child does not search for them again
+	const auto reported_rule = [&](const Node& node,
+								   const Children& children,
+								   std::deque<Children>& below) {
+		Node current = node;
+		const Children* current_children = &children;
+		for(std::size_t depth = 0;; ++depth) {
+			const std::size_t rule = rule_of(current);
+			if(rule >= visibility.reported_rules.size()) {
+				return rule;
+			}
+			if(visibility.reported_rules[rule] !=
+			   RuleVisibility::same_as_last_child) {
+				return visibility.reported_rules[rule];
+			}
+
+			const GrammarSymbol& last_symbol =
+				grammar_rules[rule].replacement.back();
+			current = child_of(current,
+							   *current_children,
+							   current_children->size() - 1,
+							   last_symbol);
+			if(depth == below.size()) {
+				below.push_back(find_children(current));
+			}
+			current_children = &below[depth];
+		}
+	};
+
+	struct Frame {
+		Node node;
+		Children children;
+		std::size_t reported_rule;
+		bool spliced;
+		std::size_t symbol;			 // next symbol of the rule to walk
+		std::size_t child;			 // next of children to walk
+		std::size_t token_location;	 // start of the next symbol
+		// children down the chain of last children, found by reported_rule
+		std::deque<Children> below;
+	};
+
+	std::vector<Frame> frames;
+
+	// below: children down the chain of last children of node, if the frame of
+	// its parent found them already
+	const auto enter = [&](const Node& node, std::deque<Children> below) {
+		Frame frame{node, {}, 0, false, 0, 0, node.start, {}};
+		if(below.empty()) {
+			frame.children = find_children(node);
+		} else {
+			frame.children = std::move(below.front());
+			below.pop_front();
+		}
+
+		const std::size_t rule = rule_of(node);
+		frame.spliced =
+			rule < visibility.spliced.size() && visibility.spliced[rule];
+		if(!frame.spliced) {
+			frame.reported_rule =
+				reported_rule(node, frame.children, below);
+			if(events.enter_rule) {
+				events.enter_rule(
+					frame.reported_rule, node.start, node.item.end);
+			}
+		}
+		frame.below = std::move(below);
+
+		frames.push_back(std::move(frame));
+	};
+
+	const FlippedEarleyItem top = find_top_item(
+		flipped_earley_sets, grammar_rules, unit_chains, default_start);
+	enter(Node{top, 0, &chain_to(default_start, top.rule), 0}, {});
+
+	while(!frames.empty()) {
+		Frame& frame = frames.back();
+		const Rule& rule = grammar_rules[rule_of(frame.node)];
+
+		if(frame.symbol == rule.replacement.size()) {
+			if(!frame.spliced && events.exit_rule) {
+				events.exit_rule(
+					frame.reported_rule, frame.node.start, frame.node.item.end);
+			}
+
+			frames.pop_back();
+			continue;
+		}
+
+		const GrammarSymbol& symbol = rule.replacement[frame.symbol];
+		++frame.symbol;
+
+		if(symbol.terminal) {
+			if(events.visit_token) {
+				events.visit_token(input_tokens[frame.token_location],
+								   frame.token_location);
+			}
+
+			++frame.token_location;
+			continue;
+		}
+
+		const Node child =
+			child_of(frame.node, frame.children, frame.child, symbol);
+		++frame.child;
+		frame.token_location = child.item.end;
+
+		// only the last child is on the chain that reported_rule looked down
+		std::deque<Children> below;
+		if(frame.symbol == rule.replacement.size()) {
+			below = std::move(frame.below);
+		}
+
+		// frame is no longer valid once the child is pushed
+		enter(child, std::move(below));
+	}
+
+	LOG("INFO") << "Walked Parse Tree" << std::endl;
+}
+
+/**
+ * Find the unit rules of a grammar, and the chains they form.
+ *
+ * A unit rule has a single non-terminal as replacement, like
+ * <expression> ::= <assignment-expression>. In a grammar of expressions with
+ * one non-terminal per level of precedence, a single integer literal goes
+ * through a unit rule for every level. Skipping them saves the parser an
+ * Earley item per level, and the parse tree a SubParse per level: a
+ * non-terminal directly matches the rules of the non-terminals it derives
+ * through unit rules.
+ *
+ * Unit rules to kept_symbols are not skipped. A list like
+ * <statements> ::= <statement>+ has a helper non-terminal as its single
+ * symbol, and must keep its SubParse to hold the elements of the list.
+ *
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param kept_symbols: non-terminals whose unit rules are not skipped
+ * @return unit rules and chains of unit rules
+ */
+auto find_unit_chains(const std::vector<Rule>& grammar_rules,
+					  const std::set<std::string>& kept_symbols) -> UnitChains {
+	UnitChains unit_chains;
+	unit_chains.skipped.resize(grammar_rules.size(), false);
+
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		const Rule& rule = grammar_rules[i];
+		unit_chains.skipped[i] =
+			rule.replacement.size() == 1 && !rule.replacement[0].terminal &&
+			rule.replacement[0].value != rule.production.value &&
+			kept_symbols.find(rule.replacement[0].value) == kept_symbols.end();
+	}
+
+	// breadth-first search from each non-terminal through unit rules, so that
+	// the first chain found to each descendant is a shortest one
+	std::set<std::string> nonterminals;
+	for(const Rule& rule : grammar_rules) {
+		nonterminals.insert(rule.production.value);
+	}
+
+	for(const std::string& ancestor : nonterminals) {
+		std::vector<std::string> frontier{ancestor};
+		for(std::size_t k = 0; k < frontier.size(); ++k) {
+			const std::string current = frontier[k];
+			const std::vector<std::size_t> chain =
+				current == ancestor
+					? std::vector<std::size_t>{}
+					: unit_chains.chains[std::make_pair(ancestor, current)];
+
+			for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+				const Rule& rule = grammar_rules[i];
+				if(!unit_chains.skipped[i] ||
+				   rule.production.value != current) {
+					continue;
+				}
+
+				const std::string& descendant = rule.replacement[0].value;
+				if(descendant == ancestor ||
+				   !unit_chains.descendants[ancestor].insert(descendant).second) {
+					continue;
+				}
+
+				unit_chains.ancestors[descendant].insert(ancestor);
+
+				std::vector<std::size_t> longer_chain = chain;
+				longer_chain.push_back(i);
+				unit_chains.chains[std::make_pair(ancestor, descendant)] =
+					longer_chain;
+				frontier.push_back(descendant);
+			}
+		}
+	}
+
+	return unit_chains;
+}
+
+/**
+ * Put the SubParses of skipped unit rules back into a parse tree.
+ *
+ * A child in the parse tree stands for a non-terminal of its parent's rule:
+ * the k-th child for the k-th non-terminal of the replacement. When the
+ * child's production is a different non-terminal, the chain of unit rules
+ * between the two is inserted between parent and child, each covering the
+ * same tokens as the child. The result keeps the layout of a parse tree:
+ * breadth-first, with the children of a SubParse next to each other.
+ *
+ * @param tree: parse tree built with unit_chains
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules that were skipped
+ * @param default_start: the top-level symbol that describes the entire
+ * input program
+ * @return parse tree with a SubParse for every rule applied
+ */
+auto expand_unit_chains(const std::vector<SubParse>& tree,
+						const std::vector<Rule>& grammar_rules,
+						const UnitChains& unit_chains,
+						const std::string& default_start)
+	-> std::vector<SubParse> {
+	if(tree.empty()) {
+		return tree;
+	}
+
+	// children of a SubParse are next to each other in the tree
+	std::vector<std::size_t> children_begin(tree.size(), 0);
+	std::vector<std::size_t> children_end(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		const std::size_t parent = tree[i].parent;
+		if(children_begin[parent] == children_end[parent]) {
+			children_begin[parent] = i;
+		}
+		children_end[parent] = 1 + i;
+	}
+
+	// chain of skipped rules from expected down to the production of rule
+	const auto chain_to = [&](const std::string& expected,
+							  const std::size_t rule) {
+		const std::string& production = grammar_rules[rule].production.value;
+		if(expected == production) {
+			return std::vector<std::size_t>{};
+		}
+
+		const auto found =
+			unit_chains.chains.find(std::make_pair(expected, production));
+		if(found == unit_chains.chains.end()) {
+			throw std::invalid_argument("No chain of unit rules from <" +
+										expected + "> to <" + production +
+										">");
+		}
+
+		return found->second;
+	};
+
+	// each SubParse of the expanded tree is either a SubParse of tree, or a
+	// unit rule of the chain above one: which SubParse of tree, and how far
+	// down its chain
+	struct Origin {
+		std::size_t location;
+		std::vector<std::size_t> chain;
+		std::size_t next;
+	};
+
+	std::vector<SubParse> expanded;
+	std::vector<Origin> origins;
+
+	// add the first rule of a chain above a SubParse of tree, or the SubParse
+	// itself if the chain is empty
+	const auto add = [&](const std::size_t location,
+						 const std::vector<std::size_t>& chain,
+						 const std::size_t next,
+						 const std::size_t parent) {
+		const SubParse sub_parse = tree[location];
+		const std::size_t rule =
+			next < chain.size() ? chain[next] : sub_parse.rule;
+		expanded.push_back(
+			SubParse{rule, sub_parse.start, sub_parse.end, parent});
+		origins.push_back(Origin{location, chain, next});
+	};
+
+	add(0, chain_to(default_start, tree[0].rule), 0, 0);
+
+	for(std::size_t location = 0; location < expanded.size(); ++location) {
+		const Origin origin = origins[location];
+
+		// middle of a chain: its only child is the next rule of the chain
+		if(origin.next < origin.chain.size()) {
+			add(origin.location, origin.chain, 1 + origin.next, location);
+			continue;
+		}
+
+		// the k-th child stands for the k-th non-terminal of the rule
+		const Rule& rule = grammar_rules[tree[origin.location].rule];
+		std::size_t child = children_begin[origin.location];
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(symbol.terminal ||
+			   child == children_end[origin.location]) {
+				continue;
+			}
+
+			add(child, chain_to(symbol.value, tree[child].rule), 0, location);
+			++child;
+		}
+	}
+
+	return expanded;
+}
+
+/**
+ * Leave out the SubParses of skipped unit rules from a parse tree. A skipped
+ * rule has a single child, which takes its place under its parent.
+ * @param tree: parse tree with a SubParse for every rule applied
+ * @param unit_chains: unit rules to leave out
+ * @return parse tree as if built with unit_chains
+ */
+auto collapse_unit_chains(const std::vector<SubParse>& tree,
+						  const UnitChains& unit_chains)
+	-> std::vector<SubParse> {
+	if(tree.empty()) {
+		return tree;
+	}
+
+	std::vector<std::size_t> children_begin(tree.size(), 0);
+	std::vector<std::size_t> children_end(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		const std::size_t parent = tree[i].parent;
+		if(children_begin[parent] == children_end[parent]) {
+			children_begin[parent] = i;
+		}
+		children_end[parent] = 1 + i;
+	}
+
+	// first SubParse down a chain of skipped rules that is not skipped
+	const auto skip_chain = [&](std::size_t location) {
+		while(is_skipped(unit_chains, tree[location].rule) &&
+			  children_begin[location] < children_end[location]) {
+			location = children_begin[location];
+		}
+
+		return location;
+	};
+
+	const std::size_t root = skip_chain(0);
+	std::vector<SubParse> collapsed{
+		SubParse{tree[root].rule, tree[root].start, tree[root].end, 0}};
+
+	// for each SubParse of collapsed, the same SubParse in tree
+	std::vector<std::size_t> locations{root};
+
+	for(std::size_t location = 0; location < collapsed.size(); ++location) {
+		const std::size_t original = locations[location];
+		for(std::size_t child = children_begin[original];
+			child < children_end[original];
+			++child) {
+			const std::size_t kept = skip_chain(child);
+			collapsed.push_back(SubParse{
+				tree[kept].rule, tree[kept].start, tree[kept].end, location});
+			locations.push_back(kept);
+		}
+	}
+
+	return collapsed;
+}
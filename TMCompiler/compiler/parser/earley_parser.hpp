@@ -5,13 +5,20 @@
 #ifndef EARLEY_PARSER_HPP
 #define EARLEY_PARSER_HPP
 
-#include <cstddef>	// std::size_t
-#include <string>	// std::string
-#include <vector>	// std::vector
+#include <cstddef>	   // std::size_t
+#include <functional>  // std::function
+#include <map>		   // std::map
+#include <set>		   // std::set
+#include <string>	   // std::string
+#include <utility>	   // std::pair
+#include <vector>	   // std::vector
 
 #include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
 #include <TMCompiler/compiler/models/rule.hpp>			  // Rule
 #include <TMCompiler/compiler/models/token.hpp>			  // Token
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseMeter, ParseStatistics
+
+class SpilledEarleySets;
 
 struct EarleyItem {
 	std::size_t rule;	// index of rule in list of rules in Grammar
@@ -32,6 +39,187 @@ struct SubParse {
 	std::size_t parent;
 };
 
+// everything kept from one parse so that parsing a slightly edited input can
+// reuse it: see Grammar::reparse
+struct IncrementalParseState {
+	std::vector<Token> tokens;
+	std::vector<std::vector<EarleyItem> > earley_sets;
+
+	// finished items of earley_sets by start, sorted by rule_ranks: see
+	// flip_finished_items
+	std::vector<std::vector<FlippedEarleyItem> > flipped_earley_sets;
+	std::vector<std::size_t> rule_ranks;
+
+	std::vector<SubParse> tree;
+
+	// the children of tree[i] are tree[children_begin[i]] up to
+	// tree[children_begin[1 + i]]
+	std::vector<std::size_t> children_begin;
+
+	// the SubParses of tree that start at token i are tree[subtrees[j]] for j
+	// from subtrees_begin[i] up to subtrees_begin[1 + i]
+	std::vector<std::size_t> subtrees_begin;
+	std::vector<std::size_t> subtrees;
+
+	// work of the last parse
+	ParseStatistics statistics;
+};
+
+// chains of unit rules, like <expression> ::= <assignment-expression>, that
+// the parser skips: a non-terminal X matches any rule of a non-terminal Y that
+// X derives through unit rules only. See find_unit_chains
+struct UnitChains {
+	// skipped[i] is true iff rule i is a unit rule that is never predicted
+	std::vector<bool> skipped;
+
+	// for each non-terminal X, the non-terminals Y != X with X =>+ Y through
+	// skipped rules
+	std::map<std::string, std::set<std::string> > descendants;
+
+	// for each non-terminal Y, the non-terminals X != Y with X =>+ Y through
+	// skipped rules
+	std::map<std::string, std::set<std::string> > ancestors;
+
+	// for each such pair (X, Y), the shortest chain of skipped rules from X
+	// down to Y
+	std::map<std::pair<std::string, std::string>, std::vector<std::size_t> >
+		chains;
+};
+
+// parses that the parser rules out while it recognizes, so that an ambiguous
+// grammar has a single parse. Rules are indices into the grammar rules; empty
+// vectors rule out nothing. See make_disambiguation
+struct Disambiguation {
+	// rejected_children[p][k] holds the rules whose SubParse may not be the
+	// child for the k-th symbol of rule p
+	std::vector<std::vector<std::set<std::size_t> > > rejected_children;
+
+	// follow_restrictions[r] holds the tokens, by type or value, that may not
+	// come right after a SubParse of rule r
+	std::vector<std::set<std::string> > follow_restrictions;
+};
+
+// another parser that finds the parses of some rules, which the Earley parser
+// then does not predict. See PrecedenceParser
+struct EmbeddedParser {
+	// embedded[i] is true iff the Earley parser never predicts rule i
+	std::vector<bool> embedded;
+
+	// called with a non-terminal that the Earley parser predicts, and the
+	// index of the state set it predicts it in. Returns finished items for the
+	// embedded rules, each with the index of the state set it belongs in,
+	// after the given one.
+	std::function<std::vector<std::pair<std::size_t, EarleyItem> >(
+		const std::string&, std::size_t)>
+		parse;
+};
+
+// skips no rules: for parsing with every rule of the grammar
+extern const UnitChains no_unit_chains;
+
+// rules out no parses: for parsing an unambiguous grammar
+extern const Disambiguation no_disambiguation;
+
+// embeds no other parser: the Earley parser predicts every rule
+extern const EmbeddedParser no_embedded_parser;
+
+// callbacks for walk_earley_parse_tree, called in document order. Any of them
+// may be left empty.
+struct ParseEvents {
+	// (rule, start, end) of a SubParse, before anything inside it
+	std::function<void(std::size_t, std::size_t, std::size_t)> enter_rule;
+
+	// a token and its index in the input tokens
+	std::function<void(const Token&, std::size_t)> visit_token;
+
+	// (rule, start, end) of a SubParse, after everything inside it
+	std::function<void(std::size_t, std::size_t, std::size_t)> exit_rule;
+};
+
+// how the rules of the parser show up in walk_earley_parse_tree. Empty
+// vectors report every rule as itself.
+struct RuleVisibility {
+	// reported rule of a SubParse that takes its rule from its last child
+	static constexpr std::size_t same_as_last_child =
+		static_cast<std::size_t>(-1);
+
+	// for each rule, the rule index reported to ParseEvents
+	std::vector<std::size_t> reported_rules;
+
+	// spliced[i] is true iff a SubParse of rule i is left out, and its
+	// children take its place under its parent
+	std::vector<bool> spliced;
+};
+
+// human-readable form of a rule, like Rule[statement -> expression ;]
+auto rule_to_string(const Rule& rule) -> std::string;
+
+/**
+ * Earley recognizer that is fed one input token at a time, for instance
+ * straight from the lexer. Each token is processed as soon as it arrives, so
+ * a syntax error is found at the first token that no rule can continue with,
+ * without reading the rest of the input.
+ *
+ * EarleyRecognizer recognizer{grammar_rules, "compilation-unit"};
+ * for(const Token& token : tokens) {
+ *		if(!recognizer.push(token)) {
+ *			// syntax error at token
+ *		}
+ * }
+ * bool valid = recognizer.is_accepted();
+ *
+ * A recognizer that only checks syntax can call keep_needed_sets_only(), so
+ * that its memory grows with the nesting of the input instead of its length.
+ *
+ * restart() readies the recognizer for another input. Its state sets keep
+ * their memory, so recognizing inputs no larger than earlier ones does not
+ * allocate.
+ */
+class EarleyRecognizer {
+public:
+	EarleyRecognizer(const std::vector<Rule>& _grammar_rules,
+					 std::string _default_start,
+					 const UnitChains& _unit_chains = no_unit_chains,
+					 const Disambiguation& _disambiguation = no_disambiguation,
+					 const ParseBudget& budget = ParseBudget{});
+	auto push(const Token& token) -> bool;
+	[[nodiscard]] auto is_accepted() const -> bool;
+	[[nodiscard]] auto num_tokens() const -> std::size_t;
+	[[nodiscard]] auto get_earley_sets() const
+		-> const std::vector<std::vector<EarleyItem> >&;
+	auto restart() -> void;
+	auto keep_needed_sets_only() -> void;
+	auto spill_finished_items(SpilledEarleySets& spilled) -> void;
+	[[nodiscard]] auto get_statistics() const -> ParseStatistics;
+
+private:
+	const std::vector<Rule>& grammar_rules;
+	const UnitChains& unit_chains;
+	const Disambiguation& disambiguation;
+	std::string default_start;
+	// state_set[i] refers to the valid possible parses, before reading token[i]
+	std::vector<std::vector<EarleyItem> > earley_sets;
+	// emptied state sets of a previous input, to be reused by later tokens,
+	// the next one last
+	std::vector<std::vector<EarleyItem> > spare_sets;
+	// number of items of the last state set before it was closed
+	std::size_t open_items;
+	// true iff state sets that later tokens cannot need are cleared
+	bool needed_sets_only;
+	// state sets before checked_sets that were needed when last checked
+	std::vector<std::size_t> kept_sets;
+	// number of state sets that were checked for being needed
+	std::size_t checked_sets;
+	// counts the work of the recognizer, and stops it once it goes over its
+	// budget
+	ParseMeter meter;
+	// where the finished items of each state set are written once it is
+	// final, or nullptr
+	SpilledEarleySets* spilled_sets;
+
+	auto clear_unneeded_sets() -> void;
+};
+
 /**
  * Build up the entire Earley state sets from a given input and set of
  * grammar rules. From it, backtrack from the end to find the parse of
@@ -40,16 +228,92 @@ struct SubParse {
  * @param inputs: the "words" of the program / input
  * @param default_start: the top symbol of the parse; which production
  * rule in grammar_rules should start parsing the input
+ * @param unit_chains: unit rules to skip, or none
+ * @param disambiguation: parses to rule out, or none
+ * @param embedded_parser: parser for rules that are not predicted, or none
  * @return list of Earley state sets, of size inputs.size() + 1.
  * state_set[i] refers to the valid possible parses, before reading
  * token[i]. The last state set that has a finished rule and starts from
  * the beginning, is a valid grammar parse of the input tokens.
  */
-auto build_earley_items(const std::vector<Rule>& grammar_rules,
-						const std::vector<Token>& inputs,
-						const std::string& default_start)
+auto build_earley_items(
+	const std::vector<Rule>& grammar_rules,
+	const std::vector<Token>& inputs,
+	const std::string& default_start,
+	const UnitChains& unit_chains = no_unit_chains,
+	const Disambiguation& disambiguation = no_disambiguation,
+	const EmbeddedParser& embedded_parser = no_embedded_parser)
 	-> std::vector<std::vector<EarleyItem> >;
 
+/**
+ * Check whether Earley state sets hold a parse of the whole input.
+ * @param earley_sets: Earley state sets generated by build_earley_items
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules the parser skipped, or empty
+ * @param default_start: the top symbol of the parse
+ * @return true iff the last state set has a finished item of default_start
+ * that starts at the first token
+ */
+auto is_accepted(const std::vector<std::vector<EarleyItem> >& earley_sets,
+				 const std::vector<Rule>& grammar_rules,
+				 const UnitChains& unit_chains,
+				 const std::string& default_start) -> bool;
+
+/**
+ * Bring Earley state sets of a previous input up to date with a new input.
+ * The state sets before the first changed token are kept; the rest are
+ * rebuilt.
+ * @param earley_sets: Earley state sets of the previous input, or empty to
+ * build from scratch. Updated to be the state sets of inputs.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param inputs: the "words" of the program / input
+ * @param default_start: the top symbol of the parse
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in inputs
+ * @param embedded_parser: parser for rules that are not predicted, or none
+ * @param meter: counts each state set that is built, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto rebuild_earley_items(
+	std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const UnitChains& unit_chains,
+	const Disambiguation& disambiguation,
+	const std::vector<Token>& inputs,
+	const std::string& default_start,
+	std::size_t first_changed_token,
+	const EmbeddedParser& embedded_parser = no_embedded_parser,
+	ParseMeter* meter = nullptr) -> void;
+
+/**
+ * Bring the Earley state sets of state, and their finished items by start, up
+ * to date with a new input. Only the finished items of the rebuilt state sets
+ * are flipped again.
+ * @param state: Earley state sets and finished items of the previous input,
+ * or an empty state
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param inputs: the "words" of the program / input
+ * @param default_start: the top symbol of the parse
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in inputs
+ * @param rule_ranks: rank of each rule, or empty: see flip_finished_items
+ * @param meter: counts each state set that is built, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto reparse_earley_items(IncrementalParseState& state,
+						  const std::vector<Rule>& grammar_rules,
+						  const UnitChains& unit_chains,
+						  const Disambiguation& disambiguation,
+						  const std::vector<Token>& inputs,
+						  const std::string& default_start,
+						  std::size_t first_changed_token,
+						  const std::vector<std::size_t>& rule_ranks = {},
+						  ParseMeter* meter = nullptr) -> void;
+
 /**
  * Build up parse tree from input_tokens, given partial parses from Earley
  * state sets.
@@ -59,6 +323,12 @@ auto build_earley_items(const std::vector<Rule>& grammar_rules,
  * @param input_tokens: words from the input program
  * @param default_start: the top-level symbol that describes the entire
  * input program
+ * @param unit_chains: unit rules the parser skipped, or none
+ * @param disambiguation: parses the parser ruled out, or none
+ * @param rule_ranks: order in which SubParses of each rule are tried as
+ * children, lowest first, or empty: see flip_finished_items
+ * @param meter: counts each child that the search tries, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
  * @return list of SubParse, each with a range of tokens its rule covers, and
  *		an index of its parent SubParse
  */
@@ -66,6 +336,149 @@ auto build_earley_parse_tree(
 	const std::vector<std::vector<EarleyItem> >& earley_sets,
 	const std::vector<Rule>& grammar_rules,
 	const std::vector<Token>& input_tokens,
-	const std::string& default_start) -> std::vector<SubParse>;
+	const std::string& default_start,
+	const UnitChains& unit_chains = no_unit_chains,
+	const Disambiguation& disambiguation = no_disambiguation,
+	const std::vector<std::size_t>& rule_ranks = {},
+	ParseMeter* meter = nullptr) -> std::vector<SubParse>;
+
+/**
+ * Build up parse tree from input_tokens, given the finished items of Earley
+ * state sets that were spilled to disk.
+ * @param spilled_sets: finished items of the Earley state sets
+ * @param grammar_rules: list of input to replacement symbols from a
+ * context-free grammar
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param input_tokens: words from the input program
+ * @param default_start: the top-level symbol that describes the entire
+ * input program
+ * @param meter: counts each child that the search tries, and throws
+ * ParseBudgetExceeded once they go over its budget
+ * @return list of SubParse, each with a range of tokens its rule covers, and
+ *		an index of its parent SubParse
+ */
+auto build_earley_parse_tree(const SpilledEarleySets& spilled_sets,
+							 const std::vector<Rule>& grammar_rules,
+							 const UnitChains& unit_chains,
+							 const Disambiguation& disambiguation,
+							 const std::vector<Token>& input_tokens,
+							 const std::string& default_start,
+							 ParseMeter& meter) -> std::vector<SubParse>;
+
+/**
+ * Build up the parse tree of input_tokens in state, given the finished items
+ * that reparse_earley_items left in state. Sub-trees of the previous tree in
+ * state that end before the first changed token are copied instead of
+ * searched for again.
+ * @param state: finished items of input_tokens, and the parse tree of the
+ * previous input, or no tree. Its tree is replaced by the one of input_tokens.
+ * @param grammar_rules: list of input to replacement symbols from a
+ * context-free grammar
+ * @param unit_chains: unit rules to skip, or empty
+ * @param disambiguation: parses to rule out, or empty
+ * @param input_tokens: words from the input program
+ * @param default_start: the top-level symbol that describes the entire
+ * input program
+ * @param first_changed_token: number of leading tokens that are the same in
+ * the previous input and in input_tokens
+ * @param meter: counts each child that the search tries, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto rebuild_earley_parse_tree(IncrementalParseState& state,
+							   const std::vector<Rule>& grammar_rules,
+							   const UnitChains& unit_chains,
+							   const Disambiguation& disambiguation,
+							   const std::vector<Token>& input_tokens,
+							   const std::string& default_start,
+							   std::size_t first_changed_token,
+							   ParseMeter* meter = nullptr) -> void;
+
+/**
+ * Flip the finished items of Earley state sets: flipped[i] holds the items
+ * that start at token i, and each records where it ends. This is the form
+ * that parse trees are searched in, trying the items of each token in order:
+ * rule_ranks puts the items of low-ranked rules first.
+ * @param earley_sets: Earley State sets generated by build_earley_items
+ * @param grammar_rules: list of input to replacement symbols from a
+ * context-free grammar
+ * @param rule_ranks: rank of each rule, or empty to keep the order of the
+ * Earley sets
+ * @return finished items, indexed by their start
+ */
+auto flip_finished_items(
+	const std::vector<std::vector<EarleyItem> >& earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const std::vector<std::size_t>& rule_ranks = {})
+	-> std::vector<std::vector<FlippedEarleyItem> >;
+
+/**
+ * Derive the parse tree depth-first and report it as events, without storing
+ * it: only the SubParses from the root down to the current one are kept, next
+ * to flipped_earley_sets, which hold the finished items of the whole input.
+ * Skipped unit rules are put back, then SubParses of spliced rules are left
+ * out.
+ * @param flipped_earley_sets: finished items from flip_finished_items
+ * @param grammar_rules: list of input to replacement symbols from a
+ * context-free grammar
+ * @param unit_chains: unit rules the parser skipped, or empty
+ * @param disambiguation: parses the parser ruled out, or empty
+ * @param input_tokens: words from the input program
+ * @param default_start: the top-level symbol that describes the entire
+ * input program
+ * @param visibility: rules to report instead of grammar_rules, or empty
+ * @param events: callbacks for each SubParse and token, in document order
+ * @param meter: counts each child that the search tries, and throws
+ * ParseBudgetExceeded once they go over its budget, or nullptr for no limit
+ */
+auto walk_earley_parse_tree(
+	const std::vector<std::vector<FlippedEarleyItem> >& flipped_earley_sets,
+	const std::vector<Rule>& grammar_rules,
+	const UnitChains& unit_chains,
+	const Disambiguation& disambiguation,
+	const std::vector<Token>& input_tokens,
+	const std::string& default_start,
+	const RuleVisibility& visibility,
+	const ParseEvents& events,
+	ParseMeter* meter = nullptr) -> void;
+
+/**
+ * Find the unit rules of a grammar, like <expression> ::= <assignment-expression>
+ * where the replacement is a single non-terminal, and the chains they form, so
+ * that the parser can skip them.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param kept_symbols: non-terminals whose unit rules are not skipped
+ * @return unit rules and chains of unit rules
+ */
+auto find_unit_chains(const std::vector<Rule>& grammar_rules,
+					  const std::set<std::string>& kept_symbols = {})
+	-> UnitChains;
+
+/**
+ * Put the SubParses of skipped unit rules back into a parse tree built with
+ * unit_chains, so that it is the same as a parse tree built without them.
+ * @param tree: parse tree built with unit_chains
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param unit_chains: unit rules that were skipped
+ * @param default_start: the top-level symbol that describes the entire
+ * input program
+ * @return parse tree with a SubParse for every rule applied
+ */
+auto expand_unit_chains(const std::vector<SubParse>& tree,
+						const std::vector<Rule>& grammar_rules,
+						const UnitChains& unit_chains,
+						const std::string& default_start)
+	-> std::vector<SubParse>;
+
+/**
+ * Leave out the SubParses of skipped unit rules from a parse tree: the reverse
+ * of expand_unit_chains.
+ * @param tree: parse tree with a SubParse for every rule applied
+ * @param unit_chains: unit rules to leave out
+ * @return parse tree as if built with unit_chains
+ */
+auto collapse_unit_chains(const std::vector<SubParse>& tree,
+						  const UnitChains& unit_chains)
+	-> std::vector<SubParse>;
 
 #endif
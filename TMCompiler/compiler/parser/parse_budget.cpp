@@ -0,0 +1,271 @@
+/**
+ * Count the work of a parse against its budget, and report it.
+ */
+#include "parse_budget.hpp"
+
+#include <algorithm>  // std::max
+#include <chrono>	  // std::chrono
+#include <cstddef>	  // std::size_t
+#include <iomanip>	  // std::setprecision
+#include <ios>		  // std::fixed
+#include <iostream>	  // std::endl
+#include <sstream>	  // std::stringstream
+#include <stdexcept>  // std::runtime_error
+#include <string>	  // std::string, std::to_string
+
+#include <TMCompiler/utils/logger/logger.hpp>  // LOG
+
+// search steps between two reads of the clock: a step is much cheaper than
+// reading the clock
+constexpr std::size_t search_steps_between_clock_reads = 1024;
+
+/**
+ * Constructor for ParseBudgetExceeded.
+ * @param message: which limit the parse went over
+ * @param _statistics: work that the parse did until then
+ */
+ParseBudgetExceeded::ParseBudgetExceeded(const std::string& message,
+										 const ParseStatistics& _statistics)
+	: std::runtime_error(message), statistics(_statistics) {
+}
+
+/**
+ * @return work that the parse did until it went over its budget
+ */
+[[gnu::const]] auto ParseBudgetExceeded::get_statistics() const
+	-> const ParseStatistics& {
+	return statistics;
+}
+
+/**
+ * Constructor for ParseMeter: the parse starts now. It may go on from the work
+ * of a recognizer, for a parse whose Earley state sets were built by another
+ * meter.
+ * @param _budget: limits of the parse, including the work of the recognizer
+ * @param recognized: work of the recognizer so far, or none
+ */
+ParseMeter::ParseMeter(const ParseBudget& _budget,
+					   const ParseStatistics& recognized)
+	: budget(_budget),
+	  statistics(recognized),
+	  start_time(std::chrono::steady_clock::now()),
+	  searching(false),
+	  search_start_time(start_time) {
+}
+
+/**
+ * Count a closed Earley state set. A state set only grows while it is
+ * closed, so its size is checked once it is complete.
+ * @param items: number of items of the state set
+ */
+auto ParseMeter::count_earley_set(const std::size_t items) -> void {
+	++statistics.earley_sets;
+	statistics.items += items;
+	statistics.largest_set = std::max(statistics.largest_set, items);
+
+	// bucket of sets with as many binary digits
+	std::size_t bucket = 0;
+	for(std::size_t rest = items; rest > 0 && 1 + bucket < set_size_buckets;
+		rest /= 2) {
+		++bucket;
+	}
+	++statistics.set_sizes[bucket];
+
+	if(budget.max_items_per_set != 0 && items > budget.max_items_per_set) {
+		exceed("items in an Earley state set", budget.max_items_per_set);
+	}
+
+	if(budget.max_items != 0 && statistics.items > budget.max_items) {
+		exceed("items in the Earley state sets", budget.max_items);
+	}
+
+	check_time();
+}
+
+/**
+ * Count an item that the predict step of the Earley parser adds.
+ * @param added: false iff the state set already had the item
+ */
+auto ParseMeter::count_prediction(const bool added) -> void {
+	++statistics.predictions;
+	statistics.duplicate_items += added ? 0 : 1;
+}
+
+/**
+ * Count an item that the scan step of the Earley parser adds.
+ * @param added: false iff the state set already had the item
+ */
+auto ParseMeter::count_scan(const bool added) -> void {
+	++statistics.scans;
+	statistics.duplicate_items += added ? 0 : 1;
+}
+
+/**
+ * Count an item that the complete step of the Earley parser adds.
+ * @param added: false iff the state set already had the item
+ */
+auto ParseMeter::count_completion(const bool added) -> void {
+	++statistics.completions;
+	statistics.duplicate_items += added ? 0 : 1;
+}
+
+/**
+ * The Earley state sets are built: the time from now on is spent on the
+ * parse tree search.
+ */
+auto ParseMeter::start_search() -> void {
+	if(!searching) {
+		searching = true;
+		search_start_time = std::chrono::steady_clock::now();
+	}
+}
+
+/**
+ * Count a child that the parse tree search tries.
+ */
+auto ParseMeter::count_search_step() -> void {
+	++statistics.search_steps;
+
+	if(budget.max_search_steps != 0 &&
+	   statistics.search_steps > budget.max_search_steps) {
+		exceed("parse tree search steps", budget.max_search_steps);
+	}
+
+	if(statistics.search_steps % search_steps_between_clock_reads == 0) {
+		check_time();
+	}
+}
+
+/**
+ * Count a child that the parse tree search takes back.
+ */
+auto ParseMeter::count_backtrack() -> void {
+	++statistics.backtracks;
+}
+
+/**
+ * Forget the work counted so far, for another parse with the same budget that
+ * starts now.
+ */
+auto ParseMeter::restart() -> void {
+	*this = ParseMeter{budget};
+}
+
+/**
+ * @return work of the parse so far
+ */
+auto ParseMeter::get_statistics() const -> ParseStatistics {
+	const auto microseconds_between =
+		[](const std::chrono::steady_clock::time_point from,
+		   const std::chrono::steady_clock::time_point to) {
+			return static_cast<std::size_t>(
+				std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+					.count());
+		};
+
+	const std::chrono::steady_clock::time_point now =
+		std::chrono::steady_clock::now();
+
+	ParseStatistics current = statistics;
+	current.recognition_microseconds += microseconds_between(
+		start_time, searching ? search_start_time : now);
+	if(searching) {
+		current.search_microseconds +=
+			microseconds_between(search_start_time, now);
+	}
+	current.milliseconds =
+		(current.recognition_microseconds + current.search_microseconds) /
+		1000;
+
+	return current;
+}
+
+/**
+ * Throw ParseBudgetExceeded if the parse took longer than its budget.
+ */
+auto ParseMeter::check_time() const -> void {
+	if(budget.max_milliseconds == 0) {
+		return;
+	}
+
+	const std::size_t milliseconds = get_statistics().milliseconds;
+	if(milliseconds > budget.max_milliseconds) {
+		exceed("milliseconds", budget.max_milliseconds);
+	}
+}
+
+/**
+ * Throw ParseBudgetExceeded for a limit of the budget.
+ * @param limit: what the limit counts
+ * @param value: the limit
+ */
+auto ParseMeter::exceed(const std::string& limit,
+						const std::size_t value) const -> void {
+	const ParseStatistics current = get_statistics();
+	LOG("ERROR") << "Parse went over its budget of " << value << " " << limit
+				 << " after " << current.earley_sets << " Earley state sets, "
+				 << current.items << " items and " << current.search_steps
+				 << " search steps" << std::endl;
+
+	throw ParseBudgetExceeded(
+		"Parse went over its budget of " + std::to_string(value) + " " + limit,
+		current);
+}
+
+/**
+ * Report the statistics of a parse, like
+ *
+ * Earley state sets: 12
+ * items: 480, 40.0 per set, 97 in the largest set
+ * items per set: 32-63: 9, 64-127: 3
+ * ...
+ *
+ * @param statistics: work of a parse
+ * @return human-readable report of the statistics, one per line
+ */
+auto statistics_to_string(const ParseStatistics& statistics) -> std::string {
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(1);
+
+	const double mean_items =
+		statistics.earley_sets == 0
+			? 0.0
+			: static_cast<double>(statistics.items) /
+				  static_cast<double>(statistics.earley_sets);
+
+	ss << "Earley state sets: " << statistics.earley_sets << "\n";
+	ss << "items: " << statistics.items << ", " << mean_items
+	   << " per set, " << statistics.largest_set << " in the largest set\n";
+
+	ss << "items per set:";
+	const char* separator = " ";
+	for(std::size_t k = 0; k < set_size_buckets; ++k) {
+		if(statistics.set_sizes[k] == 0) {
+			continue;
+		}
+
+		ss << separator;
+		if(k <= 1) {
+			ss << k;
+		} else if(1 + k == set_size_buckets) {
+			ss << (std::size_t{1} << (k - 1)) << "+";
+		} else {
+			ss << (std::size_t{1} << (k - 1)) << "-"
+			   << (std::size_t{1} << k) - 1;
+		}
+		ss << ": " << statistics.set_sizes[k];
+		separator = ", ";
+	}
+	ss << "\n";
+
+	ss << "predictions: " << statistics.predictions << "\n";
+	ss << "scans: " << statistics.scans << "\n";
+	ss << "completions: " << statistics.completions << "\n";
+	ss << "duplicate items: " << statistics.duplicate_items << "\n";
+	ss << "parse tree search steps: " << statistics.search_steps << "\n";
+	ss << "backtracks: " << statistics.backtracks << "\n";
+	ss << "recognition: " << statistics.recognition_microseconds << " us\n";
+	ss << "parse tree search: " << statistics.search_microseconds << " us\n";
+
+	return ss.str();
+}
@@ -0,0 +1,130 @@
+/**
+ * Limits on the work of one parse, so that a pathological input fails fast
+ * instead of stalling everything after it, and statistics of that work: see
+ * ParseMeter.
+ */
+#ifndef PARSE_BUDGET_HPP
+#define PARSE_BUDGET_HPP
+
+#include <array>	  // std::array
+#include <chrono>	  // std::chrono
+#include <cstddef>	  // std::size_t
+#include <stdexcept>  // std::runtime_error
+#include <string>	  // std::string
+
+// most work one parse may do. A limit of 0 is no limit.
+struct ParseBudget {
+	// items of one Earley state set
+	std::size_t max_items_per_set = 0;
+
+	// items of all Earley state sets built by the parse
+	std::size_t max_items = 0;
+
+	// children tried by the parse tree search
+	std::size_t max_search_steps = 0;
+
+	// wall time of the parse
+	std::size_t max_milliseconds = 0;
+};
+
+// number of buckets of ParseStatistics::set_sizes
+constexpr std::size_t set_size_buckets = 32;
+
+// work that a parse did so far
+struct ParseStatistics {
+	// Earley state sets built, one more than the tokens recognized when
+	// recognizing from scratch
+	std::size_t earley_sets = 0;
+
+	// items of all Earley state sets built
+	std::size_t items = 0;
+
+	// items of the largest Earley state set built
+	std::size_t largest_set = 0;
+
+	// set_sizes[k] is the number of Earley state sets with 2^(k-1) to 2^k - 1
+	// items, and set_sizes[0] of empty ones. The last bucket holds all the
+	// larger ones.
+	std::array<std::size_t, set_size_buckets> set_sizes{};
+
+	// items that the predict, scan and complete steps of the Earley parser
+	// tried to add, including the ones that were already there
+	std::size_t predictions = 0;
+	std::size_t scans = 0;
+	std::size_t completions = 0;
+
+	// items that were not added because their state set already had them
+	std::size_t duplicate_items = 0;
+
+	// children tried by the parse tree search
+	std::size_t search_steps = 0;
+
+	// children that the parse tree search took back, to try another one
+	std::size_t backtracks = 0;
+
+	// wall time of building the Earley state sets, and of searching the parse
+	// tree in them
+	std::size_t recognition_microseconds = 0;
+	std::size_t search_microseconds = 0;
+
+	// wall time since the parse started
+	std::size_t milliseconds = 0;
+};
+
+// thrown when a parse goes over a limit of its ParseBudget, with the work
+// done until then
+class ParseBudgetExceeded : public std::runtime_error {
+public:
+	ParseBudgetExceeded(const std::string& message,
+						const ParseStatistics& _statistics);
+	[[nodiscard]] auto get_statistics() const -> const ParseStatistics&;
+
+private:
+	ParseStatistics statistics;
+};
+
+/**
+ * Counts the work of one parse, and throws ParseBudgetExceeded as soon as it
+ * goes over its budget. The Earley parser reports each state set it builds
+ * and each item it adds, and the parse tree search each child it tries.
+ *
+ * ParseMeter meter{ParseBudget{0, 100000, 0, 500}};
+ * rebuild_earley_items(earley_sets, ..., &meter);
+ * meter.start_search();
+ * build_earley_parse_tree(earley_sets, ..., &meter);
+ * ParseStatistics statistics = meter.get_statistics();
+ */
+class ParseMeter {
+public:
+	explicit ParseMeter(const ParseBudget& _budget,
+						const ParseStatistics& recognized = ParseStatistics{});
+	auto count_earley_set(std::size_t items) -> void;
+	auto count_prediction(bool added) -> void;
+	auto count_scan(bool added) -> void;
+	auto count_completion(bool added) -> void;
+	auto start_search() -> void;
+	auto count_search_step() -> void;
+	auto count_backtrack() -> void;
+	auto restart() -> void;
+	[[nodiscard]] auto get_statistics() const -> ParseStatistics;
+
+private:
+	ParseBudget budget;
+	ParseStatistics statistics;
+	std::chrono::steady_clock::time_point start_time;
+	// when the parse tree search started, if it did
+	bool searching;
+	std::chrono::steady_clock::time_point search_start_time;
+
+	auto check_time() const -> void;
+	[[noreturn]] auto exceed(const std::string& limit, std::size_t value) const
+		-> void;
+};
+
+/**
+ * @param statistics: work of a parse
+ * @return human-readable report of the statistics, one per line
+ */
+auto statistics_to_string(const ParseStatistics& statistics) -> std::string;
+
+#endif
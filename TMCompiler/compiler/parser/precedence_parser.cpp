@@ -0,0 +1,409 @@
+/**
+ * Precedence climbing over the rules of a grammar, with each non-terminal
+ * parsed at most once per token. See
+ * https://www.engr.mun.ca/~theo/Misc/exp_parsing.htm
+ */
+#include "precedence_parser.hpp"
+
+#include <cstddef>	  // std::size_t
+#include <map>		  // std::map
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument
+#include <string>	  // std::string
+#include <utility>	  // std::pair
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/rule.hpp>			  // Rule
+#include <TMCompiler/compiler/models/token.hpp>			  // Token
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // rule_to_string, EarleyItem, UnitChains
+
+/**
+ * Find the non-terminals that a symbol derives and sort out their rules for
+ * precedence climbing: see PrecedenceRegion.
+ *
+ * The parse of a region is deterministic, so the region must not have
+ * non-terminals that derive the empty string, and its left recursion must be
+ * of the forms that PrecedenceRegion describes.
+ *
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param symbol_name: non-terminal at the top of the region, like expression
+ * @return non-terminals and rules of the region
+ */
+auto find_precedence_region(const std::vector<Rule>& grammar_rules,
+							const std::string& symbol_name)
+	-> PrecedenceRegion {
+	PrecedenceRegion region;
+
+	std::map<std::string, std::vector<std::size_t> > rules_of;
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		rules_of[grammar_rules[i].production.value].push_back(i);
+	}
+
+	if(rules_of.find(symbol_name) == rules_of.end()) {
+		throw std::invalid_argument("No rules for <" + symbol_name + ">");
+	}
+
+	// non-terminals reachable from symbol_name, breadth-first
+	region.symbols.push_back(symbol_name);
+	region.symbol_indices[symbol_name] = 0;
+	for(std::size_t k = 0; k < region.symbols.size(); ++k) {
+		for(const std::size_t i : rules_of[region.symbols[k]]) {
+			for(const GrammarSymbol& symbol : grammar_rules[i].replacement) {
+				if(symbol.terminal ||
+				   region.symbol_indices.find(symbol.value) !=
+					   region.symbol_indices.end()) {
+					continue;
+				}
+
+				if(rules_of.find(symbol.value) == rules_of.end()) {
+					throw std::invalid_argument(
+						"No rules for <" + symbol.value + ">, used in " +
+						rule_to_string(grammar_rules[i]));
+				}
+
+				region.symbol_indices[symbol.value] = region.symbols.size();
+				region.symbols.push_back(symbol.value);
+			}
+		}
+	}
+
+	const auto index_of = [&region](const GrammarSymbol& symbol) {
+		return symbol.terminal ? PrecedenceRegion::no_symbol
+							   : region.symbol_indices[symbol.value];
+	};
+
+	region.embedded.resize(grammar_rules.size(), false);
+	region.rule_symbols.resize(grammar_rules.size());
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		const Rule& rule = grammar_rules[i];
+		const bool inside = region.symbol_indices.find(
+								rule.production.value) !=
+							region.symbol_indices.end();
+
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(inside) {
+				region.rule_symbols[i].push_back(index_of(symbol));
+			} else if(!symbol.terminal &&
+					  region.symbol_indices.find(symbol.value) !=
+						  region.symbol_indices.end()) {
+				region.roots.insert(symbol.value);
+			}
+		}
+
+		region.embedded[i] = inside;
+	}
+	region.roots.insert(symbol_name);
+
+	// a non-terminal that derives the empty string would make the first symbol
+	// of a rule optional
+	bool changed = true;
+	std::set<std::size_t> nullable;
+	while(changed) {
+		changed = false;
+		for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+			bool all_nullable = region.embedded[i];
+			for(const std::size_t symbol : region.rule_symbols[i]) {
+				all_nullable = all_nullable && nullable.count(symbol) > 0;
+			}
+			if(all_nullable &&
+			   nullable.insert(index_of(grammar_rules[i].production)).second) {
+				changed = true;
+			}
+		}
+	}
+	if(!nullable.empty()) {
+		throw std::invalid_argument(
+			"<" + region.symbols[*nullable.begin()] +
+			"> derives the empty string, so it cannot be parsed by precedence");
+	}
+
+	const std::size_t n = region.symbols.size();
+
+	// left_corners[x][y] is true iff x derives a string that starts with y
+	std::vector<std::vector<bool> > left_corners(n, std::vector<bool>(n));
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		if(region.embedded[i] &&
+		   region.rule_symbols[i].front() != PrecedenceRegion::no_symbol) {
+			left_corners[index_of(grammar_rules[i].production)]
+						[region.rule_symbols[i].front()] = true;
+		}
+	}
+	for(std::size_t k = 0; k < n; ++k) {
+		for(std::size_t x = 0; x < n; ++x) {
+			for(std::size_t y = 0; y < n; ++y) {
+				if(left_corners[x][k] && left_corners[k][y]) {
+					left_corners[x][y] = true;
+				}
+			}
+		}
+	}
+
+	// first symbol of rule i, if it is a non-terminal
+	const auto first_symbol = [&region](const std::size_t i) {
+		return region.rule_symbols[i].front();
+	};
+
+	// unit rules X ::= Y where every rule of Y starts with X
+	region.heads.resize(n);
+	for(std::size_t x = 0; x < n; ++x) {
+		region.heads[x] = x;
+	}
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		const std::size_t x = region.embedded[i]
+								  ? index_of(grammar_rules[i].production)
+								  : PrecedenceRegion::no_symbol;
+		if(x == PrecedenceRegion::no_symbol ||
+		   region.rule_symbols[i].size() != 1 || first_symbol(i) == x ||
+		   first_symbol(i) == PrecedenceRegion::no_symbol) {
+			continue;
+		}
+
+		const std::size_t y = first_symbol(i);
+		bool wrapped = true;
+		for(const std::size_t j : rules_of[region.symbols[y]]) {
+			wrapped = wrapped && first_symbol(j) == x &&
+					  region.rule_symbols[j].size() > 1;
+		}
+		if(wrapped) {
+			region.heads[y] = x;
+		}
+	}
+
+	region.bounded.resize(grammar_rules.size(), false);
+	for(std::size_t i = 0; i < grammar_rules.size(); ++i) {
+		if(!region.embedded[i]) {
+			continue;
+		}
+
+		const std::size_t last = region.rule_symbols[i].back();
+		region.bounded[i] = last != PrecedenceRegion::no_symbol &&
+							region.heads[last] == last &&
+							left_corners[last][index_of(
+								grammar_rules[i].production)];
+	}
+
+	region.seeds.resize(n);
+	region.extensions.resize(n);
+	for(std::size_t x = 0; x < n; ++x) {
+		if(region.heads[x] != x) {
+			continue;
+		}
+
+		for(const std::size_t i : rules_of[region.symbols[x]]) {
+			const std::size_t first = first_symbol(i);
+
+			if(first == x) {
+				region.extensions[x].push_back(PrecedenceRegion::Extension{
+					i, PrecedenceRegion::no_symbol});
+			} else if(first != PrecedenceRegion::no_symbol &&
+					  region.heads[first] == x &&
+					  region.rule_symbols[i].size() == 1) {
+				for(const std::size_t j : rules_of[region.symbols[first]]) {
+					region.extensions[x].push_back(
+						PrecedenceRegion::Extension{j, i});
+				}
+			} else if(first != PrecedenceRegion::no_symbol &&
+					  left_corners[first][x]) {
+				throw std::invalid_argument(
+					"Rule " + rule_to_string(grammar_rules[i]) +
+					" is left-recursive in a way that cannot be parsed by "
+					"precedence");
+			} else {
+				region.seeds[x].push_back(i);
+			}
+		}
+	}
+
+	return region;
+}
+
+/**
+ * Constructor for PrecedenceParser.
+ * @param _region: non-terminals to parse, from find_precedence_region. Must
+ * outlive the parser.
+ * @param _grammar_rules: rules the region was found in. Must outlive the
+ * parser.
+ * @param _unit_chains: unit rules the Earley parser skips, or empty. Items of
+ * skipped rules are left out, like the Earley parser would. Must outlive the
+ * parser.
+ * @param _input_tokens: words of the program. Must outlive the parser.
+ */
+PrecedenceParser::PrecedenceParser(const PrecedenceRegion& _region,
+								   const std::vector<Rule>& _grammar_rules,
+								   const UnitChains& _unit_chains,
+								   const std::vector<Token>& _input_tokens)
+	: region(_region),
+	  grammar_rules(_grammar_rules),
+	  unit_chains(_unit_chains),
+	  input_tokens(_input_tokens),
+	  ends(_region.symbols.size(),
+		   std::vector<std::size_t>(1 + _input_tokens.size(), not_parsed)),
+	  seed_ends(_region.symbols.size(),
+				std::vector<std::size_t>(1 + _input_tokens.size(), no_parse)) {
+	for(const std::string& root : region.roots) {
+		entries[root].push_back(region.symbol_indices.at(root));
+	}
+
+	// a rule that expects X also matches the rules of what X derives through
+	// skipped unit rules
+	for(const auto& descendants : unit_chains.descendants) {
+		for(const std::string& descendant : descendants.second) {
+			if(region.roots.find(descendant) != region.roots.end()) {
+				entries[descendants.first].push_back(
+					region.symbol_indices.at(descendant));
+			}
+		}
+	}
+}
+
+/**
+ * Parse the roots that a non-terminal stands for, from a token on.
+ * @param symbol_name: non-terminal that the Earley parser predicts
+ * @param start: index of the token where the non-terminal starts
+ * @return finished items of the rules of the region that were parsed since
+ * the last call, each with the index of the Earley state set it belongs in.
+ * Empty if symbol_name stands for no root.
+ */
+auto PrecedenceParser::parse(const std::string& symbol_name,
+							 const std::size_t start)
+	-> std::vector<std::pair<std::size_t, EarleyItem> > {
+	found_items.clear();
+
+	const auto found = entries.find(symbol_name);
+	if(found != entries.end()) {
+		for(const std::size_t root : found->second) {
+			parse_symbol(root, start);
+		}
+	}
+
+	return found_items;
+}
+
+/**
+ * Find the longest parse of a non-terminal of the region from a token on.
+ * Every rule matched along the way is added to found_items.
+ * @param symbol: index of the non-terminal in the region
+ * @param start: index of the token where the non-terminal starts
+ * @return index of the token after the parse, or no_parse
+ */
+auto PrecedenceParser::parse_symbol(const std::size_t symbol,
+									const std::size_t start) -> std::size_t {
+	if(ends[symbol][start] != not_parsed) {
+		return ends[symbol][start];
+	}
+
+	// parses of symbol are found while extending parses of its head
+	const std::size_t head = region.heads[symbol];
+	if(head != symbol) {
+		ends[symbol][start] = no_parse;
+		parse_symbol(head, start);
+		return ends[symbol][start];
+	}
+
+	ends[symbol][start] = no_parse;
+
+	std::size_t end = no_parse;
+	std::size_t rule = 0;
+	for(const std::size_t seed : region.seeds[symbol]) {
+		const std::size_t seed_end = match(seed, 0, start);
+		if(seed_end != no_parse && (end == no_parse || seed_end > end)) {
+			end = seed_end;
+			rule = seed;
+		}
+	}
+
+	if(end == no_parse) {
+		return no_parse;
+	}
+	add_item(rule, start, end);
+	seed_ends[symbol][start] = end;
+
+	while(true) {
+		std::size_t extended_end = no_parse;
+		const PrecedenceRegion::Extension* extension = nullptr;
+		for(const PrecedenceRegion::Extension& candidate :
+			region.extensions[symbol]) {
+			const std::size_t candidate_end = match(candidate.rule, 1, end);
+			if(candidate_end != no_parse &&
+			   (extended_end == no_parse || candidate_end > extended_end)) {
+				extended_end = candidate_end;
+				extension = &candidate;
+			}
+		}
+
+		if(extension == nullptr) {
+			break;
+		}
+
+		end = extended_end;
+		add_item(extension->rule, start, end);
+		if(extension->wrapper != PrecedenceRegion::no_symbol) {
+			ends[region.rule_symbols[extension->wrapper].front()][start] = end;
+			add_item(extension->wrapper, start, end);
+		}
+	}
+
+	ends[symbol][start] = end;
+	return end;
+}
+
+/**
+ * Match the symbols of a rule from a given symbol on, each non-terminal to its
+ * longest parse.
+ * @param rule: index of a rule of the region
+ * @param first_symbol: index of the first symbol of the rule to match
+ * @param start: index of the token where that symbol starts
+ * @return index of the token after the rule, or no_parse
+ */
+auto PrecedenceParser::match(const std::size_t rule,
+							 const std::size_t first_symbol,
+							 const std::size_t start) -> std::size_t {
+	const std::vector<GrammarSymbol>& replacement =
+		grammar_rules[rule].replacement;
+
+	std::size_t end = start;
+	for(std::size_t k = first_symbol; k < replacement.size(); ++k) {
+		const std::size_t symbol = region.rule_symbols[rule][k];
+
+		if(symbol != PrecedenceRegion::no_symbol) {
+			const std::size_t symbol_start = end;
+			end = parse_symbol(symbol, symbol_start);
+			if(end == no_parse) {
+				return no_parse;
+			}
+			if(1 + k == replacement.size() && region.bounded[rule]) {
+				end = seed_ends[symbol][symbol_start];
+			}
+			continue;
+		}
+
+		// special symbols like <identifier> match the token type
+		if(end == input_tokens.size() ||
+		   (replacement[k].value != input_tokens[end].type &&
+			replacement[k].value != input_tokens[end].value)) {
+			return no_parse;
+		}
+		++end;
+	}
+
+	return end;
+}
+
+/**
+ * Hand a parse of a rule to the Earley parser as a finished item, unless the
+ * Earley parser skips the rule.
+ * @param rule: index of a rule of the region
+ * @param start: index of the first token of the parse
+ * @param end: index of the token after the parse
+ */
+auto PrecedenceParser::add_item(const std::size_t rule,
+								const std::size_t start,
+								const std::size_t end) -> void {
+	if(rule < unit_chains.skipped.size() && unit_chains.skipped[rule]) {
+		return;
+	}
+
+	found_items.emplace_back(
+		end, EarleyItem{rule, start, grammar_rules[rule].replacement.size()});
+}
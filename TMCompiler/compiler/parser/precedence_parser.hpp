@@ -0,0 +1,143 @@
+/**
+ * Precedence-climbing parser for the expressions of a grammar, which the
+ * Earley parser embeds: see Grammar::embed_precedence_parser.
+ */
+#ifndef PRECEDENCE_PARSER_HPP
+#define PRECEDENCE_PARSER_HPP
+
+#include <cstddef>	// std::size_t
+#include <map>		// std::map
+#include <set>		// std::set
+#include <string>	// std::string
+#include <utility>	// std::pair
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/models/token.hpp>			 // Token
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // EarleyItem, UnitChains
+
+/**
+ * Non-terminals reachable from a symbol like <expression>, and their rules
+ * sorted out for precedence climbing. Each non-terminal X is parsed by
+ * matching one of its seed rules, which do not start with X, and then
+ * extending the parse as long as possible with rules X ::= X ..., like
+ * <additive-expression> ::= <additive-expression> "+" <multiplicative-expression>.
+ *
+ * An operand at the end of a rule that may itself start with the rule's
+ * non-terminal, like <multiplicative-expression> in
+ * <unary-expression> ::= <unary-operator> <multiplicative-expression>, is
+ * not extended: -a * b is parsed as (-a) * b, and the non-terminal that
+ * contains the rule extends it instead.
+ *
+ * Left recursion through another non-terminal is allowed in one form: a unit
+ * rule X ::= Y, where every rule of Y starts with X, like
+ * <postfix-expression> ::= <method-invocation> and
+ * <method-invocation> ::= <postfix-expression> "(" ")". Y then has no seeds:
+ * a parse of Y is found while extending a parse of X.
+ */
+struct PrecedenceRegion {
+	// marks symbols of rules that are terminals
+	static constexpr std::size_t no_symbol = static_cast<std::size_t>(-1);
+
+	// a rule that extends a parse of a non-terminal X: either X ::= X ...,
+	// or Y ::= X ... wrapped in the unit rule X ::= Y
+	struct Extension {
+		std::size_t rule;
+		std::size_t wrapper;
+	};
+
+	// non-terminals of the region, in order of first reach
+	std::vector<std::string> symbols;
+
+	// index of each non-terminal in symbols
+	std::map<std::string, std::size_t> symbol_indices;
+
+	// non-terminals of the region that rules outside of it use, where the
+	// Earley parser hands over to the precedence parser
+	std::set<std::string> roots;
+
+	// embedded[i] is true iff rule i is a rule of a non-terminal of the region
+	std::vector<bool> embedded;
+
+	// for each rule of the region, the index in symbols of each of its
+	// symbols, or no_symbol for terminals
+	std::vector<std::vector<std::size_t> > rule_symbols;
+
+	// bounded[i] is true iff the last symbol of rule i is an operand that is
+	// not extended
+	std::vector<bool> bounded;
+
+	// for each non-terminal: rules that start a parse of it
+	std::vector<std::vector<std::size_t> > seeds;
+
+	// for each non-terminal: rules that extend a parse of it
+	std::vector<std::vector<Extension> > extensions;
+
+	// for each non-terminal: itself, or the non-terminal X of the unit rule
+	// X ::= Y whose parses contain its parses
+	std::vector<std::size_t> heads;
+};
+
+/**
+ * Find the non-terminals that a symbol derives and sort out their rules for
+ * precedence climbing.
+ * @param grammar_rules: list of production symbols to replacement rules
+ * @param symbol_name: non-terminal at the top of the region, like expression
+ * @return non-terminals and rules of the region
+ */
+auto find_precedence_region(const std::vector<Rule>& grammar_rules,
+							const std::string& symbol_name) -> PrecedenceRegion;
+
+/**
+ * Parser for the non-terminals of a PrecedenceRegion, for one input. It
+ * supplies the Earley parser with finished items: the Earley parser does not
+ * predict the rules of the region, and instead asks for the parse of a root
+ * where it expects one.
+ *
+ * Each non-terminal is parsed at most once per token, and always to its
+ * longest parse: the first seed rule that matches the most tokens, then the
+ * first extension that matches the most tokens, until none matches.
+ */
+class PrecedenceParser {
+public:
+	PrecedenceParser(const PrecedenceRegion& _region,
+					 const std::vector<Rule>& _grammar_rules,
+					 const UnitChains& _unit_chains,
+					 const std::vector<Token>& _input_tokens);
+	auto parse(const std::string& symbol_name, std::size_t start)
+		-> std::vector<std::pair<std::size_t, EarleyItem> >;
+
+private:
+	// marks parses that were not tried yet, and parses that failed
+	static constexpr std::size_t not_parsed = static_cast<std::size_t>(-1);
+	static constexpr std::size_t no_parse = static_cast<std::size_t>(-2);
+
+	const PrecedenceRegion& region;
+	const std::vector<Rule>& grammar_rules;
+	const UnitChains& unit_chains;
+	const std::vector<Token>& input_tokens;
+
+	// for each non-terminal that rules outside of the region expect, the roots
+	// it stands for: itself, and roots it derives through skipped unit rules
+	std::map<std::string, std::vector<std::size_t> > entries;
+
+	// ends[symbol][start] is the end of the longest parse of symbol from
+	// token start, not_parsed or no_parse
+	std::vector<std::vector<std::size_t> > ends;
+
+	// seed_ends[symbol][start] is the end of the parse of symbol from token
+	// start before it is extended
+	std::vector<std::vector<std::size_t> > seed_ends;
+
+	// finished items not yet handed to the Earley parser, with their state
+	// set
+	std::vector<std::pair<std::size_t, EarleyItem> > found_items;
+
+	auto parse_symbol(std::size_t symbol, std::size_t start) -> std::size_t;
+	auto match(std::size_t rule, std::size_t first_symbol, std::size_t start)
+		-> std::size_t;
+	auto add_item(std::size_t rule, std::size_t start, std::size_t end)
+		-> void;
+};
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * Keep the finished items of Earley state sets in files on disk, and map them
+ * back into memory by the token they start at.
+ */
+#include "spilled_earley_sets.hpp"
+
+#include <algorithm>  // std::stable_sort
+#include <cerrno>	  // errno
+#include <cstddef>	  // std::size_t
+#include <cstdint>	  // std::uint32_t
+#include <cstdio>	  // std::remove
+#include <cstring>	  // std::strerror
+#include <fstream>	  // std::ifstream, std::ofstream
+#include <ios>		  // std::ios, std::streamsize
+#include <iostream>	  // std::endl
+#include <limits>	  // std::numeric_limits
+#include <stdexcept>  // std::invalid_argument, std::logic_error, std::runtime_error
+#include <string>	  // std::string, std::to_string
+#include <utility>	  // std::move
+#include <vector>	  // std::vector
+
+#include <fcntl.h>	   // open, O_CREAT, O_RDWR, O_TRUNC
+#include <sys/mman.h>  // mmap, munmap, MAP_FAILED, MAP_SHARED, PROT_READ, PROT_WRITE
+#include <unistd.h>	   // close, ftruncate
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // EarleyItem, FlippedEarleyItem
+#include <TMCompiler/utils/logger/logger.hpp>			 // LOG
+
+// items read back from the unsorted file at a time
+constexpr std::size_t items_per_read = 4096;
+
+// finished Earley item in the unsorted file, which is in order of end
+struct UnsortedItem {
+	std::uint32_t rule;
+	std::uint32_t start;
+	std::uint32_t end;
+};
+
+/**
+ * Narrow a rule index or token position to the size stored on disk.
+ * @param value: rule index or token position
+ * @return value, as stored on disk
+ */
+auto to_spilled(const std::size_t value) -> std::uint32_t {
+	if(value > std::numeric_limits<std::uint32_t>::max()) {
+		throw std::invalid_argument("Earley item position " +
+									std::to_string(value) +
+									" is too large to spill to disk");
+	}
+
+	return static_cast<std::uint32_t>(value);
+}
+
+/**
+ * Throw for a file operation that failed, with the reason of errno.
+ * @param action: what failed
+ * @param file_name: file it failed on
+ */
+[[noreturn]] auto throw_file_error(const std::string& action,
+								   const std::string& file_name) -> void {
+	const std::string reason = std::strerror(errno);
+	LOG("ERROR") << "Unable to " << action << " " << file_name << ": "
+				 << reason << std::endl;
+	throw std::runtime_error("Unable to " + action + " " + file_name + ": " +
+							 reason);
+}
+
+/**
+ * Constructor for SpilledItems.
+ * @param _items: items that start at the same token, in the mapped file
+ * @param _size: number of items
+ * @param _grammar_rules: rules of the items
+ */
+SpilledItems::SpilledItems(const SpilledItem* const _items,
+						   const std::size_t _size,
+						   const std::vector<Rule>& _grammar_rules)
+	: items(_items), num_items(_size), grammar_rules(_grammar_rules) {
+}
+
+/**
+ * @return number of items that start at the token
+ */
+[[gnu::pure]] auto SpilledItems::size() const -> std::size_t {
+	return num_items;
+}
+
+/**
+ * @param i: index of an item, less than size()
+ * @return the item, as flip_finished_items stores it
+ */
+[[gnu::pure]] auto SpilledItems::operator[](const std::size_t i) const
+	-> FlippedEarleyItem {
+	const SpilledItem item = items[i];
+	return FlippedEarleyItem{
+		item.rule, item.end, grammar_rules[item.rule].replacement.size()};
+}
+
+/**
+ * Constructor for SpilledEarleySets: start a file of items.
+ * @param _file_name: file to keep the items in, overwritten once finished.
+ * Items are appended to _file_name + ".unsorted" until then.
+ * @param _grammar_rules: rules of the items. Must outlive SpilledEarleySets.
+ */
+SpilledEarleySets::SpilledEarleySets(std::string _file_name,
+									 const std::vector<Rule>& _grammar_rules)
+	: file_name(std::move(_file_name)),
+	  grammar_rules(_grammar_rules),
+	  num_sets(0),
+	  finished(false),
+	  file_descriptor(-1),
+	  items(nullptr),
+	  mapped_bytes(0) {
+	unsorted_file.open(unsorted_file_name(), std::ios::binary);
+	if(!unsorted_file.is_open()) {
+		throw_file_error("open", unsorted_file_name());
+	}
+}
+
+/**
+ * Destructor for SpilledEarleySets: unmap and remove the files.
+ */
+SpilledEarleySets::~SpilledEarleySets() {
+	unmap();
+
+	if(unsorted_file.is_open()) {
+		unsorted_file.close();
+	}
+	std::remove(unsorted_file_name().c_str());
+
+	if(finished) {
+		std::remove(file_name.c_str());
+	}
+}
+
+/**
+ * Append the finished items of the next Earley state set. Its partial parses
+ * are never part of the parse tree, so they are left out.
+ * @param earley_set: state set after the tokens of the sets added so far
+ */
+auto SpilledEarleySets::add_earley_set(
+	const std::vector<EarleyItem>& earley_set) -> void {
+	if(finished) {
+		throw std::logic_error(
+			"Cannot add Earley state sets to finished SpilledEarleySets");
+	}
+
+	const std::uint32_t end = to_spilled(num_sets);
+	++num_sets;
+	offsets.resize(num_sets, 0);
+
+	for(const EarleyItem item : earley_set) {
+		if(grammar_rules[item.rule].replacement.size() == item.next) {
+			const UnsortedItem unsorted{
+				to_spilled(item.rule), to_spilled(item.start), end};
+			unsorted_file.write(reinterpret_cast<const char*>(&unsorted),
+								sizeof(unsorted));
+			++offsets[item.start];
+		}
+	}
+
+	if(!unsorted_file) {
+		throw_file_error("write to", unsorted_file_name());
+	}
+}
+
+/**
+ * Add the last Earley state set, and lay out all items by the token they start
+ * at in the mapped file. The items that start at a token keep the order they
+ * were added in, as in flip_finished_items.
+ * @param last_earley_set: state set after the last token
+ * @param rule_ranks: rank of each rule: the items that start at each token
+ * are sorted by it, as in flip_finished_items. Or empty
+ */
+auto SpilledEarleySets::finish(const std::vector<EarleyItem>& last_earley_set,
+							   const std::vector<std::size_t>& rule_ranks)
+	-> void {
+	add_earley_set(last_earley_set);
+	unsorted_file.close();
+	finished = true;
+
+	// offsets[start] becomes the first item that starts at token start
+	std::size_t total = 0;
+	for(std::size_t& offset : offsets) {
+		const std::size_t count = offset;
+		offset = total;
+		total += count;
+	}
+	offsets.push_back(total);
+
+	file_descriptor = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(file_descriptor < 0) {
+		throw_file_error("open", file_name);
+	}
+
+	mapped_bytes = total * sizeof(SpilledItem);
+	if(mapped_bytes > 0) {
+		if(ftruncate(file_descriptor, static_cast<off_t>(mapped_bytes)) != 0) {
+			throw_file_error("resize", file_name);
+		}
+
+		void* const memory = mmap(nullptr,
+								  mapped_bytes,
+								  PROT_READ | PROT_WRITE,
+								  MAP_SHARED,
+								  file_descriptor,
+								  0);
+		if(memory == MAP_FAILED) {
+			mapped_bytes = 0;
+			throw_file_error("map", file_name);
+		}
+		items = static_cast<SpilledItem*>(memory);
+	}
+
+	// the unsorted file is read in order of end, so each item goes to the
+	// next free place of the items that start where it starts
+	std::vector<std::size_t> next_places(offsets.begin(), offsets.end() - 1);
+	std::ifstream unsorted{unsorted_file_name(), std::ios::binary};
+	std::vector<UnsortedItem> buffer(items_per_read);
+	while(unsorted) {
+		unsorted.read(
+			reinterpret_cast<char*>(buffer.data()),
+			static_cast<std::streamsize>(buffer.size() * sizeof(UnsortedItem)));
+		const std::size_t num_read =
+			static_cast<std::size_t>(unsorted.gcount()) / sizeof(UnsortedItem);
+
+		for(std::size_t i = 0; i < num_read; ++i) {
+			const UnsortedItem item = buffer[i];
+			items[next_places[item.start]] = SpilledItem{item.rule, item.end};
+			++next_places[item.start];
+		}
+	}
+	unsorted.close();
+	std::remove(unsorted_file_name().c_str());
+
+	if(!rule_ranks.empty()) {
+		for(std::size_t start = 0; start < num_sets; ++start) {
+			std::stable_sort(
+				items + offsets[start],
+				items + offsets[1 + start],
+				[&rule_ranks](const SpilledItem a, const SpilledItem b) {
+					return rule_ranks[a.rule] < rule_ranks[b.rule];
+				});
+		}
+	}
+}
+
+/**
+ * @return number of Earley state sets added, one more than the tokens
+ */
+[[gnu::pure]] auto SpilledEarleySets::size() const -> std::size_t {
+	return num_sets;
+}
+
+/**
+ * @return number of finished items in the mapped file
+ */
+[[gnu::pure]] auto SpilledEarleySets::num_items() const -> std::size_t {
+	return mapped_bytes / sizeof(SpilledItem);
+}
+
+/**
+ * @param start: index of a token, or the number of tokens
+ * @return finished items that start at token start
+ */
+auto SpilledEarleySets::operator[](const std::size_t start) const
+	-> SpilledItems {
+	if(!finished) {
+		throw std::logic_error(
+			"SpilledEarleySets can only be read once finished");
+	}
+
+	return SpilledItems{items + offsets[start],
+						offsets[1 + start] - offsets[start],
+						grammar_rules};
+}
+
+/**
+ * @return file that the items are appended to until finish()
+ */
+auto SpilledEarleySets::unsorted_file_name() const -> std::string {
+	return file_name + ".unsorted";
+}
+
+/**
+ * Unmap and close the file of the items, if it is open.
+ */
+auto SpilledEarleySets::unmap() -> void {
+	if(items != nullptr) {
+		munmap(items, mapped_bytes);
+		items = nullptr;
+	}
+
+	if(file_descriptor >= 0) {
+		close(file_descriptor);
+		file_descriptor = -1;
+	}
+}
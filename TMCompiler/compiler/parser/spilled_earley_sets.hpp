@@ -0,0 +1,93 @@
+/**
+ * Finished items of Earley state sets, kept in files on disk instead of in
+ * memory, so that the parse tree of a long input can be built without its
+ * Earley state sets in memory: see Grammar::parse_spilling_finished_items.
+ */
+#ifndef SPILLED_EARLEY_SETS_HPP
+#define SPILLED_EARLEY_SETS_HPP
+
+#include <cstddef>	// std::size_t
+#include <cstdint>	// std::uint32_t
+#include <fstream>	// std::ofstream
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // EarleyItem, FlippedEarleyItem
+
+// finished Earley item in the file of SpilledEarleySets: its rule, and the
+// token where it ends
+struct SpilledItem {
+	std::uint32_t rule;
+	std::uint32_t end;
+};
+
+// finished items of SpilledEarleySets that start at the same token
+class SpilledItems {
+public:
+	SpilledItems(const SpilledItem* _items,
+				 std::size_t _size,
+				 const std::vector<Rule>& _grammar_rules);
+	[[nodiscard]] auto size() const -> std::size_t;
+	[[nodiscard]] auto operator[](std::size_t i) const -> FlippedEarleyItem;
+
+private:
+	const SpilledItem* items;
+	std::size_t num_items;
+	const std::vector<Rule>& grammar_rules;
+};
+
+/**
+ * Finished items of Earley state sets, written to disk one state set at a
+ * time, as a recognizer finishes each one. finish() then lays them out by the
+ * token they start at, like flip_finished_items, in a file that is mapped
+ * into memory: the parse tree search reads them back through the page cache,
+ * so only the pages it touches take up memory.
+ *
+ * SpilledEarleySets spilled{"parse.items", grammar_rules};
+ * recognizer.spill_finished_items(spilled);
+ * for(const Token& token : tokens) {
+ *		recognizer.push(token);
+ * }
+ * spilled.finish(recognizer.get_earley_sets().back(), rule_ranks);
+ * build_earley_parse_tree(spilled, grammar_rules, ...);
+ *
+ * The files are removed when SpilledEarleySets is destroyed.
+ */
+class SpilledEarleySets {
+public:
+	SpilledEarleySets(std::string _file_name,
+					  const std::vector<Rule>& _grammar_rules);
+	SpilledEarleySets(const SpilledEarleySets&) = delete;
+	auto operator=(const SpilledEarleySets&) -> SpilledEarleySets& = delete;
+	~SpilledEarleySets();
+	auto add_earley_set(const std::vector<EarleyItem>& earley_set) -> void;
+	auto finish(const std::vector<EarleyItem>& last_earley_set,
+				const std::vector<std::size_t>& rule_ranks) -> void;
+	[[nodiscard]] auto size() const -> std::size_t;
+	[[nodiscard]] auto num_items() const -> std::size_t;
+	[[nodiscard]] auto operator[](std::size_t start) const -> SpilledItems;
+
+private:
+	// file of the items by start, once finished; the items are appended to
+	// file_name + ".unsorted" until then
+	std::string file_name;
+	const std::vector<Rule>& grammar_rules;
+	std::ofstream unsorted_file;
+	// number of state sets added
+	std::size_t num_sets;
+	// true iff the items are laid out in the mapped file
+	bool finished;
+	// number of items that start at each token, and once finished, where the
+	// items that start at each token begin in the file
+	std::vector<std::size_t> offsets;
+	// descriptor and mapping of the file, once finished
+	int file_descriptor;
+	SpilledItem* items;
+	std::size_t mapped_bytes;
+
+	auto unsorted_file_name() const -> std::string;
+	auto unmap() -> void;
+};
+
+#endif
@@ -1,7 +1,24 @@
-#include <string>  // std::string
+#include <algorithm>   // std::is_sorted
+#include <chrono>	   // std::chrono
+#include <cstddef>	   // std::size_t
+#include <filesystem>  // std::filesystem
+#include <fstream>	   // std::ofstream
+#include <set>		   // std::multiset
+#include <stdexcept>   // std::logic_error
+#include <string>	   // std::string, std::to_string
+#include <thread>	   // std::thread
+#include <tuple>	   // std::tuple
+#include <vector>	   // std::vector
 
-#include <TMCompiler/compiler/compiler.hpp>	   // Compiler
+#include <TMCompiler/compiler/batch_compiler.hpp>  // compile_files, find_source_files, CompileResult
+#include <TMCompiler/compiler/compile_server.hpp>  // send_compile_request, CompileServer
+#include <TMCompiler/compiler/compiler.hpp>	 // Compiler, LazyFunction, LazyParse
+#include <TMCompiler/compiler/models/embedded_specification.hpp>  // embedded_language_specification
+#include <TMCompiler/compiler/models/rule.hpp>			 // Rule
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseBudgetExceeded
 #include <TMCompiler/utils/logger/logger.hpp>  // logger
+#include <TMCompiler/utils/tracer/tracer.hpp>  // tracer, TraceEvent, TraceSpan
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -71,3 +88,303 @@ TEST_CASE("compiles") {
 	compiler.compile_text(program_text);
 	SUCCEED("Compiled without errors");
 }
+
+TEST_CASE("checks syntax without compiling") {
+	logger.set_level("NONE");
+
+	const Compiler compiler("TMCompiler/config/language.toml");
+
+	SECTION("valid program") {
+		const SyntaxCheck result =
+			compiler.check_text("void foo() {}  void main() { foo(); }");
+		REQUIRE(result.valid);
+	}
+	SECTION("first unexpected token") {
+		const SyntaxCheck result =
+			compiler.check_text("void foo() {\n\tint x = ; return; }");
+		REQUIRE(!result.valid);
+		REQUIRE(result.line == 2);
+		REQUIRE(result.unexpected == ";");
+	}
+	SECTION("program ends too early") {
+		const SyntaxCheck result = compiler.check_text("void foo() {");
+		REQUIRE(!result.valid);
+		REQUIRE(result.line == 1);
+		REQUIRE(result.unexpected.empty());
+	}
+}
+
+TEST_CASE("parse budget stops a compile that does too much work") {
+	logger.set_level("NONE");
+
+	Compiler compiler("TMCompiler/config/language.toml");
+	const std::string program_text =
+		"int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3;"
+		"  while(a < b) { a += 1; if(a == c) return a; else c -= 1; }"
+		"  return c; }";
+
+	ParseBudget budget;
+	budget.max_items = 1000;
+	compiler.set_parse_budget(budget);
+	REQUIRE_THROWS_AS(compiler.compile_text(program_text),
+					  ParseBudgetExceeded);
+
+	budget.max_items = 1000000;
+	compiler.set_parse_budget(budget);
+	compiler.compile_text(program_text);
+}
+
+TEST_CASE("parses function bodies on demand") {
+	logger.set_level("NONE");
+
+	const Compiler compiler("TMCompiler/config/language.toml");
+
+	SECTION("headers and bodies") {
+		const LazyParse program = compiler.parse_headers_text(
+			"int foo(int a, bool b) { if(b) { return a; } return -a; }\n"
+			"void main() { while(true) { foo(1, false); } }");
+		REQUIRE(program.functions.size() == 2);
+
+		const std::vector<Rule> rules = program.grammar->get_rules();
+		const std::vector<SubParse> tree =
+			program.grammar->parse(program.tokens);
+
+		for(std::size_t f = 0; f < program.functions.size(); ++f) {
+			const LazyFunction& function = program.functions[f];
+			REQUIRE(program.tokens[function.body_start].value == "{");
+			REQUIRE(program.tokens[function.body_end - 1].value == "}");
+			REQUIRE(rules[function.header.front().rule].production.value ==
+					"function-header");
+
+			const std::vector<SubParse> body = Compiler::parse_body(program, f);
+			REQUIRE(rules[body.front().rule].production.value ==
+					"compound-statement");
+
+			// the body parses as it does in the parse of the whole program
+			std::multiset<std::tuple<std::size_t, std::size_t, std::size_t> >
+				expected;
+			for(const SubParse& node : tree) {
+				if(node.start >= function.body_start &&
+				   node.end <= function.body_end) {
+					expected.insert({node.rule,
+									 node.start - function.body_start,
+									 node.end - function.body_start});
+				}
+			}
+			std::multiset<std::tuple<std::size_t, std::size_t, std::size_t> >
+				found;
+			for(const SubParse& node : body) {
+				found.insert({node.rule, node.start, node.end});
+			}
+			REQUIRE(found == expected);
+		}
+
+		REQUIRE(program.functions[0].header_start == 0);
+		REQUIRE(program.functions[1].header_start ==
+				program.functions[0].body_end);
+		REQUIRE(program.functions[1].body_end == program.tokens.size());
+	}
+	SECTION("programs share the grammar of the compiler") {
+		const LazyParse program = compiler.parse_headers_text("void foo() {}");
+		const LazyParse other = compiler.parse_headers_text("void bar() {}");
+		REQUIRE(program.grammar == other.grammar);
+	}
+	SECTION("syntax error in a body is found once it is parsed") {
+		const LazyParse program =
+			compiler.parse_headers_text("void foo() { int x = ; }");
+		REQUIRE(program.functions.size() == 1);
+		REQUIRE_THROWS_AS(Compiler::parse_body(program, 0), std::logic_error);
+	}
+	SECTION("unclosed body") {
+		REQUIRE_THROWS_AS(compiler.parse_headers_text("void foo() { {}"),
+						  std::logic_error);
+	}
+}
+
+TEST_CASE("compiles a directory of files on threads that share a compiler") {
+	logger.set_level("NONE");
+
+	const Compiler compiler("TMCompiler/config/language.toml");
+
+	const std::string directory = "test_batch_programs";
+	std::filesystem::create_directories(directory + "/nested");
+
+	const std::vector<std::string> programs{
+		"void foo() {}",
+		"int compute(int y) { return 5; }",
+		"int foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += i; }"
+		" return sum; }",
+		"int foo() { if(true) { return 1; } else { return -1; } }",
+		"void foo() { int x = ; }",
+		"int foo() { while(true) { return 1; }}",
+	};
+	for(std::size_t i = 0; i < programs.size(); ++i) {
+		const std::string subdirectory = i % 2 == 0 ? "/" : "/nested/";
+		std::ofstream program_file{directory + subdirectory + "program_" +
+								   std::to_string(i) + ".cpp"};
+		program_file << programs[i] << "\n";
+	}
+	std::ofstream{directory + "/notes.txt"} << "not a program\n";
+
+	const std::vector<std::string> file_names = find_source_files(directory);
+	REQUIRE(file_names.size() == programs.size());
+	REQUIRE(std::is_sorted(file_names.begin(), file_names.end()));
+
+	const std::vector<CompileResult> sequential =
+		compile_files(compiler, file_names, 1);
+	const std::vector<CompileResult> parallel =
+		compile_files(compiler, file_names, 4);
+	std::filesystem::remove_all(directory);
+
+	REQUIRE(parallel.size() == file_names.size());
+	for(std::size_t i = 0; i < file_names.size(); ++i) {
+		REQUIRE(parallel[i].file_name == file_names[i]);
+		REQUIRE(parallel[i].success == sequential[i].success);
+		REQUIRE(parallel[i].error == sequential[i].error);
+		REQUIRE(parallel[i].statistics.items == sequential[i].statistics.items);
+
+		// only the program with a syntax error fails
+		const bool has_error =
+			file_names[i].find("program_4") != std::string::npos;
+		REQUIRE(parallel[i].success == !has_error);
+		REQUIRE(parallel[i].error.empty() == !has_error);
+	}
+}
+
+TEST_CASE("compile server keeps its compiler until the specification changes") {
+	logger.set_level("NONE");
+
+	const std::string spec_file_name = "test_compile_server.toml";
+	const std::string program_file_name = "test_compile_server_program.cpp";
+	const std::string socket_path = "test_compile_server.sock";
+
+	const auto copy_spec = [&spec_file_name]() {
+		std::filesystem::copy_file(
+			"TMCompiler/config/language.toml",
+			spec_file_name,
+			std::filesystem::copy_options::overwrite_existing);
+	};
+	const auto answers = [&socket_path](const std::string& request,
+										const std::string& prefix) {
+		return send_compile_request(socket_path, request).rfind(prefix, 0) ==
+			   0;
+	};
+
+	copy_spec();
+	std::ofstream{program_file_name} << "int foo() { return 1; }\n";
+	const std::string compile_request = "compile " + program_file_name;
+
+	// the socket is open while the server exists
+	{
+		CompileServer server{spec_file_name, socket_path};
+		std::thread serving{[&server]() { server.serve(2); }};
+
+		REQUIRE(answers(compile_request, "ok "));
+		REQUIRE(answers("compile missing.cpp", "error "));
+		REQUIRE(answers("link", "error "));
+
+		// a longer request is refused, rather than cut short and compiled
+		std::string long_path = program_file_name;
+		while(long_path.size() <= 4096) {
+			long_path = "./" + long_path;
+		}
+		REQUIRE(answers("compile " + long_path, "error Expected"));
+
+		// a broken specification fails the requests until it is fixed
+		const std::filesystem::file_time_type write_time =
+			std::filesystem::last_write_time(spec_file_name);
+		std::ofstream{spec_file_name} << "not = [a specification\n";
+		std::filesystem::last_write_time(spec_file_name,
+										 write_time + std::chrono::seconds(1));
+		REQUIRE(answers(compile_request, "error "));
+
+		copy_spec();
+		std::filesystem::last_write_time(spec_file_name,
+										 write_time + std::chrono::seconds(2));
+		REQUIRE(answers(compile_request, "ok "));
+
+		REQUIRE(send_compile_request(socket_path, "stop") == "ok");
+		serving.join();
+	}
+
+	std::filesystem::remove(spec_file_name);
+	std::filesystem::remove(spec_file_name + ".cache");
+	std::filesystem::remove(program_file_name);
+	REQUIRE_FALSE(std::filesystem::exists(socket_path));
+}
+
+TEST_CASE("compile server without a file serves the built-in specification") {
+	logger.set_level("NONE");
+
+	const std::string program_file_name = "test_built_in_server_program.cpp";
+	const std::string socket_path = "test_built_in_server.sock";
+	std::ofstream{program_file_name} << "int foo() { return 1; }\n";
+
+	{
+		CompileServer server{"", socket_path};
+		std::thread serving{[&server]() { server.serve(1); }};
+
+		REQUIRE(send_compile_request(socket_path,
+									 "compile " + program_file_name)
+					.rfind("ok ", 0) == 0);
+
+		REQUIRE(send_compile_request(socket_path, "stop") == "ok");
+		serving.join();
+	}
+
+	std::filesystem::remove(program_file_name);
+}
+
+TEST_CASE("traces the phases of compiles on each thread") {
+	logger.set_level("NONE");
+
+	tracer.start();
+	const Compiler compiler(embedded_language_specification());
+	compiler.compile_text("int foo() { return 1; }");
+	std::thread other{[&compiler]() {
+		compiler.compile_text("void foo() { int x = 1; }");
+	}};
+	other.join();
+	{
+		const TraceSpan span{"quoted", "a \"b\"\\c"};
+	}
+	tracer.stop();
+
+	// spans after stop() are not recorded
+	{
+		const TraceSpan span{"after stop"};
+	}
+
+	const std::vector<TraceEvent> events = tracer.get_events();
+	std::multiset<std::tuple<std::size_t, std::string> > spans;
+	for(const TraceEvent& event : events) {
+		REQUIRE(event.start >= 0);
+		REQUIRE(event.duration >= 0);
+		spans.insert({event.thread, event.name});
+	}
+
+	const std::size_t main_thread = events.front().thread;
+	REQUIRE(spans.count({main_thread, "load specification"}) == 1);
+	REQUIRE(spans.count({main_thread, "prepare grammar"}) == 1);
+	REQUIRE(spans.count({main_thread, "after stop"}) == 0);
+
+	// each compile is traced on the thread that ran it
+	const std::size_t other_thread = events.back().thread;
+	REQUIRE(other_thread != main_thread);
+	for(const std::size_t thread : {main_thread, other_thread}) {
+		REQUIRE(spans.count({thread, "lex and recognize"}) == 1);
+		REQUIRE(spans.count({thread, "build parse tree"}) == 1);
+		REQUIRE(spans.count({thread, "semantic analysis"}) == 1);
+		REQUIRE(spans.count({thread, "backend"}) == 1);
+	}
+
+	const std::string trace = tracer.to_chrome_trace();
+	REQUIRE(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) ==
+			0);
+	REQUIRE(trace.find("\"name\":\"thread_name\",\"ph\":\"M\"") !=
+			std::string::npos);
+	REQUIRE(trace.find("\"name\":\"build parse tree\",\"cat\":\"tmc\","
+					   "\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(trace.find("\"args\":{\"detail\":\"a \\\"b\\\"\\\\c\"}") !=
+			std::string::npos);
+}
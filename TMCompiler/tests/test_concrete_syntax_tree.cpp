@@ -0,0 +1,52 @@
+#include <cstdint>	// std::uint32_t
+#include <vector>	// std::vector
+
+#include <TMCompiler/compiler/models/concrete_syntax_tree.hpp>	// ConcreteSyntaxTree
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // SubParse
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("concrete syntax tree is in preorder") {
+	// breadth-first tree, like from build_earley_parse_tree:
+	// rule 10 covers [0, 5) with children rule 11 [0, 2) and rule 12 [2, 5);
+	// rule 11 has children rule 13 [0, 1) and rule 14 [1, 2);
+	// rule 12 has child rule 15 [2, 5)
+	const std::vector<SubParse> parse_tree{
+		SubParse{10, 0, 5, 0},
+		SubParse{11, 0, 2, 0},
+		SubParse{12, 2, 5, 0},
+		SubParse{13, 0, 1, 1},
+		SubParse{14, 1, 2, 1},
+		SubParse{15, 2, 5, 2},
+	};
+
+	const ConcreteSyntaxTree tree{parse_tree};
+
+	REQUIRE(tree.size() == 6);
+
+	// preorder: 10, 11, 13, 14, 12, 15
+	const std::vector<std::uint32_t> expected_rules{10, 11, 13, 14, 12, 15};
+	for(std::uint32_t node = 0; node < tree.size(); ++node) {
+		REQUIRE(tree.rule(node) == expected_rules[node]);
+	}
+
+	REQUIRE(tree.parent(ConcreteSyntaxTree::root()) ==
+			ConcreteSyntaxTree::no_node);
+	REQUIRE(tree.token_begin(0) == 0);
+	REQUIRE(tree.token_end(0) == 5);
+	REQUIRE(tree.subtree_end(0) == 6);
+	REQUIRE(tree.subtree_end(1) == 4);
+
+	std::vector<std::uint32_t> root_children;
+	for(const std::uint32_t child : tree.children(ConcreteSyntaxTree::root())) {
+		root_children.push_back(child);
+		REQUIRE(tree.parent(child) == ConcreteSyntaxTree::root());
+	}
+	REQUIRE(root_children == std::vector<std::uint32_t>{1, 4});
+
+	REQUIRE(tree.num_children(1) == 2);
+	REQUIRE(tree.num_children(4) == 1);
+	REQUIRE(tree.num_children(5) == 0);
+	REQUIRE(tree.token_begin(5) == 2);
+	REQUIRE(tree.token_end(5) == 5);
+}
@@ -0,0 +1,228 @@
+/**
+ * Allocation and memory tests of the Earley parser. This file replaces the
+ * global operator new of the test program with one that counts the heap
+ * allocations, and the bytes they hold.
+ */
+#include <atomic>	   // std::atomic
+#include <cstddef>	   // std::max_align_t, std::size_t
+#include <cstdlib>	   // std::free, std::malloc
+#include <filesystem>  // std::filesystem
+#include <new>		   // std::bad_alloc
+#include <set>		   // std::set
+#include <string>	   // std::string
+#include <vector>	   // std::vector
+
+#include <TMCompiler/compiler/lexer/lexer.hpp>			  // Lexer
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // make_disambiguation
+#include <TMCompiler/compiler/models/grammar.hpp>		  // Grammar
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/rule.hpp>					  // Rule
+#include <TMCompiler/compiler/models/token.hpp>					  // Token
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // find_unit_chains, rebuild_earley_items, Disambiguation, EarleyItem, EarleyRecognizer, UnitChains
+#include <TMCompiler/utils/logger/logger.hpp>  // logger
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+// heap allocations of the test program so far, by any of its threads
+std::atomic<std::size_t> allocations{0};
+
+// bytes that heap allocations hold now, and the most they held since
+// peak_bytes was last set
+std::atomic<std::size_t> live_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+// each allocation starts with its size, padded to keep the alignment of
+// malloc
+constexpr std::size_t size_header = alignof(std::max_align_t);
+
+// most bytes that heap allocations hold while call runs, beyond what they held
+// before
+template <typename Function>
+auto peak_bytes_of(const Function& call) -> std::size_t {
+	const std::size_t before = live_bytes;
+	peak_bytes = before;
+	call();
+	return peak_bytes - before;
+}
+
+auto tokenize(const LanguageSpecification& spec,
+			  const std::string& program_text) -> std::vector<Token> {
+	Lexer lexer{spec.token_regexes};
+	lexer.set_text(program_text);
+
+	std::vector<Token> tokens;
+	while(lexer.has_next_token()) {
+		const Token token = lexer.get_next_token();
+		if(spec.token_regexes_ignore.find(token.type) ==
+		   spec.token_regexes_ignore.end()) {
+			tokens.push_back(token);
+		}
+	}
+
+	return tokens;
+}
+
+}  // namespace
+
+auto operator new(std::size_t size) -> void* {
+	++allocations;
+
+	auto* const memory =
+		static_cast<unsigned char*>(std::malloc(size_header + size));
+	if(memory == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	*reinterpret_cast<std::size_t*>(memory) = size;
+	const std::size_t live = live_bytes += size;
+	std::size_t peak = peak_bytes;
+	while(live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+	}
+
+	return memory + size_header;
+}
+
+auto operator delete(void* memory) noexcept -> void {
+	if(memory == nullptr) {
+		return;
+	}
+
+	auto* const start = static_cast<unsigned char*>(memory) - size_header;
+	live_bytes -= *reinterpret_cast<std::size_t*>(start);
+	std::free(start);
+}
+
+auto operator delete(void* memory, std::size_t /*size*/) noexcept -> void {
+	operator delete(memory);
+}
+
+TEST_CASE("rebuilding Earley sets in warm buffers does not allocate") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	std::set<std::string> token_names;
+	for(const auto& token_regex : spec.token_regexes) {
+		token_names.insert(token_regex.first);
+	}
+
+	const Grammar grammar{spec.syntax_rules, spec.syntax_main, token_names};
+	const std::vector<Rule> rules = grammar.get_rules();
+
+	UnitChains unit_chains;
+	Disambiguation disambiguation;
+
+	SECTION("every rule") {
+	}
+	SECTION("skipped unit rules") {
+		unit_chains = find_unit_chains(rules);
+	}
+	SECTION("disambiguated") {
+		disambiguation =
+			make_disambiguation(rules, spec.syntax_disambiguation);
+	}
+
+	// the programs of test_compiler.cpp, one after the other
+	const std::vector<Token> tokens = tokenize(
+		spec,
+		"void foo() {} int compute(int y) { return 5; }"
+		"void foo() { int sum = 0; int extra = -25; sum += 5; }"
+		"int foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += i; }"
+		"  return sum; }"
+		"int foo() { if(true) { return 1; } return -1; }"
+		"int foo() { if(true) return 1; return -1; }"
+		"int foo() { if(true) { return 1; } else { return -1; } }"
+		"bool check() { return true; }"
+		"int foo() { if(check()) { return 1; } return -1; }"
+		"int foo() { while(true) { return 1; }}"
+		"int main() {\n\treturn 0;}"
+		"void foo() {}  void main() { foo(); }");
+
+	std::vector<std::vector<EarleyItem> > earley_sets;
+	rebuild_earley_items(earley_sets,
+						 rules,
+						 unit_chains,
+						 disambiguation,
+						 tokens,
+						 spec.syntax_main,
+						 0);
+	REQUIRE(earley_sets.size() == tokens.size() + 1);
+	const std::vector<std::vector<EarleyItem> > first_sets = earley_sets;
+
+	// every token is parsed again, in the state sets of the first parse
+	const std::size_t allocations_before = allocations;
+	rebuild_earley_items(earley_sets,
+						 rules,
+						 unit_chains,
+						 disambiguation,
+						 tokens,
+						 spec.syntax_main,
+						 0);
+	REQUIRE(allocations == allocations_before);
+
+	for(std::size_t i = 0; i < earley_sets.size(); ++i) {
+		REQUIRE(earley_sets[i].size() == first_sets[i].size());
+	}
+
+	// a restarted recognizer pushes the tokens into the state sets of the
+	// first input
+	EarleyRecognizer recognizer{
+		rules, spec.syntax_main, unit_chains, disambiguation};
+	for(const Token& token : tokens) {
+		REQUIRE(recognizer.push(token));
+	}
+	recognizer.restart();
+
+	const std::size_t push_allocations_before = allocations;
+	for(const Token& token : tokens) {
+		(void)recognizer.push(token);
+	}
+	REQUIRE(allocations == push_allocations_before);
+
+	REQUIRE(recognizer.is_accepted());
+	for(std::size_t i = 0; i < earley_sets.size(); ++i) {
+		REQUIRE(recognizer.get_earley_sets()[i].size() ==
+				first_sets[i].size());
+	}
+}
+
+TEST_CASE("spilling finished items keeps less of a long parse in memory") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	std::set<std::string> token_names;
+	for(const auto& token_regex : spec.token_regexes) {
+		token_names.insert(token_regex.first);
+	}
+
+	Grammar grammar{spec.syntax_rules, spec.syntax_main, token_names};
+	grammar.disambiguate(spec.syntax_disambiguation);
+	grammar.collapse_unit_chains();
+
+	std::string program_text = "int foo(int a, int b) {";
+	for(std::size_t i = 0; i < 150; ++i) {
+		program_text += " if(a < b) { a += b * 2; } else a -= 1;";
+	}
+	program_text += " return a; }";
+	const std::vector<Token> tokens = tokenize(spec, program_text);
+
+	const std::size_t parse_bytes =
+		peak_bytes_of([&]() { (void)grammar.parse(tokens); });
+
+	const std::string file_name = "test_spilled_memory.bin";
+	const std::size_t spilled_bytes = peak_bytes_of([&]() {
+		(void)grammar.parse_spilling_finished_items(tokens, file_name);
+	});
+	std::filesystem::remove(file_name);
+
+	// the tokens, the parse tree and an offset per token are still kept
+	REQUIRE(spilled_bytes > 0);
+	REQUIRE(spilled_bytes * 2 < parse_bytes);
+}
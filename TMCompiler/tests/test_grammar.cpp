@@ -0,0 +1,1303 @@
+#include <algorithm>  // std::max, std::min_element
+#include <cstdio>	  // std::remove
+#include <cstddef>	  // std::size_t
+#include <fstream>	  // std::ifstream
+#include <set>		  // std::set
+#include <stdexcept>  // std::invalid_argument, std::logic_error
+#include <string>	  // std::string, std::to_string
+#include <tuple>	  // std::tuple
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/lexer/lexer.hpp>	// Lexer
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // make_disambiguation, DisambiguationRules, PrecedenceLevel
+#include <TMCompiler/compiler/models/grammar.hpp>			// Grammar
+#include <TMCompiler/compiler/models/grammar_analysis.hpp>	// GrammarAnalysis
+#include <TMCompiler/compiler/models/grammar_normalization.hpp>	 // NormalizedRules, normalize_rules
+#include <TMCompiler/compiler/models/grammar_repetition.hpp>  // expand_repetitions
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>	  // GrammarSymbol
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/parse_profile.hpp>	 // add_to_profile, rank_rules, read_parse_profile, write_parse_profile, ParseProfile
+#include <TMCompiler/compiler/models/rule.hpp>	 // Rule
+#include <TMCompiler/compiler/models/token.hpp>	 // Token
+#include <TMCompiler/compiler/parser/bitset_recognizer.hpp>	 // fits_bitset_recognizer, make_bitset_grammar, BitsetRecognizer
+#include <TMCompiler/compiler/parser/earley_parser.hpp>	 // build_earley_items, Disambiguation, EarleyItem, EarleyRecognizer, IncrementalParseState, ParseEvents, SubParse, UnitChains
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseBudgetExceeded, ParseStatistics
+#include <TMCompiler/utils/logger/logger.hpp>  // logger
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+auto tokenize(const LanguageSpecification& spec,
+			  const std::string& program_text) -> std::vector<Token> {
+	Lexer lexer{spec.token_regexes};
+	lexer.set_text(program_text);
+
+	std::vector<Token> tokens;
+	while(lexer.has_next_token()) {
+		const Token token = lexer.get_next_token();
+		if(spec.token_regexes_ignore.find(token.type) ==
+		   spec.token_regexes_ignore.end()) {
+			tokens.push_back(token);
+		}
+	}
+
+	return tokens;
+}
+
+auto make_grammar(const LanguageSpecification& spec) -> Grammar {
+	std::set<std::string> token_names;
+	for(const auto& token_regex : spec.token_regexes) {
+		token_names.insert(token_regex.first);
+	}
+
+	return Grammar{spec.syntax_rules, spec.syntax_main, token_names};
+}
+
+auto nonterminal(const std::string& value) -> GrammarSymbol {
+	return GrammarSymbol{value, false};
+}
+
+auto terminal(const std::string& value) -> GrammarSymbol {
+	return GrammarSymbol{value, true};
+}
+
+auto same_tree(const std::vector<SubParse>& tree1,
+			   const std::vector<SubParse>& tree2) -> bool {
+	if(tree1.size() != tree2.size()) {
+		return false;
+	}
+
+	for(std::size_t i = 0; i < tree1.size(); ++i) {
+		if(tree1[i].rule != tree2[i].rule || tree1[i].start != tree2[i].start ||
+		   tree1[i].end != tree2[i].end || tree1[i].parent != tree2[i].parent) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// (rule, start, end) of each SubParse of a parse tree, in document order
+auto document_order(const std::vector<SubParse>& tree)
+	-> std::vector<std::tuple<std::size_t, std::size_t, std::size_t> > {
+	std::vector<std::vector<std::size_t> > children(tree.size());
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		children[tree[i].parent].push_back(i);
+	}
+
+	std::vector<std::tuple<std::size_t, std::size_t, std::size_t> > order;
+	std::vector<std::size_t> pending{0};
+	while(!pending.empty() && !tree.empty()) {
+		const std::size_t location = pending.back();
+		pending.pop_back();
+		order.emplace_back(
+			tree[location].rule, tree[location].start, tree[location].end);
+		pending.insert(pending.end(),
+					   children[location].rbegin(),
+					   children[location].rend());
+	}
+
+	return order;
+}
+
+}  // namespace
+
+TEST_CASE("reparse matches full parse") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	const std::string original =
+		"int foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += "
+		"i; } return sum; }";
+	std::string edited;
+	// input that fails to parse between the original and the edit, or empty
+	std::string broken;
+
+	SECTION("edit_near_end") {
+		edited =
+			"int foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += "
+			"i; } return sum + 1; }";
+	}
+	SECTION("edit_at_start") {
+		edited =
+			"bool foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += "
+			"i; } return sum; }";
+	}
+	SECTION("append_function") {
+		edited = original + " void bar() { foo(); }";
+	}
+	SECTION("remove_statement") {
+		edited = "int foo() { int sum = 0; return sum; }";
+	}
+	SECTION("unchanged") {
+		edited = original;
+	}
+	SECTION("syntax_error_then_edit") {
+		broken =
+			"int foo() { int sum = ; for(int i = 0; i < 10; i += 1) { sum += "
+			"i; } return sum; }";
+		edited =
+			"int foo() { int sum = 0; for(int i = 0; i < 10; i += 1) { sum += "
+			"i; } return sum + 1; }";
+	}
+
+	IncrementalParseState state;
+	const std::vector<SubParse> first =
+		grammar.reparse(tokenize(spec, original), state);
+	REQUIRE(same_tree(first, grammar.parse(tokenize(spec, original))));
+
+	// a failed reparse leaves no state that the next reparse could trust
+	if(!broken.empty()) {
+		REQUIRE_THROWS_AS(grammar.reparse(tokenize(spec, broken), state),
+						  std::logic_error);
+	}
+
+	const std::vector<Token> edited_tokens = tokenize(spec, edited);
+	const std::vector<SubParse> second = grammar.reparse(edited_tokens, state);
+	REQUIRE(same_tree(second, grammar.parse(edited_tokens)));
+	REQUIRE(state.earley_sets.size() == 1 + edited_tokens.size());
+}
+
+TEST_CASE("reparse of an edit near the end does little work") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	std::string original;
+	for(int i = 0; i < 40; ++i) {
+		original += "int foo" + std::to_string(i) +
+					"(int a) { int sum = 0; while(sum < a) { sum += 1; } "
+					"return sum; } ";
+	}
+	const std::string edited = original + "void main() { foo0(1); }";
+	original += "void main() { foo1(1); }";
+
+	IncrementalParseState state;
+	(void)grammar.reparse(tokenize(spec, original), state);
+
+	const std::vector<Token> edited_tokens = tokenize(spec, edited);
+	ParseStatistics full;
+	const std::vector<SubParse> tree = grammar.parse(edited_tokens, full);
+
+	REQUIRE(same_tree(grammar.reparse(edited_tokens, state), tree));
+	REQUIRE(state.statistics.earley_sets < full.earley_sets / 10);
+	REQUIRE(state.statistics.items < full.items / 10);
+	REQUIRE(state.statistics.search_steps < full.search_steps / 10);
+
+	// the index of the new tree finds every SubParse
+	REQUIRE(state.subtrees.size() == state.tree.size());
+	REQUIRE(state.children_begin.size() == 1 + state.tree.size());
+
+	// and the next edit reuses it
+	const std::vector<Token> again_tokens =
+		tokenize(spec, original + "void bar() { }");
+	REQUIRE(same_tree(grammar.reparse(again_tokens, state),
+					  grammar.parse(again_tokens)));
+}
+
+TEST_CASE("recognizer stops at first bad token") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	const std::vector<Token> tokens =
+		tokenize(spec, "void foo() { int x = ; return; }");
+
+	EarleyRecognizer recognizer = grammar.make_recognizer();
+	std::size_t pushed = 0;
+	while(pushed < tokens.size() && recognizer.push(tokens[pushed])) {
+		++pushed;
+	}
+
+	// "void foo ( ) { int x =" are fine, but ";" cannot follow "="
+	REQUIRE(pushed == 8);
+	REQUIRE(tokens[pushed].value == ";");
+	REQUIRE(!recognizer.is_accepted());
+}
+
+TEST_CASE("recognizer accepts complete program") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	const std::vector<Token> tokens =
+		tokenize(spec, "void foo() {}  void main() { foo(); }");
+
+	EarleyRecognizer recognizer = grammar.make_recognizer();
+	for(const Token& token : tokens) {
+		REQUIRE(recognizer.push(token));
+	}
+
+	REQUIRE(recognizer.is_accepted());
+	REQUIRE(recognizer.num_tokens() == tokens.size());
+	REQUIRE(grammar.parse(recognizer, tokens).size() ==
+			grammar.parse(tokens).size());
+}
+
+TEST_CASE("recognizer that only checks syntax clears unneeded sets") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	std::string program_text = "void foo() {";
+	for(std::size_t i = 0; i < 200; ++i) {
+		program_text += " x += 1;";
+	}
+	program_text += " }";
+	const std::vector<Token> tokens = tokenize(spec, program_text);
+
+	EarleyRecognizer checker = grammar.make_recognizer();
+	checker.keep_needed_sets_only();
+	EarleyRecognizer recognizer = grammar.make_recognizer();
+	for(const Token& token : tokens) {
+		REQUIRE(checker.push(token));
+		REQUIRE(recognizer.push(token));
+	}
+
+	REQUIRE(checker.is_accepted());
+	REQUIRE(checker.num_tokens() == tokens.size());
+
+	// the statements of the block only need the state sets where the
+	// function and the block start, and the ones since the last clear
+	std::size_t kept = 0;
+	for(const std::vector<EarleyItem>& earley_set : checker.get_earley_sets()) {
+		kept += earley_set.empty() ? 0 : 1;
+	}
+	REQUIRE(kept < tokens.size() / 2);
+	REQUIRE(checker.get_earley_sets().back().size() ==
+			recognizer.get_earley_sets().back().size());
+}
+
+TEST_CASE("bit-parallel recognizer agrees with the Earley recognizer") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+
+	std::string program_text;
+	bool collapsed = true;
+	SECTION("valid program") {
+		program_text =
+			"int foo(int y) { int sum = -y * 2 + 3; for(int i = 0; i < 10; i "
+			"+= 1) { sum += i; } return sum; }";
+	}
+	SECTION("dangling else") {
+		program_text =
+			"int foo() { if(true) if(false) return 1; else return 2; return "
+			"3; }";
+	}
+	SECTION("syntax error") {
+		program_text = "void foo() { int x = ; return; }";
+	}
+	SECTION("program ends too early") {
+		program_text = "void foo() { while(true) {";
+	}
+	SECTION("without collapsed unit chains") {
+		collapsed = false;
+		program_text = "void foo() {}  void main() { foo(); }";
+	}
+
+	if(collapsed) {
+		grammar.collapse_unit_chains();
+	}
+
+	REQUIRE(grammar.fits_bitset_recognizer());
+
+	const std::vector<Token> tokens = tokenize(spec, program_text);
+	EarleyRecognizer recognizer = grammar.make_recognizer();
+	BitsetRecognizer bitset_recognizer = grammar.make_bitset_recognizer();
+	for(const Token& token : tokens) {
+		const bool valid = recognizer.push(token);
+		REQUIRE(bitset_recognizer.push(token) == valid);
+		if(!valid) {
+			break;
+		}
+	}
+
+	REQUIRE(bitset_recognizer.num_tokens() == recognizer.num_tokens());
+	REQUIRE(bitset_recognizer.is_accepted() == recognizer.is_accepted());
+}
+
+TEST_CASE("bit-parallel recognizer needs non-empty rules") {
+	const std::vector<Rule> rules{
+		Rule{nonterminal("list"), {nonterminal("list"), terminal("x")}},
+		Rule{nonterminal("list"), {}},
+	};
+
+	REQUIRE(!fits_bitset_recognizer(rules));
+	REQUIRE_THROWS_AS(
+		make_bitset_grammar(rules, UnitChains{}, Disambiguation{}, "list"),
+		std::invalid_argument);
+}
+
+TEST_CASE("grammar analysis removes unused rules") {
+	logger.set_level("NONE");
+
+	const std::vector<Rule> rules{
+		Rule{nonterminal("s"), {nonterminal("a"), terminal("x")}},
+		Rule{nonterminal("s"), {nonterminal("b")}},
+		Rule{nonterminal("s"), {nonterminal("identifier")}},
+		Rule{nonterminal("a"), {terminal("a")}},
+		Rule{nonterminal("a"), {}},
+		Rule{nonterminal("a"), {terminal("a")}},
+		Rule{nonterminal("b"), {nonterminal("b"), terminal("y")}},
+		Rule{nonterminal("c"), {terminal("c")}},
+	};
+
+	const Grammar grammar{rules, "s", std::set<std::string>{"identifier"}};
+	const GrammarAnalysis& analysis = grammar.get_analysis();
+
+	SECTION("lexical symbols become terminal") {
+		REQUIRE(analysis.terminals.count("identifier") == 1);
+		REQUIRE(analysis.nonterminals.count("identifier") == 0);
+	}
+
+	SECTION("dead and duplicate rules are removed") {
+		const std::vector<Rule> remaining = grammar.get_rules();
+		REQUIRE(remaining.size() == 4);
+		for(const Rule& rule : remaining) {
+			REQUIRE(rule.production.value != "b");
+			REQUIRE(rule.production.value != "c");
+		}
+
+		REQUIRE(analysis.reachable == std::set<std::string>{"s", "a"});
+		REQUIRE(analysis.nonproductive_rules.empty());
+		REQUIRE(analysis.unreachable_rules.empty());
+		REQUIRE(analysis.duplicate_rules.empty());
+	}
+
+	SECTION("nullable, first and follow") {
+		REQUIRE(analysis.nullable == std::set<std::string>{"a"});
+		REQUIRE(analysis.first.at("s") ==
+				std::set<std::string>{"a", "x", "identifier"});
+		REQUIRE(analysis.first.at("a") == std::set<std::string>{"a"});
+		REQUIRE(analysis.follow.at("a") == std::set<std::string>{"x"});
+		REQUIRE(analysis.follow.at("s") ==
+				std::set<std::string>{GrammarAnalysis::end_of_input});
+	}
+
+	SECTION("start symbol that derives nothing") {
+		REQUIRE_THROWS_AS((Grammar{rules, "b", std::set<std::string>{}}),
+						  std::invalid_argument);
+	}
+}
+
+TEST_CASE("language grammar has no unused rules") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	REQUIRE(grammar.get_rules().size() ==
+			expand_repetitions(spec.syntax_rules).rules.size());
+	REQUIRE(grammar.get_analysis().reachable ==
+			grammar.get_analysis().nonterminals);
+}
+
+TEST_CASE("collapsed unit chains expand to the full parse") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+	Grammar collapsed_grammar = make_grammar(spec);
+	collapsed_grammar.collapse_unit_chains();
+
+	const std::vector<Token> tokens =
+		tokenize(spec,
+				 "int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3;"
+				 "  c = foo(a, b)[1] ^ c | 4; return a == b != (c >= 1); }"
+				 "void main() { int x = 1; x = -x; if(x < 2) { x = 3; } }");
+
+	const std::vector<SubParse> full = grammar.parse(tokens);
+	const std::vector<SubParse> collapsed = collapsed_grammar.parse(tokens);
+
+	SECTION("collapsed tree is smaller") {
+		REQUIRE(2 * collapsed.size() < full.size());
+	}
+
+	SECTION("expanding restores every unit rule") {
+		REQUIRE(same_tree(collapsed_grammar.expand_unit_chains(collapsed),
+						  full));
+		REQUIRE(same_tree(grammar.expand_unit_chains(full), full));
+	}
+
+	SECTION("recognizer and reparse skip the same rules") {
+		EarleyRecognizer recognizer = collapsed_grammar.make_recognizer();
+		for(const Token& token : tokens) {
+			REQUIRE(recognizer.push(token));
+		}
+		REQUIRE(recognizer.is_accepted());
+		REQUIRE(same_tree(collapsed_grammar.parse(recognizer, tokens),
+						  collapsed));
+
+		IncrementalParseState state;
+		REQUIRE(same_tree(collapsed_grammar.reparse(tokens, state), collapsed));
+	}
+}
+
+TEST_CASE("normalized rules parse to the original tree") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const Grammar grammar = make_grammar(spec);
+
+	const std::vector<Token> tokens =
+		tokenize(spec,
+				 "int foo(int a, int b) { if(a <= b) { return a; } else"
+				 "  { return b; } } void main() { int x = foo(1, 2);"
+				 "  while(x >= 0) { x = x - 1; if(x != 3) x = x % 2; } }");
+
+	const std::vector<SubParse> full = grammar.parse(tokens);
+
+	SECTION("left factoring and binarization keep the parse") {
+		for(const std::size_t max_rule_length :
+			std::vector<std::size_t>{100, 4, 2}) {
+			Grammar normalized_grammar = make_grammar(spec);
+			normalized_grammar.normalize_rules(max_rule_length);
+			REQUIRE(same_tree(normalized_grammar.parse(tokens), full));
+		}
+	}
+
+	SECTION("normalized rules are short and helpers are hidden") {
+		const NormalizedRules normalized =
+			normalize_rules(grammar.get_rules(), 2);
+		REQUIRE(!normalized.helpers.empty());
+		for(const Rule& rule : normalized.rules) {
+			REQUIRE(rule.replacement.size() <= 2);
+		}
+
+		Grammar normalized_grammar = make_grammar(spec);
+		normalized_grammar.normalize_rules(2);
+		const std::vector<SubParse> tree = normalized_grammar.parse(tokens);
+		for(const SubParse& node : tree) {
+			REQUIRE(node.rule < grammar.get_rules().size());
+		}
+	}
+
+	SECTION("normalized rules compose with collapsed unit chains") {
+		Grammar normalized_grammar = make_grammar(spec);
+		normalized_grammar.normalize_rules(3);
+		normalized_grammar.collapse_unit_chains();
+
+		const std::vector<SubParse> collapsed = normalized_grammar.parse(tokens);
+		REQUIRE(same_tree(normalized_grammar.expand_unit_chains(collapsed),
+						  full));
+
+		IncrementalParseState state;
+		REQUIRE(same_tree(normalized_grammar.reparse(tokens, state), collapsed));
+	}
+}
+
+TEST_CASE("parse tree of a million-token function body") {
+	logger.set_level("NONE");
+
+	// statements are left-recursive here: with the right-recursive
+	// <statements> of language.toml, Earley recognition is quadratic in the
+	// number of statements of a block
+	const std::vector<Rule> rules{
+		Rule{nonterminal("function"),
+			 {terminal("int"),
+			  terminal("identifier"),
+			  terminal("("),
+			  terminal(")"),
+			  nonterminal("block")}},
+		Rule{nonterminal("block"),
+			 {terminal("{"), nonterminal("statements"), terminal("}")}},
+		Rule{nonterminal("statements"),
+			 {nonterminal("statements"), nonterminal("statement")}},
+		Rule{nonterminal("statements"), {nonterminal("statement")}},
+		Rule{nonterminal("statement"),
+			 {terminal("identifier"),
+			  terminal("="),
+			  terminal("identifier"),
+			  terminal(";")}},
+		Rule{nonterminal("statement"), {nonterminal("block")}},
+	};
+
+	const Grammar grammar{rules, "function"};
+
+	const auto token = [](const std::string& type, const std::string& value) {
+		return Token{type, value, 0, 0};
+	};
+
+	const auto add_assignment = [&](std::vector<Token>& tokens) {
+		tokens.push_back(token("identifier", "x"));
+		tokens.push_back(token("=", "="));
+		tokens.push_back(token("identifier", "y"));
+		tokens.push_back(token(";", ";"));
+	};
+
+	// blocks nested inside each other, each with an assignment before and
+	// after the inner block: the parse tree is as deep as the input is long
+	const std::size_t depth = 100000;
+	std::vector<Token> tokens{token("int", "int"),
+							  token("identifier", "main"),
+							  token("(", "("),
+							  token(")", ")")};
+	for(std::size_t level = 0; level < depth; ++level) {
+		tokens.push_back(token("{", "{"));
+		add_assignment(tokens);
+	}
+	for(std::size_t level = 0; level < depth; ++level) {
+		add_assignment(tokens);
+		tokens.push_back(token("}", "}"));
+	}
+
+	REQUIRE(tokens.size() >= 1000000);
+
+	const std::vector<SubParse> tree = grammar.parse(tokens);
+
+	// function, then per level a block, 3 <statements> and 3 <statement>: 2
+	// assignments and the inner block. The innermost block has no inner one.
+	REQUIRE(tree.size() == 1 + 7 * depth - 2);
+	REQUIRE(tree[0].start == 0);
+	REQUIRE(tree[0].end == tokens.size());
+
+	std::size_t deepest = 0;
+	std::vector<std::size_t> depths(tree.size(), 0);
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		REQUIRE(tree[i].parent < i);
+		depths[i] = 1 + depths[tree[i].parent];
+		deepest = std::max(deepest, depths[i]);
+	}
+
+	REQUIRE(deepest > depth);
+}
+
+TEST_CASE("parse events follow the parse tree in document order") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::vector<Token> tokens =
+		tokenize(spec,
+				 "int foo(int a, int b) { if(a <= b) { return a; } else"
+				 "  { return b * 2 + a; } } void main() { int x = foo(1, 2);"
+				 "  while(x >= 0) { x = x - 1; if(x != 3) x = x % 2; } }");
+
+	Grammar grammar = make_grammar(spec);
+
+	const auto check_events = [&]() {
+		std::vector<std::tuple<std::size_t, std::size_t, std::size_t> >
+			entered;
+		std::vector<std::tuple<std::size_t, std::size_t, std::size_t> > open;
+		std::size_t next_token = 0;
+		bool balanced = true;
+
+		ParseEvents events;
+		events.enter_rule = [&](const std::size_t rule,
+								const std::size_t start,
+								const std::size_t end) {
+			entered.emplace_back(rule, start, end);
+			open.emplace_back(rule, start, end);
+		};
+		events.visit_token = [&](const Token& token,
+								 const std::size_t location) {
+			balanced = balanced && location == next_token &&
+					   token.value == tokens[location].value;
+			++next_token;
+		};
+		events.exit_rule = [&](const std::size_t rule,
+							   const std::size_t start,
+							   const std::size_t end) {
+			balanced = balanced && !open.empty() &&
+					   open.back() == std::make_tuple(rule, start, end);
+			open.pop_back();
+		};
+
+		grammar.walk_parse_tree(tokens, events);
+
+		REQUIRE(balanced);
+		REQUIRE(open.empty());
+		REQUIRE(next_token == tokens.size());
+		REQUIRE(entered == document_order(grammar.parse(tokens)));
+	};
+
+	SECTION("every rule") {
+		check_events();
+	}
+
+	SECTION("collapsed unit chains") {
+		grammar.collapse_unit_chains();
+		check_events();
+	}
+
+	SECTION("normalized rules") {
+		grammar.normalize_rules(2);
+		check_events();
+
+		// the children that a rule's report looks down to are not searched
+		// for again when they are walked
+		ParseStatistics statistics;
+		(void)grammar.parse(tokens, statistics);
+		ParseBudget budget;
+		budget.max_search_steps = statistics.search_steps;
+		grammar.set_parse_budget(budget);
+		grammar.walk_parse_tree(tokens, ParseEvents{});
+	}
+
+	SECTION("normalized rules and collapsed unit chains") {
+		grammar.normalize_rules(3);
+		grammar.collapse_unit_chains();
+		check_events();
+	}
+
+	SECTION("callbacks may be left empty") {
+		std::size_t identifiers = 0;
+		ParseEvents events;
+		events.visit_token = [&](const Token& token, const std::size_t) {
+			identifiers += token.type == "identifier" ? 1 : 0;
+		};
+
+		grammar.walk_parse_tree(tokens, events);
+
+		std::size_t expected = 0;
+		for(const Token& token : tokens) {
+			expected += token.type == "identifier" ? 1 : 0;
+		}
+		REQUIRE(identifiers == expected);
+		REQUIRE(identifiers > 0);
+	}
+}
+
+TEST_CASE("precedence and associativity choose the expression tree") {
+	logger.set_level("NONE");
+
+	// one ambiguous non-terminal for every operator, as operator precedence
+	// parsers expect
+	const auto binary = [](const std::string& op) {
+		return Rule{nonterminal("expression"),
+					{nonterminal("expression"),
+					 terminal(op),
+					 nonterminal("expression")}};
+	};
+	const std::vector<Rule> rules{
+		binary("+"),
+		binary("-"),
+		binary("*"),
+		binary("^"),
+		Rule{nonterminal("expression"),
+			 {terminal("("), nonterminal("expression"), terminal(")")}},
+		Rule{nonterminal("expression"), {terminal("identifier")}},
+	};
+	const std::size_t plus = 0;
+	const std::size_t minus = 1;
+	const std::size_t times = 2;
+	const std::size_t power = 3;
+	const std::size_t identifier = 5;
+
+	DisambiguationRules declarations;
+	declarations.precedence = {
+		PrecedenceLevel{"left", {binary("+"), binary("-")}},
+		PrecedenceLevel{"left", {binary("*")}},
+		PrecedenceLevel{"right", {binary("^")}},
+	};
+
+	// a - b - c * d ^ e ^ f
+	std::vector<Token> tokens;
+	for(const std::string& value :
+		{"a", "-", "b", "-", "c", "*", "d", "^", "e", "^", "f"}) {
+		tokens.push_back(Token{
+			value.size() == 1 && value[0] >= 'a' ? "identifier" : value,
+			value,
+			0,
+			0});
+	}
+
+	// ((a - b) - (c * (d ^ (e ^ f))))
+	const std::vector<std::tuple<std::size_t, std::size_t, std::size_t> >
+		expected{
+			{minus, 0, 11},
+			{minus, 0, 3},
+			{identifier, 0, 1},
+			{identifier, 2, 3},
+			{times, 4, 11},
+			{identifier, 4, 5},
+			{power, 6, 11},
+			{identifier, 6, 7},
+			{power, 8, 11},
+			{identifier, 8, 9},
+			{identifier, 10, 11},
+		};
+
+	Grammar grammar{rules, "expression"};
+	grammar.disambiguate(declarations);
+
+	SECTION("parse") {
+		REQUIRE(document_order(grammar.parse(tokens)) == expected);
+	}
+
+	SECTION("normalized rules") {
+		grammar.normalize_rules(2);
+		REQUIRE(document_order(grammar.parse(tokens)) == expected);
+	}
+
+	SECTION("recognizer and reparse") {
+		EarleyRecognizer recognizer = grammar.make_recognizer();
+		for(const Token& token : tokens) {
+			REQUIRE(recognizer.push(token));
+		}
+		REQUIRE(document_order(grammar.parse(recognizer, tokens)) == expected);
+
+		IncrementalParseState state;
+		std::vector<Token> edited = tokens;
+		edited[3] = Token{"+", "+", 0, 0};
+		REQUIRE(!grammar.reparse(edited, state).empty());
+		REQUIRE(document_order(grammar.reparse(tokens, state)) == expected);
+	}
+
+	SECTION("rejected parses are never recognized") {
+		const Disambiguation disambiguation =
+			make_disambiguation(rules, declarations);
+		REQUIRE(disambiguation.rejected_children[minus][0].count(plus) == 0);
+		REQUIRE(disambiguation.rejected_children[minus][2].count(plus) == 1);
+		REQUIRE(disambiguation.rejected_children[times][0].count(plus) == 1);
+		REQUIRE(disambiguation.rejected_children[power][0].count(power) == 1);
+		REQUIRE(disambiguation.rejected_children[power][2].count(power) == 0);
+
+		std::size_t ambiguous_items = 0;
+		for(const std::vector<EarleyItem>& earley_set :
+			build_earley_items(rules, tokens, "expression")) {
+			ambiguous_items += earley_set.size();
+		}
+
+		std::size_t items = 0;
+		for(const std::vector<EarleyItem>& earley_set :
+			build_earley_items(
+				rules, tokens, "expression", UnitChains{}, disambiguation)) {
+			items += earley_set.size();
+		}
+
+		REQUIRE(items < ambiguous_items);
+	}
+
+	SECTION("declared rules must be rules of the grammar") {
+		declarations.precedence.push_back(
+			PrecedenceLevel{"left", {binary("/")}});
+		REQUIRE_THROWS_AS(grammar.disambiguate(declarations),
+						  std::invalid_argument);
+
+		declarations.precedence.pop_back();
+		declarations.precedence[0].associativity = "up";
+		REQUIRE_THROWS_AS(grammar.disambiguate(declarations),
+						  std::invalid_argument);
+	}
+}
+
+TEST_CASE("else belongs to the nearest if") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const std::vector<Token> tokens = tokenize(
+		spec, "void main() { if(a) if(b) x = 1; else x = 2; x = 3; }");
+
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+
+	std::size_t if_else = 0;
+	const std::vector<Rule> rules = grammar.get_rules();
+	while(if_else < rules.size() &&
+		  !(rules[if_else].production.value == "selection-statement" &&
+			rules[if_else].replacement.size() == 7)) {
+		++if_else;
+	}
+	REQUIRE(if_else < rules.size());
+
+	// the inner if starts at token 9: void main ( ) { if ( a ) if
+	const auto check_tree = [&](const std::vector<SubParse>& tree) {
+		std::vector<std::size_t> starts;
+		for(const SubParse& sub_parse : tree) {
+			if(sub_parse.rule == if_else) {
+				starts.push_back(sub_parse.start);
+			}
+		}
+		REQUIRE(starts == std::vector<std::size_t>{9});
+	};
+
+	SECTION("parse") {
+		check_tree(grammar.parse(tokens));
+	}
+
+	SECTION("collapsed unit chains and normalized rules") {
+		grammar.collapse_unit_chains();
+		grammar.normalize_rules(3);
+		check_tree(grammar.parse(tokens));
+	}
+
+	SECTION("recognizer") {
+		EarleyRecognizer recognizer = grammar.make_recognizer();
+		for(const Token& token : tokens) {
+			REQUIRE(recognizer.push(token));
+		}
+		REQUIRE(recognizer.is_accepted());
+		check_tree(grammar.parse(recognizer, tokens));
+	}
+
+	SECTION("reparse after adding the else") {
+		IncrementalParseState state;
+		REQUIRE(!grammar
+					 .reparse(tokenize(spec,
+									   "void main() { if(a) if(b) x = 1; x "
+									   "= 2; x = 3; }"),
+							  state)
+					 .empty());
+		check_tree(grammar.reparse(tokens, state));
+	}
+}
+
+TEST_CASE("repetitions parse to flat lists") {
+	logger.set_level("NONE");
+
+	// list ::= "[" <element>* "]"
+	const std::vector<Rule> rules{
+		Rule{nonterminal("list"),
+			 {terminal("["),
+			  GrammarSymbol{"element", false, '*'},
+			  terminal("]")}},
+		Rule{nonterminal("element"), {terminal("x")}},
+		Rule{nonterminal("element"), {nonterminal("list")}},
+	};
+
+	std::vector<Token> tokens;
+	for(const std::string& value : {"[", "x", "[", "]", "x", "x", "]"}) {
+		tokens.push_back(Token{value, value, 0, 0});
+	}
+
+	Grammar grammar{rules, "list"};
+	const std::vector<SubParse> tree = grammar.parse(tokens);
+
+	SECTION("a list is one SubParse with a child per element") {
+		std::vector<std::size_t> children(tree.size(), 0);
+		for(std::size_t i = 1; i < tree.size(); ++i) {
+			++children[tree[i].parent];
+		}
+
+		REQUIRE(children[0] == 4);
+		for(const SubParse& sub_parse : tree) {
+			REQUIRE(grammar.get_rules()[sub_parse.rule].production.value !=
+					"element+");
+		}
+	}
+
+	SECTION("collapsed unit chains expand to the same tree") {
+		grammar.collapse_unit_chains();
+		REQUIRE(same_tree(grammar.expand_unit_chains(grammar.parse(tokens)),
+						  tree));
+	}
+
+	SECTION("normalized rules") {
+		grammar.normalize_rules(2);
+		REQUIRE(same_tree(grammar.parse(tokens), tree));
+	}
+
+	SECTION("walk") {
+		std::vector<std::tuple<std::size_t, std::size_t, std::size_t> >
+			entered;
+		ParseEvents events;
+		events.enter_rule = [&](const std::size_t rule,
+								const std::size_t start,
+								const std::size_t end) {
+			entered.emplace_back(rule, start, end);
+		};
+
+		grammar.walk_parse_tree(tokens, events);
+		REQUIRE(entered == document_order(tree));
+	}
+
+	SECTION("one list per alternative") {
+		const std::vector<Rule> two_lists{
+			Rule{nonterminal("list"),
+				 {GrammarSymbol{"element", false, '+'},
+				  GrammarSymbol{"element", false, '*'}}},
+			Rule{nonterminal("element"), {terminal("x")}},
+		};
+		REQUIRE_THROWS_AS((Grammar{two_lists, "list"}), std::invalid_argument);
+	}
+}
+
+TEST_CASE("statements of a block are one list") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::size_t statements = 1000;
+	std::string program = "void main() { int x = 0;";
+	for(std::size_t i = 1; i < statements; ++i) {
+		program += " x = x + 1;";
+	}
+	program += " foo(x, 1, 2); }";
+
+	Grammar grammar = make_grammar(spec);
+	grammar.collapse_unit_chains();
+	const std::vector<Rule> rules = grammar.get_rules();
+	const std::vector<SubParse> tree =
+		grammar.expand_unit_chains(grammar.parse(tokenize(spec, program)));
+
+	std::vector<std::size_t> children(tree.size(), 0);
+	std::vector<std::size_t> depths(tree.size(), 0);
+	std::size_t deepest = 0;
+	for(std::size_t i = 1; i < tree.size(); ++i) {
+		++children[tree[i].parent];
+		depths[i] = 1 + depths[tree[i].parent];
+		deepest = std::max(deepest, depths[i]);
+	}
+
+	std::size_t lists = 0;
+	for(std::size_t i = 0; i < tree.size(); ++i) {
+		const std::string& production = rules[tree[i].rule].production.value;
+		if(production == "statements") {
+			REQUIRE(children[i] == 1 + statements);
+			++lists;
+		} else if(production == "argument-list") {
+			REQUIRE(children[i] == 3);
+			++lists;
+		}
+	}
+
+	REQUIRE(lists == 2);
+	REQUIRE(deepest < 50);
+}
+
+TEST_CASE("precedence parser finds the same parse trees as the Earley parser") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::vector<Token> tokens = tokenize(
+		spec,
+		"int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3, d = -a * b;"
+		"  c = foo(a, b)[1] ^ c | d & 4; a[0] = b = foo(c)(d)[a[b]];"
+		"  c = - - a % +b / !c; foo(); while(a <= b && !(a > b)) a -= 1;"
+		"  return a == b != (c >= d); }"
+		"void main() { if(foo(1, 2) < 3) if(1) foo(); else foo(); }");
+
+	Grammar grammar = make_grammar(spec);
+	Grammar precedence_grammar = make_grammar(spec);
+	precedence_grammar.embed_precedence_parser("expression");
+
+	SECTION("full trees") {
+		REQUIRE(same_tree(precedence_grammar.parse(tokens),
+						  grammar.parse(tokens)));
+	}
+
+	SECTION("collapsed unit chains") {
+		grammar.collapse_unit_chains();
+		precedence_grammar.collapse_unit_chains();
+		REQUIRE(same_tree(precedence_grammar.parse(tokens),
+						  grammar.parse(tokens)));
+	}
+
+	SECTION("disambiguated statements") {
+		grammar.disambiguate(spec.syntax_disambiguation);
+		precedence_grammar.disambiguate(spec.syntax_disambiguation);
+		REQUIRE(same_tree(precedence_grammar.parse(tokens),
+						  grammar.parse(tokens)));
+	}
+
+	SECTION("syntax errors are still found") {
+		const std::vector<Token> bad_tokens =
+			tokenize(spec, "void main() { foo(1 +); }");
+		REQUIRE_THROWS_AS(precedence_grammar.parse(bad_tokens),
+						  std::logic_error);
+	}
+}
+
+TEST_CASE("precedence parser needs left recursion it can climb") {
+	logger.set_level("NONE");
+
+	// <list> ::= <item> "," ; <item> ::= <list> "x" | "y": left recursion
+	// through <item>, which is not a unit rule of <list>
+	const std::vector<Rule> indirect = {
+		Rule{nonterminal("list"), {nonterminal("item"), terminal(",")}},
+		Rule{nonterminal("item"), {nonterminal("list"), terminal("x")}},
+		Rule{nonterminal("item"), {terminal("y")}},
+	};
+
+	Grammar indirect_grammar{indirect, "list"};
+	REQUIRE_THROWS_AS(indirect_grammar.embed_precedence_parser("list"),
+					  std::invalid_argument);
+
+	const std::vector<Rule> nullable = {
+		Rule{nonterminal("list"), {nonterminal("list"), terminal("x")}},
+		Rule{nonterminal("list"), {}},
+	};
+
+	Grammar nullable_grammar{nullable, "list"};
+	REQUIRE_THROWS_AS(nullable_grammar.embed_precedence_parser("list"),
+					  std::invalid_argument);
+}
+
+TEST_CASE("parse profile orders the search without changing the parse") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::vector<Token> tokens = tokenize(
+		spec,
+		"int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3;"
+		"  while(a < b) { a += 1; if(a == c) return a; else c -= 1; }"
+		"  return foo(a, b)[c]; }");
+
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+	grammar.collapse_unit_chains();
+	const std::vector<SubParse> tree = grammar.parse(tokens);
+
+	ParseProfile profile;
+	add_to_profile(profile, grammar.get_rules(), tree);
+	REQUIRE_FALSE(profile.rule_uses.empty());
+
+	SECTION("profiled parse") {
+		Grammar profiled_grammar = make_grammar(spec);
+		profiled_grammar.disambiguate(spec.syntax_disambiguation);
+		profiled_grammar.collapse_unit_chains();
+		profiled_grammar.use_parse_profile(profile);
+		REQUIRE(same_tree(profiled_grammar.parse(tokens), tree));
+	}
+
+	SECTION("saved profile") {
+		const std::string file_name = "test_parse_profile.txt";
+		write_parse_profile(profile, file_name);
+		const ParseProfile saved = read_parse_profile(file_name);
+		std::remove(file_name.c_str());
+		REQUIRE(saved.rule_uses == profile.rule_uses);
+	}
+
+	SECTION("most used rules rank first") {
+		const std::vector<std::size_t> ranks =
+			rank_rules(profile, grammar.get_rules());
+		REQUIRE(ranks.size() == grammar.get_rules().size());
+		REQUIRE(*std::min_element(ranks.begin(), ranks.end()) == 0);
+	}
+}
+
+TEST_CASE("parse budget stops a parse that does too much work") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::vector<Token> tokens = tokenize(
+		spec,
+		"int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3;"
+		"  while(a < b) { a += 1; if(a == c) return a; else c -= 1; }"
+		"  return foo(a, b)[c]; }");
+
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+	const std::vector<SubParse> tree = grammar.parse(tokens);
+
+	ParseBudget budget;
+
+	SECTION("items in a state set") {
+		budget.max_items_per_set = 20;
+		grammar.set_parse_budget(budget);
+		try {
+			(void)grammar.parse(tokens);
+			FAIL("parse should go over its budget");
+		} catch(const ParseBudgetExceeded& error) {
+			REQUIRE(error.get_statistics().largest_set > 20);
+			REQUIRE(error.get_statistics().earley_sets <= tokens.size() + 1);
+		}
+	}
+
+	SECTION("items in all state sets") {
+		budget.max_items = 1000;
+		grammar.set_parse_budget(budget);
+		try {
+			(void)grammar.parse(tokens);
+			FAIL("parse should go over its budget");
+		} catch(const ParseBudgetExceeded& error) {
+			REQUIRE(error.get_statistics().items > 1000);
+			REQUIRE(error.get_statistics().earley_sets < tokens.size() + 1);
+			REQUIRE(error.get_statistics().search_steps == 0);
+		}
+	}
+
+	SECTION("parse tree search steps") {
+		budget.max_search_steps = 10;
+		grammar.set_parse_budget(budget);
+		try {
+			(void)grammar.parse(tokens);
+			FAIL("parse should go over its budget");
+		} catch(const ParseBudgetExceeded& error) {
+			REQUIRE(error.get_statistics().search_steps == 11);
+			REQUIRE(error.get_statistics().earley_sets == tokens.size() + 1);
+		}
+	}
+
+	SECTION("recognizers from the grammar") {
+		budget.max_items = 1000;
+		grammar.set_parse_budget(budget);
+		REQUIRE(grammar.fits_bitset_recognizer());
+
+		EarleyRecognizer recognizer = grammar.make_recognizer();
+		try {
+			for(const Token& token : tokens) {
+				(void)recognizer.push(token);
+			}
+			FAIL("recognizer should go over its budget");
+		} catch(const ParseBudgetExceeded& error) {
+			REQUIRE(error.get_statistics().items > 1000);
+			REQUIRE(error.get_statistics().earley_sets < tokens.size() + 1);
+		}
+
+		BitsetRecognizer bitset_recognizer = grammar.make_bitset_recognizer();
+		try {
+			for(const Token& token : tokens) {
+				(void)bitset_recognizer.push(token);
+			}
+			FAIL("bit-parallel recognizer should go over its budget");
+		} catch(const ParseBudgetExceeded& error) {
+			REQUIRE(error.get_statistics().items > 1000);
+			REQUIRE(error.get_statistics().earley_sets < tokens.size() + 1);
+		}
+	}
+
+	SECTION("enough budget") {
+		budget.max_items = 1000000;
+		budget.max_search_steps = 1000000;
+		budget.max_milliseconds = 60000;
+		grammar.set_parse_budget(budget);
+		REQUIRE(same_tree(grammar.parse(tokens), tree));
+	}
+}
+
+TEST_CASE("parse statistics count the work of a parse") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	const std::vector<Token> tokens = tokenize(
+		spec,
+		"int foo(int a, int b) { int c = a * b + (a - b) / 2 % 3;"
+		"  while(a < b) { a += 1; if(a == c) return a; else c -= 1; }"
+		"  return foo(a, b)[c]; }");
+
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+	const std::vector<SubParse> tree = grammar.parse(tokens);
+
+	ParseStatistics statistics;
+
+	SECTION("parse") {
+		REQUIRE(same_tree(grammar.parse(tokens, statistics), tree));
+		REQUIRE(statistics.predictions + statistics.scans +
+					statistics.completions ==
+				statistics.items + statistics.duplicate_items);
+	}
+	SECTION("parse after a recognizer") {
+		EarleyRecognizer recognizer = grammar.make_recognizer();
+		for(const Token& token : tokens) {
+			REQUIRE(recognizer.push(token));
+		}
+		REQUIRE(same_tree(grammar.parse(recognizer, tokens, statistics), tree));
+	}
+
+	REQUIRE(statistics.earley_sets == tokens.size() + 1);
+	REQUIRE(statistics.largest_set > 0);
+	REQUIRE(statistics.largest_set <= statistics.items);
+
+	std::size_t histogram_sets = 0;
+	for(const std::size_t sets : statistics.set_sizes) {
+		histogram_sets += sets;
+	}
+	REQUIRE(histogram_sets == statistics.earley_sets);
+
+	REQUIRE(statistics.predictions > 0);
+	REQUIRE(statistics.scans >= tokens.size());
+	REQUIRE(statistics.completions > 0);
+	// a recognizer closes a state set again when its next token is restricted
+	REQUIRE(statistics.predictions + statistics.scans +
+				statistics.completions >=
+			statistics.items + statistics.duplicate_items);
+
+	REQUIRE(statistics.search_steps > 0);
+	REQUIRE(statistics.backtracks <= statistics.search_steps);
+	REQUIRE(statistics.milliseconds * 1000 <=
+			statistics.recognition_microseconds +
+				statistics.search_microseconds);
+}
+
+TEST_CASE("parse spilling finished items finds the same parse tree") {
+	logger.set_level("NONE");
+
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	std::string program_text = "int foo(int a, int b) {";
+	for(std::size_t i = 0; i < 50; ++i) {
+		program_text += " if(a < b) { a += b * 2; } else a -= 1;";
+	}
+	program_text += " return a; }";
+	const std::vector<Token> tokens = tokenize(spec, program_text);
+
+	Grammar grammar = make_grammar(spec);
+	grammar.disambiguate(spec.syntax_disambiguation);
+	SECTION("every rule") {
+	}
+	SECTION("skipped unit rules") {
+		grammar.collapse_unit_chains();
+	}
+	SECTION("profiled") {
+		grammar.collapse_unit_chains();
+		ParseProfile profile;
+		add_to_profile(profile, grammar.get_rules(), grammar.parse(tokens));
+		grammar.use_parse_profile(profile);
+	}
+
+	const std::string file_name = "test_spilled_items.bin";
+	REQUIRE(
+		same_tree(grammar.parse_spilling_finished_items(tokens, file_name),
+				  grammar.parse(tokens)));
+
+	// the spilled items are removed once the parse tree is built
+	REQUIRE_FALSE(std::ifstream{file_name}.is_open());
+	REQUIRE_FALSE(std::ifstream{file_name + ".unsorted"}.is_open());
+
+	const std::vector<Token> incomplete(tokens.begin(), tokens.end() - 1);
+	REQUIRE_THROWS_AS(
+		grammar.parse_spilling_finished_items(incomplete, file_name),
+		std::logic_error);
+	REQUIRE_FALSE(std::ifstream{file_name + ".unsorted"}.is_open());
+}
@@ -1,6 +1,23 @@
-#include <string>  // std::string
+#include <cstddef>	   // std::size_t
+#include <filesystem>  // std::filesystem
+#include <fstream>	   // std::ifstream, std::ofstream
+#include <ios>		   // std::ios
+#include <iterator>	   // std::istreambuf_iterator
+#include <set>		   // std::set
+#include <string>	   // std::string, std::to_string
+#include <thread>	   // std::thread
+#include <vector>	   // std::vector
 
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // FollowRestriction
+#include <TMCompiler/compiler/models/embedded_specification.hpp>  // embedded_language_specification
+#include <TMCompiler/compiler/models/grammar.hpp>			// Grammar
+#include <TMCompiler/compiler/models/grammar_analysis.hpp>	// GrammarAnalysis
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>	// GrammarSymbol
 #include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/language_tables.hpp>  // language_grammar
+#include <TMCompiler/compiler/models/rule.hpp>			   // Rule
+#include <TMCompiler/compiler/models/static_grammar.hpp>  // static_first_sets, static_nullable, static_set_contains, static_symbol_index
+#include <TMCompiler/compiler/models/specification_cache.hpp>  // hash_specification_text, read_language_specification_cached, read_specification_cache, write_specification_cache
 // #include <TMCompiler/utils/logger/logger.hpp>  // logger
 
 #include <catch2/catch_test_macros.hpp>
@@ -21,3 +38,237 @@ TEST_CASE("Reads TOML file") {
 	REQUIRE(!spec.syntax_main.empty());
 	REQUIRE(!spec.syntax_rules.empty());
 }
+
+TEST_CASE("Reads syntax restrictions") {
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	// precedence follows from the layered expression rules
+	REQUIRE(spec.syntax_disambiguation.precedence.empty());
+
+	// the if without else may not be followed by else
+	REQUIRE(spec.syntax_disambiguation.restrictions.size() == 1);
+	const FollowRestriction& restriction =
+		spec.syntax_disambiguation.restrictions[0];
+	REQUIRE(restriction.rule.production.value == "selection-statement");
+	REQUIRE(restriction.rule.replacement.size() == 5);
+	REQUIRE(restriction.tokens == std::set<std::string>{"else"});
+}
+
+TEST_CASE("Reads EBNF operators") {
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+
+	std::set<std::string> repeated;
+	bool plus_token = false;
+	for(const Rule& rule : spec.syntax_rules) {
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			if(symbol.repetition != '\0') {
+				REQUIRE(!symbol.terminal);
+				repeated.insert(symbol.value + symbol.repetition);
+			}
+			plus_token = plus_token || (symbol.terminal && symbol.value == "+");
+		}
+	}
+
+	REQUIRE(repeated.count("statement+") == 1);
+	REQUIRE(repeated.count("statements?") == 1);
+	REQUIRE(repeated.count("next-argument*") == 1);
+
+	// operators like "+" stay tokens
+	REQUIRE(plus_token);
+}
+
+namespace {
+
+auto same_symbols(const GrammarSymbol& a, const GrammarSymbol& b) -> bool {
+	return a.value == b.value && a.terminal == b.terminal &&
+		   a.repetition == b.repetition;
+}
+
+auto same_rules(const std::vector<Rule>& a, const std::vector<Rule>& b)
+	-> bool {
+	if(a.size() != b.size()) {
+		return false;
+	}
+
+	for(std::size_t i = 0; i < a.size(); ++i) {
+		if(!same_symbols(a[i].production, b[i].production) ||
+		   a[i].replacement.size() != b[i].replacement.size()) {
+			return false;
+		}
+		for(std::size_t j = 0; j < a[i].replacement.size(); ++j) {
+			if(!same_symbols(a[i].replacement[j], b[i].replacement[j])) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}  // namespace
+
+TEST_CASE("Reads the specification back from its cache") {
+	const std::string spec_file_name = "test_specification_cache.toml";
+	const std::string cache_file_name = spec_file_name + ".cache";
+	std::filesystem::copy_file(
+		"TMCompiler/config/language.toml",
+		spec_file_name,
+		std::filesystem::copy_options::overwrite_existing);
+	std::filesystem::remove(cache_file_name);
+
+	const auto text_hash = [&spec_file_name]() {
+		std::ifstream spec_file{spec_file_name, std::ios::binary};
+		return hash_specification_text(
+			std::string{std::istreambuf_iterator<char>(spec_file),
+						std::istreambuf_iterator<char>()});
+	};
+
+	const LanguageSpecification toml_spec =
+		LanguageSpecification::read_language_specification_toml(
+			spec_file_name);
+
+	// the first read writes the cache, and the second reads it
+	read_language_specification_cached(spec_file_name);
+	REQUIRE(std::filesystem::exists(cache_file_name));
+	const LanguageSpecification spec =
+		read_language_specification_cached(spec_file_name);
+
+	REQUIRE(spec.spec_file_name == spec_file_name);
+	REQUIRE(spec.title == toml_spec.title);
+	REQUIRE(spec.description == toml_spec.description);
+	REQUIRE(spec.version == toml_spec.version);
+	REQUIRE(spec.syntax_main == toml_spec.syntax_main);
+	REQUIRE(spec.token_patterns == toml_spec.token_patterns);
+	REQUIRE(spec.token_regexes.size() == toml_spec.token_regexes.size());
+	for(std::size_t i = 0; i < spec.token_regexes.size(); ++i) {
+		REQUIRE(spec.token_regexes[i].first ==
+				toml_spec.token_regexes[i].first);
+	}
+	REQUIRE(spec.token_regexes_ignore == toml_spec.token_regexes_ignore);
+	REQUIRE(same_rules(spec.syntax_rules, toml_spec.syntax_rules));
+
+	const std::vector<FollowRestriction>& restrictions =
+		spec.syntax_disambiguation.restrictions;
+	REQUIRE(restrictions.size() == 1);
+	REQUIRE(same_rules({restrictions[0].rule},
+					   {toml_spec.syntax_disambiguation.restrictions[0].rule}));
+	REQUIRE(restrictions[0].tokens == std::set<std::string>{"else"});
+
+	SECTION("a cache of the same TOML contents is read instead of the TOML") {
+		LanguageSpecification changed = toml_spec;
+		changed.title = "Cached Specification";
+		write_specification_cache(changed, text_hash(), cache_file_name);
+
+		REQUIRE(read_language_specification_cached(spec_file_name).title ==
+				"Cached Specification");
+	}
+
+	SECTION("writers at the same time each write a file of their own") {
+		std::vector<std::thread> writers;
+		for(std::size_t i = 0; i < 4; ++i) {
+			writers.emplace_back(
+				[&toml_spec, &text_hash, &cache_file_name, i]() {
+					LanguageSpecification changed = toml_spec;
+					changed.title = "Writer " + std::to_string(i);
+					write_specification_cache(
+						changed, text_hash(), cache_file_name);
+				});
+		}
+		for(std::thread& writer : writers) {
+			writer.join();
+		}
+
+		REQUIRE(read_language_specification_cached(spec_file_name)
+					.title.rfind("Writer ", 0) == 0);
+		for(const auto& entry : std::filesystem::directory_iterator{"."}) {
+			REQUIRE(entry.path().filename().string().rfind(
+						cache_file_name + ".", 0) != 0);
+		}
+	}
+
+	SECTION("changed TOML contents are read again") {
+		std::ofstream{spec_file_name, std::ios::app} << "# changed\n";
+		REQUIRE_FALSE(
+			read_specification_cache(cache_file_name, text_hash()).has_value());
+
+		REQUIRE(read_language_specification_cached(spec_file_name).title ==
+				toml_spec.title);
+		REQUIRE(
+			read_specification_cache(cache_file_name, text_hash()).has_value());
+	}
+
+	SECTION("a damaged cache is read again from the TOML") {
+		std::filesystem::resize_file(
+			cache_file_name, std::filesystem::file_size(cache_file_name) / 2);
+		REQUIRE_FALSE(
+			read_specification_cache(cache_file_name, text_hash()).has_value());
+
+		REQUIRE(same_rules(
+			read_language_specification_cached(spec_file_name).syntax_rules,
+			toml_spec.syntax_rules));
+	}
+
+	std::filesystem::remove(spec_file_name);
+	std::filesystem::remove(cache_file_name);
+}
+
+TEST_CASE("Tables generated at build time match the TOML file") {
+	const LanguageSpecification toml_spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	const LanguageSpecification spec = embedded_language_specification();
+
+	REQUIRE(spec.spec_file_name == toml_spec.spec_file_name);
+	REQUIRE(spec.title == toml_spec.title);
+	REQUIRE(spec.version == toml_spec.version);
+	REQUIRE(spec.syntax_main == toml_spec.syntax_main);
+	REQUIRE(spec.token_patterns == toml_spec.token_patterns);
+	REQUIRE(spec.token_regexes_ignore == toml_spec.token_regexes_ignore);
+	REQUIRE(same_rules(spec.syntax_rules, toml_spec.syntax_rules));
+	REQUIRE(spec.syntax_disambiguation.precedence.size() ==
+			toml_spec.syntax_disambiguation.precedence.size());
+	REQUIRE(spec.syntax_disambiguation.restrictions.size() == 1);
+	REQUIRE(spec.syntax_disambiguation.restrictions[0].tokens ==
+			toml_spec.syntax_disambiguation.restrictions[0].tokens);
+
+	// lookups in the tables are constant expressions
+	constexpr std::size_t if_symbol =
+		static_symbol_index(language_grammar, "if", true);
+	static_assert(if_symbol < language_grammar.symbols.values.size());
+	static_assert(static_symbol_index(language_grammar, "if", false) ==
+				  language_grammar.symbols.values.size());
+
+	// the analysis at compile time agrees with the one at run time
+	std::set<std::string> token_names;
+	for(const auto& token_regex : toml_spec.token_regexes) {
+		token_names.insert(token_regex.first);
+	}
+	const Grammar grammar{
+		toml_spec.syntax_rules, toml_spec.syntax_main, token_names};
+	const GrammarAnalysis& analysis = grammar.get_analysis();
+
+	constexpr auto nullable = static_nullable(language_grammar);
+	constexpr auto first = static_first_sets(language_grammar);
+	const auto& values = language_grammar.symbols.values;
+	for(std::size_t symbol = 0; symbol < values.size(); ++symbol) {
+		const std::string value{values[symbol]};
+		if(language_grammar.symbols.terminal[symbol] ||
+		   analysis.nonterminals.count(value) == 0) {
+			continue;
+		}
+
+		REQUIRE(nullable[symbol] == (analysis.nullable.count(value) == 1));
+
+		std::set<std::string> first_values;
+		for(std::size_t other = 0; other < values.size(); ++other) {
+			if(static_set_contains(first[symbol], other)) {
+				first_values.insert(std::string{values[other]});
+			}
+		}
+		REQUIRE(first_values == analysis.first.at(value));
+	}
+}
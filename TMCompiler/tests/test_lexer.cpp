@@ -43,3 +43,34 @@ TEST_CASE("test_lexer_comment_0") {
 	REQUIRE(tokens.size() == 1);
 	REQUIRE(tokens[0].type == "block-comment");
 }
+
+TEST_CASE("operators of two characters are single tokens") {
+	const LanguageSpecification spec =
+		LanguageSpecification::read_language_specification_toml(
+			"TMCompiler/config/language.toml");
+	Lexer lexer(spec.token_regexes);
+
+	lexer.set_text("a<=b==c&&d||!e+=f-g!=h");
+	std::vector<std::string> values;
+
+	while(lexer.has_next_token()) {
+		values.push_back(lexer.get_next_token().value);
+	}
+
+	REQUIRE(values == std::vector<std::string>{"a",
+											   "<=",
+											   "b",
+											   "==",
+											   "c",
+											   "&&",
+											   "d",
+											   "||",
+											   "!",
+											   "e",
+											   "+=",
+											   "f",
+											   "-",
+											   "g",
+											   "!=",
+											   "h"});
+}
@@ -0,0 +1,416 @@
+/**
+ * Generate a header of constexpr tables from a language specification: its
+ * symbols, its rules flattened into arrays of symbol indices, the rules of
+ * each non-terminal, its token regexes and its disambiguation declarations.
+ * embedded_specification.cpp builds the LanguageSpecification of tmc from
+ * these tables, so tmc does not read the TOML file when it starts. CMake runs
+ * it whenever the TOML file changes:
+ *
+ * generate_language_tables TMCompiler/config/language.toml language_tables.hpp
+ */
+
+#include <cstddef>	  // std::size_t
+#include <exception>  // std::exception
+#include <fstream>	  // std::ofstream
+#include <iostream>	  // std::cerr, std::endl
+#include <map>		  // std::map
+#include <ostream>	  // std::ostream
+#include <set>		  // std::set
+#include <sstream>	  // std::stringstream
+#include <string>	  // std::string, std::to_string
+#include <utility>	  // std::make_pair, std::pair
+#include <vector>	  // std::vector
+
+#include <TMCompiler/compiler/models/disambiguation.hpp>  // FollowRestriction, PrecedenceLevel
+#include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
+#include <TMCompiler/compiler/models/language_specification.hpp>  // LanguageSpecification
+#include <TMCompiler/compiler/models/rule.hpp>					  // Rule
+
+// widest line of the generated arrays
+constexpr std::size_t max_line_length = 80;
+
+// StaticRules of some rules, as generated
+struct GeneratedRules {
+	// like "2, 3" for StaticRules<2, 3>
+	std::string template_arguments;
+	std::string initializer;
+};
+
+// symbols of the tables, in the order they are first used
+struct TableSymbols {
+	std::vector<std::string> values;
+	std::vector<bool> terminal;
+	std::map<std::pair<std::string, bool>, std::size_t> indices;
+};
+
+/**
+ * @param symbols: symbols of the tables so far
+ * @param value: value of a symbol
+ * @param terminal: whether the symbol is terminal
+ * @return index of the symbol, added to symbols if it is new
+ */
+auto intern_symbol(TableSymbols& symbols,
+				   const std::string& value,
+				   const bool terminal) -> std::size_t {
+	const auto found = symbols.indices.find(std::make_pair(value, terminal));
+	if(found != symbols.indices.end()) {
+		return found->second;
+	}
+
+	const std::size_t index = symbols.values.size();
+	symbols.values.push_back(value);
+	symbols.terminal.push_back(terminal);
+	symbols.indices.emplace(std::make_pair(value, terminal), index);
+	return index;
+}
+
+/**
+ * @param text: any string
+ * @return C++ string literal of text
+ */
+auto to_string_literal(const std::string& text) -> std::string {
+	std::string literal = "\"";
+	for(const char c : text) {
+		const auto byte = static_cast<unsigned char>(c);
+		if(c == '"' || c == '\\') {
+			literal += '\\';
+			literal += c;
+		} else if(byte < ' ' || byte >= 0x7F) {
+			// three octal digits, so that no digit after it joins the escape
+			literal += '\\';
+			literal += static_cast<char>('0' + ((byte >> 6U) & 7U));
+			literal += static_cast<char>('0' + ((byte >> 3U) & 7U));
+			literal += static_cast<char>('0' + (byte & 7U));
+		} else {
+			literal += c;
+		}
+	}
+
+	return literal + "\"";
+}
+
+/**
+ * @param c: EBNF operator of a symbol, or '\0'
+ * @return C++ character literal of c
+ */
+auto to_char_literal(const char c) -> std::string {
+	if(c == '\0') {
+		return "'\\0'";
+	}
+
+	return std::string{'\'', c, '\''};
+}
+
+/**
+ * @param elements: initializers of the elements of a std::array
+ * @param indent: tabs before each line, the first one included
+ * @return initializer of the std::array, with lines wrapped
+ */
+auto to_array_initializer(const std::vector<std::string>& elements,
+						  const std::size_t indent) -> std::string {
+	if(elements.empty()) {
+		return "{}";
+	}
+
+	const std::string line_start = "\n" + std::string(indent, '\t');
+	// tabs are 4 columns wide
+	const std::size_t start_column = 4 * indent;
+
+	std::string initializer = "{{";
+	std::size_t column = start_column + initializer.size();
+	for(std::size_t i = 0; i < elements.size(); ++i) {
+		const std::string element =
+			elements[i] + (i + 1 < elements.size() ? "," : "}}");
+		if(i > 0 && column + 1 + element.size() > max_line_length) {
+			initializer += line_start;
+			column = start_column;
+		} else if(i > 0) {
+			initializer += " ";
+			++column;
+		}
+
+		initializer += element;
+		column += element.size();
+	}
+
+	return initializer;
+}
+
+/**
+ * @param values: numbers
+ * @return their initializers
+ */
+auto to_number_elements(const std::vector<std::size_t>& values)
+	-> std::vector<std::string> {
+	std::vector<std::string> elements;
+	for(const std::size_t value : values) {
+		elements.push_back(std::to_string(value));
+	}
+
+	return elements;
+}
+
+/**
+ * @param values: strings
+ * @return their initializers, as std::string_view literals
+ */
+auto to_string_elements(const std::vector<std::string>& values)
+	-> std::vector<std::string> {
+	std::vector<std::string> elements;
+	for(const std::string& value : values) {
+		elements.push_back(to_string_literal(value));
+	}
+
+	return elements;
+}
+
+/**
+ * @param values: flags
+ * @return their initializers
+ */
+auto to_bool_elements(const std::vector<bool>& values)
+	-> std::vector<std::string> {
+	std::vector<std::string> elements;
+	for(const bool value : values) {
+		elements.emplace_back(value ? "true" : "false");
+	}
+
+	return elements;
+}
+
+/**
+ * Flatten rules into a StaticRules.
+ * @param symbols: symbols of the tables, which the symbols of rules are added
+ * to
+ * @param rules: rules of the specification
+ * @return the StaticRules
+ */
+auto to_static_rules(TableSymbols& symbols, const std::vector<Rule>& rules)
+	-> GeneratedRules {
+	std::vector<std::size_t> productions;
+	std::vector<std::size_t> replacement_offsets{0};
+	std::vector<std::size_t> replacement_symbols;
+	std::vector<std::string> repetitions;
+
+	for(const Rule& rule : rules) {
+		productions.push_back(
+			intern_symbol(symbols, rule.production.value, false));
+		for(const GrammarSymbol& symbol : rule.replacement) {
+			replacement_symbols.push_back(
+				intern_symbol(symbols, symbol.value, symbol.terminal));
+			repetitions.push_back(to_char_literal(symbol.repetition));
+		}
+		replacement_offsets.push_back(replacement_symbols.size());
+	}
+
+	const std::string template_arguments =
+		std::to_string(rules.size()) + ", " +
+		std::to_string(replacement_symbols.size());
+	const std::string initializer =
+		"{\n\t" + to_array_initializer(to_number_elements(productions), 1) +
+		",\n\t" +
+		to_array_initializer(to_number_elements(replacement_offsets), 1) +
+		",\n\t" +
+		to_array_initializer(to_number_elements(replacement_symbols), 1) +
+		",\n\t" + to_array_initializer(repetitions, 1) + ",\n}";
+
+	return {template_arguments, initializer};
+}
+
+/**
+ * Write the header of tables of spec.
+ * @param spec: language specification
+ * @param out: stream of the header
+ */
+auto write_language_tables(const LanguageSpecification& spec, std::ostream& out)
+	-> void {
+	TableSymbols symbols;
+
+	const GeneratedRules syntax_rules =
+		to_static_rules(symbols, spec.syntax_rules);
+	const std::size_t main_symbol =
+		intern_symbol(symbols, spec.syntax_main, false);
+
+	std::vector<std::string> associativities;
+	std::vector<std::size_t> precedence_offsets{0};
+	std::vector<Rule> precedence_rules;
+	for(const PrecedenceLevel& level : spec.syntax_disambiguation.precedence) {
+		associativities.push_back(level.associativity);
+		precedence_rules.insert(
+			precedence_rules.end(), level.rules.begin(), level.rules.end());
+		precedence_offsets.push_back(precedence_rules.size());
+	}
+
+	std::vector<Rule> restriction_rules;
+	std::vector<std::size_t> restriction_token_offsets{0};
+	std::vector<std::string> restriction_tokens;
+	for(const FollowRestriction& restriction :
+		spec.syntax_disambiguation.restrictions) {
+		restriction_rules.push_back(restriction.rule);
+		restriction_tokens.insert(restriction_tokens.end(),
+								  restriction.tokens.begin(),
+								  restriction.tokens.end());
+		restriction_token_offsets.push_back(restriction_tokens.size());
+	}
+
+	const GeneratedRules static_precedence_rules =
+		to_static_rules(symbols, precedence_rules);
+	const GeneratedRules static_restriction_rules =
+		to_static_rules(symbols, restriction_rules);
+
+	// the rules of each symbol, and the symbols that the lexer parses
+	std::vector<std::string> token_names;
+	std::vector<bool> token_ignored;
+	for(const auto& token_regex : spec.token_regexes) {
+		token_names.push_back(token_regex.first);
+		token_ignored.push_back(spec.token_regexes_ignore.count(
+									token_regex.first) != 0);
+	}
+	const std::set<std::string> token_name_set(token_names.begin(),
+											   token_names.end());
+
+	const std::size_t num_symbols = symbols.values.size();
+	std::vector<std::vector<std::size_t>> rules_of_symbols(num_symbols);
+	for(std::size_t rule = 0; rule < spec.syntax_rules.size(); ++rule) {
+		rules_of_symbols[symbols.indices.at(std::make_pair(
+							 spec.syntax_rules[rule].production.value, false))]
+			.push_back(rule);
+	}
+
+	std::vector<std::size_t> symbol_rule_offsets{0};
+	std::vector<std::size_t> symbol_rules;
+	std::vector<bool> lexical;
+	for(std::size_t symbol = 0; symbol < num_symbols; ++symbol) {
+		symbol_rules.insert(symbol_rules.end(),
+							rules_of_symbols[symbol].begin(),
+							rules_of_symbols[symbol].end());
+		symbol_rule_offsets.push_back(symbol_rules.size());
+		lexical.push_back(!symbols.terminal[symbol] &&
+						  rules_of_symbols[symbol].empty() &&
+						  token_name_set.count(symbols.values[symbol]) != 0);
+	}
+
+	const std::string num_tokens = std::to_string(token_names.size());
+	const std::string num_levels = std::to_string(associativities.size());
+	const std::string num_restrictions =
+		std::to_string(restriction_rules.size());
+	const std::string num_restriction_tokens =
+		std::to_string(restriction_tokens.size());
+
+	out << "// Generated by generate_language_tables from "
+		<< spec.spec_file_name << ".\n"
+		<< "// Do not edit: edit the TOML file, and build again.\n\n"
+		<< "#ifndef LANGUAGE_TABLES_HPP\n"
+		<< "#define LANGUAGE_TABLES_HPP\n\n"
+		<< "#include <array>\n"
+		<< "#include <cstddef>\n"
+		<< "#include <string_view>\n\n"
+		<< "#include <TMCompiler/compiler/models/static_grammar.hpp>\n\n";
+
+	out << "constexpr std::string_view language_spec_file_name{"
+		<< to_string_literal(spec.spec_file_name) << "};\n"
+		<< "constexpr std::string_view language_title{"
+		<< to_string_literal(spec.title) << "};\n"
+		<< "constexpr std::string_view language_description{"
+		<< to_string_literal(spec.description) << "};\n"
+		<< "constexpr std::string_view language_version{"
+		<< to_string_literal(spec.version) << "};\n\n";
+
+	out << "// [[token.regexes]]\n"
+		<< "constexpr std::array<std::string_view, " << num_tokens
+		<< "> language_token_names =\n\t"
+		<< to_array_initializer(to_string_elements(token_names), 1) << ";\n"
+		<< "constexpr std::array<std::string_view, " << num_tokens
+		<< "> language_token_patterns =\n\t"
+		<< to_array_initializer(to_string_elements(spec.token_patterns), 1)
+		<< ";\n"
+		<< "constexpr std::array<bool, " << num_tokens
+		<< "> language_token_ignored =\n\t"
+		<< to_array_initializer(to_bool_elements(token_ignored), 1) << ";\n\n";
+
+	out << "// [[syntax.rules]] and [syntax.main]\n"
+		<< "constexpr StaticGrammar<" << num_symbols << ", "
+		<< syntax_rules.template_arguments << "> language_grammar{\n"
+		<< "\t{\n\t\t"
+		<< to_array_initializer(to_string_elements(symbols.values), 2)
+		<< ",\n\t\t"
+		<< to_array_initializer(to_bool_elements(symbols.terminal), 2)
+		<< ",\n\t\t" << to_array_initializer(to_bool_elements(lexical), 2)
+		<< ",\n\t},\n"
+		<< "\t" << main_symbol << ",\n"
+		<< "\t" << syntax_rules.initializer << ",\n"
+		<< "\t"
+		<< to_array_initializer(to_number_elements(symbol_rule_offsets), 1)
+		<< ",\n"
+		<< "\t" << to_array_initializer(to_number_elements(symbol_rules), 1)
+		<< ",\n};\n\n";
+
+	out << "// [[syntax.precedence]]: the rules of level i are\n"
+		<< "// language_precedence_rules language_precedence_offsets[i] up to\n"
+		<< "// language_precedence_offsets[i + 1]\n"
+		<< "constexpr std::array<std::string_view, " << num_levels
+		<< "> language_precedence_associativity =\n\t"
+		<< to_array_initializer(to_string_elements(associativities), 1)
+		<< ";\n"
+		<< "constexpr std::array<std::size_t, " << num_levels
+		<< " + 1> language_precedence_offsets =\n\t"
+		<< to_array_initializer(to_number_elements(precedence_offsets), 1)
+		<< ";\n"
+		<< "constexpr StaticRules<"
+		<< static_precedence_rules.template_arguments
+		<< "> language_precedence_rules"
+		<< static_precedence_rules.initializer << ";\n\n";
+
+	out << "// [[syntax.restrictions]]: rule i may not be followed by\n"
+		<< "// language_restriction_tokens "
+		   "language_restriction_token_offsets[i] up\n"
+		<< "// to language_restriction_token_offsets[i + 1]\n"
+		<< "constexpr StaticRules<"
+		<< static_restriction_rules.template_arguments
+		<< "> language_restriction_rules"
+		<< static_restriction_rules.initializer << ";\n"
+		<< "constexpr std::array<std::size_t, " << num_restrictions
+		<< " + 1> language_restriction_token_offsets =\n\t"
+		<< to_array_initializer(to_number_elements(restriction_token_offsets),
+								1)
+		<< ";\n"
+		<< "constexpr std::array<std::string_view, " << num_restriction_tokens
+		<< "> language_restriction_tokens =\n\t"
+		<< to_array_initializer(to_string_elements(restriction_tokens), 1)
+		<< ";\n\n"
+		<< "#endif\n";
+}
+
+int main(int argc, char* argv[]) {
+	if(argc != 3) {
+		std::cerr << "Usage: " << argv[0]
+				  << " LANGUAGE_TOML OUTPUT_HEADER" << std::endl;
+		return 1;
+	}
+
+	const std::string spec_file_name = argv[1];
+	const std::string header_file_name = argv[2];
+
+	try {
+		const LanguageSpecification spec =
+			LanguageSpecification::read_language_specification_toml(
+				spec_file_name);
+
+		// the header is only opened once the tables are made, so a
+		// specification that fails to read leaves the last header as it was
+		std::stringstream header;
+		write_language_tables(spec, header);
+
+		std::ofstream header_file{header_file_name};
+		header_file << header.str();
+		if(!header_file) {
+			std::cerr << "Unable to write " << header_file_name << std::endl;
+			return 1;
+		}
+	} catch(const std::exception& e) {
+		std::cerr << spec_file_name << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -4,22 +4,59 @@ from typing import Dict, Generator, List, Optional, Set, Tuple
 from rich.panel import Panel
 
 includes_provides: Dict[str, List[str]] = {
-    "algorithm": ["std::max", "std::min"],
+    "algorithm": [
+        "std::fill",
+        "std::is_sorted",
+        "std::lower_bound",
+        "std::max",
+        "std::min",
+        "std::min_element",
+        "std::remove_if",
+        "std::sort",
+        "std::stable_sort",
+        "std::unique",
+    ],
+    "array": ["std::array"],
+    "atomic": ["std::atomic"],
     "cctype": ["std::isspace"],
+    "charconv": ["std::from_chars"],
+    "condition_variable": ["std::condition_variable"],
     "chrono": ["std::chrono"],
-    "cstddef": ["std::ptrdiff_t", "std::size_t"],
-    "ctime": ["std::ctime", "std::time_t"],
+    "cstddef": ["std::max_align_t", "std::ptrdiff_t", "std::size_t"],
+    "cstdio": ["std::remove", "std::rename"],
+    "cstdint": ["std::int64_t", "std::uint32_t", "std::uint64_t"],
+    "cstdlib": ["std::free", "std::malloc"],
+    "cstring": ["std::memcpy", "std::strerror"],
+    "ctime": ["std::ctime", "std::time_t", "std::tm"],
+    "deque": ["std::deque"],
     "exception": ["std::exception"],
-    "fstream": ["std::ifstream"],
-    "iomanip": ["std::setw"],
-    "ios": ["std::ios", "std::ios_base", "std::left", "std::right"],
-    "iostream": ["std::cout", "std::endl", "std::clog"],
+    "filesystem": ["std::filesystem"],
+    "fstream": ["std::ifstream", "std::ofstream"],
+    "functional": ["std::function"],
+    "iomanip": ["std::put_time", "std::setfill", "std::setprecision", "std::setw"],
+    "ios": [
+        "std::dec",
+        "std::fixed",
+        "std::hex",
+        "std::ios",
+        "std::ios_base",
+        "std::left",
+        "std::right",
+        "std::streamsize",
+    ],
+    "iostream": ["std::cout", "std::cerr", "std::endl", "std::clog"],
+    "iterator": ["std::istreambuf_iterator"],
+    "limits": ["std::numeric_limits"],
     "list": ["std::list"],
     "map": ["std::map"],
-    "optional": ["std::optional"],
-    "ostream": ["std::ostream"],
+    "memory": ["std::make_shared", "std::shared_ptr"],
+    "mutex": ["std::lock_guard", "std::mutex", "std::unique_lock"],
+    "new": ["std::bad_alloc"],
+    "optional": ["std::nullopt", "std::optional"],
+    "ostream": ["std::flush", "std::ostream"],
+    "queue": ["std::queue"],
     "regex": ["std::regex", "std::regex_match", "std::regex_search", "std::smatch"],
-    "set": ["std::set"],
+    "set": ["std::multiset", "std::set"],
     "sstream": ["std::stringstream"],
     "stdexcept": [
         "std::invalid_argument",
@@ -27,8 +64,11 @@ includes_provides: Dict[str, List[str]] = {
         "std::runtime_error",
         "std::out_of_range",
     ],
-    "string": ["std::string", "std::to_string", "std::getline"],
+    "string": ["std::string", "std::to_string", "std::getline", "std::stoul"],
     "string_view": ["std::string_view"],
+    "system_error": ["std::errc"],
+    "thread": ["std::this_thread", "std::thread"],
+    "tuple": ["std::make_tuple", "std::tuple"],
     "unordered_map": ["std::unordered_map"],
     "unordered_set": ["std::unordered_set"],
     "utility": ["std::make_pair", "std::pair", "std::move"],
@@ -61,9 +101,20 @@ def what_is_included(lines: List[str]) -> Set[str]:
                 continue
 
             header_name: str = line[1 + begin : end]
+            # errno and the POSIX headers provide names outside of std::
             if not header_name.startswith("TMCompiler") and header_name not in [
                 "toml++/toml.hpp",
                 "catch2/catch_test_macros.hpp",
+                "cerrno",
+                "fcntl.h",
+                "sys/mman.h",
+                "sys/socket.h",
+                "sys/stat.h",
+                "sys/time.h",
+                "sys/un.h",
+                "stdlib.h",
+                "time.h",
+                "unistd.h",
             ]:
                 includes.add(header_name)
 
@@ -137,7 +188,7 @@ def what_is_used(lines: List[str]) -> Set[str]:
                 curr_index + len("std::") <= len(line)
                 and line[curr_index : curr_index + len("std::")] == "std::"
             ):
-                regex_pattern: str = "[^a-z_]"
+                regex_pattern: str = "[^a-z0-9_]"
                 matches: List[Tuple[int, int]] = [
                     m.span()
                     for m in re.finditer(
@@ -7,15 +7,19 @@
 
 #include <chrono>	  // std::chrono
 #include <cstddef>	  // std::size_t
-#include <ctime>	  // std::ctime
-#include <iomanip>	  // std::setw
+#include <ctime>	  // std::time_t, std::tm
+#include <iomanip>	  // std::put_time, std::setw
 #include <ios>		  // std::ios, std::ios_base, std::left, std::right
 #include <iostream>	  // std::clog, std::endl
 #include <map>		  // std::map
-#include <ostream>	  // std::ostream
+#include <mutex>	  // std::lock_guard, std::mutex
+#include <ostream>	  // std::flush, std::ostream
+#include <sstream>	  // std::stringstream
 #include <stdexcept>  // std::invalid_argument
 #include <string>	  // std::string
 
+#include <time.h>  // localtime_r
+
 /**
  * Information associated with each logging level.
  * pretty_name: name of the level, like "WARNING"
@@ -58,6 +62,18 @@ const std::string func_color{"\033[36m"};  // light blue
 // one global logger
 Logger logger{};
 
+// message that a thread is logging: its level, and its text until it is
+// written out
+struct Message {
+	std::string level{"INFO"};
+	std::stringstream text;
+};
+
+thread_local Message message;
+
+// held while a message is written out, so that messages do not interleave
+std::mutex clog_mutex;
+
 /**
  * Retrieve the current time as a string in format hh:mm:ss.
  */
@@ -66,26 +82,21 @@ auto get_current_time() -> std::string {
 		std::chrono::system_clock::now();
 	const std::time_t current_time_2 =
 		std::chrono::system_clock::to_time_t(current_time);
-	const std::string current_time_textual{std::ctime(&current_time_2)};
 
-	// format like
-	// Www Mmm dd hh:mm:ss yyyy\n
-	// 0    5    0123456789
-	// see https://en.cppreference.com/w/cpp/chrono/c/ctime
+	// unlike std::localtime and std::ctime, localtime_r does not share a
+	// buffer between threads
+	std::tm local_time{};
+	localtime_r(&current_time_2, &local_time);
 
-	const std::size_t hour_start_location = std::string("Www Mmm dd ").size();
-	const std::size_t time_format_width = std::string("HH:MM:SS").size();
-
-	// extract out HH:MM:SS as string
-	return current_time_textual.substr(hour_start_location, time_format_width);
+	std::stringstream ss;
+	ss << std::put_time(&local_time, "%H:%M:%S");
+	return ss.str();
 }
 
 /**
  * Constructor. Default logging level at INFO.
  */
-Logger::Logger()
-	: desired_output_level(level_mapping.at("INFO").importance),
-	  message_level(std::string("INFO")) {
+Logger::Logger() : desired_output_level(level_mapping.at("INFO").importance) {
 }
 
 /**
@@ -100,11 +111,11 @@ Logger::Logger()
 auto Logger::log_prefix(const std::string& level,
 						const char* file_name,
 						int line_number,
-						const std::string& func_name) -> void {
-	message_level = level;
+						const char* func_name) -> void {
+	message.level = level;
 
 	// do not log messages beneath the desired level
-	if(desired_output_level > Logger::get_importance(message_level)) {
+	if(!is_reported()) {
 		return;
 	}
 
@@ -120,34 +131,35 @@ auto Logger::log_prefix(const std::string& level,
 			: nice_file_name.substr(1 + last_slash);
 
 	// print message with color and formatting
-	std::clog << reset_color;
-	std::clog << "[ ";
-
-	std::clog << time_color;
-	std::clog << get_current_time();
-
-	std::clog << reset_color;
-	std::clog << " | ";
-
-	std::clog << level_mapping.at(level).color_info;
-	std::clog << std::left << std::setw(max_level_name_size)
-			  << level_mapping.at(level).pretty_name;
-
-	std::clog << reset_color;
-	std::clog << " | ";
-
-	std::clog << file_color;
-	std::clog << truncated_file_name;
-	std::clog << ":";
-	std::clog << func_color;
-	std::clog << func_name;
-	std::clog << ":";
-	std::clog << file_color;
-	std::clog << line_number;
-
-	std::clog << reset_color;
-	std::clog << "] ";
-	std::clog << level_mapping.at(level).color_info;
+	std::ostream& out = message_buffer();
+	out << reset_color;
+	out << "[ ";
+
+	out << time_color;
+	out << get_current_time();
+
+	out << reset_color;
+	out << " | ";
+
+	out << level_mapping.at(level).color_info;
+	out << std::left << std::setw(max_level_name_size)
+		<< level_mapping.at(level).pretty_name;
+
+	out << reset_color;
+	out << " | ";
+
+	out << file_color;
+	out << truncated_file_name;
+	out << ":";
+	out << func_color;
+	out << func_name;
+	out << ":";
+	out << file_color;
+	out << line_number;
+
+	out << reset_color;
+	out << "] ";
+	out << level_mapping.at(level).color_info;
 }
 
 /**
@@ -179,26 +191,56 @@ auto Logger::set_level(const std::string& level_name) -> void {
 // special functions to allow something like "logger << std::endl;"
 // see
 // https://stackoverflow.com/questions/16444119/how-to-write-a-function-wrapper-for-cout-that-allows-for-expressive-syntax
+//
+// manipulators like std::endl end the message, so it is written out
 auto Logger::operator<<(std::ostream& (*f)(std::ostream&)) -> Logger& {
-	if(desired_output_level <= Logger::get_importance(message_level)) {
-		f(std::clog);
+	if(is_reported()) {
+		f(message_buffer());
+		flush_message();
 	}
 
 	return *this;
 }
 
 auto Logger::operator<<(std::ostream& (*f)(std::ios&)) -> Logger& {
-	if(desired_output_level <= Logger::get_importance(message_level)) {
-		f(std::clog);
+	if(is_reported()) {
+		f(message_buffer());
 	}
 
 	return *this;
 }
 
 auto Logger::operator<<(std::ostream& (*f)(std::ios_base&)) -> Logger& {
-	if(desired_output_level <= Logger::get_importance(message_level)) {
-		f(std::clog);
+	if(is_reported()) {
+		f(message_buffer());
 	}
 
 	return *this;
 }
+
+/**
+ * @return true iff the message that the calling thread is logging is at or
+ * above the current logging level
+ */
+auto Logger::is_reported() const -> bool {
+	return desired_output_level <= Logger::get_importance(message.level);
+}
+
+/**
+ * @return buffer of the message that the calling thread is logging
+ */
+auto Logger::message_buffer() -> std::ostream& {
+	return message.text;
+}
+
+/**
+ * Write out the message that the calling thread logged so far, and start an
+ * empty one.
+ */
+auto Logger::flush_message() -> void {
+	const std::string text = message.text.str();
+	message.text.str("");
+
+	const std::lock_guard<std::mutex> lock{clog_mutex};
+	std::clog << text << std::flush;
+}
@@ -9,8 +9,13 @@
  * increasing importance: DEBUG, INFO, WARNING, ERROR, CRITICAL.
  *
  * Set the current level of logging with set_level(new_level).
+ *
+ * Logging is thread-safe: each thread writes its message to its own buffer,
+ * and the buffer is written out at once on std::endl, so the lines of
+ * different threads do not interleave.
  */
 
+#include <atomic>	// std::atomic
 #include <ios>		// std::ios, std::ios_base
 #include <ostream>	// std::ostream
 #include <string>	// std::string
@@ -40,10 +45,8 @@
  * [22:54:10 CRITICAL     logging.cpp:88   ] this is critical
  */
 #define LOG(level)                                                      \
-	logger.log_prefix(level,                                            \
-					  __FILE__,                                         \
-					  __LINE__,                                         \
-					  std::string(static_cast<const char*>(__func__))); \
+	logger.log_prefix(                                                  \
+		level, __FILE__, __LINE__, static_cast<const char*>(__func__)); \
 	logger
 
 class Logger {
@@ -65,7 +68,7 @@ public:
 	auto log_prefix(const std::string& level,
 					const char* file_name,
 					int line_number,
-					const std::string& func_name) -> void;
+					const char* func_name) -> void;
 
 	/**
 	 * Output operator, like std::cout's.
@@ -105,10 +108,23 @@ public:
 
 private:
 	// all log levels below desired are not reported
-	int desired_output_level;
+	std::atomic<int> desired_output_level;
 
-	// temporary storage of each log's level
-	std::string message_level;
+	/**
+	 * @return true iff the message that the calling thread is logging is at
+	 * or above the current logging level
+	 */
+	[[nodiscard]] auto is_reported() const -> bool;
+
+	/**
+	 * @return buffer of the message that the calling thread is logging
+	 */
+	static auto message_buffer() -> std::ostream&;
+
+	/**
+	 * Write out the message that the calling thread logged so far.
+	 */
+	static auto flush_message() -> void;
 };
 
 // implementation of template functions
@@ -1,5 +1,3 @@
-#include <iostream>
-
 /**
  * Output operator, like std::cout's.
  * @param val: any value that std::cout's << operator takes in
@@ -8,10 +6,10 @@
 template <typename T>
 auto Logger::operator<<(T val) -> Logger& {
 	// do not log messages beneath the desired level
-	if(desired_output_level > Logger::get_importance(message_level)) {
+	if(!is_reported()) {
 		return *this;
 	}
 
-	std::clog << val;
+	message_buffer() << val;
 	return *this;
 }
@@ -0,0 +1,277 @@
+#include "tracer.hpp"
+
+/**
+ * Implementation file of tracer.hpp, which times the phases of a compile, and
+ * writes them out for a trace viewer like Perfetto.
+ */
+
+#include <algorithm>  // std::sort
+#include <chrono>	  // std::chrono
+#include <cstddef>	  // std::size_t
+#include <cstdint>	  // std::int64_t
+#include <fstream>	  // std::ofstream
+#include <iomanip>	  // std::setfill, std::setw
+#include <ios>		  // std::dec, std::hex
+#include <iostream>	  // std::endl
+#include <memory>	  // std::make_shared, std::shared_ptr
+#include <mutex>	  // std::lock_guard, std::mutex
+#include <set>		  // std::set
+#include <sstream>	  // std::stringstream
+#include <stdexcept>  // std::runtime_error
+#include <string>	  // std::string
+#include <utility>	  // std::move
+#include <vector>	  // std::vector
+
+#include <TMCompiler/utils/logger/logger.hpp>  // LOG
+
+// one global tracer
+Tracer tracer{};
+
+// buffer that the calling thread records its spans to, once it recorded one
+thread_local std::shared_ptr<ThreadTrace> thread_trace;
+
+/**
+ * @return nanoseconds of the steady clock, which never goes back
+ */
+auto steady_nanoseconds() -> std::int64_t {
+	return static_cast<std::int64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch())
+			.count());
+}
+
+/**
+ * Write nanoseconds as microseconds, the unit of trace-event timestamps,
+ * without losing precision to a floating-point number.
+ *
+ * @param nanoseconds: non-negative duration
+ * @return nanoseconds / 1000 with three decimals, like "12.345"
+ */
+auto trace_microseconds(const std::int64_t nanoseconds) -> std::string {
+	std::stringstream ss;
+	ss << nanoseconds / 1000 << "." << std::setfill('0') << std::setw(3)
+	   << nanoseconds % 1000;
+	return ss.str();
+}
+
+/**
+ * @param text: any text, like the name of a file
+ * @return text as a JSON string, in quotes
+ */
+auto trace_json_string(const std::string& text) -> std::string {
+	std::stringstream ss;
+	ss << '"';
+	for(const char c : text) {
+		if(c == '"' || c == '\\') {
+			ss << '\\' << c;
+		} else if(static_cast<unsigned char>(c) < 0x20) {
+			ss << "\\u" << std::hex << std::setfill('0') << std::setw(4)
+			   << static_cast<int>(c) << std::dec;
+		} else {
+			ss << c;
+		}
+	}
+	ss << '"';
+	return ss.str();
+}
+
+/**
+ * Constructor. Nothing is recorded until start().
+ */
+Tracer::Tracer() : started(false), epoch(0) {
+}
+
+/**
+ * Forget the spans recorded so far, and record the spans after. Timestamps
+ * count from now.
+ */
+auto Tracer::start() -> void {
+	const std::lock_guard<std::mutex> lock{buffers_mutex};
+	for(const std::shared_ptr<ThreadTrace>& buffer : buffers) {
+		const std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+		buffer->events.clear();
+	}
+
+	epoch = steady_nanoseconds();
+	started = true;
+}
+
+/**
+ * Record no more spans. The spans recorded so far are kept, to be written
+ * out.
+ */
+auto Tracer::stop() -> void {
+	started = false;
+}
+
+/**
+ * @return true iff spans are recorded
+ */
+auto Tracer::is_started() const -> bool {
+	return started;
+}
+
+/**
+ * @return nanoseconds since start()
+ */
+auto Tracer::now() const -> std::int64_t {
+	return steady_nanoseconds() - epoch;
+}
+
+/**
+ * Add a finished span to the buffer of the calling thread. Only that thread
+ * adds to its buffer, so its lock is only waited on while the spans are
+ * written out.
+ *
+ * @param name: name of the phase, a string literal
+ * @param detail: what the phase worked on, or empty
+ * @param start: now() at the start of the span
+ * @param end: now() at the end of the span
+ */
+auto Tracer::record(const char* name,
+					std::string detail,
+					const std::int64_t start,
+					const std::int64_t end) -> void {
+	ThreadTrace& buffer = thread_buffer();
+
+	const std::lock_guard<std::mutex> lock{buffer.mutex};
+	buffer.events.push_back(
+		TraceEvent{name, std::move(detail), start, end - start, buffer.thread});
+}
+
+/**
+ * @return spans recorded by all threads, by thread and then by start. Of spans
+ * that start at once, the longer one comes first, as it holds the others.
+ */
+auto Tracer::get_events() const -> std::vector<TraceEvent> {
+	std::vector<TraceEvent> events;
+	{
+		const std::lock_guard<std::mutex> lock{buffers_mutex};
+		for(const std::shared_ptr<ThreadTrace>& buffer : buffers) {
+			const std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+			events.insert(
+				events.end(), buffer->events.begin(), buffer->events.end());
+		}
+	}
+
+	std::sort(events.begin(),
+			  events.end(),
+			  [](const TraceEvent& a, const TraceEvent& b) {
+				  if(a.thread != b.thread) {
+					  return a.thread < b.thread;
+				  }
+				  if(a.start != b.start) {
+					  return a.start < b.start;
+				  }
+				  return a.duration > b.duration;
+			  });
+
+	return events;
+}
+
+/**
+ * Write the recorded spans in the trace-event JSON format of Chrome: each span
+ * is a complete event, whose timestamp and duration are in microseconds, and
+ * each thread is named by a metadata event.
+ *
+ * See
+ * https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+ *
+ * @return recorded spans, as a JSON object with one event per line
+ */
+auto Tracer::to_chrome_trace() const -> std::string {
+	const std::vector<TraceEvent> events = get_events();
+
+	std::set<std::size_t> threads;
+	for(const TraceEvent& event : events) {
+		threads.insert(event.thread);
+	}
+
+	std::stringstream ss;
+	ss << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	const char* separator = "\n";
+	for(const std::size_t thread : threads) {
+		ss << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		   << "\"tid\":" << thread << ",\"args\":{\"name\":\"thread "
+		   << thread << "\"}}";
+		separator = ",\n";
+	}
+
+	for(const TraceEvent& event : events) {
+		ss << separator << "{\"name\":" << trace_json_string(event.name)
+		   << ",\"cat\":\"tmc\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+		   << event.thread << ",\"ts\":" << trace_microseconds(event.start)
+		   << ",\"dur\":" << trace_microseconds(event.duration);
+		if(!event.detail.empty()) {
+			ss << ",\"args\":{\"detail\":" << trace_json_string(event.detail)
+			   << "}";
+		}
+		ss << "}";
+		separator = ",\n";
+	}
+
+	ss << "\n]}\n";
+	return ss.str();
+}
+
+/**
+ * Write to_chrome_trace() to a file.
+ * @param file_name: path of the file to write
+ */
+auto Tracer::write_chrome_trace(const std::string& file_name) const -> void {
+	std::ofstream trace_file{file_name};
+	if(!trace_file.is_open()) {
+		LOG("ERROR") << "Unable to write trace to " << file_name << std::endl;
+		throw std::runtime_error("Unable to write trace to " + file_name);
+	}
+
+	trace_file << to_chrome_trace();
+}
+
+/**
+ * @return buffer of the calling thread. A thread registers its buffer on its
+ * first span, and the tracer keeps it after the thread exits, so that the
+ * spans of a pool of threads are written out once the pool is done.
+ */
+auto Tracer::thread_buffer() -> ThreadTrace& {
+	if(!thread_trace) {
+		thread_trace = std::make_shared<ThreadTrace>();
+
+		const std::lock_guard<std::mutex> lock{buffers_mutex};
+		thread_trace->thread = buffers.size();
+		buffers.push_back(thread_trace);
+	}
+
+	return *thread_trace;
+}
+
+/**
+ * Start a span of the scope it is declared in.
+ * @param _name: name of the phase, a string literal
+ */
+TraceSpan::TraceSpan(const char* _name) : TraceSpan(_name, std::string{}) {
+}
+
+/**
+ * Start a span of the scope it is declared in. Reading the clock is skipped
+ * unless the tracer is started, so spans cost next to nothing otherwise.
+ *
+ * @param _name: name of the phase, a string literal
+ * @param _detail: what the phase works on, like the name of a file
+ */
+TraceSpan::TraceSpan(const char* _name, std::string _detail)
+	: name(_name),
+	  detail(std::move(_detail)),
+	  recording(tracer.is_started()),
+	  start(recording ? tracer.now() : 0) {
+}
+
+/**
+ * Record the span, if the tracer was started when it began.
+ */
+TraceSpan::~TraceSpan() {
+	if(recording) {
+		tracer.record(name, std::move(detail), start, tracer.now());
+	}
+}
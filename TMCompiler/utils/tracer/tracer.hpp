@@ -0,0 +1,162 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+/**
+ * Tracing system for finding where the time of a compile goes, without an
+ * external profiler.
+ *
+ * Put a TraceSpan at the start of a phase, like lexing or building the parse
+ * tree: it records when the phase starts, and how long it takes, in
+ * nanoseconds. Spans nest, so a phase is broken down by the spans inside it.
+ *
+ * Nothing is recorded until tracer.start(). Each thread records its spans to
+ * its own buffer, so threads do not wait on each other while tracing. Write
+ * the spans of all threads with tracer.write_chrome_trace(file_name), and
+ * open the file in https://ui.perfetto.dev or chrome://tracing.
+ *
+ * Example usage:
+ * tracer.start();
+ * {
+ *     const TraceSpan span{"lex", file_name};
+ *     ...
+ * }
+ * tracer.write_chrome_trace("trace.json");
+ */
+
+#include <atomic>	// std::atomic
+#include <cstddef>	// std::size_t
+#include <cstdint>	// std::int64_t
+#include <memory>	// std::shared_ptr
+#include <mutex>	// std::mutex
+#include <string>	// std::string
+#include <vector>	// std::vector
+
+// one finished span
+struct TraceEvent {
+	// name of the phase, a string literal
+	const char* name;
+	// what the phase worked on, like the name of the file, or empty
+	std::string detail;
+	// nanoseconds from tracer.start() to the start of the span
+	std::int64_t start;
+	std::int64_t duration;
+	// index of the thread that recorded the span, in the order that threads
+	// first recorded a span
+	std::size_t thread;
+};
+
+// spans recorded by one thread
+struct ThreadTrace {
+	std::mutex mutex;
+	std::size_t thread;
+	std::vector<TraceEvent> events;
+};
+
+class Tracer {
+public:
+	/**
+	 * Constructor. Nothing is recorded until start().
+	 */
+	Tracer();
+
+	/**
+	 * Forget the spans recorded so far, and record the spans after.
+	 */
+	auto start() -> void;
+
+	/**
+	 * Record no more spans. The spans recorded so far are kept.
+	 */
+	auto stop() -> void;
+
+	/**
+	 * @return true iff spans are recorded
+	 */
+	[[nodiscard]] auto is_started() const -> bool;
+
+	/**
+	 * @return nanoseconds since start()
+	 */
+	[[nodiscard]] auto now() const -> std::int64_t;
+
+	/**
+	 * Add a finished span to the buffer of the calling thread.
+	 * @param name: name of the phase, a string literal
+	 * @param detail: what the phase worked on, or empty
+	 * @param start: now() at the start of the span
+	 * @param end: now() at the end of the span
+	 */
+	auto record(const char* name,
+				std::string detail,
+				std::int64_t start,
+				std::int64_t end) -> void;
+
+	/**
+	 * @return spans recorded by all threads, by thread and then by start
+	 */
+	[[nodiscard]] auto get_events() const -> std::vector<TraceEvent>;
+
+	/**
+	 * @return recorded spans in the trace-event JSON format of Chrome, which
+	 * Perfetto reads
+	 */
+	[[nodiscard]] auto to_chrome_trace() const -> std::string;
+
+	/**
+	 * Write to_chrome_trace() to a file.
+	 * @param file_name: path of the file to write
+	 */
+	auto write_chrome_trace(const std::string& file_name) const -> void;
+
+private:
+	std::atomic<bool> started;
+	// steady clock time of start(), in nanoseconds
+	std::atomic<std::int64_t> epoch;
+
+	// buffer of every thread that recorded a span, kept after the thread
+	// exits
+	mutable std::mutex buffers_mutex;
+	std::vector<std::shared_ptr<ThreadTrace> > buffers;
+
+	/**
+	 * @return buffer of the calling thread, registered on its first span
+	 */
+	auto thread_buffer() -> ThreadTrace&;
+};
+
+// one global tracer
+extern Tracer tracer;
+
+// Times the scope it is declared in, if the tracer is started: see the top of
+// this file.
+class TraceSpan {
+public:
+	/**
+	 * @param _name: name of the phase, a string literal
+	 */
+	explicit TraceSpan(const char* _name);
+
+	/**
+	 * @param _name: name of the phase, a string literal
+	 * @param _detail: what the phase works on, like the name of a file
+	 */
+	TraceSpan(const char* _name, std::string _detail);
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan(TraceSpan&&) = delete;
+	auto operator=(const TraceSpan&) -> TraceSpan& = delete;
+	auto operator=(TraceSpan&&) -> TraceSpan& = delete;
+
+	/**
+	 * Record the span, if the tracer was started when it began.
+	 */
+	~TraceSpan();
+
+private:
+	const char* name;
+	std::string detail;
+	bool recording;
+	std::int64_t start;
+};
+
+#endif
@@ -1,16 +1,28 @@
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
 #include <iostream>
 #include <map>
+#include <set>
 #include <string>
+#include <system_error>
 #include <tuple>
 #include <vector>
 
+#include <TMCompiler/compiler/batch_compiler.hpp>  // compile_files, find_source_files, read_file_list, CompileResult
+#include <TMCompiler/compiler/compile_server.hpp>  // send_compile_request, CompileServer
 #include <TMCompiler/compiler/compiler.hpp>
+#include <TMCompiler/compiler/models/embedded_specification.hpp>  // embedded_language_specification
 #include <TMCompiler/compiler/models/grammar_symbol.hpp>  // GrammarSymbol
 #include <TMCompiler/compiler/models/rule.hpp>			  // Rule
 #include <TMCompiler/compiler/models/token.hpp>			  // Token
 #include <TMCompiler/compiler/parser/earley_parser.hpp>
+#include <TMCompiler/compiler/parser/parse_budget.hpp>	// ParseBudget, ParseStatistics, statistics_to_string
 #include <TMCompiler/utils/logger/logger.hpp>
+#include <TMCompiler/utils/tracer/tracer.hpp>  // tracer
 
 std::vector<Rule> get_grammar_rules() {
 	std::vector<Rule> grammar_rules;
@@ -295,23 +307,288 @@ void attempt_parse() {
 	std::cout << "7: Number -> [0-9]" << std::endl;
 }
 
-void trial() {
-	Compiler compiler("TMCompiler/config/language.toml");
+void trial(const std::string& file_name,
+		   const ParseBudget& budget,
+		   const bool show_statistics) {
+	// the language specification as generated at build time, so the TOML
+	// file is not read
+	Compiler compiler(embedded_language_specification());
+	compiler.set_parse_budget(budget);
 
 	std::string program_text{"?"};
 	program_text = "void foo() {}  void main() { foo(); }";
 
 	// compiler.compile_text(program_text);
-	compiler.compile("sample_program.cpp");
+	ParseStatistics statistics;
+	compiler.compile(file_name, statistics);
+
+	if(show_statistics) {
+		std::cout << statistics_to_string(statistics);
+	}
 }
 
-int main() {
+// compile file_names on jobs threads that share one Compiler, and report the
+// outcome of each file. Returns the exit status: 1 if any file failed.
+int batch(const std::vector<std::string>& file_names,
+		  const std::size_t jobs,
+		  const ParseBudget& budget,
+		  const bool show_statistics) {
+	const std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	Compiler compiler(embedded_language_specification());
+	compiler.set_parse_budget(budget);
+	const std::vector<CompileResult> results =
+		compile_files(compiler, file_names, jobs);
+
+	std::size_t failures = 0;
+	for(const CompileResult& result : results) {
+		if(result.success) {
+			std::cout << result.file_name << ": ok (" << result.milliseconds
+					  << " ms)" << std::endl;
+		} else {
+			++failures;
+			std::cout << result.file_name << ": " << result.error << std::endl;
+		}
+
+		if(show_statistics) {
+			std::cout << statistics_to_string(result.statistics);
+		}
+	}
+
+	const auto milliseconds =
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start)
+			.count();
+	std::cout << results.size() - failures << " of " << results.size()
+			  << " files compiled in " << milliseconds << " ms" << std::endl;
+
+	return failures == 0 ? 0 : 1;
+}
+
+// send a compile request for each of file_names to the server on
+// socket_path, and report its answers. Returns the exit status: 1 if any file
+// failed.
+int request(const std::string& socket_path,
+			const std::vector<std::string>& file_names) {
+	std::size_t failures = 0;
+	for(const std::string& file_name : file_names) {
+		// the server may run in another directory
+		const std::string answer = send_compile_request(
+			socket_path,
+			"compile " + std::filesystem::absolute(file_name).string());
+		std::cout << file_name << ": " << answer << std::endl;
+
+		if(answer.rfind("ok", 0) != 0) {
+			++failures;
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
+
+// tmc [--statistics] [--trace FILE] [--jobs N] [--list FILE]
+//     [--max-items N] [--max-milliseconds N] [program|directory ...]
+// tmc --serve SOCKET [--spec FILE] [--trace FILE] [--jobs N] [--max-items N]
+//     [--max-milliseconds N]
+// tmc --server SOCKET [--list FILE] [program|directory ...]
+// tmc --stop-server SOCKET
+//
+// Compiles sample_program.cpp without arguments, and one program in detail.
+// Several programs, a directory of them, a list file of them or --jobs
+// compile them all on N threads, or one per core, with a line per program.
+//
+// --serve keeps a compiler on a Unix socket until it is stopped, and --server
+// has it compile the programs instead of starting a compiler of its own. The
+// server compiles the language that tmc was built with, or the one of the
+// TOML file of --spec, which it reloads when the file changes.
+//
+// --trace times the phases of each compile, on each thread, and writes them
+// to FILE as Chrome trace events, to open in https://ui.perfetto.dev
+//
+// --max-items and --max-milliseconds stop the parse of a program that builds
+// more Earley items, or takes longer, than that
+int main(int argc, char* argv[]) {
+	const std::vector<std::string> args(argv + 1, argv + argc);
+
+	std::vector<std::string> paths;
+	std::vector<std::string> list_file_names;
+	bool show_statistics = false;
+	bool is_batch = false;
+	std::size_t jobs = 0;
+	std::string serve_socket;
+	std::string server_socket;
+	std::string stop_socket;
+	std::string spec_file_name;
+	std::string trace_file_name;
+	ParseBudget budget;
+
+	const auto usage = [&argv]() {
+		std::cerr << "Usage: " << argv[0]
+				  << " [--statistics] [--trace FILE] [--jobs N] [--list FILE]"
+				  << " [--max-items N] [--max-milliseconds N]"
+				  << " [program|directory ...]\n"
+				  << "       " << argv[0]
+				  << " --serve SOCKET [--spec FILE] [--trace FILE] [--jobs N]"
+				  << " [--max-items N] [--max-milliseconds N]\n"
+				  << "       " << argv[0]
+				  << " --server SOCKET [--list FILE] [program|directory ...]\n"
+				  << "       " << argv[0] << " --stop-server SOCKET"
+				  << std::endl;
+		return 1;
+	};
+
+	const std::set<std::string> options_with_values{"--jobs",
+													"--list",
+													"--max-items",
+													"--max-milliseconds",
+													"--serve",
+													"--server",
+													"--spec",
+													"--stop-server",
+													"--trace"};
+
+	// reads all of value as a number into number, and false if it is not one,
+	// or too large for a std::size_t
+	const auto read_number = [](const std::string& value, std::size_t& number) {
+		const char* const end = value.data() + value.size();
+		const auto [rest, error] = std::from_chars(value.data(), end, number);
+		return error == std::errc{} && rest == end;
+	};
+
+	for(std::size_t i = 0; i < args.size(); ++i) {
+		const std::string& arg = args[i];
+		std::size_t number = 0;
+		if(arg == "--statistics") {
+			show_statistics = true;
+		} else if(options_with_values.find(arg) != options_with_values.end() &&
+				  1 + i == args.size()) {
+			std::cerr << "Option " << arg << " needs a value" << std::endl;
+			return usage();
+		} else if((arg == "--jobs" || arg == "--max-items" ||
+				   arg == "--max-milliseconds") &&
+				  !read_number(args[1 + i], number)) {
+			std::cerr << arg << " needs a number, not " << args[1 + i]
+					  << std::endl;
+			return usage();
+		} else if(arg == "--jobs") {
+			++i;
+			jobs = number;
+			is_batch = true;
+		} else if(arg == "--max-items") {
+			++i;
+			budget.max_items = number;
+		} else if(arg == "--max-milliseconds") {
+			++i;
+			budget.max_milliseconds = number;
+		} else if(arg == "--list") {
+			++i;
+			list_file_names.push_back(args[i]);
+			is_batch = true;
+		} else if(arg == "--serve") {
+			++i;
+			serve_socket = args[i];
+		} else if(arg == "--server") {
+			++i;
+			server_socket = args[i];
+		} else if(arg == "--spec") {
+			++i;
+			spec_file_name = args[i];
+		} else if(arg == "--stop-server") {
+			++i;
+			stop_socket = args[i];
+		} else if(arg == "--trace") {
+			++i;
+			trace_file_name = args[i];
+		} else if(arg.rfind("--", 0) == 0) {
+			std::cerr << "Unknown option " << arg << std::endl;
+			return usage();
+		} else {
+			paths.push_back(arg);
+		}
+	}
+
+	// spans are recorded from the start, so that loading the language
+	// specification is traced too
+	if(!trace_file_name.empty()) {
+		tracer.start();
+	}
+
+	// writes the trace once the compiles are done, and passes on the exit
+	// status
+	const auto write_trace = [&trace_file_name](const int status) {
+		if(trace_file_name.empty()) {
+			return status;
+		}
+
+		try {
+			tracer.write_chrome_trace(trace_file_name);
+		} catch(const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+
+		return status;
+	};
+
+	// no server to reach, or another one on the socket, is reported without
+	// a stack of logs
+	try {
+		if(!serve_socket.empty()) {
+			logger.set_level("WARNING");
+			CompileServer server{spec_file_name, serve_socket, budget};
+			server.serve(jobs);
+			return write_trace(0);
+		}
+
+		if(!stop_socket.empty()) {
+			logger.set_level("NONE");
+			std::cout << send_compile_request(stop_socket, "stop")
+					  << std::endl;
+			return 0;
+		}
+	} catch(const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> file_names;
+	for(const std::string& list_file_name : list_file_names) {
+		const std::vector<std::string> listed = read_file_list(list_file_name);
+		file_names.insert(file_names.end(), listed.begin(), listed.end());
+	}
+	for(const std::string& path : paths) {
+		const std::vector<std::string> found = find_source_files(path);
+		is_batch = is_batch || found.size() != 1 || found[0] != path;
+		file_names.insert(file_names.end(), found.begin(), found.end());
+	}
+	is_batch = is_batch || paths.size() > 1;
+
+	if(!server_socket.empty()) {
+		logger.set_level("NONE");
+		try {
+			return request(server_socket, file_names);
+		} catch(const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if(is_batch) {
+		// the outcome of each file is reported on its own line, so only the
+		// problems are logged
+		logger.set_level("WARNING");
+		return write_trace(batch(file_names, jobs, budget, show_statistics));
+	}
+
 	logger.set_level("DEBUG");
 
 	LOG("INFO") << "BEGIN" << std::endl;
 	// attempt_parse();
-	trial();
+	trial(paths.empty() ? "sample_program.cpp" : paths[0],
+		  budget,
+		  show_statistics);
 	LOG("INFO") << "DONE" << std::endl;
 
-	return 0;
+	return write_trace(0);
 }